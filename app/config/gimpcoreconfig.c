@@ -98,8 +98,12 @@ enum
   PROP_DEFAULT_GRID,
   PROP_UNDO_LEVELS,
   PROP_UNDO_SIZE,
+  PROP_UNDO_SWAP,
   PROP_UNDO_PREVIEW_SIZE,
   PROP_FILTER_HISTORY_SIZE,
+  PROP_BRUSH_CACHE_SIZE,
+  PROP_BRUSH_CACHE_ANGLE_STEP,
+  PROP_BRUSH_CACHE_SCALE_STEP,
   PROP_PLUGINRC_PATH,
   PROP_LAYER_PREVIEWS,
   PROP_GROUP_LAYER_PREVIEWS,
@@ -113,6 +117,7 @@ enum
   PROP_IMPORT_PROMOTE_DITHER,
   PROP_IMPORT_ADD_ALPHA,
   PROP_IMPORT_RAW_PLUG_IN,
+  PROP_XCF_LAZY_LOADING,
   PROP_EXPORT_FILE_TYPE,
   PROP_EXPORT_COLOR_PROFILE,
   PROP_EXPORT_COMMENT,
@@ -575,6 +580,13 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                             GIMP_PARAM_STATIC_STRINGS |
                             GIMP_CONFIG_PARAM_CONFIRM);
 
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_UNDO_SWAP,
+                            "undo-swap",
+                            "Undo swap",
+                            UNDO_SWAP_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
   GIMP_CONFIG_PROP_ENUM (object_class, PROP_UNDO_PREVIEW_SIZE,
                          "undo-preview-size",
                          "Undo preview size",
@@ -592,6 +604,27 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                         GIMP_PARAM_STATIC_STRINGS |
                         GIMP_CONFIG_PARAM_RESTART);
 
+  GIMP_CONFIG_PROP_MEMSIZE (object_class, PROP_BRUSH_CACHE_SIZE,
+                            "brush-cache-size",
+                            "Brush cache size",
+                            BRUSH_CACHE_SIZE_BLURB,
+                            0, GIMP_MAX_MEMSIZE, 1 << 25, /* 32MB */
+                            GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_DOUBLE (object_class, PROP_BRUSH_CACHE_ANGLE_STEP,
+                           "brush-cache-angle-step",
+                           "Brush cache angle step",
+                           BRUSH_CACHE_ANGLE_STEP_BLURB,
+                           0.0, 15.0, 0.0,
+                           GIMP_PARAM_STATIC_STRINGS);
+
+  GIMP_CONFIG_PROP_DOUBLE (object_class, PROP_BRUSH_CACHE_SCALE_STEP,
+                           "brush-cache-scale-step",
+                           "Brush cache scale step",
+                           BRUSH_CACHE_SCALE_STEP_BLURB,
+                           0.0, 0.1, 0.0,
+                           GIMP_PARAM_STATIC_STRINGS);
+
   GIMP_CONFIG_PROP_PATH (object_class,
                          PROP_PLUGINRC_PATH,
                          "pluginrc-path",
@@ -733,6 +766,13 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                          GIMP_PARAM_STATIC_STRINGS |
                          GIMP_CONFIG_PARAM_RESTART);
 
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_XCF_LAZY_LOADING,
+                            "xcf-lazy-loading",
+                            "XCF lazy loading",
+                            XCF_LAZY_LOADING_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
   GIMP_CONFIG_PROP_ENUM (object_class, PROP_EXPORT_FILE_TYPE,
                          "export-file-type",
                          "Default export file type",
@@ -1070,12 +1110,24 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_FILTER_HISTORY_SIZE:
       core_config->filter_history_size = g_value_get_int (value);
       break;
+    case PROP_BRUSH_CACHE_SIZE:
+      core_config->brush_cache_size = g_value_get_uint64 (value);
+      break;
+    case PROP_BRUSH_CACHE_ANGLE_STEP:
+      core_config->brush_cache_angle_step = g_value_get_double (value);
+      break;
+    case PROP_BRUSH_CACHE_SCALE_STEP:
+      core_config->brush_cache_scale_step = g_value_get_double (value);
+      break;
     case PROP_UNDO_LEVELS:
       core_config->levels_of_undo = g_value_get_int (value);
       break;
     case PROP_UNDO_SIZE:
       core_config->undo_size = g_value_get_uint64 (value);
       break;
+    case PROP_UNDO_SWAP:
+      core_config->undo_swap = g_value_get_boolean (value);
+      break;
     case PROP_UNDO_PREVIEW_SIZE:
       core_config->undo_preview_size = g_value_get_enum (value);
       break;
@@ -1146,6 +1198,9 @@ gimp_core_config_set_property (GObject      *object,
       g_free (core_config->import_raw_plug_in);
       core_config->import_raw_plug_in = g_value_dup_string (value);
       break;
+    case PROP_XCF_LAZY_LOADING:
+      core_config->xcf_lazy_loading = g_value_get_boolean (value);
+      break;
     case PROP_EXPORT_FILE_TYPE:
       core_config->export_file_type = g_value_get_enum (value);
       break;
@@ -1342,12 +1397,24 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_FILTER_HISTORY_SIZE:
       g_value_set_int (value, core_config->filter_history_size);
       break;
+    case PROP_BRUSH_CACHE_SIZE:
+      g_value_set_uint64 (value, core_config->brush_cache_size);
+      break;
+    case PROP_BRUSH_CACHE_ANGLE_STEP:
+      g_value_set_double (value, core_config->brush_cache_angle_step);
+      break;
+    case PROP_BRUSH_CACHE_SCALE_STEP:
+      g_value_set_double (value, core_config->brush_cache_scale_step);
+      break;
     case PROP_UNDO_LEVELS:
       g_value_set_int (value, core_config->levels_of_undo);
       break;
     case PROP_UNDO_SIZE:
       g_value_set_uint64 (value, core_config->undo_size);
       break;
+    case PROP_UNDO_SWAP:
+      g_value_set_boolean (value, core_config->undo_swap);
+      break;
     case PROP_UNDO_PREVIEW_SIZE:
       g_value_set_enum (value, core_config->undo_preview_size);
       break;
@@ -1411,6 +1478,9 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_IMPORT_RAW_PLUG_IN:
       g_value_set_string (value, core_config->import_raw_plug_in);
       break;
+    case PROP_XCF_LAZY_LOADING:
+      g_value_set_boolean (value, core_config->xcf_lazy_loading);
+      break;
     case PROP_EXPORT_FILE_TYPE:
       g_value_set_enum (value, core_config->export_file_type);
       break;
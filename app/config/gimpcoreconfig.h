@@ -82,8 +82,12 @@ struct _GimpCoreConfig
   GimpGrid               *default_grid;
   gint                    levels_of_undo;
   guint64                 undo_size;
+  gboolean                undo_swap;
   GimpViewSize            undo_preview_size;
   gint                    filter_history_size;
+  guint64                 brush_cache_size;
+  gdouble                 brush_cache_angle_step;
+  gdouble                 brush_cache_scale_step;
   gchar                  *plug_in_rc_path;
   gboolean                layer_previews;
   gboolean                group_layer_previews;
@@ -97,6 +101,7 @@ struct _GimpCoreConfig
   gboolean                import_promote_dither;
   gboolean                import_add_alpha;
   gchar                  *import_raw_plug_in;
+  gboolean                xcf_lazy_loading;
   GimpExportFileType      export_file_type;
   gboolean                export_color_profile;
   gboolean                export_comment;
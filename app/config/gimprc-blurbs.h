@@ -14,6 +14,20 @@ _("When enabled, an image will become the active image when its image " \
   "window receives the focus. This is useful for window managers using " \
   "\"click to focus\".")
 
+#define BRUSH_CACHE_ANGLE_STEP_BLURB \
+"Rounds the angle of transformed brushes to multiples of this many " \
+"degrees, so that brushes rotated by dynamics can be reused from the " \
+"brush cache.  Set to 0 to transform brushes exactly."
+
+#define BRUSH_CACHE_SCALE_STEP_BLURB \
+"Rounds the scale of transformed brushes to steps of this relative size, " \
+"so that brushes scaled by dynamics can be reused from the brush cache.  " \
+"Set to 0 to transform brushes exactly."
+
+#define BRUSH_CACHE_SIZE_BLURB \
+"Sets the maximum amount of memory used by each of the caches of " \
+"transformed brushes, of which every brush in use has several."
+
 #define BRUSH_PATH_BLURB \
 "Sets the brush search path."
 
@@ -226,6 +240,12 @@ _("Add an alpha channel to all layers of imported images.")
 #define IMPORT_RAW_PLUG_IN_BLURB \
 _("Which plug-in to use for importing raw digital camera files.")
 
+#define XCF_LAZY_LOADING_BLURB \
+_("Only read the pixels of XCF layers and channels from the file when they " \
+  "are first accessed.  This makes large files open faster and use less " \
+  "memory, but the file must stay in place while it is open.  Compressed " \
+  "files are always read completely.")
+
 #define EXPORT_FILE_TYPE_BLURB \
 _("Export file type used by default.")
 
@@ -761,6 +781,11 @@ _("Sets an upper limit to the memory that is used per image to keep " \
   "operations on the undo stack. Regardless of this setting, at least " \
   "as many undo-levels as configured can be undone.")
 
+#define UNDO_SWAP_BLURB \
+_("When enabled, image data of older undo steps is compressed in the " \
+  "background and moved to the folder for temporary files. Such steps " \
+  "no longer count against the undo-size limit.")
+
 #define UNDO_PREVIEW_SIZE_BLURB \
 _("Sets the size of the previews in the Undo History.")
 
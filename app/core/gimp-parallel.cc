@@ -46,44 +46,80 @@ extern "C"
 
 
 #define GIMP_PARALLEL_MAX_THREADS           64
-#define GIMP_PARALLEL_RUN_ASYNC_MAX_THREADS  1
+#define GIMP_PARALLEL_RUN_ASYNC_MAX_THREADS GIMP_PARALLEL_MAX_THREADS
+
+#define GIMP_PARALLEL_RUN_ASYNC_THREAD_KEY  "gimp-parallel-run-async-thread"
+#define GIMP_PARALLEL_RUN_ASYNC_TASK_KEY    "gimp-parallel-run-async-task"
 
 
 typedef struct
 {
   GimpAsync        *async;
   gint              priority;
+  guint64           serial;
+  gint              index;
   GimpRunAsyncFunc  func;
   gpointer          user_data;
   GDestroyNotify    user_data_destroy_func;
 } GimpParallelRunAsyncTask;
 
+/* each worker thread owns a binary min-heap of tasks, ordered by priority
+ * and, for equal priorities, by insertion order.  the heap is protected by
+ * the thread's own mutex; idle threads steal the most urgent task from the
+ * other threads' heaps.
+ */
 typedef struct
 {
-  GThread   *thread;
+  GThread    *thread;
 
-  gboolean   quit;
+  GMutex      mutex;
+  GPtrArray  *tasks;
+  gint        n_tasks;
+  guint64     serial;
 
-  GimpAsync *current_async;
+  gint        quit;
+  gboolean    stopped;  /* the thread was joined, and its heap drained;
+                         * protected by the mutex
+                         */
+
+  GimpAsync  *current_async;
 } GimpParallelRunAsyncThread;
 
 
 /*  local function prototypes  */
 
-static void                       gimp_parallel_notify_num_processors   (GimpGeglConfig             *config);
-
-static void                       gimp_parallel_set_n_threads           (gint                        n_threads,
-                                                                         gboolean                    finish_tasks);
-
-static void                       gimp_parallel_run_async_set_n_threads (gint                        n_threads,
-                                                                         gboolean                    finish_tasks);
-static gpointer                   gimp_parallel_run_async_thread_func   (GimpParallelRunAsyncThread *thread);
-static void                       gimp_parallel_run_async_enqueue_task  (GimpParallelRunAsyncTask   *task);
-static GimpParallelRunAsyncTask * gimp_parallel_run_async_dequeue_task  (void);
-static gboolean                   gimp_parallel_run_async_execute_task  (GimpParallelRunAsyncTask   *task);
-static void                       gimp_parallel_run_async_abort_task    (GimpParallelRunAsyncTask   *task);
-static void                       gimp_parallel_run_async_cancel        (GimpAsync                  *async);
-static void                       gimp_parallel_run_async_waiting       (GimpAsync                  *async);
+static void                       gimp_parallel_notify_num_processors    (GimpGeglConfig             *config);
+
+static void                       gimp_parallel_set_n_threads            (gint                        n_threads,
+                                                                          gboolean                    finish_tasks);
+
+static void                       gimp_parallel_run_async_set_n_threads  (gint                        n_threads,
+                                                                          gboolean                    finish_tasks);
+static gpointer                   gimp_parallel_run_async_thread_func    (GimpParallelRunAsyncThread *thread);
+static GimpParallelRunAsyncThread * gimp_parallel_run_async_select_thread (void);
+static void                       gimp_parallel_run_async_enqueue_task   (GimpParallelRunAsyncThread *thread,
+                                                                          GimpParallelRunAsyncTask   *task);
+static GimpParallelRunAsyncTask * gimp_parallel_run_async_dequeue_task   (GimpParallelRunAsyncThread *thread);
+static GimpParallelRunAsyncTask * gimp_parallel_run_async_steal_task     (GimpParallelRunAsyncThread *thread);
+static gboolean                   gimp_parallel_run_async_should_yield   (GimpParallelRunAsyncThread *thread,
+                                                                          GimpParallelRunAsyncTask   *task);
+static GimpParallelRunAsyncTask * gimp_parallel_run_async_lock_task      (GimpAsync                  *async,
+                                                                          GimpParallelRunAsyncThread **thread);
+static gboolean                   gimp_parallel_run_async_execute_task   (GimpParallelRunAsyncTask   *task);
+static void                       gimp_parallel_run_async_abort_task     (GimpParallelRunAsyncTask   *task);
+static void                       gimp_parallel_run_async_cancel         (GimpAsync                  *async);
+static void                       gimp_parallel_run_async_waiting        (GimpAsync                  *async);
+
+static inline gboolean            gimp_parallel_run_async_task_less      (GimpParallelRunAsyncTask   *task1,
+                                                                          GimpParallelRunAsyncTask   *task2);
+static void                       gimp_parallel_run_async_heap_sift_up   (GimpParallelRunAsyncThread *thread,
+                                                                          gint                        index);
+static void                       gimp_parallel_run_async_heap_sift_down (GimpParallelRunAsyncThread *thread,
+                                                                          gint                        index);
+static void                       gimp_parallel_run_async_heap_push      (GimpParallelRunAsyncThread *thread,
+                                                                          GimpParallelRunAsyncTask   *task);
+static GimpParallelRunAsyncTask * gimp_parallel_run_async_heap_remove    (GimpParallelRunAsyncThread *thread,
+                                                                          gint                        index);
 
 
 /*  local variables  */
@@ -91,9 +127,10 @@ static void                       gimp_parallel_run_async_waiting       (GimpAsy
 static gint                       gimp_parallel_run_async_n_threads = 0;
 static GimpParallelRunAsyncThread gimp_parallel_run_async_threads[GIMP_PARALLEL_RUN_ASYNC_MAX_THREADS];
 
+/* protects the idle threads' sleep, and the threads' "quit" flag */
 static GMutex                     gimp_parallel_run_async_mutex;
 static GCond                      gimp_parallel_run_async_cond;
-static GQueue                     gimp_parallel_run_async_queue = G_QUEUE_INIT;
+static gint                       gimp_parallel_run_async_n_queued_tasks = 0;
 
 
 /*  public functions  */
@@ -152,6 +189,8 @@ gimp_parallel_run_async_full (gint             priority,
 
   task->async                  = GIMP_ASYNC (g_object_ref (async));
   task->priority               = priority;
+  task->serial                 = 0;
+  task->index                  = -1;
   task->func                   = func;
   task->user_data              = user_data;
   task->user_data_destroy_func = user_data_destroy_func;
@@ -165,13 +204,8 @@ gimp_parallel_run_async_full (gint             priority,
                               G_CALLBACK (gimp_parallel_run_async_waiting),
                               NULL);
 
-      g_mutex_lock (&gimp_parallel_run_async_mutex);
-
-      gimp_parallel_run_async_enqueue_task (task);
-
-      g_cond_signal (&gimp_parallel_run_async_cond);
-
-      g_mutex_unlock (&gimp_parallel_run_async_mutex);
+      gimp_parallel_run_async_enqueue_task (
+        gimp_parallel_run_async_select_thread (), task);
     }
   else
     {
@@ -270,66 +304,118 @@ static void
 gimp_parallel_run_async_set_n_threads (gint     n_threads,
                                        gboolean finish_tasks)
 {
+  gint old_n_threads = gimp_parallel_run_async_n_threads;
   gint i;
 
   n_threads = CLAMP (n_threads, 0, GIMP_PARALLEL_RUN_ASYNC_MAX_THREADS);
 
-  if (n_threads > gimp_parallel_run_async_n_threads) /* need more threads */
+  if (n_threads > old_n_threads) /* need more threads */
     {
-      for (i = gimp_parallel_run_async_n_threads; i < n_threads; i++)
+      for (i = old_n_threads; i < n_threads; i++)
         {
           GimpParallelRunAsyncThread *thread =
             &gimp_parallel_run_async_threads[i];
 
-          thread->quit = FALSE;
+          thread->quit    = FALSE;
+          thread->stopped = FALSE;
 
           thread->thread = g_thread_new (
             "async",
             (GThreadFunc) gimp_parallel_run_async_thread_func,
             thread);
         }
+
+      g_atomic_int_set (&gimp_parallel_run_async_n_threads, n_threads);
     }
-  else if (n_threads < gimp_parallel_run_async_n_threads) /* need less threads */
+  else if (n_threads < old_n_threads) /* need less threads */
     {
+      /* make sure new tasks only go to the remaining threads */
+      g_atomic_int_set (&gimp_parallel_run_async_n_threads, n_threads);
+
       g_mutex_lock (&gimp_parallel_run_async_mutex);
 
-      for (i = n_threads; i < gimp_parallel_run_async_n_threads; i++)
+      for (i = n_threads; i < old_n_threads; i++)
         {
           GimpParallelRunAsyncThread *thread =
             &gimp_parallel_run_async_threads[i];
 
-          thread->quit = TRUE;
-
-          if (thread->current_async && ! finish_tasks)
-            gimp_cancelable_cancel (GIMP_CANCELABLE (thread->current_async));
+          g_atomic_int_set (&thread->quit, TRUE);
         }
 
       g_cond_broadcast (&gimp_parallel_run_async_cond);
 
       g_mutex_unlock (&gimp_parallel_run_async_mutex);
 
-      for (i = n_threads; i < gimp_parallel_run_async_n_threads; i++)
+      for (i = n_threads; i < old_n_threads; i++)
         {
           GimpParallelRunAsyncThread *thread =
             &gimp_parallel_run_async_threads[i];
+          GimpAsync                  *current_async = NULL;
 
-          g_thread_join (thread->thread);
-        }
-    }
+          if (! finish_tasks)
+            {
+              g_mutex_lock (&thread->mutex);
 
-  gimp_parallel_run_async_n_threads = n_threads;
+              if (thread->current_async)
+                current_async = GIMP_ASYNC (g_object_ref (thread->current_async));
 
-  if (n_threads == 0)
-    {
-      GimpParallelRunAsyncTask *task;
+              g_mutex_unlock (&thread->mutex);
+            }
 
-      /* finish remaining tasks */
-      while ((task = gimp_parallel_run_async_dequeue_task ()))
+          if (current_async)
+            {
+              gimp_cancelable_cancel (GIMP_CANCELABLE (current_async));
+
+              g_object_unref (current_async);
+            }
+        }
+
+      for (i = n_threads; i < old_n_threads; i++)
         {
-          if (finish_tasks)
-            while (gimp_parallel_run_async_execute_task (task));
-          else
-            gimp_parallel_run_async_abort_task (task);
+          GimpParallelRunAsyncThread *thread =
+            &gimp_parallel_run_async_threads[i];
+          GimpParallelRunAsyncTask   *task;
+
+          g_thread_join (thread->thread);
+
+          thread->thread = NULL;
+
+          /* from now on, tasks enqueued to the thread, by callers which
+           * picked it before it was stopped, go to the remaining threads
+           * instead; everything enqueued before is drained below
+           */
+          g_mutex_lock (&thread->mutex);
+
+          thread->stopped = TRUE;
+
+          g_mutex_unlock (&thread->mutex);
+
+          /* hand the stopped thread's remaining tasks over to the remaining
+           * threads, or, if there are none, finish them here
+           */
+          while ((task = gimp_parallel_run_async_dequeue_task (thread)))
+            {
+              if (n_threads > 0)
+                {
+                  gimp_parallel_run_async_enqueue_task (
+                    gimp_parallel_run_async_select_thread (), task);
+                }
+              else if (finish_tasks)
+                {
+                  while (gimp_parallel_run_async_execute_task (task));
+                }
+              else
+                {
+                  gimp_parallel_run_async_abort_task (task);
+                }
+            }
+
+          /* the heap is empty now, and a restarted thread allocates a new one */
+          g_mutex_lock (&thread->mutex);
+
+          g_clear_pointer (&thread->tasks, g_ptr_array_unref);
+
+          g_mutex_unlock (&thread->mutex);
         }
     }
 }
@@ -337,58 +423,104 @@ gimp_parallel_run_async_set_n_threads (gint     n_threads,
 static gpointer
 gimp_parallel_run_async_thread_func (GimpParallelRunAsyncThread *thread)
 {
-  g_mutex_lock (&gimp_parallel_run_async_mutex);
-
-  while (TRUE)
+  while (! g_atomic_int_get (&thread->quit))
     {
       GimpParallelRunAsyncTask *task;
 
-      while (! thread->quit &&
-             (task = gimp_parallel_run_async_dequeue_task ()))
+      task = gimp_parallel_run_async_dequeue_task (thread);
+
+      if (! task)
+        task = gimp_parallel_run_async_steal_task (thread);
+
+      if (task)
         {
           gboolean resume;
 
+          g_mutex_lock (&thread->mutex);
+
           thread->current_async = GIMP_ASYNC (g_object_ref (task->async));
 
+          g_mutex_unlock (&thread->mutex);
+
           do
             {
-              g_mutex_unlock (&gimp_parallel_run_async_mutex);
-
               resume = gimp_parallel_run_async_execute_task (task);
-
-              g_mutex_lock (&gimp_parallel_run_async_mutex);
             }
           while (resume &&
-                 (g_queue_is_empty (&gimp_parallel_run_async_queue) ||
-                  task->priority <
-                  ((GimpParallelRunAsyncTask *)
-                     g_queue_peek_head (
-                       &gimp_parallel_run_async_queue))->priority));
+                 ! gimp_parallel_run_async_should_yield (thread, task));
+
+          g_mutex_lock (&thread->mutex);
 
           g_clear_object (&thread->current_async);
 
+          g_mutex_unlock (&thread->mutex);
+
           if (resume)
-            gimp_parallel_run_async_enqueue_task (task);
+            gimp_parallel_run_async_enqueue_task (thread, task);
+
+          continue;
         }
 
-      if (thread->quit)
-        break;
+      g_mutex_lock (&gimp_parallel_run_async_mutex);
 
-      g_cond_wait (&gimp_parallel_run_async_cond,
-                   &gimp_parallel_run_async_mutex);
-    }
+      if (! g_atomic_int_get (&thread->quit) &&
+          ! g_atomic_int_get (&gimp_parallel_run_async_n_queued_tasks))
+        {
+          g_cond_wait (&gimp_parallel_run_async_cond,
+                       &gimp_parallel_run_async_mutex);
+        }
 
-  g_mutex_unlock (&gimp_parallel_run_async_mutex);
+      g_mutex_unlock (&gimp_parallel_run_async_mutex);
+    }
 
   return NULL;
 }
 
-static void
-gimp_parallel_run_async_enqueue_task (GimpParallelRunAsyncTask *task)
+static GimpParallelRunAsyncThread *
+gimp_parallel_run_async_select_thread (void)
 {
-  GList *link;
-  GList *iter;
+  GimpParallelRunAsyncThread *best_thread = NULL;
+  gint                        best_n_tasks = G_MAXINT;
+  gint                        n_threads;
+  gint                        i;
+
+  n_threads = g_atomic_int_get (&gimp_parallel_run_async_n_threads);
+
+  /* pick the least-loaded thread.  the task counts are read without locking,
+   * so this is only a heuristic; idle threads steal work anyway.
+   */
+  for (i = 0; i < n_threads; i++)
+    {
+      GimpParallelRunAsyncThread *thread =
+        &gimp_parallel_run_async_threads[i];
+      gint                        n_tasks;
+
+      /* don't pick threads which are being stopped.  this is racy too, but
+       * gimp_parallel_run_async_enqueue_task() redirects tasks enqueued to
+       * a stopped thread.
+       */
+      if (g_atomic_int_get (&thread->quit))
+        continue;
+
+      n_tasks = g_atomic_int_get (&thread->n_tasks);
+
+      if (n_tasks < best_n_tasks)
+        {
+          best_thread  = thread;
+          best_n_tasks = n_tasks;
+
+          if (n_tasks == 0)
+            break;
+        }
+    }
 
+  return best_thread;
+}
+
+static void
+gimp_parallel_run_async_enqueue_task (GimpParallelRunAsyncThread *thread,
+                                      GimpParallelRunAsyncTask   *task)
+{
   if (gimp_async_is_canceled (task->async))
     {
       gimp_parallel_run_async_abort_task (task);
@@ -396,58 +528,178 @@ gimp_parallel_run_async_enqueue_task (GimpParallelRunAsyncTask *task)
       return;
     }
 
-  link       = g_list_alloc ();
-  link->data = task;
+  /* if the thread was stopped after it was picked, its heap has already
+   * been drained.  pick one of the remaining threads instead, or, if there
+   * are none, run the task here.
+   */
+  while (TRUE)
+    {
+      if (! thread)
+        {
+          while (gimp_parallel_run_async_execute_task (task));
+
+          return;
+        }
+
+      g_mutex_lock (&thread->mutex);
+
+      if (! thread->stopped)
+        break;
+
+      g_mutex_unlock (&thread->mutex);
+
+      thread = gimp_parallel_run_async_select_thread ();
+    }
+
+  task->serial = thread->serial++;
 
+  gimp_parallel_run_async_heap_push (thread, task);
+
+  g_object_set_data (G_OBJECT (task->async),
+                     GIMP_PARALLEL_RUN_ASYNC_TASK_KEY, task);
   g_object_set_data (G_OBJECT (task->async),
-                     "gimp-parallel-run-async-link", link);
+                     GIMP_PARALLEL_RUN_ASYNC_THREAD_KEY, thread);
+
+  g_mutex_unlock (&thread->mutex);
+
+  g_mutex_lock (&gimp_parallel_run_async_mutex);
+
+  g_cond_signal (&gimp_parallel_run_async_cond);
 
-  for (iter = g_queue_peek_tail_link (&gimp_parallel_run_async_queue);
-       iter;
-       iter = g_list_previous (iter))
+  g_mutex_unlock (&gimp_parallel_run_async_mutex);
+}
+
+static GimpParallelRunAsyncTask *
+gimp_parallel_run_async_dequeue_task (GimpParallelRunAsyncThread *thread)
+{
+  GimpParallelRunAsyncTask *task = NULL;
+
+  if (! g_atomic_int_get (&thread->n_tasks))
+    return NULL;
+
+  g_mutex_lock (&thread->mutex);
+
+  if (thread->n_tasks > 0)
     {
-      GimpParallelRunAsyncTask *other_task =
-        (GimpParallelRunAsyncTask *) iter->data;
+      task = gimp_parallel_run_async_heap_remove (thread, 0);
 
-      if (other_task->priority <= task->priority)
-        break;
+      g_object_set_data (G_OBJECT (task->async),
+                         GIMP_PARALLEL_RUN_ASYNC_THREAD_KEY, NULL);
+      g_object_set_data (G_OBJECT (task->async),
+                         GIMP_PARALLEL_RUN_ASYNC_TASK_KEY, NULL);
     }
 
-  if (iter)
+  g_mutex_unlock (&thread->mutex);
+
+  return task;
+}
+
+static GimpParallelRunAsyncTask *
+gimp_parallel_run_async_steal_task (GimpParallelRunAsyncThread *thread)
+{
+  GimpParallelRunAsyncTask *task;
+  gint                      i;
+
+  while (g_atomic_int_get (&gimp_parallel_run_async_n_queued_tasks))
     {
-      link->prev = iter;
-      link->next = iter->next;
+      GimpParallelRunAsyncThread *victim          = NULL;
+      gint                        victim_priority = G_MAXINT;
+
+      /* find the thread whose most urgent task has the highest priority.
+       * note that we also look at threads that are being stopped, since
+       * their tasks are up for grabs as well.
+       */
+      for (i = 0; i < GIMP_PARALLEL_RUN_ASYNC_MAX_THREADS; i++)
+        {
+          GimpParallelRunAsyncThread *other =
+            &gimp_parallel_run_async_threads[i];
+
+          if (other == thread || ! g_atomic_int_get (&other->n_tasks))
+            continue;
+
+          g_mutex_lock (&other->mutex);
+
+          if (other->n_tasks > 0)
+            {
+              GimpParallelRunAsyncTask *head =
+                (GimpParallelRunAsyncTask *) g_ptr_array_index (other->tasks,
+                                                                0);
+
+              if (! victim || head->priority < victim_priority)
+                {
+                  victim          = other;
+                  victim_priority = head->priority;
+                }
+            }
+
+          g_mutex_unlock (&other->mutex);
+        }
 
-      iter->next = link;
+      if (! victim)
+        break;
 
-      if (link->next)
-        link->next->prev = link;
-      else
-        gimp_parallel_run_async_queue.tail = link;
+      task = gimp_parallel_run_async_dequeue_task (victim);
 
-      gimp_parallel_run_async_queue.length++;
+      if (task)
+        return task;
     }
-  else
+
+  return NULL;
+}
+
+static gboolean
+gimp_parallel_run_async_should_yield (GimpParallelRunAsyncThread *thread,
+                                      GimpParallelRunAsyncTask   *task)
+{
+  gboolean yield = FALSE;
+
+  if (g_atomic_int_get (&thread->quit))
+    return TRUE;
+
+  if (! g_atomic_int_get (&thread->n_tasks))
+    return FALSE;
+
+  g_mutex_lock (&thread->mutex);
+
+  if (thread->n_tasks > 0)
     {
-      g_queue_push_head_link (&gimp_parallel_run_async_queue, link);
+      GimpParallelRunAsyncTask *head =
+        (GimpParallelRunAsyncTask *) g_ptr_array_index (thread->tasks, 0);
+
+      yield = head->priority <= task->priority;
     }
+
+  g_mutex_unlock (&thread->mutex);
+
+  return yield;
 }
 
+/* returns the queued task of 'async', if any, with the mutex of the thread
+ * whose heap holds the task locked.  the thread pointer is stored on the
+ * async, rather than just the task, since the threads are statically
+ * allocated, and therefore safe to dereference even if the task has been
+ * dequeued (and freed) concurrently.
+ */
 static GimpParallelRunAsyncTask *
-gimp_parallel_run_async_dequeue_task (void)
+gimp_parallel_run_async_lock_task (GimpAsync                   *async,
+                                   GimpParallelRunAsyncThread **thread)
 {
-  GimpParallelRunAsyncTask *task;
+  while ((*thread = (GimpParallelRunAsyncThread *) g_object_get_data (
+                      G_OBJECT (async), GIMP_PARALLEL_RUN_ASYNC_THREAD_KEY)))
+    {
+      g_mutex_lock (&(*thread)->mutex);
 
-  task = (GimpParallelRunAsyncTask *) g_queue_pop_head (
-                                        &gimp_parallel_run_async_queue);
+      if (g_object_get_data (G_OBJECT (async),
+                             GIMP_PARALLEL_RUN_ASYNC_THREAD_KEY) == *thread)
+        {
+          return (GimpParallelRunAsyncTask *) g_object_get_data (
+            G_OBJECT (async), GIMP_PARALLEL_RUN_ASYNC_TASK_KEY);
+        }
 
-  if (task)
-    {
-      g_object_set_data (G_OBJECT (task->async),
-                         "gimp-parallel-run-async-link", NULL);
+      g_mutex_unlock (&(*thread)->mutex);
     }
 
-  return task;
+  return NULL;
 }
 
 static gboolean
@@ -490,63 +742,155 @@ gimp_parallel_run_async_abort_task (GimpParallelRunAsyncTask *task)
 static void
 gimp_parallel_run_async_cancel (GimpAsync *async)
 {
-  GList                    *link;
-  GimpParallelRunAsyncTask *task = NULL;
+  GimpParallelRunAsyncThread *thread;
+  GimpParallelRunAsyncTask   *task;
 
-  link = (GList *) g_object_get_data (G_OBJECT (async),
-                                      "gimp-parallel-run-async-link");
+  task = gimp_parallel_run_async_lock_task (async, &thread);
 
-  if (! link)
-    return;
+  if (task)
+    {
+      gimp_parallel_run_async_heap_remove (thread, task->index);
 
-  g_mutex_lock (&gimp_parallel_run_async_mutex);
+      g_object_set_data (G_OBJECT (async),
+                         GIMP_PARALLEL_RUN_ASYNC_THREAD_KEY, NULL);
+      g_object_set_data (G_OBJECT (async),
+                         GIMP_PARALLEL_RUN_ASYNC_TASK_KEY, NULL);
+
+      g_mutex_unlock (&thread->mutex);
+
+      gimp_parallel_run_async_abort_task (task);
+    }
+}
 
-  link = (GList *) g_object_get_data (G_OBJECT (async),
-                                      "gimp-parallel-run-async-link");
+static void
+gimp_parallel_run_async_waiting (GimpAsync *async)
+{
+  GimpParallelRunAsyncThread *thread;
+  GimpParallelRunAsyncTask   *task;
+
+  task = gimp_parallel_run_async_lock_task (async, &thread);
 
-  if (link)
+  if (task)
     {
-      g_object_set_data (G_OBJECT (async),
-                         "gimp-parallel-run-async-link", NULL);
+      task->priority = G_MININT;
 
-      task = (GimpParallelRunAsyncTask *) link->data;
+      gimp_parallel_run_async_heap_sift_up (thread, task->index);
 
-      g_queue_delete_link (&gimp_parallel_run_async_queue, link);
+      g_mutex_unlock (&thread->mutex);
     }
+}
 
-  g_mutex_unlock (&gimp_parallel_run_async_mutex);
+static inline gboolean
+gimp_parallel_run_async_task_less (GimpParallelRunAsyncTask *task1,
+                                   GimpParallelRunAsyncTask *task2)
+{
+  if (task1->priority != task2->priority)
+    return task1->priority < task2->priority;
 
-  if (task)
-    gimp_parallel_run_async_abort_task (task);
+  return task1->serial < task2->serial;
 }
 
 static void
-gimp_parallel_run_async_waiting (GimpAsync *async)
+gimp_parallel_run_async_heap_sift_up (GimpParallelRunAsyncThread *thread,
+                                      gint                        index)
 {
-  GList *link;
+  GimpParallelRunAsyncTask **tasks = (GimpParallelRunAsyncTask **)
+                                     thread->tasks->pdata;
+  GimpParallelRunAsyncTask  *task  = tasks[index];
+
+  while (index > 0)
+    {
+      gint parent = (index - 1) / 2;
 
-  link = (GList *) g_object_get_data (G_OBJECT (async),
-                                      "gimp-parallel-run-async-link");
+      if (! gimp_parallel_run_async_task_less (task, tasks[parent]))
+        break;
 
-  if (! link)
-    return;
+      tasks[index]        = tasks[parent];
+      tasks[index]->index = index;
 
-  g_mutex_lock (&gimp_parallel_run_async_mutex);
+      index = parent;
+    }
 
-  link = (GList *) g_object_get_data (G_OBJECT (async),
-                                      "gimp-parallel-run-async-link");
+  tasks[index] = task;
+  task->index  = index;
+}
 
-  if (link)
+static void
+gimp_parallel_run_async_heap_sift_down (GimpParallelRunAsyncThread *thread,
+                                        gint                        index)
+{
+  GimpParallelRunAsyncTask **tasks   = (GimpParallelRunAsyncTask **)
+                                       thread->tasks->pdata;
+  GimpParallelRunAsyncTask  *task    = tasks[index];
+  gint                       n_tasks = thread->n_tasks;
+
+  while (TRUE)
     {
-      GimpParallelRunAsyncTask *task = (GimpParallelRunAsyncTask *) link->data;
+      gint child = 2 * index + 1;
 
-      task->priority = G_MININT;
+      if (child >= n_tasks)
+        break;
+
+      if (child + 1 < n_tasks &&
+          gimp_parallel_run_async_task_less (tasks[child + 1], tasks[child]))
+        {
+          child++;
+        }
+
+      if (! gimp_parallel_run_async_task_less (tasks[child], task))
+        break;
+
+      tasks[index]        = tasks[child];
+      tasks[index]->index = index;
 
-      g_queue_unlink         (&gimp_parallel_run_async_queue, link);
-      g_queue_push_head_link (&gimp_parallel_run_async_queue, link);
+      index = child;
     }
 
-  g_mutex_unlock (&gimp_parallel_run_async_mutex);
+  tasks[index] = task;
+  task->index  = index;
+}
+
+static void
+gimp_parallel_run_async_heap_push (GimpParallelRunAsyncThread *thread,
+                                   GimpParallelRunAsyncTask   *task)
+{
+  if (! thread->tasks)
+    thread->tasks = g_ptr_array_new ();
+
+  g_ptr_array_add (thread->tasks, task);
+
+  g_atomic_int_set (&thread->n_tasks, thread->tasks->len);
+  g_atomic_int_inc (&gimp_parallel_run_async_n_queued_tasks);
+
+  gimp_parallel_run_async_heap_sift_up (thread, thread->n_tasks - 1);
+}
+
+static GimpParallelRunAsyncTask *
+gimp_parallel_run_async_heap_remove (GimpParallelRunAsyncThread *thread,
+                                     gint                        index)
+{
+  GimpParallelRunAsyncTask *task;
+  GimpParallelRunAsyncTask *last;
+
+  task = (GimpParallelRunAsyncTask *) g_ptr_array_index (thread->tasks, index);
+  last = (GimpParallelRunAsyncTask *) g_ptr_array_remove_index_fast (
+                                        thread->tasks, thread->n_tasks - 1);
+
+  g_atomic_int_set (&thread->n_tasks, thread->tasks->len);
+  g_atomic_int_add (&gimp_parallel_run_async_n_queued_tasks, -1);
+
+  task->index = -1;
+
+  if (last != task)
+    {
+      g_ptr_array_index (thread->tasks, index) = last;
+      last->index                              = index;
+
+      gimp_parallel_run_async_heap_sift_up   (thread, index);
+      gimp_parallel_run_async_heap_sift_down (thread, last->index);
+    }
+
+  return task;
 }
 
 } /* extern "C" */
@@ -55,6 +55,7 @@
 #include "gimp-units.h"
 #include "gimp-utils.h"
 #include "gimpbrush.h"
+#include "gimpbrushcache.h"
 #include "gimpbuffer.h"
 #include "gimpcontext.h"
 #include "gimpdynamics.h"
@@ -541,6 +542,8 @@ gimp_real_initialize (Gimp               *gimp,
   /*  add data objects that need the user context  */
   gimp_data_factories_add_builtin (gimp);
 
+  gimp_brush_caches_init (gimp);
+
   /*  register all internal procedures  */
   status_callback (NULL, _("Internal Procedures"), 0.2);
   internal_procs_init (gimp->pdb);
@@ -579,6 +582,8 @@ gimp_real_exit (Gimp     *gimp,
   gimp_extension_manager_exit (gimp->extension_manager);
   gimp_modules_unload (gimp);
 
+  gimp_brush_caches_exit (gimp);
+
   gimp_data_factories_save (gimp);
 
   gimp_templates_save (gimp);
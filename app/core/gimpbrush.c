@@ -97,6 +97,9 @@ static gboolean      gimp_brush_real_want_null_motion (GimpBrush            *bru
 
 static gchar       * gimp_brush_get_checksum          (GimpTagged           *tagged);
 
+static gint64        gimp_brush_temp_buf_memsize      (gconstpointer         data);
+static gint64        gimp_brush_bezier_desc_memsize   (gconstpointer         data);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpBrush, gimp_brush, GIMP_TYPE_DATA,
                          G_ADD_PRIVATE (GimpBrush)
@@ -453,13 +456,16 @@ static void
 gimp_brush_real_begin_use (GimpBrush *brush)
 {
   brush->priv->mask_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'M', 'm');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          gimp_brush_temp_buf_memsize, 'M', 'm');
 
   brush->priv->pixmap_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'P', 'p');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          gimp_brush_temp_buf_memsize, 'P', 'p');
 
   brush->priv->boundary_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free, 'B', 'b');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free,
+                          gimp_brush_bezier_desc_memsize, 'B', 'b');
 }
 
 static void
@@ -524,6 +530,20 @@ gimp_brush_get_checksum (GimpTagged *tagged)
   return checksum_string;
 }
 
+static gint64
+gimp_brush_temp_buf_memsize (gconstpointer data)
+{
+  return gimp_temp_buf_get_memsize (data);
+}
+
+static gint64
+gimp_brush_bezier_desc_memsize (gconstpointer data)
+{
+  const GimpBezierDesc *desc = data;
+
+  return sizeof (GimpBezierDesc) + desc->num_data * sizeof (cairo_path_data_t);
+}
+
 /*  public functions  */
 
 GimpData *
@@ -619,6 +639,8 @@ gimp_brush_transform_size (GimpBrush     *brush,
   g_return_if_fail (width != NULL);
   g_return_if_fail (height != NULL);
 
+  gimp_brush_caches_quantize (&scale, &angle);
+
   if (scale             == 1.0 &&
       aspect_ratio      == 0.0 &&
       fmod (angle, 0.5) == 0.0)
@@ -650,6 +672,8 @@ gimp_brush_transform_mask (GimpBrush *brush,
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  gimp_brush_caches_quantize (&scale, &angle);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              &width, &height);
@@ -718,6 +742,8 @@ gimp_brush_transform_pixmap (GimpBrush *brush,
   g_return_val_if_fail (brush->priv->pixmap != NULL, NULL);
   g_return_val_if_fail (scale > 0.0, NULL);
 
+  gimp_brush_caches_quantize (&scale, &angle);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              &width, &height);
@@ -781,6 +807,8 @@ gimp_brush_transform_boundary (GimpBrush *brush,
   g_return_val_if_fail (width != NULL, NULL);
   g_return_val_if_fail (height != NULL, NULL);
 
+  gimp_brush_caches_quantize (&scale, &angle);
+
   gimp_brush_transform_size (brush,
                              scale, aspect_ratio, angle, reflect,
                              width, height);
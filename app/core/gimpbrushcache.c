@@ -20,26 +20,30 @@
 
 #include "config.h"
 
+#include <math.h>
+
 #include <gio/gio.h>
 #include <gegl.h>
 
 #include "libgimpbase/gimpbase.h"
+#include "libgimpmath/gimpmath.h"
 
 #include "core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
+#include "gimp.h"
 #include "gimpbrushcache.h"
 
 #include "gimp-log.h"
 #include "gimp-intl.h"
 
 
-#define MAX_CACHED_DATA 20
-
-
 enum
 {
   PROP_0,
-  PROP_DATA_DESTROY
+  PROP_DATA_DESTROY,
+  PROP_DATA_MEMSIZE
 };
 
 
@@ -48,6 +52,8 @@ typedef struct _GimpBrushCacheUnit GimpBrushCacheUnit;
 struct _GimpBrushCacheUnit
 {
   gpointer data;
+  gint64   memsize;
+  GList    link;
 
   gint     width;
   gint     height;
@@ -59,16 +65,28 @@ struct _GimpBrushCacheUnit
 };
 
 
-static void   gimp_brush_cache_constructed  (GObject      *object);
-static void   gimp_brush_cache_finalize     (GObject      *object);
-static void   gimp_brush_cache_set_property (GObject      *object,
-                                             guint         property_id,
-                                             const GValue *value,
-                                             GParamSpec   *pspec);
-static void   gimp_brush_cache_get_property (GObject      *object,
-                                             guint         property_id,
-                                             GValue       *value,
-                                             GParamSpec   *pspec);
+static void       gimp_brush_cache_constructed    (GObject            *object);
+static void       gimp_brush_cache_finalize       (GObject            *object);
+static void       gimp_brush_cache_set_property   (GObject            *object,
+                                                   guint               property_id,
+                                                   const GValue       *value,
+                                                   GParamSpec         *pspec);
+static void       gimp_brush_cache_get_property   (GObject            *object,
+                                                   guint               property_id,
+                                                   GValue             *value,
+                                                   GParamSpec         *pspec);
+
+static gint64     gimp_brush_cache_get_memsize    (GimpObject         *object,
+                                                   gint64             *gui_size);
+
+static void       gimp_brush_cache_remove_unit    (GimpBrushCache     *cache,
+                                                   GimpBrushCacheUnit *unit);
+
+static guint      gimp_brush_cache_unit_hash      (const GimpBrushCacheUnit *unit);
+static gboolean   gimp_brush_cache_unit_equal     (const GimpBrushCacheUnit *unit1,
+                                                   const GimpBrushCacheUnit *unit2);
+
+static void       gimp_brush_caches_notify_config (GimpCoreConfig     *config);
 
 
 G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
@@ -76,26 +94,51 @@ G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
 #define parent_class gimp_brush_cache_parent_class
 
 
+/*  the settings shared by all brush caches, see gimp_brush_caches_init()  */
+static guint64  gimp_brush_cache_max_size      = 1 << 25;
+static gint     gimp_brush_cache_angle_buckets = 0;
+static gdouble  gimp_brush_cache_scale_base    = 0.0;
+
+/*  the statistics shown in the dashboard  */
+static guintptr gimp_brush_cache_total_memsize = 0;
+static gint     gimp_brush_cache_hits          = 0;
+static gint     gimp_brush_cache_misses        = 0;
+
+
 static void
 gimp_brush_cache_class_init (GimpBrushCacheClass *klass)
 {
-  GObjectClass  *object_class = G_OBJECT_CLASS (klass);
+  GObjectClass    *object_class      = G_OBJECT_CLASS (klass);
+  GimpObjectClass *gimp_object_class = GIMP_OBJECT_CLASS (klass);
+
+  object_class->constructed      = gimp_brush_cache_constructed;
+  object_class->finalize         = gimp_brush_cache_finalize;
+  object_class->set_property     = gimp_brush_cache_set_property;
+  object_class->get_property     = gimp_brush_cache_get_property;
 
-  object_class->constructed  = gimp_brush_cache_constructed;
-  object_class->finalize     = gimp_brush_cache_finalize;
-  object_class->set_property = gimp_brush_cache_set_property;
-  object_class->get_property = gimp_brush_cache_get_property;
+  gimp_object_class->get_memsize = gimp_brush_cache_get_memsize;
 
   g_object_class_install_property (object_class, PROP_DATA_DESTROY,
                                    g_param_spec_pointer ("data-destroy",
                                                          NULL, NULL,
                                                          GIMP_PARAM_READWRITE |
                                                          G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_DATA_MEMSIZE,
+                                   g_param_spec_pointer ("data-memsize",
+                                                         NULL, NULL,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
 }
 
 static void
-gimp_brush_cache_init (GimpBrushCache *brush)
+gimp_brush_cache_init (GimpBrushCache *cache)
 {
+  cache->cached_units =
+    g_hash_table_new ((GHashFunc)  gimp_brush_cache_unit_hash,
+                      (GEqualFunc) gimp_brush_cache_unit_equal);
+
+  g_queue_init (&cache->lru);
 }
 
 static void
@@ -106,6 +149,7 @@ gimp_brush_cache_constructed (GObject *object)
   G_OBJECT_CLASS (parent_class)->constructed (object);
 
   gimp_assert (cache->data_destroy != NULL);
+  gimp_assert (cache->data_memsize != NULL);
 }
 
 static void
@@ -115,6 +159,8 @@ gimp_brush_cache_finalize (GObject *object)
 
   gimp_brush_cache_clear (cache);
 
+  g_hash_table_unref (cache->cached_units);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -132,6 +178,10 @@ gimp_brush_cache_set_property (GObject      *object,
       cache->data_destroy = g_value_get_pointer (value);
       break;
 
+    case PROP_DATA_MEMSIZE:
+      cache->data_memsize = g_value_get_pointer (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -152,26 +202,43 @@ gimp_brush_cache_get_property (GObject    *object,
       g_value_set_pointer (value, cache->data_destroy);
       break;
 
+    case PROP_DATA_MEMSIZE:
+      g_value_set_pointer (value, cache->data_memsize);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
     }
 }
 
+static gint64
+gimp_brush_cache_get_memsize (GimpObject *object,
+                              gint64     *gui_size)
+{
+  GimpBrushCache *cache = GIMP_BRUSH_CACHE (object);
+
+  return cache->memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
+                                                                         gui_size);
+}
+
 
 /*  public functions  */
 
 GimpBrushCache *
-gimp_brush_cache_new (GDestroyNotify  data_destroy,
-                      gchar           debug_hit,
-                      gchar           debug_miss)
+gimp_brush_cache_new (GDestroyNotify             data_destroy,
+                      GimpBrushCacheMemsizeFunc  data_memsize,
+                      gchar                      debug_hit,
+                      gchar                      debug_miss)
 {
   GimpBrushCache *cache;
 
   g_return_val_if_fail (data_destroy != NULL, NULL);
+  g_return_val_if_fail (data_memsize != NULL, NULL);
 
   cache =  g_object_new (GIMP_TYPE_BRUSH_CACHE,
                          "data-destroy", data_destroy,
+                         "data-memsize", data_memsize,
                          NULL);
 
   cache->debug_hit  = debug_hit;
@@ -185,20 +252,8 @@ gimp_brush_cache_clear (GimpBrushCache *cache)
 {
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
 
-  if (cache->cached_units)
-    {
-      GList *iter;
-
-      for (iter = cache->cached_units; iter; iter = g_list_next (iter))
-        {
-          GimpBrushCacheUnit *unit = iter->data;
-
-          cache->data_destroy (unit->data);
-        }
-
-      g_list_free_full (cache->cached_units, g_free);
-      cache->cached_units = NULL;
-    }
+  while (! g_queue_is_empty (&cache->lru))
+    gimp_brush_cache_remove_unit (cache, cache->lru.head->data);
 }
 
 gconstpointer
@@ -211,40 +266,40 @@ gimp_brush_cache_get (GimpBrushCache *cache,
                       gboolean        reflect,
                       gdouble         hardness)
 {
-  GList *iter;
+  GimpBrushCacheUnit  key;
+  GimpBrushCacheUnit *unit;
 
   g_return_val_if_fail (GIMP_IS_BRUSH_CACHE (cache), NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
+  key.width        = width;
+  key.height       = height;
+  key.scale        = scale;
+  key.aspect_ratio = aspect_ratio;
+  key.angle        = angle;
+  key.reflect      = reflect;
+  key.hardness     = hardness;
+
+  unit = g_hash_table_lookup (cache->cached_units, &key);
+
+  if (unit)
     {
-      GimpBrushCacheUnit *unit = iter->data;
-
-      if (unit->data                         &&
-          unit->width        == width        &&
-          unit->height       == height       &&
-          unit->scale        == scale        &&
-          unit->aspect_ratio == aspect_ratio &&
-          unit->angle        == angle        &&
-          unit->reflect      == reflect      &&
-          unit->hardness     == hardness)
-        {
-          if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
-            g_printerr ("%c", cache->debug_hit);
+      if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
+        g_printerr ("%c", cache->debug_hit);
 
-          /* Make the returned cached brush first in the list. */
-          cache->cached_units = g_list_remove_link (cache->cached_units, iter);
-          iter->next = cache->cached_units;
-          if (cache->cached_units)
-            cache->cached_units->prev = iter;
-          cache->cached_units = iter;
+      g_atomic_int_inc (&gimp_brush_cache_hits);
 
-          return (gconstpointer) unit->data;
-        }
+      /* Make the returned cached brush the most recently used one. */
+      g_queue_unlink (&cache->lru, &unit->link);
+      g_queue_push_head_link (&cache->lru, &unit->link);
+
+      return (gconstpointer) unit->data;
     }
 
   if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
     g_printerr ("%c", cache->debug_miss);
 
+  g_atomic_int_inc (&gimp_brush_cache_misses);
+
   return NULL;
 }
 
@@ -259,44 +314,206 @@ gimp_brush_cache_add (GimpBrushCache *cache,
                       gboolean        reflect,
                       gdouble         hardness)
 {
-  GList              *iter;
   GimpBrushCacheUnit *unit;
-  GList              *last   = NULL;
-  gint                length = 0;
 
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
   g_return_if_fail (data != NULL);
 
-  for (iter = cache->cached_units; iter; iter = g_list_next (iter))
+  unit = g_slice_new0 (GimpBrushCacheUnit);
+
+  unit->data         = data;
+  unit->memsize      = cache->data_memsize (data);
+  unit->link.data    = unit;
+  unit->width        = width;
+  unit->height       = height;
+  unit->scale        = scale;
+  unit->aspect_ratio = aspect_ratio;
+  unit->angle        = angle;
+  unit->reflect      = reflect;
+  unit->hardness     = hardness;
+
+  if (g_hash_table_contains (cache->cached_units, unit))
     {
-      unit = iter->data;
+      GimpBrushCacheUnit *old_unit;
 
-      if (data == unit->data)
-        return;
+      old_unit = g_hash_table_lookup (cache->cached_units, unit);
+
+      if (old_unit->data == data)
+        {
+          g_slice_free (GimpBrushCacheUnit, unit);
+
+          return;
+        }
 
-      length++;
-      last = iter;
+      gimp_brush_cache_remove_unit (cache, old_unit);
     }
 
-  if (length > MAX_CACHED_DATA)
+  g_hash_table_add (cache->cached_units, unit);
+  g_queue_push_head_link (&cache->lru, &unit->link);
+
+  cache->memsize += unit->memsize;
+
+  g_atomic_pointer_add (&gimp_brush_cache_total_memsize, +unit->memsize);
+
+  /*  drop the least recently used brushes until we are within budget,
+   *  but never the one just added, the caller is about to use it
+   */
+  while (cache->memsize > gimp_brush_cache_max_size &&
+         cache->lru.length > 1)
+    {
+      gimp_brush_cache_remove_unit (cache, cache->lru.tail->data);
+    }
+}
+
+
+/*  global functions  */
+
+void
+gimp_brush_caches_init (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  g_signal_connect (gimp->config, "notify::brush-cache-size",
+                    G_CALLBACK (gimp_brush_caches_notify_config),
+                    NULL);
+  g_signal_connect (gimp->config, "notify::brush-cache-angle-step",
+                    G_CALLBACK (gimp_brush_caches_notify_config),
+                    NULL);
+  g_signal_connect (gimp->config, "notify::brush-cache-scale-step",
+                    G_CALLBACK (gimp_brush_caches_notify_config),
+                    NULL);
+
+  gimp_brush_caches_notify_config (gimp->config);
+}
+
+void
+gimp_brush_caches_exit (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  g_signal_handlers_disconnect_by_func (gimp->config,
+                                        (gpointer) gimp_brush_caches_notify_config,
+                                        NULL);
+}
+
+/*  rounds the transformation parameters to the configured buckets, so
+ *  that slightly different transformations share a cached brush.  the
+ *  rounding is exact for the identity transformation.
+ */
+void
+gimp_brush_caches_quantize (gdouble *scale,
+                            gdouble *angle)
+{
+  g_return_if_fail (scale != NULL);
+  g_return_if_fail (angle != NULL);
+
+  if (gimp_brush_cache_angle_buckets > 0)
     {
-      unit = last->data;
+      *angle = RINT (*angle * gimp_brush_cache_angle_buckets) /
+               gimp_brush_cache_angle_buckets;
+    }
 
-      cache->data_destroy (unit->data);
-      cache->cached_units = g_list_delete_link (cache->cached_units, last);
-      g_free (unit);
+  if (gimp_brush_cache_scale_base > 0.0 && *scale > 0.0)
+    {
+      *scale = exp (RINT (log (*scale) / gimp_brush_cache_scale_base) *
+                    gimp_brush_cache_scale_base);
     }
+}
 
-  unit = g_new0 (GimpBrushCacheUnit, 1);
+guint64
+gimp_brush_caches_get_memsize (void)
+{
+  return gimp_brush_cache_total_memsize;
+}
 
-  unit->data         = data;
-  unit->width        = width;
-  unit->height       = height;
-  unit->scale        = scale;
-  unit->aspect_ratio = aspect_ratio;
-  unit->angle        = angle;
-  unit->reflect      = reflect;
-  unit->hardness     = hardness;
+void
+gimp_brush_caches_get_hit_miss (gint *hits,
+                                gint *misses)
+{
+  if (hits)
+    *hits = g_atomic_int_get (&gimp_brush_cache_hits);
+
+  if (misses)
+    *misses = g_atomic_int_get (&gimp_brush_cache_misses);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_brush_cache_remove_unit (GimpBrushCache     *cache,
+                              GimpBrushCacheUnit *unit)
+{
+  g_hash_table_remove (cache->cached_units, unit);
+  g_queue_unlink (&cache->lru, &unit->link);
+
+  cache->memsize -= unit->memsize;
+
+  g_atomic_pointer_add (&gimp_brush_cache_total_memsize, -unit->memsize);
+
+  cache->data_destroy (unit->data);
+
+  g_slice_free (GimpBrushCacheUnit, unit);
+}
+
+static guint
+gimp_brush_cache_double_hash (gdouble value)
+{
+  /*  make 0.0 and -0.0, which compare equal, hash the same  */
+  value += 0.0;
+
+  return g_double_hash (&value);
+}
+
+static guint
+gimp_brush_cache_unit_hash (const GimpBrushCacheUnit *unit)
+{
+  guint hash;
+
+  hash = unit->width;
+  hash = hash * 31 + unit->height;
+  hash = hash * 31 + (unit->reflect ? 1 : 0);
+  hash = hash * 31 + gimp_brush_cache_double_hash (unit->scale);
+  hash = hash * 31 + gimp_brush_cache_double_hash (unit->aspect_ratio);
+  hash = hash * 31 + gimp_brush_cache_double_hash (unit->angle);
+  hash = hash * 31 + gimp_brush_cache_double_hash (unit->hardness);
+
+  return hash;
+}
+
+static gboolean
+gimp_brush_cache_unit_equal (const GimpBrushCacheUnit *unit1,
+                             const GimpBrushCacheUnit *unit2)
+{
+  return (unit1->width        == unit2->width        &&
+          unit1->height       == unit2->height       &&
+          unit1->scale        == unit2->scale        &&
+          unit1->aspect_ratio == unit2->aspect_ratio &&
+          unit1->angle        == unit2->angle        &&
+          (! unit1->reflect)  == (! unit2->reflect)  &&
+          unit1->hardness     == unit2->hardness);
+}
+
+static void
+gimp_brush_caches_notify_config (GimpCoreConfig *config)
+{
+  gimp_brush_cache_max_size = config->brush_cache_size;
+
+  if (config->brush_cache_angle_step > 0.0)
+    {
+      /*  use a whole number of buckets per quarter turn, so that the
+       *  multiples of 90 degrees stay exact
+       */
+      gimp_brush_cache_angle_buckets =
+        4 * MAX (1, RINT (90.0 / config->brush_cache_angle_step));
+    }
+  else
+    {
+      gimp_brush_cache_angle_buckets = 0;
+    }
 
-  cache->cached_units = g_list_prepend (cache->cached_units, unit);
+  if (config->brush_cache_scale_step > 0.0)
+    gimp_brush_cache_scale_base = log1p (config->brush_cache_scale_step);
+  else
+    gimp_brush_cache_scale_base = 0.0;
 }
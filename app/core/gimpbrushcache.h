@@ -25,6 +25,9 @@
 #include "gimpobject.h"
 
 
+typedef gint64 (* GimpBrushCacheMemsizeFunc) (gconstpointer data);
+
+
 #define GIMP_TYPE_BRUSH_CACHE            (gimp_brush_cache_get_type ())
 #define GIMP_BRUSH_CACHE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_BRUSH_CACHE, GimpBrushCache))
 #define GIMP_BRUSH_CACHE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass), GIMP_TYPE_BRUSH_CACHE, GimpBrushCacheClass))
@@ -37,14 +40,17 @@ typedef struct _GimpBrushCacheClass GimpBrushCacheClass;
 
 struct _GimpBrushCache
 {
-  GimpObject      parent_instance;
+  GimpObject                 parent_instance;
 
-  GDestroyNotify  data_destroy;
+  GDestroyNotify             data_destroy;
+  GimpBrushCacheMemsizeFunc  data_memsize;
 
-  GList          *cached_units;
+  GHashTable                *cached_units;
+  GQueue                     lru;
+  gint64                     memsize;
 
-  gchar           debug_hit;
-  gchar           debug_miss;
+  gchar                      debug_hit;
+  gchar                      debug_miss;
 };
 
 struct _GimpBrushCacheClass
@@ -55,9 +61,10 @@ struct _GimpBrushCacheClass
 
 GType            gimp_brush_cache_get_type (void) G_GNUC_CONST;
 
-GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify  data_destory,
-                                            gchar           debug_hit,
-                                            gchar           debug_miss);
+GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify             data_destory,
+                                            GimpBrushCacheMemsizeFunc  data_memsize,
+                                            gchar                      debug_hit,
+                                            gchar                      debug_miss);
 
 void             gimp_brush_cache_clear    (GimpBrushCache *cache);
 
@@ -80,4 +87,15 @@ void             gimp_brush_cache_add      (GimpBrushCache *cache,
                                             gdouble         hardness);
 
 
+void             gimp_brush_caches_init         (Gimp     *gimp);
+void             gimp_brush_caches_exit         (Gimp     *gimp);
+
+void             gimp_brush_caches_quantize     (gdouble  *scale,
+                                                 gdouble  *angle);
+
+guint64          gimp_brush_caches_get_memsize  (void);
+void             gimp_brush_caches_get_hit_miss (gint     *hits,
+                                                 gint     *misses);
+
+
 #endif  /*  __GIMP_BRUSH_CACHE_H__  */
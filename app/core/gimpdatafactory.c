@@ -212,6 +212,7 @@ gimp_data_factory_constructed (GObject *object)
 
   /* Passing along the "unique names" property to the data container. */
   priv->container = gimp_list_new (priv->data_type, priv->unique_names);
+  gimp_list_set_indexed (GIMP_LIST (priv->container), TRUE);
   gimp_list_set_sort_func (GIMP_LIST (priv->container),
                            (GCompareFunc) gimp_data_compare);
 
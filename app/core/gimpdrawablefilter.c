@@ -40,6 +40,9 @@
 #include "gegl/gimpapplicator.h"
 #include "gegl/gimp-gegl-utils.h"
 
+#include "operations/operations-types.h"
+#include "operations/gimpoperationpointfilterchain.h"
+
 #include "gimpchannel.h"
 #include "gimpdrawable-filters.h"
 #include "gimpdrawablefilter.h"
@@ -83,6 +86,8 @@ struct _GimpDrawableFilter
 
   gboolean                override_constraints;
 
+  gboolean                merging;
+
   GeglRectangle           filter_area;
   gboolean                filter_clip;
 
@@ -98,6 +103,8 @@ struct _GimpDrawableFilter
 static void       gimp_drawable_filter_dispose               (GObject             *object);
 static void       gimp_drawable_filter_finalize              (GObject             *object);
 
+static GeglNode * gimp_drawable_filter_get_point_operation   (GimpFilter          *filter);
+
 static void       gimp_drawable_filter_sync_active           (GimpDrawableFilter  *filter);
 static void       gimp_drawable_filter_sync_clip             (GimpDrawableFilter  *filter,
                                                               gboolean             sync_region);
@@ -149,7 +156,8 @@ static guint drawable_filter_signals[LAST_SIGNAL] = { 0, };
 static void
 gimp_drawable_filter_class_init (GimpDrawableFilterClass *klass)
 {
-  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GObjectClass    *object_class = G_OBJECT_CLASS (klass);
+  GimpFilterClass *filter_class = GIMP_FILTER_CLASS (klass);
 
   drawable_filter_signals[FLUSH] =
     g_signal_new ("flush",
@@ -159,8 +167,10 @@ gimp_drawable_filter_class_init (GimpDrawableFilterClass *klass)
                   NULL, NULL, NULL,
                   G_TYPE_NONE, 0);
 
-  object_class->dispose  = gimp_drawable_filter_dispose;
-  object_class->finalize = gimp_drawable_filter_finalize;
+  object_class->dispose              = gimp_drawable_filter_dispose;
+  object_class->finalize             = gimp_drawable_filter_finalize;
+
+  filter_class->get_point_operation  = gimp_drawable_filter_get_point_operation;
 }
 
 static void
@@ -202,6 +212,37 @@ gimp_drawable_filter_finalize (GObject *object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static GeglNode *
+gimp_drawable_filter_get_point_operation (GimpFilter *filter)
+{
+  GimpDrawableFilter *drawable_filter = GIMP_DRAWABLE_FILTER (filter);
+  GimpApplicator     *applicator      = drawable_filter->applicator;
+  GeglOperation      *operation;
+
+  operation = gegl_node_get_gegl_operation (drawable_filter->operation);
+
+  /*  the filter can only be fused with its neighbors if the applicator
+   *  just replaces the drawable's pixels with the operation's output
+   */
+  if (operation                                                   &&
+      ! drawable_filter->merging                                  &&
+      drawable_filter->has_input                                  &&
+      drawable_filter->preview_enabled                            &&
+      ! drawable_filter->preview_split_enabled                    &&
+      ! drawable_filter->crop_enabled                             &&
+      ! drawable_filter->gamma_hack                               &&
+      drawable_filter->opacity    == GIMP_OPACITY_OPAQUE          &&
+      drawable_filter->paint_mode == GIMP_LAYER_MODE_REPLACE      &&
+      applicator->mask_buffer     == NULL                         &&
+      applicator->affect          == GIMP_COMPONENT_MASK_ALL      &&
+      gimp_operation_point_filter_chain_can_fuse (operation, NULL))
+    {
+      return drawable_filter->operation;
+    }
+
+  return NULL;
+}
+
 GimpDrawableFilter *
 gimp_drawable_filter_new (GimpDrawable *drawable,
                           const gchar  *undo_desc,
@@ -589,6 +630,12 @@ gimp_drawable_filter_commit (GimpDrawableFilter *filter,
                                               filter->preview_split_position);
       gimp_drawable_filter_set_preview (filter, TRUE);
 
+      /*  merging processes the filter's own node, so it must not be
+       *  fused with its neighbors
+       */
+      filter->merging = TRUE;
+      gimp_filter_point_operation_changed (GIMP_FILTER (filter));
+
       success = gimp_drawable_merge_filter (filter->drawable,
                                             GIMP_FILTER (filter),
                                             progress,
@@ -600,6 +647,8 @@ gimp_drawable_filter_commit (GimpDrawableFilter *filter,
 
       gimp_drawable_filter_remove_filter (filter);
 
+      filter->merging = FALSE;
+
       if (! success)
         gimp_drawable_filter_update_drawable (filter, NULL);
 
@@ -1158,6 +1207,9 @@ gimp_drawable_filter_update_drawable (GimpDrawableFilter  *filter,
   if (update_area.width  > 0 &&
       update_area.height > 0)
     {
+      /*  every change to the filter ends up here  */
+      gimp_filter_point_operation_changed (GIMP_FILTER (filter));
+
       gimp_drawable_update (filter->drawable,
                             update_area.x,
                             update_area.y,
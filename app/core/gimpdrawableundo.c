@@ -17,19 +17,38 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <gegl.h>
+#include <zlib.h>
 
 #include "libgimpbase/gimpbase.h"
 
 #include "core-types.h"
 
+#include "gimp.h"
 #include "gimp-memsize.h"
+#include "gimp-parallel.h"
+#include "gimpasync.h"
 #include "gimpimage.h"
+#include "gimpimage-undo.h"
 #include "gimpdrawable.h"
 #include "gimpdrawableundo.h"
 
 
+/*  the approximate amount of pixel data compressed at once  */
+#define SWAP_STRIP_SIZE  (1 << 20)
+#define SWAP_CHUNK_SIZE  (1 << 16)
+
+
+typedef struct
+{
+  GeglBuffer *buffer;
+  GFile      *file;
+} SwapData;
+
+
 enum
 {
   PROP_0,
@@ -40,6 +59,7 @@ enum
 
 
 static void     gimp_drawable_undo_constructed  (GObject             *object);
+static void     gimp_drawable_undo_finalize     (GObject             *object);
 static void     gimp_drawable_undo_set_property (GObject             *object,
                                                  guint                property_id,
                                                  const GValue        *value,
@@ -57,6 +77,16 @@ static void     gimp_drawable_undo_pop          (GimpUndo            *undo,
                                                  GimpUndoAccumulator *accum);
 static void     gimp_drawable_undo_free         (GimpUndo            *undo,
                                                  GimpUndoMode         undo_mode);
+static void     gimp_drawable_undo_swap_out     (GimpUndo            *undo);
+
+static void     gimp_drawable_undo_swap_in      (GimpDrawableUndo    *drawable_undo);
+static void     gimp_drawable_undo_swap_clear   (GimpDrawableUndo    *drawable_undo);
+
+static void     gimp_drawable_undo_swap_out_func     (GimpAsync        *async,
+                                                      SwapData         *data);
+static void     gimp_drawable_undo_swap_data_free    (SwapData         *data);
+static void     gimp_drawable_undo_swap_out_callback (GimpAsync        *async,
+                                                      GimpDrawableUndo *drawable_undo);
 
 
 G_DEFINE_TYPE (GimpDrawableUndo, gimp_drawable_undo, GIMP_TYPE_ITEM_UNDO)
@@ -72,6 +102,7 @@ gimp_drawable_undo_class_init (GimpDrawableUndoClass *klass)
   GimpUndoClass   *undo_class        = GIMP_UNDO_CLASS (klass);
 
   object_class->constructed      = gimp_drawable_undo_constructed;
+  object_class->finalize         = gimp_drawable_undo_finalize;
   object_class->set_property     = gimp_drawable_undo_set_property;
   object_class->get_property     = gimp_drawable_undo_get_property;
 
@@ -79,6 +110,7 @@ gimp_drawable_undo_class_init (GimpDrawableUndoClass *klass)
 
   undo_class->pop                = gimp_drawable_undo_pop;
   undo_class->free               = gimp_drawable_undo_free;
+  undo_class->swap_out           = gimp_drawable_undo_swap_out;
 
   g_object_class_install_property (object_class, PROP_BUFFER,
                                    g_param_spec_object ("buffer", NULL, NULL,
@@ -115,6 +147,18 @@ gimp_drawable_undo_constructed (GObject *object)
   gimp_assert (GEGL_IS_BUFFER (drawable_undo->buffer));
 }
 
+static void
+gimp_drawable_undo_finalize (GObject *object)
+{
+  GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (object);
+
+  gimp_drawable_undo_swap_clear (drawable_undo);
+
+  g_clear_object (&drawable_undo->buffer);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static void
 gimp_drawable_undo_set_property (GObject      *object,
                                  guint         property_id,
@@ -152,6 +196,7 @@ gimp_drawable_undo_get_property (GObject    *object,
   switch (property_id)
     {
     case PROP_BUFFER:
+      gimp_drawable_undo_swap_in (drawable_undo);
       g_value_set_object (value, drawable_undo->buffer);
       break;
     case PROP_X:
@@ -174,7 +219,11 @@ gimp_drawable_undo_get_memsize (GimpObject *object,
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (object);
   gint64            memsize       = 0;
 
-  memsize += gimp_gegl_buffer_get_memsize (drawable_undo->buffer);
+  /*  once swapped out, the pixels are on their way to disk, unless
+   *  writing them failed
+   */
+  if (! drawable_undo->swap_file)
+    memsize += gimp_gegl_buffer_get_memsize (drawable_undo->buffer);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -189,6 +238,8 @@ gimp_drawable_undo_pop (GimpUndo            *undo,
 
   GIMP_UNDO_CLASS (parent_class)->pop (undo, undo_mode, accum);
 
+  gimp_drawable_undo_swap_in (drawable_undo);
+
   gimp_drawable_swap_pixels (GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item),
                              drawable_undo->buffer,
                              drawable_undo->x,
@@ -201,7 +252,301 @@ gimp_drawable_undo_free (GimpUndo     *undo,
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
 
+  gimp_drawable_undo_swap_clear (drawable_undo);
+
   g_clear_object (&drawable_undo->buffer);
 
   GIMP_UNDO_CLASS (parent_class)->free (undo, undo_mode);
 }
+
+static void
+gimp_drawable_undo_swap_out (GimpUndo *undo)
+{
+  GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
+  SwapData         *data;
+
+  if (! drawable_undo->buffer     ||
+      drawable_undo->swap_file     ||
+      drawable_undo->swap_failed)
+    return;
+
+  drawable_undo->swap_file = gimp_get_temp_file (undo->image->gimp, "undo");
+
+  data         = g_slice_new (SwapData);
+  data->buffer = g_object_ref (drawable_undo->buffer);
+  data->file   = g_object_ref (drawable_undo->swap_file);
+
+  /*  compress and write the pixels in the background, the buffer is
+   *  cleared in the callback, once they are safely on disk
+   */
+  drawable_undo->swap_async = gimp_parallel_run_async_full (
+    +1,
+    (GimpRunAsyncFunc) gimp_drawable_undo_swap_out_func,
+    data,
+    (GDestroyNotify) gimp_drawable_undo_swap_data_free);
+
+  gimp_async_add_callback_for_object (
+    drawable_undo->swap_async,
+    (GimpAsyncCallback) gimp_drawable_undo_swap_out_callback,
+    drawable_undo,
+    drawable_undo);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_drawable_undo_swap_in (GimpDrawableUndo *drawable_undo)
+{
+  GInputStream  *input;
+  const Babl    *format;
+  GeglRectangle  rect;
+  gint           bpp;
+  gint           strip_height;
+  guchar        *strip;
+  guchar        *chunk;
+  z_stream       zs    = { 0, };
+  gboolean       error = FALSE;
+  gint           y;
+
+  /*  if the data is still being written, stop that and use the buffer  */
+  if (drawable_undo->swap_async)
+    gimp_async_cancel_and_wait (drawable_undo->swap_async);
+
+  if (! drawable_undo->swap_file)
+    return;
+
+  format = gegl_buffer_get_format (drawable_undo->buffer);
+  bpp    = babl_format_get_bytes_per_pixel (format);
+  rect   = *gegl_buffer_get_extent (drawable_undo->buffer);
+
+  strip_height = CLAMP (SWAP_STRIP_SIZE / MAX (rect.width * bpp, 1),
+                        1, MAX (rect.height, 1));
+
+  input = G_INPUT_STREAM (g_file_read (drawable_undo->swap_file, NULL, NULL));
+
+  if (! input || inflateInit (&zs) != Z_OK)
+    {
+      g_clear_object (&input);
+
+      error = TRUE;
+    }
+
+  strip = g_malloc ((gsize) rect.width * strip_height * bpp);
+  chunk = g_malloc (SWAP_CHUNK_SIZE);
+
+  for (y = 0; ! error && y < rect.height; y += strip_height)
+    {
+      GeglRectangle strip_rect = { rect.x,     rect.y + y,
+                                   rect.width, MIN (strip_height,
+                                                    rect.height - y) };
+
+      zs.next_out  = strip;
+      zs.avail_out = strip_rect.width * strip_rect.height * bpp;
+
+      while (zs.avail_out > 0)
+        {
+          gint ret;
+
+          if (zs.avail_in == 0)
+            {
+              gssize n_read;
+
+              n_read = g_input_stream_read (input, chunk, SWAP_CHUNK_SIZE,
+                                            NULL, NULL);
+
+              if (n_read <= 0)
+                {
+                  error = TRUE;
+                  break;
+                }
+
+              zs.next_in  = chunk;
+              zs.avail_in = n_read;
+            }
+
+          ret = inflate (&zs, Z_NO_FLUSH);
+
+          if (ret != Z_OK && ! (ret == Z_STREAM_END && zs.avail_out == 0))
+            {
+              error = TRUE;
+              break;
+            }
+        }
+
+      if (! error)
+        {
+          gegl_buffer_set (drawable_undo->buffer, &strip_rect, 0,
+                           format, strip, GEGL_AUTO_ROWSTRIDE);
+        }
+    }
+
+  g_free (chunk);
+  g_free (strip);
+
+  if (input)
+    {
+      inflateEnd (&zs);
+
+      g_object_unref (input);
+    }
+
+  if (error)
+    g_warning ("%s: failed to read undo data from swap", G_STRFUNC);
+
+  gimp_drawable_undo_swap_clear (drawable_undo);
+}
+
+static void
+gimp_drawable_undo_swap_clear (GimpDrawableUndo *drawable_undo)
+{
+  if (drawable_undo->swap_async)
+    gimp_async_cancel_and_wait (drawable_undo->swap_async);
+
+  if (drawable_undo->swap_file)
+    {
+      g_file_delete (drawable_undo->swap_file, NULL, NULL);
+
+      g_clear_object (&drawable_undo->swap_file);
+    }
+}
+
+static void
+gimp_drawable_undo_swap_out_func (GimpAsync *async,
+                                  SwapData  *data)
+{
+  GOutputStream *output;
+  const Babl    *format;
+  GeglRectangle  rect;
+  gint           bpp;
+  gint           strip_height;
+  guchar        *strip;
+  guchar        *chunk;
+  z_stream       zs    = { 0, };
+  gboolean       error = FALSE;
+  gint           y;
+
+  format = gegl_buffer_get_format (data->buffer);
+  bpp    = babl_format_get_bytes_per_pixel (format);
+  rect   = *gegl_buffer_get_extent (data->buffer);
+
+  strip_height = CLAMP (SWAP_STRIP_SIZE / MAX (rect.width * bpp, 1),
+                        1, MAX (rect.height, 1));
+
+  output = G_OUTPUT_STREAM (g_file_replace (data->file,
+                                            NULL, FALSE,
+                                            G_FILE_CREATE_PRIVATE,
+                                            NULL, NULL));
+
+  if (! output || deflateInit (&zs, Z_BEST_SPEED) != Z_OK)
+    {
+      g_clear_object (&output);
+
+      error = TRUE;
+    }
+
+  strip = g_malloc ((gsize) rect.width * strip_height * bpp);
+  chunk = g_malloc (SWAP_CHUNK_SIZE);
+
+  for (y = 0; ! error && y < rect.height; y += strip_height)
+    {
+      GeglRectangle strip_rect = { rect.x,     rect.y + y,
+                                   rect.width, MIN (strip_height,
+                                                    rect.height - y) };
+      gboolean      last       = (y + strip_height >= rect.height);
+
+      if (gimp_async_is_canceled (async))
+        {
+          error = TRUE;
+          break;
+        }
+
+      gegl_buffer_get (data->buffer, &strip_rect, 1.0,
+                       format, strip,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      zs.next_in  = strip;
+      zs.avail_in = strip_rect.width * strip_rect.height * bpp;
+
+      do
+        {
+          zs.next_out  = chunk;
+          zs.avail_out = SWAP_CHUNK_SIZE;
+
+          if (deflate (&zs, last ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR ||
+              ! g_output_stream_write_all (output,
+                                           chunk,
+                                           SWAP_CHUNK_SIZE - zs.avail_out,
+                                           NULL, NULL, NULL))
+            {
+              error = TRUE;
+              break;
+            }
+        }
+      while (zs.avail_out == 0);
+    }
+
+  g_free (chunk);
+  g_free (strip);
+
+  if (output)
+    {
+      deflateEnd (&zs);
+
+      if (! g_output_stream_close (output, NULL, NULL))
+        error = TRUE;
+
+      g_object_unref (output);
+    }
+
+  gimp_drawable_undo_swap_data_free (data);
+
+  if (error)
+    gimp_async_abort (async);
+  else
+    gimp_async_finish (async, NULL);
+}
+
+static void
+gimp_drawable_undo_swap_data_free (SwapData *data)
+{
+  g_object_unref (data->buffer);
+  g_object_unref (data->file);
+
+  g_slice_free (SwapData, data);
+}
+
+static void
+gimp_drawable_undo_swap_out_callback (GimpAsync        *async,
+                                      GimpDrawableUndo *drawable_undo)
+{
+  if (gimp_async_is_finished (async))
+    {
+      /*  drop the pixels, they are read back from the swap file
+       *  when the undo is popped
+       */
+      gegl_buffer_clear (drawable_undo->buffer, NULL);
+    }
+  else if (drawable_undo->swap_file)
+    {
+      /*  we failed, or were interrupted, keep the pixels in memory,
+       *  where they count against the undo size again.  don't retry
+       *  a failed swap, it will most likely fail again.
+       */
+      g_file_delete (drawable_undo->swap_file, NULL, NULL);
+
+      g_clear_object (&drawable_undo->swap_file);
+
+      if (! gimp_async_is_canceled (async))
+        {
+          drawable_undo->swap_failed = TRUE;
+
+          GIMP_UNDO (drawable_undo)->swapped = FALSE;
+
+          gimp_image_undo_update_memsize (GIMP_UNDO (drawable_undo)->image,
+                                          GIMP_UNDO (drawable_undo));
+        }
+    }
+
+  g_clear_object (&drawable_undo->swap_async);
+}
@@ -40,6 +40,10 @@ struct _GimpDrawableUndo
   GeglBuffer   *buffer;
   gint          x;
   gint          y;
+
+  GFile        *swap_file;
+  GimpAsync    *swap_async;
+  gboolean      swap_failed;
 };
 
 struct _GimpDrawableUndoClass
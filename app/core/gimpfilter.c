@@ -34,6 +34,8 @@
 enum
 {
   ACTIVE_CHANGED,
+  POINT_OPERATION_CHANGED,
+  MODE_NODE_CHANGED,
   LAST_SIGNAL
 };
 
@@ -76,6 +78,10 @@ static gint64     gimp_filter_get_memsize   (GimpObject   *object,
                                              gint64       *gui_size);
 
 static GeglNode * gimp_filter_real_get_node (GimpFilter   *filter);
+static GeglNode * gimp_filter_real_get_point_operation
+                                            (GimpFilter   *filter);
+static GeglNode * gimp_filter_real_get_mode_node
+                                            (GimpFilter   *filter);
 
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpFilter, gimp_filter, GIMP_TYPE_VIEWABLE)
@@ -99,6 +105,22 @@ gimp_filter_class_init (GimpFilterClass *klass)
                   NULL, NULL, NULL,
                   G_TYPE_NONE, 0);
 
+  gimp_filter_signals[POINT_OPERATION_CHANGED] =
+    g_signal_new ("point-operation-changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_FIRST,
+                  G_STRUCT_OFFSET (GimpFilterClass, point_operation_changed),
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE, 0);
+
+  gimp_filter_signals[MODE_NODE_CHANGED] =
+    g_signal_new ("mode-node-changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_FIRST,
+                  G_STRUCT_OFFSET (GimpFilterClass, mode_node_changed),
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE, 0);
+
   object_class->finalize         = gimp_filter_finalize;
   object_class->set_property     = gimp_filter_set_property;
   object_class->get_property     = gimp_filter_get_property;
@@ -106,7 +128,11 @@ gimp_filter_class_init (GimpFilterClass *klass)
   gimp_object_class->get_memsize = gimp_filter_get_memsize;
 
   klass->active_changed          = NULL;
+  klass->point_operation_changed = NULL;
+  klass->mode_node_changed       = NULL;
   klass->get_node                = gimp_filter_real_get_node;
+  klass->get_point_operation     = gimp_filter_real_get_point_operation;
+  klass->get_mode_node           = gimp_filter_real_get_mode_node;
 
   g_object_class_install_property (object_class, PROP_ACTIVE,
                                    g_param_spec_boolean ("active", NULL, NULL,
@@ -207,6 +233,18 @@ gimp_filter_real_get_node (GimpFilter *filter)
   return private->node;
 }
 
+static GeglNode *
+gimp_filter_real_get_point_operation (GimpFilter *filter)
+{
+  return NULL;
+}
+
+static GeglNode *
+gimp_filter_real_get_mode_node (GimpFilter *filter)
+{
+  return NULL;
+}
+
 
 /*  public functions  */
 
@@ -313,3 +351,44 @@ gimp_filter_get_applicator (GimpFilter *filter)
 
   return GET_PRIVATE (filter)->applicator;
 }
+
+/*  returns the filter's operation node if applying the filter is
+ *  equivalent to just running it, and it is a point filter which can be
+ *  fused with its neighbors, see gimp_filter_stack_get_graph()
+ */
+GeglNode *
+gimp_filter_get_point_operation (GimpFilter *filter)
+{
+  g_return_val_if_fail (GIMP_IS_FILTER (filter), NULL);
+
+  return GIMP_FILTER_GET_CLASS (filter)->get_point_operation (filter);
+}
+
+void
+gimp_filter_point_operation_changed (GimpFilter *filter)
+{
+  g_return_if_fail (GIMP_IS_FILTER (filter));
+
+  g_signal_emit (filter, gimp_filter_signals[POINT_OPERATION_CHANGED], 0);
+}
+
+/*  returns the filter's layer mode node if the filter's node just
+ *  composites the node's "aux" and "aux2" producers over its input
+ *  through it, and it can be replaced by a layer in a gimp:layer-stack,
+ *  see gimp_filter_stack_get_graph()
+ */
+GeglNode *
+gimp_filter_get_mode_node (GimpFilter *filter)
+{
+  g_return_val_if_fail (GIMP_IS_FILTER (filter), NULL);
+
+  return GIMP_FILTER_GET_CLASS (filter)->get_mode_node (filter);
+}
+
+void
+gimp_filter_mode_node_changed (GimpFilter *filter)
+{
+  g_return_if_fail (GIMP_IS_FILTER (filter));
+
+  g_signal_emit (filter, gimp_filter_signals[MODE_NODE_CHANGED], 0);
+}
@@ -44,10 +44,14 @@ struct _GimpFilterClass
   GimpViewableClass  parent_class;
 
   /*  signals  */
-  void       (* active_changed) (GimpFilter *filter);
+  void       (* active_changed)          (GimpFilter *filter);
+  void       (* point_operation_changed) (GimpFilter *filter);
+  void       (* mode_node_changed)       (GimpFilter *filter);
 
   /*  virtual functions  */
-  GeglNode * (* get_node)       (GimpFilter *filter);
+  GeglNode * (* get_node)                (GimpFilter *filter);
+  GeglNode * (* get_point_operation)     (GimpFilter *filter);
+  GeglNode * (* get_mode_node)           (GimpFilter *filter);
 };
 
 
@@ -69,5 +73,11 @@ void             gimp_filter_set_applicator   (GimpFilter     *filter,
                                                GimpApplicator *applicator);
 GimpApplicator * gimp_filter_get_applicator   (GimpFilter     *filter);
 
+GeglNode       * gimp_filter_get_point_operation     (GimpFilter *filter);
+void             gimp_filter_point_operation_changed (GimpFilter *filter);
+
+GeglNode       * gimp_filter_get_mode_node           (GimpFilter *filter);
+void             gimp_filter_mode_node_changed       (GimpFilter *filter);
+
 
 #endif /* __GIMP_FILTER_H__ */
@@ -25,10 +25,27 @@
 
 #include "core-types.h"
 
+#include "gegl/gimpapplicator.h"
+
+#include "operations/operations-types.h"
+#include "operations/gimpoperationpointfilterchain.h"
+#include "operations/layer-modes/gimpoperationlayerstack.h"
+
 #include "gimpfilter.h"
 #include "gimpfilterstack.h"
 
 
+/*  a run of consecutive point filters, or of consecutive layers, which
+ *  are replaced by a single chain or layer stack node in the graph
+ */
+typedef struct
+{
+  GList    *filters;  /* bottom to top */
+  GeglNode *chain;
+  GeglNode *convert;
+} GimpFilterStackRun;
+
+
 /*  local function prototypes  */
 
 static void   gimp_filter_stack_constructed      (GObject         *object);
@@ -48,8 +65,25 @@ static void   gimp_filter_stack_remove_node      (GimpFilterStack *stack,
                                                   GimpFilter      *filter);
 static void   gimp_filter_stack_update_last_node (GimpFilterStack *stack);
 
+static GList    * gimp_filter_stack_end_run        (GList           *runs,
+                                                    GList           *run);
+static GList    * gimp_filter_stack_find_runs      (GimpFilterStack *stack);
+static gboolean   gimp_filter_stack_runs_equal     (GimpFilterStack *stack,
+                                                    GList           *runs);
+static void       gimp_filter_stack_sync_run       (GimpFilterStackRun *run);
+static void       gimp_filter_stack_relink         (GimpFilterStack *stack,
+                                                    GList           *runs);
+static gboolean   gimp_filter_stack_update_fusion  (GimpFilterStack *stack,
+                                                    gboolean         relink);
+
 static void   gimp_filter_stack_filter_active    (GimpFilter      *filter,
                                                   GimpFilterStack *stack);
+static void   gimp_filter_stack_filter_point_operation_changed
+                                                 (GimpFilter      *filter,
+                                                  GimpFilterStack *stack);
+static void   gimp_filter_stack_filter_mode_node_changed
+                                                 (GimpFilter      *filter,
+                                                  GimpFilterStack *stack);
 
 
 G_DEFINE_TYPE (GimpFilterStack, gimp_filter_stack, GIMP_TYPE_LIST);
@@ -89,6 +123,12 @@ gimp_filter_stack_constructed (GObject *object)
   gimp_container_add_handler (container, "active-changed",
                               G_CALLBACK (gimp_filter_stack_filter_active),
                               container);
+  gimp_container_add_handler (container, "point-operation-changed",
+                              G_CALLBACK (gimp_filter_stack_filter_point_operation_changed),
+                              container);
+  gimp_container_add_handler (container, "mode-node-changed",
+                              G_CALLBACK (gimp_filter_stack_filter_mode_node_changed),
+                              container);
 }
 
 static void
@@ -96,6 +136,21 @@ gimp_filter_stack_finalize (GObject *object)
 {
   GimpFilterStack *stack = GIMP_FILTER_STACK (object);
 
+  if (stack->fused_runs)
+    {
+      GList *list;
+
+      for (list = stack->fused_runs; list; list = g_list_next (list))
+        {
+          GimpFilterStackRun *run = list->data;
+
+          g_list_free (run->filters);
+          g_slice_free (GimpFilterStackRun, run);
+        }
+
+      g_clear_pointer (&stack->fused_runs, g_list_free);
+    }
+
   g_clear_object (&stack->graph);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -115,7 +170,9 @@ gimp_filter_stack_add (GimpContainer *container,
       if (stack->graph)
         {
           gegl_node_add_child (stack->graph, gimp_filter_get_node (filter));
-          gimp_filter_stack_add_node (stack, filter);
+
+          if (! gimp_filter_stack_update_fusion (stack, TRUE))
+            gimp_filter_stack_add_node (stack, filter);
         }
 
       gimp_filter_stack_update_last_node (stack);
@@ -131,6 +188,28 @@ gimp_filter_stack_remove (GimpContainer *container,
 
   if (stack->graph && gimp_filter_get_active (filter))
     {
+      if (stack->fused_runs)
+        {
+          /*  the filter might be part of a run, relink the graph once
+           *  the filter is gone
+           */
+          g_object_ref (filter);
+
+          GIMP_CONTAINER_CLASS (parent_class)->remove (container, object);
+
+          gimp_filter_stack_update_fusion (stack, TRUE);
+
+          gegl_node_disconnect (gimp_filter_get_node (filter), "input");
+          gegl_node_remove_child (stack->graph, gimp_filter_get_node (filter));
+
+          gimp_filter_set_is_last_node (filter, FALSE);
+          gimp_filter_stack_update_last_node (stack);
+
+          g_object_unref (filter);
+
+          return;
+        }
+
       gimp_filter_stack_remove_node (stack, filter);
       gegl_node_remove_child (stack->graph, gimp_filter_get_node (filter));
     }
@@ -139,6 +218,10 @@ gimp_filter_stack_remove (GimpContainer *container,
 
   if (gimp_filter_get_active (filter))
     {
+      /*  removing the filter might have joined two runs  */
+      if (stack->graph)
+        gimp_filter_stack_update_fusion (stack, TRUE);
+
       gimp_filter_set_is_last_node (filter, FALSE);
       gimp_filter_stack_update_last_node (stack);
     }
@@ -152,7 +235,7 @@ gimp_filter_stack_reorder (GimpContainer *container,
   GimpFilterStack *stack  = GIMP_FILTER_STACK (container);
   GimpFilter      *filter = GIMP_FILTER (object);
 
-  if (stack->graph && gimp_filter_get_active (filter))
+  if (stack->graph && gimp_filter_get_active (filter) && ! stack->fused_runs)
     gimp_filter_stack_remove_node (stack, filter);
 
   GIMP_CONTAINER_CLASS (parent_class)->reorder (container, object, new_index);
@@ -161,7 +244,7 @@ gimp_filter_stack_reorder (GimpContainer *container,
     {
       gimp_filter_stack_update_last_node (stack);
 
-      if (stack->graph)
+      if (stack->graph && ! gimp_filter_stack_update_fusion (stack, TRUE))
         gimp_filter_stack_add_node (stack, filter);
     }
 }
@@ -220,6 +303,8 @@ gimp_filter_stack_get_graph (GimpFilterStack *stack)
 
   gegl_node_link (previous, output);
 
+  gimp_filter_stack_update_fusion (stack, TRUE);
+
   return stack->graph;
 }
 
@@ -320,6 +405,315 @@ gimp_filter_stack_update_last_node (GimpFilterStack *stack)
     }
 }
 
+static GList *
+gimp_filter_stack_end_run (GList *runs,
+                           GList *run)
+{
+  if (g_list_length (run) > 1)
+    return g_list_append (runs, run);
+
+  g_list_free (run);
+
+  return runs;
+}
+
+/*  returns the runs of consecutive active filters which can be fused
+ *  into a single point filter chain, and of consecutive layers which
+ *  can be composited by a single layer stack, as lists of filters,
+ *  bottom to top
+ */
+static GList *
+gimp_filter_stack_find_runs (GimpFilterStack *stack)
+{
+  GList         *runs     = NULL;
+  GList         *run      = NULL;
+  GeglOperation *previous = NULL;
+  gboolean       layers   = FALSE;
+  GList         *list;
+
+  for (list = GIMP_LIST (stack)->queue->tail;
+       list;
+       list = g_list_previous (list))
+    {
+      GimpFilter    *filter    = list->data;
+      GeglOperation *operation = NULL;
+      gboolean       is_layer  = FALSE;
+      GeglNode      *node;
+
+      if (! gimp_filter_get_active (filter))
+        continue;
+
+      if ((node = gimp_filter_get_point_operation (filter)))
+        {
+          operation = gegl_node_get_gegl_operation (node);
+
+          if (! gimp_operation_point_filter_chain_can_fuse (operation, NULL))
+            operation = NULL;
+        }
+      else if ((node = gimp_filter_get_mode_node (filter)))
+        {
+          operation = gegl_node_get_gegl_operation (node);
+          is_layer  = TRUE;
+        }
+
+      if (run)
+        {
+          gboolean end_run;
+
+          if (! operation || is_layer != layers)
+            end_run = TRUE;
+          else if (is_layer)
+            end_run = (g_list_length (run) ==
+                       GIMP_OPERATION_LAYER_STACK_MAX_LAYERS);
+          else
+            end_run = ! gimp_operation_point_filter_chain_can_fuse (operation,
+                                                                    previous);
+
+          if (end_run)
+            {
+              runs = gimp_filter_stack_end_run (runs, run);
+              run  = NULL;
+            }
+        }
+
+      if (operation)
+        {
+          run      = g_list_append (run, filter);
+          previous = operation;
+          layers   = is_layer;
+        }
+    }
+
+  return gimp_filter_stack_end_run (runs, run);
+}
+
+static gboolean
+gimp_filter_stack_runs_equal (GimpFilterStack *stack,
+                              GList           *runs)
+{
+  GList *list;
+
+  for (list = stack->fused_runs;
+       list && runs;
+       list = g_list_next (list), runs = g_list_next (runs))
+    {
+      GimpFilterStackRun *run     = list->data;
+      GList              *filters = runs->data;
+      GList              *iter;
+
+      for (iter = run->filters;
+           iter && filters;
+           iter = g_list_next (iter), filters = g_list_next (filters))
+        {
+          if (iter->data != filters->data)
+            return FALSE;
+        }
+
+      if (iter || filters)
+        return FALSE;
+    }
+
+  return ! list && ! runs;
+}
+
+static void
+gimp_filter_stack_sync_run (GimpFilterStackRun *run)
+{
+  GimpFilter     *last = g_list_last (run->filters)->data;
+  GimpApplicator *applicator;
+  GList          *operations = NULL;
+  GList          *list;
+
+  if (gimp_filter_get_mode_node (last))
+    {
+      GList *mode_nodes = NULL;
+
+      for (list = run->filters; list; list = g_list_next (list))
+        {
+          mode_nodes = g_list_prepend (mode_nodes,
+                                       gimp_filter_get_mode_node (list->data));
+        }
+
+      mode_nodes = g_list_reverse (mode_nodes);
+
+      gimp_operation_layer_stack_set_layers (
+        GIMP_OPERATION_LAYER_STACK (gegl_node_get_gegl_operation (run->chain)),
+        mode_nodes);
+
+      g_list_free (mode_nodes);
+
+      return;
+    }
+
+  for (list = run->filters; list; list = g_list_next (list))
+    {
+      GeglNode *node = gimp_filter_get_point_operation (list->data);
+
+      operations = g_list_prepend (operations,
+                                   gegl_node_get_gegl_operation (node));
+    }
+
+  operations = g_list_reverse (operations);
+
+  gimp_operation_point_filter_chain_set_operations (
+    GIMP_OPERATION_POINT_FILTER_CHAIN (gegl_node_get_gegl_operation (run->chain)),
+    operations);
+
+  g_list_free (operations);
+
+  /*  convert the result the same way the run's last filter would  */
+  applicator = gimp_filter_get_applicator (last);
+
+  if (applicator && gimp_applicator_get_output_format (applicator))
+    {
+      gegl_node_set (run->convert,
+                     "operation", "gegl:convert-format",
+                     "format",    gimp_applicator_get_output_format (applicator),
+                     NULL);
+    }
+  else
+    {
+      gegl_node_set (run->convert,
+                     "operation", "gegl:nop",
+                     NULL);
+    }
+}
+
+/*  links all active filters from scratch, replacing each of @runs by a
+ *  single chain or layer stack node, and leaving the run's filters
+ *  unconnected
+ */
+static void
+gimp_filter_stack_relink (GimpFilterStack *stack,
+                          GList           *runs)
+{
+  GeglNode *previous;
+  GList    *list;
+  GList    *iter;
+
+  for (list = stack->fused_runs; list; list = g_list_next (list))
+    {
+      GimpFilterStackRun *run = list->data;
+
+      gegl_node_remove_child (stack->graph, run->chain);
+      gegl_node_remove_child (stack->graph, run->convert);
+
+      g_list_free (run->filters);
+      g_slice_free (GimpFilterStackRun, run);
+    }
+
+  g_clear_pointer (&stack->fused_runs, g_list_free);
+
+  for (list = GIMP_LIST (stack)->queue->head;
+       list;
+       list = g_list_next (list))
+    {
+      GimpFilter *filter = list->data;
+
+      if (gimp_filter_get_active (filter))
+        gegl_node_disconnect (gimp_filter_get_node (filter), "input");
+    }
+
+  previous = gegl_node_get_input_proxy (stack->graph, "input");
+
+  iter = runs;
+  list = GIMP_LIST (stack)->queue->tail;
+
+  while (list)
+    {
+      GimpFilter *filter = list->data;
+      GeglNode   *node;
+
+      if (! gimp_filter_get_active (filter))
+        {
+          list = g_list_previous (list);
+          continue;
+        }
+
+      if (iter && ((GList *) iter->data)->data == filter)
+        {
+          GimpFilterStackRun *run = g_slice_new0 (GimpFilterStackRun);
+          GimpFilter         *last;
+          const gchar        *operation;
+
+          if (gimp_filter_get_mode_node (filter))
+            operation = "gimp:layer-stack";
+          else
+            operation = "gimp:point-filter-chain";
+
+          run->filters = iter->data;
+          run->chain   = gegl_node_new_child (stack->graph,
+                                              "operation", operation,
+                                              NULL);
+          run->convert = gegl_node_new_child (stack->graph,
+                                              "operation", "gegl:nop",
+                                              NULL);
+
+          gimp_filter_stack_sync_run (run);
+
+          gegl_node_link_many (previous, run->chain, run->convert, NULL);
+
+          previous = run->convert;
+
+          stack->fused_runs = g_list_append (stack->fused_runs, run);
+
+          /*  skip the run's filters  */
+          last = g_list_last (run->filters)->data;
+
+          while (list->data != last)
+            list = g_list_previous (list);
+
+          list = g_list_previous (list);
+          iter = g_list_next (iter);
+
+          continue;
+        }
+
+      node = gimp_filter_get_node (filter);
+
+      gegl_node_link (previous, node);
+
+      previous = node;
+      list     = g_list_previous (list);
+    }
+
+  gegl_node_link (previous,
+                  gegl_node_get_output_proxy (stack->graph, "output"));
+
+  /*  the runs' filter lists are now owned by stack->fused_runs  */
+  g_list_free (runs);
+}
+
+/*  updates the fused runs of filters, and returns whether the
+ *  stack has any, in which case the graph is linked by this function.
+ *  if @relink is FALSE, the graph is only relinked if the runs changed.
+ */
+static gboolean
+gimp_filter_stack_update_fusion (GimpFilterStack *stack,
+                                 gboolean         relink)
+{
+  GList *runs;
+
+  runs = gimp_filter_stack_find_runs (stack);
+
+  if (! runs && ! stack->fused_runs)
+    return FALSE;
+
+  if (! relink && gimp_filter_stack_runs_equal (stack, runs))
+    {
+      g_list_free_full (runs, (GDestroyNotify) g_list_free);
+
+      g_list_foreach (stack->fused_runs,
+                      (GFunc) gimp_filter_stack_sync_run, NULL);
+    }
+  else
+    {
+      gimp_filter_stack_relink (stack, runs);
+    }
+
+  return TRUE;
+}
+
 static void
 gimp_filter_stack_filter_active (GimpFilter      *filter,
                                  GimpFilterStack *stack)
@@ -329,11 +723,18 @@ gimp_filter_stack_filter_active (GimpFilter      *filter,
       if (gimp_filter_get_active (filter))
         {
           gegl_node_add_child (stack->graph, gimp_filter_get_node (filter));
-          gimp_filter_stack_add_node (stack, filter);
+
+          if (! gimp_filter_stack_update_fusion (stack, TRUE))
+            gimp_filter_stack_add_node (stack, filter);
         }
       else
         {
-          gimp_filter_stack_remove_node (stack, filter);
+          if (! stack->fused_runs)
+            gimp_filter_stack_remove_node (stack, filter);
+
+          gimp_filter_stack_update_fusion (stack, TRUE);
+
+          gegl_node_disconnect (gimp_filter_get_node (filter), "input");
           gegl_node_remove_child (stack->graph, gimp_filter_get_node (filter));
         }
     }
@@ -343,3 +744,19 @@ gimp_filter_stack_filter_active (GimpFilter      *filter,
   if (! gimp_filter_get_active (filter))
     gimp_filter_set_is_last_node (filter, FALSE);
 }
+
+static void
+gimp_filter_stack_filter_point_operation_changed (GimpFilter      *filter,
+                                                  GimpFilterStack *stack)
+{
+  if (stack->graph && gimp_filter_get_active (filter))
+    gimp_filter_stack_update_fusion (stack, FALSE);
+}
+
+static void
+gimp_filter_stack_filter_mode_node_changed (GimpFilter      *filter,
+                                            GimpFilterStack *stack)
+{
+  if (stack->graph && gimp_filter_get_active (filter))
+    gimp_filter_stack_update_fusion (stack, FALSE);
+}
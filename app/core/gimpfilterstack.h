@@ -38,6 +38,7 @@ struct _GimpFilterStack
   GimpList  parent_instance;
 
   GeglNode *graph;
+  GList    *fused_runs;
 };
 
 struct _GimpFilterStackClass
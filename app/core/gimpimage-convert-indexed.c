@@ -192,6 +192,23 @@
 #define G_SCALE 24              /*  scale G (a*) distances by this much  */
 #define B_SCALE 26              /*  and B (b*) by this much              */
 
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 256.0 * 256.0 /* pixels */)
+
+/*  every additional thread allocates, clears and merges a partial
+ *  histogram of several megabytes, so only split up large layers, and
+ *  only among a few threads
+ */
+#define HISTOGRAM_PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 1024.0 * 1024.0 /* pixels */)
+#define HISTOGRAM_MAX_THREADS 4
+
+/*  the second pass runs in bands, so that progress can be reported
+ *  between them
+ */
+#define PASS2_MAX_BANDS       16
+#define PASS2_MIN_BAND_HEIGHT 64
+
 
 typedef struct _Color Color;
 typedef struct _QuantizeObj QuantizeObj;
@@ -314,9 +331,26 @@ HIST_LIN (ColorFreq  *hist_ptr,
 #define BRAT (1.0F)
 #endif
 
+/*  only ever set once, by init_lab_fishes()  */
 static const Babl *rgb_to_lab_fish = NULL;
 static const Babl *lab_to_rgb_fish = NULL;
 
+static void
+init_lab_fishes (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      rgb_to_lab_fish = babl_fish (babl_format ("R'G'B' float"),
+                                   babl_format ("CIE Lab float"));
+      lab_to_rgb_fish = babl_fish (babl_format ("CIE Lab float"),
+                                   babl_format ("R'G'B' float"));
+
+      g_once_init_leave (&initialized, 1);
+    }
+}
+
 static inline void
 rgb_to_unshifted_lin (const guchar  r,
                       const guchar  g,
@@ -468,6 +502,15 @@ struct _Color
   gint blue;
 };
 
+typedef struct
+{
+  guchar        cols[MAXNUMCOLORS][3];    /* distinct colors seen so far       */
+  gint          num_cols;
+  gboolean      needs_quantize;           /* more colors than the limit        */
+  gboolean      had_white;
+  gboolean      had_black;
+} FoundColors;
+
 struct _QuantizeObj
 {
   Pass1Func     first_pass;       /* first pass over image data creates colormap  */
@@ -483,6 +526,7 @@ struct _QuantizeObj
   Color         clin[256];                /* .. converted back to linear space */
   guint64       index_used_count[256];    /* how many times an index was used  */
   CFHistogram   histogram;                /* holds the histogram               */
+  FoundColors   found;                    /* colors found while building it    */
 
   gboolean      want_dither_alpha;
   gint          error_freedom;            /* 0=much bleed, 1=controlled bleed */
@@ -515,6 +559,33 @@ typedef struct
 
 } box, *boxptr;
 
+typedef struct
+{
+  CFHistogram   histogram;
+  FoundColors   found;
+} HistogramPartial;
+
+typedef struct
+{
+  CFHistogram        histogram;
+  const FoundColors *found;
+  GimpLayer         *layer;
+  gint               col_limit;
+  gboolean           dither_alpha;
+  GeglRectangle      extent;
+  gint               tile_height;
+  HistogramPartial   partials[HISTOGRAM_MAX_THREADS];
+} HistogramData;
+
+typedef struct
+{
+  QuantizeObj  *quantobj;
+  GimpLayer    *layer;
+  GeglBuffer   *new_buffer;
+  GMutex        mutex;
+  gint         *filled;  /* which inverse-colormap cells are filled */
+} Pass2Data;
+
 
 static void          zero_histogram_gray     (CFHistogram   histogram);
 static void          zero_histogram_rgb      (CFHistogram   histogram);
@@ -522,6 +593,7 @@ static void          generate_histogram_gray (CFHistogram   hostogram,
                                               GimpLayer    *layer,
                                               gboolean      dither_alpha);
 static void          generate_histogram_rgb  (CFHistogram   histogram,
+                                              FoundColors  *found,
                                               GimpLayer    *layer,
                                               gint          col_limit,
                                               gboolean      dither_alpha,
@@ -541,12 +613,6 @@ static void          compute_color_lin8      (QuantizeObj           *quantobj,
                                               const int              icolor);
 
 
-static guchar    found_cols[MAXNUMCOLORS][3];
-static gint      num_found_cols;
-static gboolean  needs_quantize;
-static gboolean  had_white;
-static gboolean  had_black;
-
 
 /**********************************************************/
 typedef struct
@@ -815,10 +881,7 @@ gimp_image_convert_indexed (GimpImage               *image,
   old_type = gimp_image_get_base_type (image);
 
   /*  Build histogram if necessary.  */
-  rgb_to_lab_fish = babl_fish (babl_format ("R'G'B' float"),
-                               babl_format ("CIE Lab float"));
-  lab_to_rgb_fish = babl_fish (babl_format ("CIE Lab float"),
-                               babl_format ("R'G'B' float"));
+  init_lab_fishes ();
 
   /* don't dither if the input is grayscale and we are simply mapping
    * every color
@@ -854,10 +917,10 @@ gimp_image_convert_indexed (GimpImage               *image,
        *  than the user actually asked for.  In that case, we don't
        *  need to quantize or color-dither.
        */
-      needs_quantize = FALSE;
-      had_black = FALSE;
-      had_white = FALSE;
-      num_found_cols = 0;
+      quantobj->found.needs_quantize = FALSE;
+      quantobj->found.had_black      = FALSE;
+      quantobj->found.had_white      = FALSE;
+      quantobj->found.num_cols       = 0;
 
       /*  Build the histogram  */
       for (list = all_layers;
@@ -881,6 +944,7 @@ gimp_image_convert_indexed (GimpImage               *image,
                * specified by the user.
                */
               generate_histogram_rgb (quantobj->histogram,
+                                      &quantobj->found,
                                       layer, max_colors, dither_alpha,
                                       sub_progress);
             }
@@ -891,11 +955,12 @@ gimp_image_convert_indexed (GimpImage               *image,
     gimp_progress_set_text_literal (progress,
                                     _("Converting to indexed colors (stage 2)"));
 
-  if (old_type == GIMP_RGB &&
-      ! needs_quantize     &&
+  if (old_type == GIMP_RGB             &&
+      ! quantobj->found.needs_quantize &&
       palette_type == GIMP_CONVERT_PALETTE_GENERATE)
     {
-      gint i;
+      QuantizeObj *old_quantobj = quantobj;
+      gint         i;
 
       /*  If this is an RGB image, and the user wanted a custom-built
        *  generated palette, and this image has no more colors than
@@ -908,7 +973,6 @@ gimp_image_convert_indexed (GimpImage               *image,
        *  no-dither remapper.
        */
 
-      quantobj->delete_func (quantobj);
       quantobj = initialize_median_cut (old_type, max_colors,
                                         GIMP_CONVERT_DITHER_NODESTRUCT,
                                         palette_type,
@@ -917,12 +981,15 @@ gimp_image_convert_indexed (GimpImage               *image,
                                         sub_progress);
       /* We can skip the first pass (palette creation) */
 
-      quantobj->actual_number_of_colors = num_found_cols;
-      for (i = 0; i < num_found_cols; i++)
+      quantobj->found = old_quantobj->found;
+      old_quantobj->delete_func (old_quantobj);
+
+      quantobj->actual_number_of_colors = quantobj->found.num_cols;
+      for (i = 0; i < quantobj->found.num_cols; i++)
         {
-          quantobj->cmap[i].red   = found_cols[i][0];
-          quantobj->cmap[i].green = found_cols[i][1];
-          quantobj->cmap[i].blue  = found_cols[i][2];
+          quantobj->cmap[i].red   = quantobj->found.cols[i][0];
+          quantobj->cmap[i].green = quantobj->found.cols[i][1];
+          quantobj->cmap[i].blue  = quantobj->found.cols[i][2];
         }
     }
   else
@@ -1169,223 +1236,273 @@ generate_histogram_gray (CFHistogram  histogram,
 }
 
 static void
-check_white_or_black (const guchar *data)
+check_white_or_black (FoundColors  *found,
+                      const guchar *data)
 {
   if (data[RED]   == 255 &&
       data[GREEN] == 255 &&
       data[BLUE]  == 255)
-    had_white = TRUE;
+    found->had_white = TRUE;
   if (data[RED]  ==0 &&
       data[GREEN]==0 &&
       data[BLUE] ==0)
-    had_black = TRUE;
+    found->had_black = TRUE;
+}
+
+static gboolean
+found_colors_add (FoundColors  *found,
+                  const guchar *data,
+                  gint          col_limit)
+{
+  gint nfc_iter;
+
+  for (nfc_iter = 0; nfc_iter < found->num_cols; nfc_iter++)
+    {
+      if ((data[RED]   == found->cols[nfc_iter][0]) &&
+          (data[GREEN] == found->cols[nfc_iter][1]) &&
+          (data[BLUE]  == found->cols[nfc_iter][2]))
+        return TRUE;
+    }
+
+  /* Color was not in the table of existing colors
+   */
+  if (found->num_cols >= col_limit)
+    {
+      /* There are more colors in the image than were allowed.  We
+       * switch to plain histogram calculation with a view to
+       * quantizing at a later stage.
+       */
+      found->needs_quantize = TRUE;
+
+      return FALSE;
+    }
+
+  /* Remember the new color we just found.
+   */
+  found->cols[found->num_cols][0] = data[RED];
+  found->cols[found->num_cols][1] = data[GREEN];
+  found->cols[found->num_cols][2] = data[BLUE];
+  found->num_cols++;
+
+  check_white_or_black (found, data);
+
+  return TRUE;
 }
 
+/*  each part covers a band of whole tile rows, so that, merged in
+ *  order, the parts find the colors in the same order as a single pass
+ *  over the layer would, regardless of the number of threads
+ */
 static void
-generate_histogram_rgb (CFHistogram   histogram,
-                        GimpLayer    *layer,
-                        gint          col_limit,
-                        gboolean      dither_alpha,
-                        GimpProgress *progress)
+generate_histogram_rgb_part (gint           i,
+                             gint           n,
+                             HistogramData *data)
 {
+  HistogramPartial   *partial = &data->partials[i];
+  GeglRectangle       band;
+  GeglRectangle      *area    = &band;
   GeglBufferIterator *iter;
   const Babl         *format;
   GeglRectangle      *roi;
   ColorFreq          *colfreq;
-  gint                nfc_iter;
+  gint                col_limit = data->col_limit;
   gint                row, col, coledge;
   gint                offsetx, offsety;
-  gint64              layer_size;
-  gint64              total_size = 0;
-  gint                count      = 0;
   gint                bpp;
   gboolean            has_alpha;
+  gint                first_tile_row;
+  gint                n_tile_rows;
+  gint                y1, y2;
 
-  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+  first_tile_row = data->extent.y / data->tile_height;
+  n_tile_rows    = (data->extent.y + data->extent.height +
+                    data->tile_height - 1) / data->tile_height -
+                   first_tile_row;
 
-  g_return_if_fail (format == babl_format_with_space ("R'G'B' u8", format) ||
-                    format == babl_format_with_space ("R'G'B'A u8", format));
+  y1 = (first_tile_row + n_tile_rows *  i      / n) * data->tile_height;
+  y2 = (first_tile_row + n_tile_rows * (i + 1) / n) * data->tile_height;
 
-  bpp       = babl_format_get_bytes_per_pixel (format);
-  has_alpha = babl_format_has_alpha (format);
+  y1 = MAX (y1, data->extent.y);
+  y2 = MIN (y2, data->extent.y + data->extent.height);
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+  band = data->extent;
+  band.y      = y1;
+  band.height = MAX (y2 - y1, 0);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+  /*  the first part accumulates straight into the final histogram, all
+   *  others into a private one which is merged afterwards
+   */
+  if (i == 0)
+    {
+      partial->histogram = data->histogram;
+    }
+  else
+    {
+      partial->histogram = g_new0 (ColorFreq,
+                                   HIST_R_ELEMS *
+                                   HIST_G_ELEMS *
+                                   HIST_B_ELEMS);
+    }
 
-  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
+  /*  start from the colors found in previous layers  */
+  partial->found = *data->found;
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, format,
+  format    = gimp_drawable_get_format (GIMP_DRAWABLE (data->layer));
+  bpp       = babl_format_get_bytes_per_pixel (format);
+  has_alpha = babl_format_has_alpha (format);
+
+  gimp_item_get_offset (GIMP_ITEM (data->layer), &offsetx, &offsety);
+
+  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (data->layer)),
+                                   area, 0, format,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
   roi = &iter->items[0].roi;
 
-  if (progress)
-    gimp_progress_set_value (progress, 0.0);
-
   while (gegl_buffer_iterator_next (iter))
     {
-      const guchar *data   = iter->items[0].data;
+      const guchar *src    = iter->items[0].data;
       gint          length = iter->length;
 
-      total_size += length;
-
-      /* g_printerr (" [%d,%d - %d,%d]", srcPR.x, src_roi->y, offsetx, offsety); */
+      /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
+      col = roi->x + offsetx;
+      coledge = col + roi->width;
+      row = roi->y + offsety;
 
-      if (needs_quantize)
+      while (length--)
         {
-          if (dither_alpha)
-            {
-              /* if alpha-dithering,
-                 we need to be deterministic w.r.t. offsets */
+          gboolean transparent = FALSE;
 
-              col = roi->x + offsetx;
-              coledge = col + roi->width;
-              row = roi->y + offsety;
-
-              while (length--)
+          if (has_alpha)
+            {
+              if (data->dither_alpha)
                 {
-                  gboolean transparent = FALSE;
-
-                  if (has_alpha &&
-                      data[ALPHA] <
+                  if (src[ALPHA] <
                       DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
                     transparent = TRUE;
-
-                  if (! transparent)
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      check_white_or_black (data);
-                      (*colfreq)++;
-                    }
-
-                  col++;
-                  if (col == coledge)
-                    {
-                      col = roi->x + offsetx;
-                      row++;
-                    }
-
-                  data += bpp;
+                }
+              else
+                {
+                  if (src[ALPHA] <= 127)
+                    transparent = TRUE;
                 }
             }
-          else
+
+          if (! transparent)
             {
-              while (length--)
+              colfreq = HIST_RGB (partial->histogram,
+                                  src[RED],
+                                  src[GREEN],
+                                  src[BLUE]);
+              (*colfreq)++;
+
+              if (partial->found.needs_quantize ||
+                  ! found_colors_add (&partial->found, src, col_limit))
                 {
-                  if ((has_alpha && ((data[ALPHA] > 127)))
-                      || (!has_alpha))
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      check_white_or_black (data);
-                      (*colfreq)++;
-                    }
-
-                  data += bpp;
+                  check_white_or_black (&partial->found, src);
                 }
             }
-        }
-      else
-        {
-          /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
-          col = roi->x + offsetx;
-          coledge = col + roi->width;
-          row = roi->y + offsety;
 
-          while (length--)
+          col++;
+          if (col == coledge)
             {
-              gboolean transparent = FALSE;
+              col = roi->x + offsetx;
+              row++;
+            }
 
-              if (has_alpha)
-                {
-                  if (dither_alpha)
-                    {
-                      if (data[ALPHA] <
-                          DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
-                        transparent = TRUE;
-                    }
-                  else
-                    {
-                      if (data[ALPHA] <= 127)
-                        transparent = TRUE;
-                    }
-                }
+          src += bpp;
+        }
+    }
+}
 
-              if (! transparent)
-                {
-                  colfreq = HIST_RGB (histogram,
-                                      data[RED],
-                                      data[GREEN],
-                                      data[BLUE]);
-                  (*colfreq)++;
+static void
+generate_histogram_rgb (CFHistogram   histogram,
+                        FoundColors  *found,
+                        GimpLayer    *layer,
+                        gint          col_limit,
+                        gboolean      dither_alpha,
+                        GimpProgress *progress)
+{
+  HistogramData *data;
+  GeglBuffer    *buffer;
+  const Babl    *format;
+  gint           n_threads;
+  gint           n_base_cols;
+  gint           i;
 
-                  if (!needs_quantize)
-                    {
-                      for (nfc_iter = 0;
-                           nfc_iter < num_found_cols;
-                           nfc_iter++)
-                        {
-                          if ((data[RED]   == found_cols[nfc_iter][0]) &&
-                              (data[GREEN] == found_cols[nfc_iter][1]) &&
-                              (data[BLUE]  == found_cols[nfc_iter][2]))
-                            goto already_found;
-                        }
+  format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
 
-                      /* Color was not in the table of
-                       * existing colors
-                       */
+  g_return_if_fail (format == babl_format_with_space ("R'G'B' u8", format) ||
+                    format == babl_format_with_space ("R'G'B'A u8", format));
 
-                      num_found_cols++;
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
 
-                      if (num_found_cols > col_limit)
-                        {
-                          /* There are more colors in the image than
-                           *  were allowed.  We switch to plain
-                           *  histogram calculation with a view to
-                           *  quantizing at a later stage.
-                           */
-                          needs_quantize = TRUE;
-                          /* g_print ("\nmax colors exceeded - needs quantize.\n");*/
-                          goto already_found;
-                        }
-                      else
-                        {
-                          /* Remember the new color we just found.
-                           */
-                          found_cols[num_found_cols-1][0] = data[RED];
-                          found_cols[num_found_cols-1][1] = data[GREEN];
-                          found_cols[num_found_cols-1][2] = data[BLUE];
+  /*  the partials hold copies of the found colors, keep them off the
+   *  stack
+   */
+  data = g_new0 (HistogramData, 1);
 
-                          check_white_or_black (data);
-                        }
-                    }
-                }
-            already_found:
+  data->histogram    = histogram;
+  data->found        = found;
+  data->layer        = layer;
+  data->col_limit    = col_limit;
+  data->dither_alpha = dither_alpha;
+  data->extent       = *gegl_buffer_get_extent (buffer);
 
-              col++;
-              if (col == coledge)
-                {
-                  col = roi->x + offsetx;
-                  row++;
-                }
+  g_object_get (buffer,
+                "tile-height", &data->tile_height,
+                NULL);
 
-              data += bpp;
-            }
+  n_threads = CLAMP ((gdouble) data->extent.width * data->extent.height /
+                     HISTOGRAM_PIXELS_PER_THREAD,
+                     1, HISTOGRAM_MAX_THREADS);
+
+  if (progress)
+    gimp_progress_set_value (progress, 0.0);
+
+  gegl_parallel_distribute (n_threads,
+                            (GeglParallelDistributeFunc) generate_histogram_rgb_part,
+                            data);
+
+  /*  merge the partial results, in order.  each partial started out as
+   *  a copy of the found colors passed in, so only the colors past those
+   *  are new
+   */
+  n_base_cols = found->num_cols;
+
+  for (i = 0; i < HISTOGRAM_MAX_THREADS; i++)
+    {
+      HistogramPartial *partial = &data->partials[i];
+      gint              j;
+
+      if (! partial->histogram)
+        continue;
+
+      if (partial->histogram != histogram)
+        {
+          for (j = 0; j < HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS; j++)
+            histogram[j] += partial->histogram[j];
+
+          g_free (partial->histogram);
         }
 
-      if (progress && (count % 16 == 0))
-        gimp_progress_set_value (progress,
-                                 (gdouble) total_size / (gdouble) layer_size);
+      found->had_white |= partial->found.had_white;
+      found->had_black |= partial->found.had_black;
+
+      if (partial->found.needs_quantize)
+        found->needs_quantize = TRUE;
+
+      for (j = n_base_cols;
+           j < partial->found.num_cols && ! found->needs_quantize;
+           j++)
+        {
+          found_colors_add (found, partial->found.cols[j], col_limit);
+        }
     }
 
-/*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
+  g_free (data);
+
+  if (progress)
+    gimp_progress_set_value (progress, 1.0);
 }
 
 
@@ -2822,16 +2939,16 @@ snap_to_black_and_white (QuantizeObj *quantobj)
          }
     }
 
-  if (desired > 2 &&
-      had_white   &&
+  if (desired > 2                &&
+      quantobj->found.had_white &&
       white_dist < POW2(128))
   {
      quantobj->cmap[whitest].red   =
      quantobj->cmap[whitest].green =
      quantobj->cmap[whitest].blue  = 255;
   }
-  if (desired > 2 &&
-      had_black   &&
+  if (desired > 2                &&
+      quantobj->found.had_black &&
       black_dist < POW2(128))
   {
      quantobj->cmap[blackest].red   =
@@ -2904,15 +3021,140 @@ custompal_pass1 (QuantizeObj *quantobj)
   quantobj -> actual_number_of_colors = i;
 }
 
+/*
+ * The no-dither and positional-dither passes map each pixel
+ * independently, so they are run in parallel over the layer.  The
+ * histogram doubles as the inverse-colormap cache, which is filled
+ * lazily.  Its cells are 64 bits wide, and can't be accessed
+ * atomically, so whether a cell is filled is tracked in a separate
+ * array of ints: cells are filled under the mutex, and only read once
+ * their flag is seen to be set.
+ */
+
+static inline void
+pass2_fill_inverse_cmap_gray (Pass2Data   *data,
+                              CFHistogram  histogram,
+                              gint         pixel)
+{
+  gint *filled = &data->filled[pixel];
+
+  if (! g_atomic_int_get (filled))
+    {
+      g_mutex_lock (&data->mutex);
+
+      if (! *filled)
+        {
+          fill_inverse_cmap_gray (data->quantobj, histogram, pixel);
+
+          g_atomic_int_set (filled, TRUE);
+        }
+
+      g_mutex_unlock (&data->mutex);
+    }
+}
+
+/*  fill_inverse_cmap_rgb() fills a whole update box, while only the
+ *  requested cell is flagged, so an update box must be a single cell
+ */
+G_STATIC_ASSERT (BOX_R_LOG == 0 && BOX_G_LOG == 0 && BOX_B_LOG == 0);
+
+static inline void
+pass2_fill_inverse_cmap_rgb (Pass2Data   *data,
+                             CFHistogram  histogram,
+                             gint         R,
+                             gint         G,
+                             gint         B)
+{
+  gint *filled = &data->filled[HIST_LIN (histogram, R, G, B) - histogram];
+
+  if (! g_atomic_int_get (filled))
+    {
+      g_mutex_lock (&data->mutex);
+
+      if (! *filled)
+        {
+          fill_inverse_cmap_rgb (data->quantobj, histogram, R, G, B);
+
+          g_atomic_int_set (filled, TRUE);
+        }
+
+      g_mutex_unlock (&data->mutex);
+    }
+}
+
+static void
+median_cut_pass2_distribute (QuantizeObj                     *quantobj,
+                             GimpLayer                       *layer,
+                             GeglBuffer                      *new_buffer,
+                             GeglParallelDistributeAreaFunc   func)
+{
+  Pass2Data            data;
+  const GeglRectangle *extent = gegl_buffer_get_extent (new_buffer);
+  gint                 n_bands;
+  gint                 band;
+
+  data.quantobj   = quantobj;
+  data.layer      = layer;
+  data.new_buffer = new_buffer;
+  data.filled     = g_new0 (gint, HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS);
+
+  g_mutex_init (&data.mutex);
+
+  n_bands = CLAMP (extent->height / PASS2_MIN_BAND_HEIGHT,
+                   1, PASS2_MAX_BANDS);
+
+  /*  each band is processed in parallel, progress is reported from
+   *  this thread in between
+   */
+  for (band = 0; band < n_bands; band++)
+    {
+      GeglRectangle area = *extent;
+      gint          y1   = extent->height *  band      / n_bands;
+      gint          y2   = extent->height * (band + 1) / n_bands;
+
+      area.y      = extent->y + y1;
+      area.height = y2 - y1;
+
+      gegl_parallel_distribute_area (&area,
+                                     PIXELS_PER_THREAD,
+                                     GEGL_SPLIT_STRATEGY_AUTO,
+                                     func, &data);
+
+      if (quantobj->progress)
+        gimp_progress_set_value (quantobj->progress,
+                                 (gdouble) y2 / MAX (extent->height, 1));
+    }
+
+  g_mutex_clear (&data.mutex);
+
+  g_free (data.filled);
+}
+
+static void
+median_cut_pass2_merge_used_count (Pass2Data     *data,
+                                   const guint64  index_used_count[])
+{
+  gint i;
+
+  g_mutex_lock (&data->mutex);
+
+  for (i = 0; i < 256; i++)
+    data->quantobj->index_used_count[i] += index_used_count[i];
+
+  g_mutex_unlock (&data->mutex);
+}
+
 /*
  * Map some rows of pixels to the output colormapped representation.
  */
 
 static void
-median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
-                                 GimpLayer   *layer,
-                                 GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_gray_area (const GeglRectangle *area,
+                                      Pass2Data           *data)
 {
+  QuantizeObj        *quantobj   = data->quantobj;
+  GimpLayer          *layer      = data->layer;
+  GeglBuffer         *new_buffer = data->new_buffer;
   GeglBufferIterator *iter;
   CFHistogram         histogram = quantobj->histogram;
   ColorFreq          *cachep;
@@ -2922,7 +3164,7 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
   gint                src_bpp;
   gint                dest_bpp;
   gint                has_alpha;
-  guint64            *index_used_count = quantobj->index_used_count;
+  guint64             index_used_count[256] = { 0, };
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
   gint                offsetx, offsety;
 
@@ -2937,12 +3179,12 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
   has_alpha = babl_format_has_alpha (src_format);
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -2961,11 +3203,8 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
               gint pixel = src[GRAY];
 
               cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
+              /* make sure the cache holds the nearest colormap entry */
+              pass2_fill_inverse_cmap_gray (data, histogram, pixel);
 
               if (has_alpha)
                 {
@@ -3006,13 +3245,27 @@ median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
             }
         }
     }
+
+  median_cut_pass2_merge_used_count (data, index_used_count);
 }
 
 static void
-median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
-                                    GimpLayer   *layer,
-                                    GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_gray (QuantizeObj *quantobj,
+                                 GimpLayer   *layer,
+                                 GeglBuffer  *new_buffer)
+{
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               (GeglParallelDistributeAreaFunc)
+                               median_cut_pass2_no_dither_gray_area);
+}
+
+static void
+median_cut_pass2_fixed_dither_gray_area (const GeglRectangle *area,
+                                         Pass2Data           *data)
 {
+  QuantizeObj        *quantobj   = data->quantobj;
+  GimpLayer          *layer      = data->layer;
+  GeglBuffer         *new_buffer = data->new_buffer;
   GeglBufferIterator *iter;
   CFHistogram         histogram = quantobj->histogram;
   ColorFreq          *cachep;
@@ -3028,7 +3281,7 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
   gint                err2;
   Color              *color1;
   Color              *color2;
-  guint64            *index_used_count = quantobj->index_used_count;
+  guint64             index_used_count[256] = { 0, };
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
   gint                offsetx, offsety;
 
@@ -3043,12 +3296,12 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
   has_alpha = babl_format_has_alpha (src_format);
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
   while (gegl_buffer_iterator_next (iter))
@@ -3072,11 +3325,8 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
               pixel = src[GRAY];
 
               cachep = &histogram[pixel];
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_gray (quantobj, histogram, pixel);
+              /* make sure the cache holds the nearest colormap entry */
+              pass2_fill_inverse_cmap_gray (data, histogram, pixel);
 
               pixval1 = *cachep - 1;
               color1 = &quantobj->cmap[pixval1];
@@ -3091,11 +3341,8 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
                       const gint R = CLAMP0255 (RV);
 
                       cachep = &histogram[R];
-                      /* If we have not seen this color before, find
-                       * nearest colormap entry and update the cache
-                       */
-                      if (*cachep == 0)
-                        fill_inverse_cmap_gray (quantobj, histogram, R);
+                      /* make sure the cache holds the nearest colormap entry */
+                      pass2_fill_inverse_cmap_gray (data, histogram, R);
 
                       pixval2 = *cachep - 1;
                       RV += re;
@@ -3174,13 +3421,27 @@ median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
             }
         }
     }
+
+  median_cut_pass2_merge_used_count (data, index_used_count);
 }
 
 static void
-median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
-                                GimpLayer   *layer,
-                                GeglBuffer  *new_buffer)
+median_cut_pass2_fixed_dither_gray (QuantizeObj *quantobj,
+                                    GimpLayer   *layer,
+                                    GeglBuffer  *new_buffer)
 {
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               (GeglParallelDistributeAreaFunc)
+                               median_cut_pass2_fixed_dither_gray_area);
+}
+
+static void
+median_cut_pass2_no_dither_rgb_area (const GeglRectangle *area,
+                                     Pass2Data           *data)
+{
+  QuantizeObj        *quantobj   = data->quantobj;
+  GimpLayer          *layer      = data->layer;
+  GeglBuffer         *new_buffer = data->new_buffer;
   GeglBufferIterator *iter;
   CFHistogram         histogram = quantobj->histogram;
   ColorFreq          *cachep;
@@ -3197,10 +3458,7 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
   gint                alpha_pix        = ALPHA;
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
   gint                offsetx, offsety;
-  guint64            *index_used_count = quantobj->index_used_count;
-  gint64              total_size       = 0;
-  gint64              layer_size;
-  gint                count            = 0;
+  guint64             index_used_count[256] = { 0, };
 
   gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
 
@@ -3222,25 +3480,20 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
     }
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
   while (gegl_buffer_iterator_next (iter))
     {
       const guchar *src  = iter->items[0].data;
       guchar       *dest = iter->items[1].data;
       gint          row;
 
-      total_size += src_roi->height * src_roi->width;
-
       for (row = 0; row < src_roi->height; row++)
         {
           gint col;
@@ -3281,11 +3534,8 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
                           &R, &G, &B);
 
               cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+              /* make sure the cache holds the nearest colormap entry */
+              pass2_fill_inverse_cmap_rgb (data, histogram, R, G, B);
 
               /* Now emit the colormap index for this cell, barfbarf */
               index_used_count[dest[INDEXED] = *cachep - 1]++;
@@ -3296,18 +3546,28 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
               dest += dest_bpp;
             }
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-         gimp_progress_set_value (quantobj->progress,
-                                  (gdouble) total_size / (gdouble) layer_size);
     }
+
+  median_cut_pass2_merge_used_count (data, index_used_count);
 }
 
 static void
-median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
-                                   GimpLayer   *layer,
-                                   GeglBuffer  *new_buffer)
+median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
+                                GimpLayer   *layer,
+                                GeglBuffer  *new_buffer)
+{
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               (GeglParallelDistributeAreaFunc)
+                               median_cut_pass2_no_dither_rgb_area);
+}
+
+static void
+median_cut_pass2_fixed_dither_rgb_area (const GeglRectangle *area,
+                                        Pass2Data           *data)
 {
+  QuantizeObj        *quantobj   = data->quantobj;
+  GimpLayer          *layer      = data->layer;
+  GeglBuffer         *new_buffer = data->new_buffer;
   GeglBufferIterator *iter;
   CFHistogram         histogram = quantobj->histogram;
   ColorFreq          *cachep;
@@ -3330,10 +3590,7 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
   gint                alpha_pix        = ALPHA;
   gboolean            dither_alpha     = quantobj->want_dither_alpha;
   gint                offsetx, offsety;
-  guint64            *index_used_count = quantobj->index_used_count;
-  gint64              total_size       = 0;
-  gint64              layer_size;
-  gint                count            = 0;
+  guint64             index_used_count[256] = { 0, };
 
   gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
 
@@ -3355,25 +3612,20 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
     }
 
   iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
+                                   area, 0, NULL,
                                    GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 2);
   src_roi = &iter->items[0].roi;
 
   gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
+                            area, 0, NULL,
                             GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
-
   while (gegl_buffer_iterator_next (iter))
     {
       const guchar *src  = iter->items[0].data;
       guchar       *dest = iter->items[1].data;
       gint          row;
 
-      total_size += src_roi->height * src_roi->width;
-
       for (row = 0; row < src_roi->height; row++)
         {
           gint col;
@@ -3415,11 +3667,8 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                           &R, &G, &B);
 
               cachep = HIST_LIN (histogram, R, G, B);
-              /* If we have not seen this color before, find nearest
-               * colormap entry and update the cache
-               */
-              if (*cachep == 0)
-                fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+              /* make sure the cache holds the nearest colormap entry */
+              pass2_fill_inverse_cmap_rgb (data, histogram, R, G, B);
 
               /* We now try to find a color which, when mixed in some
                * fashion with the closest match, yields something
@@ -3450,11 +3699,8 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
                                   &R, &G, &B);
 
                       cachep = HIST_LIN (histogram, R, G, B);
-                      /* If we have not seen this color before, find
-                       * nearest colormap entry and update the cache
-                       */
-                      if (*cachep == 0)
-                        fill_inverse_cmap_rgb (quantobj, histogram, R, G, B);
+                      /* make sure the cache holds the nearest colormap entry */
+                      pass2_fill_inverse_cmap_rgb (data, histogram, R, G, B);
 
                       pixval2 = *cachep - 1;
                       RV += re;  GV += ge;  BV += be;
@@ -3528,11 +3774,19 @@ median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
               dest += dest_bpp;
             }
         }
-
-      if (quantobj->progress && (count % 16 == 0))
-        gimp_progress_set_value (quantobj->progress,
-                                 (gdouble) total_size / (gdouble) layer_size);
     }
+
+  median_cut_pass2_merge_used_count (data, index_used_count);
+}
+
+static void
+median_cut_pass2_fixed_dither_rgb (QuantizeObj *quantobj,
+                                   GimpLayer   *layer,
+                                   GeglBuffer  *new_buffer)
+{
+  median_cut_pass2_distribute (quantobj, layer, new_buffer,
+                               (GeglParallelDistributeAreaFunc)
+                               median_cut_pass2_fixed_dither_rgb_area);
 }
 
 static void
@@ -4425,7 +4679,7 @@ initialize_median_cut (GimpImageBaseType       type,
   QuantizeObj *quantobj;
 
   /* Initialize the data structures */
-  quantobj = g_new (QuantizeObj, 1);
+  quantobj = g_new0 (QuantizeObj, 1);
 
   if (type == GIMP_GRAY && palette_type == GIMP_CONVERT_PALETTE_GENERATE)
     quantobj->histogram = g_new (ColorFreq, 256);
@@ -4451,7 +4705,7 @@ initialize_median_cut (GimpImageBaseType       type,
           break;
         case GIMP_CONVERT_PALETTE_CUSTOM:
           quantobj->first_pass = custompal_pass1;
-          needs_quantize = TRUE;
+          quantobj->found.needs_quantize = TRUE;
           break;
         case GIMP_CONVERT_PALETTE_MONO:
         default:
@@ -4525,11 +4779,11 @@ initialize_median_cut (GimpImageBaseType       type,
           break;
         case GIMP_CONVERT_PALETTE_WEB:
           quantobj->first_pass = webpal_pass1;
-          needs_quantize = TRUE;
+          quantobj->found.needs_quantize = TRUE;
           break;
         case GIMP_CONVERT_PALETTE_CUSTOM:
           quantobj->first_pass = custompal_pass1;
-          needs_quantize = TRUE;
+          quantobj->found.needs_quantize = TRUE;
           break;
         case GIMP_CONVERT_PALETTE_MONO:
         default:
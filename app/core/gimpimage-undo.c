@@ -34,6 +34,12 @@
 #include "gimpundostack.h"
 
 
+/*  the number of most recent undo steps whose data is always kept in
+ *  memory, when "undo-swap" is enabled
+ */
+#define N_HOT_UNDO_LEVELS 2
+
+
 /*  local function prototypes  */
 
 static void          gimp_image_undo_pop_stack       (GimpImage     *image,
@@ -262,6 +268,25 @@ gimp_image_undo_free (GimpImage *image)
    */
 }
 
+/*  re-reads the memsize of an undo whose size has changed after it was
+ *  pushed, e.g. when its preview is created, or when it fails to swap
+ *  out, so that the undo and redo stacks account for it.
+ */
+void
+gimp_image_undo_update_memsize (GimpImage *image,
+                                GimpUndo  *undo)
+{
+  GimpImagePrivate *private;
+
+  g_return_if_fail (GIMP_IS_IMAGE (image));
+  g_return_if_fail (GIMP_IS_UNDO (undo));
+
+  private = GIMP_IMAGE_GET_PRIVATE (image);
+
+  if (! gimp_undo_stack_update_memsize (private->undo_stack, undo))
+    gimp_undo_stack_update_memsize (private->redo_stack, undo);
+}
+
 gint
 gimp_image_get_undo_group_count (GimpImage *image)
 {
@@ -345,6 +370,10 @@ gimp_image_undo_group_end (GimpImage *image)
       gimp_image_undo_event (image, GIMP_UNDO_EVENT_UNDO_PUSHED,
                              gimp_undo_stack_peek (private->undo_stack));
 
+      /*  the group has grown since it was pushed  */
+      gimp_undo_stack_update_memsize (private->undo_stack,
+                                      gimp_undo_stack_peek (private->undo_stack));
+
       gimp_image_undo_free_space (image);
     }
 
@@ -516,37 +545,43 @@ static void
 gimp_image_undo_free_space (GimpImage *image)
 {
   GimpImagePrivate *private = GIMP_IMAGE_GET_PRIVATE (image);
+  GimpUndoStack    *stack;
   GimpContainer    *container;
   gint              min_undo_levels;
   gint              max_undo_levels;
   gint64            undo_size;
 
-  container = private->undo_stack->undos;
+  stack     = private->undo_stack;
+  container = stack->undos;
 
   min_undo_levels = image->gimp->config->levels_of_undo;
   max_undo_levels = 1024; /* FIXME */
   undo_size       = image->gimp->config->undo_size;
 
+  /*  move the data of older steps out of memory before giving up on them  */
+  if (image->gimp->config->undo_swap)
+    gimp_undo_stack_swap_out (stack, N_HOT_UNDO_LEVELS);
+
 #ifdef DEBUG_IMAGE_UNDO
   g_printerr ("undo_steps: %d    undo_bytes: %ld\n",
               gimp_container_get_n_children (container),
-              (glong) gimp_object_get_memsize (GIMP_OBJECT (container), NULL));
+              (glong) gimp_object_get_memsize (GIMP_OBJECT (stack), NULL));
 #endif
 
   /*  keep at least min_undo_levels undo steps  */
   if (gimp_container_get_n_children (container) <= min_undo_levels)
     return;
 
-  while ((gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size) ||
+  while ((gimp_object_get_memsize (GIMP_OBJECT (stack), NULL) > undo_size) ||
          (gimp_container_get_n_children (container) > max_undo_levels))
     {
-      GimpUndo *freed = gimp_undo_stack_free_bottom (private->undo_stack,
+      GimpUndo *freed = gimp_undo_stack_free_bottom (stack,
                                                      GIMP_UNDO_MODE_UNDO);
 
 #ifdef DEBUG_IMAGE_UNDO
       g_printerr ("freed one step: undo_steps: %d    undo_bytes: %ld\n",
                   gimp_container_get_n_children (container),
-                  (glong) gimp_object_get_memsize (GIMP_OBJECT (container),
+                  (glong) gimp_object_get_memsize (GIMP_OBJECT (stack),
                                                    NULL));
 #endif
 
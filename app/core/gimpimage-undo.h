@@ -35,6 +35,8 @@ GimpUndoStack * gimp_image_get_undo_stack       (GimpImage     *image);
 GimpUndoStack * gimp_image_get_redo_stack       (GimpImage     *image);
 
 void            gimp_image_undo_free            (GimpImage     *image);
+void            gimp_image_undo_update_memsize  (GimpImage     *image,
+                                                 GimpUndo      *undo);
 
 gint            gimp_image_get_undo_group_count (GimpImage     *image);
 gboolean        gimp_image_undo_group_start     (GimpImage     *image,
@@ -38,6 +38,9 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
+#include "gimpasync.h"
+#include "gimpcancelable.h"
 #include "gimpcontainer.h"
 #include "gimpcontext.h"
 #include "gimpimage.h"
@@ -51,6 +54,10 @@
 #include "gimp-intl.h"
 
 
+/*  the maximal total size of the decoded thumbnails kept in memory  */
+#define THUMB_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+
 enum
 {
   INFO_CHANGED,
@@ -59,6 +66,7 @@ enum
 
 
 typedef struct _GimpImagefilePrivate GimpImagefilePrivate;
+typedef struct _ThumbCacheUnit       ThumbCacheUnit;
 
 struct _GimpImagefilePrivate
 {
@@ -71,11 +79,41 @@ struct _GimpImagefilePrivate
 
   gchar         *description;
   gboolean       static_desc;
+
+  GimpAsync     *thumb_async;
+  gint           thumb_width;
+  gint           thumb_height;
+};
+
+struct _ThumbCacheUnit
+{
+  gchar     *key;
+  gchar     *uri;
+  GdkPixbuf *pixbuf;
+  gint64     memsize;
+  GList      link;
 };
 
+typedef struct
+{
+  GimpThumbnail *thumbnail;
+  gint           width;
+  gint           height;
+} LoadThumbData;
+
+typedef struct
+{
+  GimpThumbnail *thumbnail;
+  GdkPixbuf     *pixbuf;
+  gchar         *error;
+} LoadThumbResult;
+
 #define GET_PRIVATE(imagefile) ((GimpImagefilePrivate *) gimp_imagefile_get_instance_private ((GimpImagefile *) (imagefile)))
 
 
+static void        load_thumb_data_free            (LoadThumbData   *data);
+static void        load_thumb_result_free          (LoadThumbResult *result);
+
 static void        gimp_imagefile_dispose          (GObject        *object);
 static void        gimp_imagefile_finalize         (GObject        *object);
 
@@ -96,15 +134,34 @@ static void        gimp_imagefile_icon_callback    (GObject        *source_objec
                                                     GAsyncResult   *result,
                                                     gpointer        data);
 
-static GdkPixbuf * gimp_imagefile_load_thumb       (GimpImagefile  *imagefile,
+static void        gimp_imagefile_load_thumb_async_func
+                                                   (GimpAsync      *async,
+                                                    LoadThumbData  *data);
+static void        gimp_imagefile_load_thumb_async_callback
+                                                   (GimpAsync      *async,
+                                                    GimpImagefile  *imagefile);
+static void        gimp_imagefile_cancel_load_thumb
+                                                   (GimpImagefile  *imagefile);
+static GdkPixbuf * gimp_imagefile_load_thumb       (GimpThumbnail  *thumbnail,
                                                     gint            width,
-                                                    gint            height);
+                                                    gint            height,
+                                                    gchar         **error_message);
 static gboolean    gimp_imagefile_save_thumb       (GimpImagefile  *imagefile,
                                                     GimpImage      *image,
                                                     gint            size,
                                                     gboolean        replace,
                                                     GError        **error);
 
+static gboolean    gimp_imagefile_cache_lookup     (const gchar    *uri,
+                                                    gint            width,
+                                                    gint            height,
+                                                    GdkPixbuf     **pixbuf);
+static void        gimp_imagefile_cache_add        (const gchar    *uri,
+                                                    gint            width,
+                                                    gint            height,
+                                                    GdkPixbuf      *pixbuf);
+static void        gimp_imagefile_cache_remove     (const gchar    *uri);
+
 static void     gimp_thumbnail_set_info_from_image (GimpThumbnail  *thumbnail,
                                                     const gchar    *mime_type,
                                                     GimpImage      *image);
@@ -122,6 +179,31 @@ G_DEFINE_TYPE_WITH_PRIVATE (GimpImagefile, gimp_imagefile, GIMP_TYPE_VIEWABLE)
 
 static guint gimp_imagefile_signals[LAST_SIGNAL] = { 0 };
 
+/*  decoded thumbnails, shared by all imagefiles, most recently used first.
+ *  only accessed on the main thread.
+ */
+static GHashTable *thumb_cache         = NULL;
+static GQueue      thumb_cache_lru     = G_QUEUE_INIT;
+static gint64      thumb_cache_memsize = 0;
+
+
+static void
+load_thumb_data_free (LoadThumbData *data)
+{
+  g_object_unref (data->thumbnail);
+
+  g_slice_free (LoadThumbData, data);
+}
+
+static void
+load_thumb_result_free (LoadThumbResult *result)
+{
+  g_object_unref (result->thumbnail);
+  g_clear_object (&result->pixbuf);
+  g_free (result->error);
+
+  g_slice_free (LoadThumbResult, result);
+}
 
 static void
 gimp_imagefile_class_init (GimpImagefileClass *klass)
@@ -181,6 +263,8 @@ gimp_imagefile_dispose (GObject *object)
       g_clear_object (&private->icon_cancellable);
     }
 
+  gimp_imagefile_cancel_load_thumb (GIMP_IMAGEFILE (object));
+
   G_OBJECT_CLASS (parent_class)->dispose (object);
 }
 
@@ -212,6 +296,8 @@ gimp_imagefile_name_changed (GimpObject *object)
   if (GIMP_OBJECT_CLASS (parent_class)->name_changed)
     GIMP_OBJECT_CLASS (parent_class)->name_changed (object);
 
+  gimp_imagefile_cancel_load_thumb (GIMP_IMAGEFILE (object));
+
   gimp_thumbnail_set_uri (private->thumbnail, gimp_object_get_name (object));
 
   g_clear_object (&private->file);
@@ -226,12 +312,71 @@ gimp_imagefile_get_new_pixbuf (GimpViewable *viewable,
                                gint          width,
                                gint          height)
 {
-  GimpImagefile *imagefile = GIMP_IMAGEFILE (viewable);
+  GimpImagefile        *imagefile = GIMP_IMAGEFILE (viewable);
+  GimpImagefilePrivate *private   = GET_PRIVATE (imagefile);
+  const gchar          *uri       = gimp_object_get_name (imagefile);
+  LoadThumbData        *data;
+  GimpAsync            *async;
+  GdkPixbuf            *pixbuf;
 
-  if (! gimp_object_get_name (imagefile))
+  if (! uri)
     return NULL;
 
-  return gimp_imagefile_load_thumb (imagefile, width, height);
+  if (gimp_imagefile_cache_lookup (uri, width, height, &pixbuf))
+    return pixbuf;
+
+  /*  the thumbnail is being loaded, the view shows an icon meanwhile,
+   *  and gets invalidated once it's done
+   */
+  if (private->thumb_async         &&
+      private->thumb_width  == width &&
+      private->thumb_height == height)
+    {
+      return NULL;
+    }
+
+  gimp_imagefile_cancel_load_thumb (imagefile);
+
+  /*  load the thumbnail on a worker thread, using a thumbnail object of
+   *  its own, since ours is watched by the main thread
+   */
+  data = g_slice_new0 (LoadThumbData);
+
+  data->thumbnail = gimp_thumbnail_new ();
+  data->width     = width;
+  data->height    = height;
+
+  g_object_set (data->thumbnail,
+                "image-uri",      uri,
+                "image-mimetype", private->thumbnail->image_mimetype,
+                NULL);
+
+  async = gimp_parallel_run_async_full (
+    +1,
+    (GimpRunAsyncFunc) gimp_imagefile_load_thumb_async_func,
+    data,
+    (GDestroyNotify) load_thumb_data_free);
+
+  private->thumb_async  = async;
+  private->thumb_width  = width;
+  private->thumb_height = height;
+
+  gimp_async_add_callback_for_object (
+    async,
+    (GimpAsyncCallback) gimp_imagefile_load_thumb_async_callback,
+    imagefile,
+    imagefile);
+
+  g_object_unref (async);
+
+  /*  the callback might have been called directly  */
+  if (! private->thumb_async &&
+      gimp_imagefile_cache_lookup (uri, width, height, &pixbuf))
+    {
+      return pixbuf;
+    }
+
+  return NULL;
 }
 
 static gchar *
@@ -380,6 +525,11 @@ gimp_imagefile_update (GimpImagefile *imagefile)
 
   private = GET_PRIVATE (imagefile);
 
+  gimp_imagefile_cancel_load_thumb (imagefile);
+
+  if (gimp_object_get_name (imagefile))
+    gimp_imagefile_cache_remove (gimp_object_get_name (imagefile));
+
   gimp_viewable_invalidate_preview (GIMP_VIEWABLE (imagefile));
 
   g_object_get (private->thumbnail,
@@ -393,7 +543,11 @@ gimp_imagefile_update (GimpImagefile *imagefile)
 
       if (documents_imagefile != imagefile &&
           GIMP_IS_IMAGEFILE (documents_imagefile))
-        gimp_viewable_invalidate_preview (GIMP_VIEWABLE (documents_imagefile));
+        {
+          gimp_imagefile_cancel_load_thumb (documents_imagefile);
+
+          gimp_viewable_invalidate_preview (GIMP_VIEWABLE (documents_imagefile));
+        }
 
       g_free (uri);
     }
@@ -887,20 +1041,124 @@ gimp_imagefile_get_desc_string (GimpImagefile *imagefile)
   return (const gchar *) private->description;
 }
 
+static void
+gimp_imagefile_load_thumb_async_func (GimpAsync     *async,
+                                      LoadThumbData *data)
+{
+  LoadThumbResult *result;
+
+  if (gimp_async_is_canceled (async))
+    {
+      gimp_async_abort (async);
+
+      return;
+    }
+
+  result = g_slice_new0 (LoadThumbResult);
+
+  result->thumbnail = g_object_ref (data->thumbnail);
+  result->pixbuf    = gimp_imagefile_load_thumb (data->thumbnail,
+                                                 data->width,
+                                                 data->height,
+                                                 &result->error);
+
+  gimp_async_finish_full (async,
+                          result,
+                          (GDestroyNotify) load_thumb_result_free);
+}
+
+static void
+gimp_imagefile_load_thumb_async_callback (GimpAsync     *async,
+                                          GimpImagefile *imagefile)
+{
+  GimpImagefilePrivate *private = GET_PRIVATE (imagefile);
+  LoadThumbResult      *result;
+  GimpThumbnail        *thumbnail;
+
+  /*  the load was canceled, because the imagefile changed or died  */
+  if (gimp_async_is_canceled (async))
+    return;
+
+  private->thumb_async = NULL;
+
+  if (! gimp_async_is_finished (async))
+    return;
+
+  result    = gimp_async_get_result (async);
+  thumbnail = result->thumbnail;
+
+  if (result->error)
+    {
+      gimp_message (private->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    _("Could not open thumbnail '%s': %s"),
+                    thumbnail->thumb_filename, result->error);
+    }
+
+  /*  a missing thumbnail is cached too, so we don't try loading it
+   *  over and over until the imagefile is updated
+   */
+  gimp_imagefile_cache_add (gimp_object_get_name (imagefile),
+                            private->thumb_width,
+                            private->thumb_height,
+                            result->pixbuf);
+
+  /*  transfer what the load found out about the image to our own
+   *  thumbnail, which updates the description
+   */
+  private->thumbnail->image_not_found_errno = thumbnail->image_not_found_errno;
+
+  g_object_set (private->thumbnail,
+                "image-state",      thumbnail->image_state,
+                "image-mtime",      thumbnail->image_mtime,
+                "image-filesize",   thumbnail->image_filesize,
+                "image-width",      thumbnail->image_width,
+                "image-height",     thumbnail->image_height,
+                "image-type",       thumbnail->image_type,
+                "image-num-layers", thumbnail->image_num_layers,
+                "thumb-state",      thumbnail->thumb_state,
+                NULL);
+
+  if (thumbnail->image_mimetype)
+    {
+      g_object_set (private->thumbnail,
+                    "image-mimetype", thumbnail->image_mimetype,
+                    NULL);
+    }
+
+  if (result->pixbuf)
+    gimp_viewable_invalidate_preview (GIMP_VIEWABLE (imagefile));
+}
+
+static void
+gimp_imagefile_cancel_load_thumb (GimpImagefile *imagefile)
+{
+  GimpImagefilePrivate *private = GET_PRIVATE (imagefile);
+
+  /*  don't wait for the load, it works on its own thumbnail object,
+   *  and our callback ignores canceled loads
+   */
+  if (private->thumb_async)
+    {
+      gimp_cancelable_cancel (GIMP_CANCELABLE (private->thumb_async));
+
+      private->thumb_async = NULL;
+    }
+}
+
+/*  called on a worker thread, must not touch anything but @thumbnail  */
 static GdkPixbuf *
-gimp_imagefile_load_thumb (GimpImagefile *imagefile,
-                           gint           width,
-                           gint           height)
+gimp_imagefile_load_thumb (GimpThumbnail  *thumbnail,
+                           gint            width,
+                           gint            height,
+                           gchar         **error_message)
 {
-  GimpImagefilePrivate *private   = GET_PRIVATE (imagefile);
-  GimpThumbnail        *thumbnail = private->thumbnail;
-  GdkPixbuf            *pixbuf    = NULL;
-  GError               *error     = NULL;
-  gint                  size      = MAX (width, height);
-  gint                  pixbuf_width;
-  gint                  pixbuf_height;
-  gint                  preview_width;
-  gint                  preview_height;
+  GdkPixbuf *pixbuf = NULL;
+  GError    *error  = NULL;
+  gint       size   = MAX (width, height);
+  gint       pixbuf_width;
+  gint       pixbuf_height;
+  gint       preview_width;
+  gint       preview_height;
 
   if (gimp_thumbnail_peek_thumb (thumbnail, size) < GIMP_THUMB_STATE_EXISTS)
     return NULL;
@@ -914,9 +1172,7 @@ gimp_imagefile_load_thumb (GimpImagefile *imagefile,
     {
       if (error)
         {
-          gimp_message (private->gimp, NULL, GIMP_MESSAGE_ERROR,
-                        _("Could not open thumbnail '%s': %s"),
-                        thumbnail->thumb_filename, error->message);
+          *error_message = g_strdup (error->message);
           g_clear_error (&error);
         }
 
@@ -1039,6 +1295,124 @@ gimp_imagefile_save_thumb (GimpImagefile  *imagefile,
   return success;
 }
 
+static gchar *
+gimp_imagefile_cache_key (const gchar *uri,
+                          gint         width,
+                          gint         height)
+{
+  return g_strdup_printf ("%dx%d:%s", width, height, uri);
+}
+
+static void
+gimp_imagefile_cache_remove_unit (ThumbCacheUnit *unit)
+{
+  g_hash_table_remove (thumb_cache, unit->key);
+
+  g_queue_unlink (&thumb_cache_lru, &unit->link);
+
+  thumb_cache_memsize -= unit->memsize;
+
+  g_free (unit->key);
+  g_free (unit->uri);
+  g_clear_object (&unit->pixbuf);
+
+  g_slice_free (ThumbCacheUnit, unit);
+}
+
+/*  returns TRUE if the cache knows about the thumbnail, which might be
+ *  a known-missing one, in which case *pixbuf is set to NULL
+ */
+static gboolean
+gimp_imagefile_cache_lookup (const gchar  *uri,
+                             gint          width,
+                             gint          height,
+                             GdkPixbuf   **pixbuf)
+{
+  ThumbCacheUnit *unit;
+  gchar          *key;
+
+  *pixbuf = NULL;
+
+  if (! thumb_cache)
+    return FALSE;
+
+  key  = gimp_imagefile_cache_key (uri, width, height);
+  unit = g_hash_table_lookup (thumb_cache, key);
+  g_free (key);
+
+  if (! unit)
+    return FALSE;
+
+  g_queue_unlink (&thumb_cache_lru, &unit->link);
+  g_queue_push_head_link (&thumb_cache_lru, &unit->link);
+
+  if (unit->pixbuf)
+    *pixbuf = g_object_ref (unit->pixbuf);
+
+  return TRUE;
+}
+
+static void
+gimp_imagefile_cache_add (const gchar *uri,
+                          gint         width,
+                          gint         height,
+                          GdkPixbuf   *pixbuf)
+{
+  ThumbCacheUnit *unit;
+  gchar          *key;
+
+  if (! thumb_cache)
+    thumb_cache = g_hash_table_new (g_str_hash, g_str_equal);
+
+  key  = gimp_imagefile_cache_key (uri, width, height);
+  unit = g_hash_table_lookup (thumb_cache, key);
+
+  if (unit)
+    gimp_imagefile_cache_remove_unit (unit);
+
+  unit = g_slice_new0 (ThumbCacheUnit);
+
+  unit->key       = key;
+  unit->uri       = g_strdup (uri);
+  unit->memsize   = sizeof (ThumbCacheUnit) + strlen (key) + strlen (uri);
+  unit->link.data = unit;
+
+  if (pixbuf)
+    {
+      unit->pixbuf   = g_object_ref (pixbuf);
+      unit->memsize += gdk_pixbuf_get_byte_length (pixbuf);
+    }
+
+  g_hash_table_insert (thumb_cache, unit->key, unit);
+  g_queue_push_head_link (&thumb_cache_lru, &unit->link);
+
+  thumb_cache_memsize += unit->memsize;
+
+  while (thumb_cache_memsize > THUMB_CACHE_MAX_SIZE &&
+         thumb_cache_lru.length > 1)
+    {
+      gimp_imagefile_cache_remove_unit (thumb_cache_lru.tail->data);
+    }
+}
+
+static void
+gimp_imagefile_cache_remove (const gchar *uri)
+{
+  GList *list;
+
+  list = thumb_cache_lru.head;
+
+  while (list)
+    {
+      ThumbCacheUnit *unit = list->data;
+
+      list = g_list_next (list);
+
+      if (! strcmp (unit->uri, uri))
+        gimp_imagefile_cache_remove_unit (unit);
+    }
+}
+
 static void
 gimp_thumbnail_set_info_from_image (GimpThumbnail *thumbnail,
                                     const gchar   *mime_type,
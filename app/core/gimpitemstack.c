@@ -75,6 +75,9 @@ gimp_item_stack_constructed (GObject *object)
 
   gimp_assert (g_type_is_a (gimp_container_get_children_type (container),
                          GIMP_TYPE_ITEM));
+
+  /*  images can have thousands of layers  */
+  gimp_list_set_indexed (GIMP_LIST (object), TRUE);
 }
 
 static void
@@ -32,6 +32,7 @@
 #include "core-types.h"
 
 #include "operations/layer-modes/gimp-layer-modes.h"
+#include "operations/layer-modes/gimpoperationlayerstack.h"
 
 #include "gegl/gimp-babl.h"
 #include "gegl/gimp-gegl-apply-operation.h"
@@ -116,6 +117,7 @@ static gchar    * gimp_layer_get_description    (GimpViewable       *viewable,
                                                  gchar             **tooltip);
 
 static GeglNode * gimp_layer_get_node           (GimpFilter         *filter);
+static GeglNode * gimp_layer_get_mode_node      (GimpFilter         *filter);
 
 static void       gimp_layer_removed            (GimpItem           *item);
 static void       gimp_layer_unset_removed      (GimpItem           *item);
@@ -415,6 +417,7 @@ gimp_layer_class_init (GimpLayerClass *klass)
   viewable_class->get_description     = gimp_layer_get_description;
 
   filter_class->get_node              = gimp_layer_get_node;
+  filter_class->get_mode_node         = gimp_layer_get_mode_node;
 
   item_class->removed                 = gimp_layer_removed;
   item_class->unset_removed           = gimp_layer_unset_removed;
@@ -715,6 +718,8 @@ gimp_layer_update_mode_node (GimpLayer *layer)
                                 visible_composite_space,
                                 visible_composite_mode);
   gimp_gegl_mode_node_set_opacity (mode_node, layer->opacity);
+
+  gimp_filter_mode_node_changed (GIMP_FILTER (layer));
 }
 
 static void
@@ -885,6 +890,29 @@ gimp_layer_get_node (GimpFilter *filter)
   return node;
 }
 
+static GeglNode *
+gimp_layer_get_mode_node (GimpFilter *filter)
+{
+  GimpLayer *layer = GIMP_LAYER (filter);
+  GeglNode  *mode_node;
+
+  /*  the source node of a floating selection's layer is hijacked by
+   *  the drawable it is attached to
+   */
+  if (! gimp_filter_peek_node (filter) || gimp_layer_is_floating_sel (layer))
+    return NULL;
+
+  mode_node = gimp_drawable_get_mode_node (GIMP_DRAWABLE (layer));
+
+  if (! gimp_operation_layer_stack_can_fuse (
+          gegl_node_get_gegl_operation (mode_node)))
+    {
+      return NULL;
+    }
+
+  return mode_node;
+}
+
 static void
 gimp_layer_removed (GimpItem *item)
 {
@@ -2368,6 +2396,8 @@ gimp_layer_set_apply_mask (GimpLayer *layer,
             {
               gegl_node_disconnect (mode_node, "aux2");
             }
+
+          gimp_filter_mode_node_changed (GIMP_FILTER (layer));
         }
 
       gimp_drawable_update_bounding_box (GIMP_DRAWABLE (layer));
@@ -2602,6 +2632,8 @@ gimp_layer_set_floating_sel_drawable (GimpLayer    *layer,
           layer->fs.num_segs = 0;
         }
 
+      gimp_filter_mode_node_changed (GIMP_FILTER (layer));
+
       g_object_notify (G_OBJECT (layer), "floating-selection");
     }
 }
@@ -38,7 +38,24 @@ enum
   PROP_0,
   PROP_UNIQUE_NAMES,
   PROP_SORT_FUNC,
-  PROP_APPEND
+  PROP_APPEND,
+  PROP_INDEXED
+};
+
+
+/*  indexed lists keep an array of entries in queue order, plus
+ *  object -> entry and name -> entries maps.  entry->index is only
+ *  updated lazily: all entries below n_valid_indices are known to be
+ *  at the right position, the rest are renumbered on demand.
+ */
+typedef struct _GimpListEntry GimpListEntry;
+
+struct _GimpListEntry
+{
+  GimpObject *object;
+  GList      *link;
+  gint        index;
+  gchar      *name;
 };
 
 
@@ -81,11 +98,41 @@ static GimpObject * gimp_list_get_child_by_index (GimpContainer           *conta
 static gint         gimp_list_get_child_index    (GimpContainer           *container,
                                                   GimpObject              *object);
 
+static gboolean     gimp_list_tracks_names       (GimpList                *list);
+static gboolean     gimp_list_name_in_use        (GimpList                *list,
+                                                  const gchar             *name,
+                                                  GimpObject              *object);
 static void         gimp_list_uniquefy_name      (GimpList                *gimp_list,
                                                   GimpObject              *object);
 static void         gimp_list_object_renamed     (GimpObject              *object,
                                                   GimpList                *list);
 
+static void            gimp_list_index_create       (GimpList      *list);
+static void            gimp_list_index_destroy      (GimpList      *list);
+static GimpListEntry * gimp_list_index_add          (GimpList      *list,
+                                                     GimpObject    *object,
+                                                     GList         *link);
+static void            gimp_list_index_remove       (GimpList      *list,
+                                                     GimpListEntry *entry);
+static void            gimp_list_index_insert       (GimpList      *list,
+                                                     GimpListEntry *entry,
+                                                     gint           position);
+static void            gimp_list_index_unlink       (GimpList      *list,
+                                                     GimpListEntry *entry);
+static void            gimp_list_index_rebuild      (GimpList      *list);
+static gint            gimp_list_index_get_position (GimpList      *list,
+                                                     GimpListEntry *entry);
+static gint            gimp_list_index_search_sorted (GimpList     *list,
+                                                      GimpObject   *object);
+static gint            gimp_list_index_compare_positions
+                                                    (GimpListEntry *entry1,
+                                                     GimpListEntry *entry2,
+                                                     GimpList      *list);
+static void            gimp_list_index_add_name     (GimpList      *list,
+                                                     GimpListEntry *entry);
+static void            gimp_list_index_remove_name  (GimpList      *list,
+                                                     GimpListEntry *entry);
+
 
 G_DEFINE_TYPE (GimpList, gimp_list, GIMP_TYPE_CONTAINER)
 
@@ -137,6 +184,13 @@ gimp_list_class_init (GimpListClass *klass)
                                                          FALSE,
                                                          GIMP_PARAM_READWRITE |
                                                          G_PARAM_CONSTRUCT));
+
+  g_object_class_install_property (object_class, PROP_INDEXED,
+                                   g_param_spec_boolean ("indexed",
+                                                         NULL, NULL,
+                                                         FALSE,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT));
 }
 
 static void
@@ -146,6 +200,7 @@ gimp_list_init (GimpList *list)
   list->unique_names = FALSE;
   list->sort_func    = NULL;
   list->append       = FALSE;
+  list->indexed      = FALSE;
 }
 
 static void
@@ -153,6 +208,9 @@ gimp_list_finalize (GObject *object)
 {
   GimpList *list = GIMP_LIST (object);
 
+  if (list->indexed)
+    gimp_list_index_destroy (list);
+
   if (list->queue)
     {
       g_queue_free (list->queue);
@@ -181,6 +239,9 @@ gimp_list_set_property (GObject      *object,
     case PROP_APPEND:
       list->append = g_value_get_boolean (value);
       break;
+    case PROP_INDEXED:
+      gimp_list_set_indexed (list, g_value_get_boolean (value));
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -207,6 +268,9 @@ gimp_list_get_property (GObject    *object,
     case PROP_APPEND:
       g_value_set_boolean (value, list->append);
       break;
+    case PROP_INDEXED:
+      g_value_set_boolean (value, list->indexed);
+      break;
 
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -233,6 +297,16 @@ gimp_list_get_memsize (GimpObject *object,
       memsize += gimp_g_queue_get_memsize (list->queue, 0);
     }
 
+  if (list->indexed)
+    {
+      memsize += (sizeof (GPtrArray) +
+                  list->entries->len * (sizeof (gpointer) +
+                                        sizeof (GimpListEntry)));
+
+      memsize += gimp_g_hash_table_get_memsize (list->entry_table, 0);
+      memsize += gimp_g_hash_table_get_memsize (list->name_table, 0);
+    }
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -256,12 +330,26 @@ gimp_list_add (GimpContainer *container,
   if (list->unique_names)
     gimp_list_uniquefy_name (list, object);
 
-  if (list->unique_names || list->sort_func)
+  if (gimp_list_tracks_names (list))
     g_signal_connect (object, "name-changed",
                       G_CALLBACK (gimp_list_object_renamed),
                       list);
 
-  if (list->sort_func)
+  if (list->indexed)
+    {
+      GimpListEntry *entry = gimp_list_index_add (list, object, NULL);
+      gint           position;
+
+      if (list->sort_func)
+        position = gimp_list_index_search_sorted (list, object);
+      else if (list->append)
+        position = list->entries->len;
+      else
+        position = 0;
+
+      gimp_list_index_insert (list, entry, position);
+    }
+  else if (list->sort_func)
     {
       g_queue_insert_sorted (list->queue, object, gimp_list_sort_func,
                              list->sort_func);
@@ -284,12 +372,22 @@ gimp_list_remove (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
-  if (list->unique_names || list->sort_func)
+  if (gimp_list_tracks_names (list))
     g_signal_handlers_disconnect_by_func (object,
                                           gimp_list_object_renamed,
                                           list);
 
-  g_queue_remove (list->queue, object);
+  if (list->indexed)
+    {
+      GimpListEntry *entry = g_hash_table_lookup (list->entry_table, object);
+
+      gimp_list_index_unlink (list, entry);
+      gimp_list_index_remove (list, entry);
+    }
+  else
+    {
+      g_queue_remove (list->queue, object);
+    }
 
   GIMP_CONTAINER_CLASS (parent_class)->remove (container, object);
 }
@@ -301,6 +399,16 @@ gimp_list_reorder (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
+  if (list->indexed)
+    {
+      GimpListEntry *entry = g_hash_table_lookup (list->entry_table, object);
+
+      gimp_list_index_unlink (list, entry);
+      gimp_list_index_insert (list, entry, new_index);
+
+      return;
+    }
+
   g_queue_remove (list->queue, object);
 
   if (new_index == gimp_container_get_n_children (container) - 1)
@@ -324,6 +432,9 @@ gimp_list_have (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
+  if (list->indexed)
+    return g_hash_table_contains (list->entry_table, object);
+
   return g_queue_find (list->queue, object) ? TRUE : FALSE;
 }
 
@@ -376,6 +487,30 @@ gimp_list_get_children_by_name (GimpContainer *container,
   GList    *children = NULL;
   GList    *iter;
 
+  if (list->indexed)
+    {
+      GSList *entries;
+      GSList *siter;
+
+      entries = g_slist_copy (g_hash_table_lookup (list->name_table, name));
+      entries = g_slist_sort_with_data (entries,
+                                        (GCompareDataFunc)
+                                        gimp_list_index_compare_positions,
+                                        list);
+
+      /*  same (reverse) order as the loop below  */
+      for (siter = entries; siter; siter = g_slist_next (siter))
+        {
+          GimpListEntry *entry = siter->data;
+
+          children = g_list_prepend (children, entry->object);
+        }
+
+      g_slist_free (entries);
+
+      return children;
+    }
+
   for (iter = list->queue->head; iter; iter = g_list_next (iter))
     {
       GimpObject *object = iter->data;
@@ -398,6 +533,27 @@ gimp_list_get_child_by_name (GimpContainer *container,
   GimpList *list = GIMP_LIST (container);
   GList    *glist;
 
+  if (list->indexed)
+    {
+      GimpListEntry *first = NULL;
+      GSList        *iter;
+
+      for (iter = g_hash_table_lookup (list->name_table, name);
+           iter;
+           iter = g_slist_next (iter))
+        {
+          GimpListEntry *entry = iter->data;
+
+          if (! first ||
+              gimp_list_index_compare_positions (entry, first, list) < 0)
+            {
+              first = entry;
+            }
+        }
+
+      return first ? first->object : NULL;
+    }
+
   for (glist = list->queue->head; glist; glist = g_list_next (glist))
     {
       GimpObject *object = glist->data;
@@ -415,6 +571,14 @@ gimp_list_get_child_by_index (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
+  if (list->indexed)
+    {
+      if (index < 0 || index >= list->entries->len)
+        return NULL;
+
+      return ((GimpListEntry *) g_ptr_array_index (list->entries, index))->object;
+    }
+
   return g_queue_peek_nth (list->queue, index);
 }
 
@@ -424,6 +588,13 @@ gimp_list_get_child_index (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
+  if (list->indexed)
+    {
+      GimpListEntry *entry = g_hash_table_lookup (list->entry_table, object);
+
+      return entry ? gimp_list_index_get_position (list, entry) : -1;
+    }
+
   return g_queue_index (list->queue, (gpointer) object);
 }
 
@@ -495,6 +666,59 @@ gimp_list_new_weak (GType    children_type,
   return GIMP_CONTAINER (list);
 }
 
+/**
+ * gimp_list_set_indexed:
+ * @list:    a #GimpList
+ * @indexed: whether to index @list's children
+ *
+ * Makes @list keep its children in an array and hash tables, in
+ * addition to its queue, so that looking up children by index or by
+ * name takes constant time, and sorted insertion logarithmic time.
+ * Looking up the index of a child is constant time too, unless
+ * children were inserted or removed before it since the last lookup.
+ *
+ * This costs some memory per child and is meant for lists that can
+ * grow large, like item stacks and data factory containers.
+ **/
+void
+gimp_list_set_indexed (GimpList *list,
+                       gboolean  indexed)
+{
+  g_return_if_fail (GIMP_IS_LIST (list));
+
+  indexed = indexed ? TRUE : FALSE;
+
+  if (indexed != list->indexed)
+    {
+      if (indexed)
+        {
+          gimp_list_index_create (list);
+          list->indexed = TRUE;
+        }
+      else
+        {
+          list->indexed = FALSE;
+          gimp_list_index_destroy (list);
+        }
+
+      g_object_notify (G_OBJECT (list), "indexed");
+    }
+}
+
+/**
+ * gimp_list_get_indexed:
+ * @list: a #GimpList
+ *
+ * Returns: whether @list is indexed, see gimp_list_set_indexed().
+ **/
+gboolean
+gimp_list_get_indexed (GimpList *list)
+{
+  g_return_val_if_fail (GIMP_IS_LIST (list), FALSE);
+
+  return list->indexed;
+}
+
 /**
  * gimp_list_reverse:
  * @list: a #GimpList
@@ -510,6 +734,10 @@ gimp_list_reverse (GimpList *list)
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       g_queue_reverse (list->queue);
+
+      if (list->indexed)
+        gimp_list_index_rebuild (list);
+
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -574,6 +802,10 @@ gimp_list_sort (GimpList     *list,
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       g_queue_sort (list->queue, gimp_list_sort_func, sort_func);
+
+      if (list->indexed)
+        gimp_list_index_rebuild (list);
+
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -595,28 +827,60 @@ gimp_list_sort_by_name (GimpList *list)
 
 /*  private functions  */
 
+static gboolean
+gimp_list_tracks_names (GimpList *list)
+{
+  return list->unique_names || list->sort_func || list->indexed;
+}
+
+static gboolean
+gimp_list_name_in_use (GimpList    *list,
+                       const gchar *name,
+                       GimpObject  *object)
+{
+  if (list->indexed)
+    {
+      GSList *iter;
+
+      for (iter = g_hash_table_lookup (list->name_table, name);
+           iter;
+           iter = g_slist_next (iter))
+        {
+          GimpListEntry *entry = iter->data;
+
+          if (entry->object != object)
+            return TRUE;
+        }
+    }
+  else
+    {
+      GList *iter;
+
+      for (iter = list->queue->head; iter; iter = g_list_next (iter))
+        {
+          GimpObject  *object2 = iter->data;
+          const gchar *name2   = gimp_object_get_name (object2);
+
+          if (object != object2 &&
+              name2             &&
+              ! strcmp (name, name2))
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
 static void
 gimp_list_uniquefy_name (GimpList   *gimp_list,
                          GimpObject *object)
 {
   gchar *name = (gchar *) gimp_object_get_name (object);
-  GList *list;
 
   if (! name)
     return;
 
-  for (list = gimp_list->queue->head; list; list = g_list_next (list))
-    {
-      GimpObject  *object2 = list->data;
-      const gchar *name2   = gimp_object_get_name (object2);
-
-      if (object != object2 &&
-          name2             &&
-          ! strcmp (name, name2))
-        break;
-    }
-
-  if (list)
+  if (gimp_list_name_in_use (gimp_list, name, object))
     {
       gchar *ext;
       gchar *new_name   = NULL;
@@ -655,19 +919,8 @@ gimp_list_uniquefy_name (GimpList   *gimp_list,
           g_free (new_name);
 
           new_name = g_strdup_printf ("%s #%d", name, unique_ext);
-
-          for (list = gimp_list->queue->head; list; list = g_list_next (list))
-            {
-              GimpObject  *object2 = list->data;
-              const gchar *name2   = gimp_object_get_name (object2);
-
-              if (object != object2 &&
-                  name2             &&
-                  ! strcmp (new_name, name2))
-                break;
-            }
         }
-      while (list);
+      while (gimp_list_name_in_use (gimp_list, new_name, object));
 
       g_free (name);
 
@@ -692,13 +945,22 @@ gimp_list_object_renamed (GimpObject *object,
                                          list);
     }
 
+  if (list->indexed)
+    {
+      GimpListEntry *entry = g_hash_table_lookup (list->entry_table, object);
+
+      gimp_list_index_remove_name (list, entry);
+      gimp_list_index_add_name (list, entry);
+    }
+
   if (list->sort_func)
     {
       GList *glist;
       gint   old_index;
       gint   new_index = 0;
 
-      old_index = g_queue_index (list->queue, object);
+      old_index = gimp_container_get_child_index (GIMP_CONTAINER (list),
+                                                  object);
 
       for (glist = list->queue->head; glist; glist = g_list_next (glist))
         {
@@ -717,3 +979,234 @@ gimp_list_object_renamed (GimpObject *object,
         gimp_container_reorder (GIMP_CONTAINER (list), object, new_index);
     }
 }
+
+static void
+gimp_list_index_create (GimpList *list)
+{
+  GList *iter;
+
+  list->entries         = g_ptr_array_new ();
+  list->entry_table     = g_hash_table_new (NULL, NULL);
+  list->name_table      = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                 g_free, NULL);
+  list->n_valid_indices = 0;
+
+  for (iter = list->queue->head; iter; iter = g_list_next (iter))
+    {
+      GimpListEntry *entry = gimp_list_index_add (list, iter->data, iter);
+
+      g_ptr_array_add (list->entries, entry);
+
+      if (! gimp_list_tracks_names (list))
+        g_signal_connect (entry->object, "name-changed",
+                          G_CALLBACK (gimp_list_object_renamed),
+                          list);
+    }
+}
+
+static void
+gimp_list_index_destroy (GimpList *list)
+{
+  gint i;
+
+  for (i = 0; i < list->entries->len; i++)
+    {
+      GimpListEntry *entry = g_ptr_array_index (list->entries, i);
+
+      if (! gimp_list_tracks_names (list))
+        g_signal_handlers_disconnect_by_func (entry->object,
+                                              gimp_list_object_renamed,
+                                              list);
+
+      /*  the links stay in the queue  */
+      entry->link = NULL;
+
+      gimp_list_index_remove (list, entry);
+    }
+
+  g_clear_pointer (&list->entries,     g_ptr_array_unref);
+  g_clear_pointer (&list->entry_table, g_hash_table_unref);
+  g_clear_pointer (&list->name_table,  g_hash_table_unref);
+}
+
+static GimpListEntry *
+gimp_list_index_add (GimpList   *list,
+                     GimpObject *object,
+                     GList      *link)
+{
+  GimpListEntry *entry = g_slice_new0 (GimpListEntry);
+
+  entry->object = object;
+  entry->link   = link;
+  entry->index  = G_MAXINT;
+
+  if (! entry->link)
+    {
+      entry->link       = g_list_alloc ();
+      entry->link->data = object;
+    }
+
+  g_hash_table_insert (list->entry_table, object, entry);
+  gimp_list_index_add_name (list, entry);
+
+  return entry;
+}
+
+static void
+gimp_list_index_remove (GimpList      *list,
+                        GimpListEntry *entry)
+{
+  gimp_list_index_remove_name (list, entry);
+  g_hash_table_remove (list->entry_table, entry->object);
+
+  if (entry->link)
+    g_list_free_1 (entry->link);
+
+  g_slice_free (GimpListEntry, entry);
+}
+
+static void
+gimp_list_index_insert (GimpList      *list,
+                        GimpListEntry *entry,
+                        gint           position)
+{
+  if (position < 0 || position > list->entries->len)
+    position = list->entries->len;
+
+  if (position < list->entries->len)
+    {
+      GimpListEntry *next = g_ptr_array_index (list->entries, position);
+
+      g_queue_insert_before_link (list->queue, next->link, entry->link);
+    }
+  else
+    {
+      g_queue_push_tail_link (list->queue, entry->link);
+    }
+
+  g_ptr_array_insert (list->entries, position, entry);
+
+  list->n_valid_indices = MIN (list->n_valid_indices, position);
+}
+
+static void
+gimp_list_index_unlink (GimpList      *list,
+                        GimpListEntry *entry)
+{
+  gint position = gimp_list_index_get_position (list, entry);
+
+  g_queue_unlink (list->queue, entry->link);
+
+  g_ptr_array_remove_index (list->entries, position);
+
+  list->n_valid_indices = MIN (list->n_valid_indices, position);
+}
+
+static void
+gimp_list_index_rebuild (GimpList *list)
+{
+  GList *iter;
+  gint   i;
+
+  for (iter = list->queue->head, i = 0;
+       iter;
+       iter = g_list_next (iter), i++)
+    {
+      g_ptr_array_index (list->entries, i) =
+        g_hash_table_lookup (list->entry_table, iter->data);
+    }
+
+  list->n_valid_indices = 0;
+}
+
+static gint
+gimp_list_index_get_position (GimpList      *list,
+                              GimpListEntry *entry)
+{
+  if (entry->index >= list->n_valid_indices)
+    {
+      gint i;
+
+      for (i = list->n_valid_indices; i < list->entries->len; i++)
+        {
+          GimpListEntry *entry2 = g_ptr_array_index (list->entries, i);
+
+          entry2->index = i;
+        }
+
+      list->n_valid_indices = list->entries->len;
+    }
+
+  return entry->index;
+}
+
+static gint
+gimp_list_index_search_sorted (GimpList   *list,
+                               GimpObject *object)
+{
+  gint lo = 0;
+  gint hi = list->entries->len;
+
+  /*  find the first child not sorting before @object, which is where
+   *  g_queue_insert_sorted() would insert it
+   */
+  while (lo < hi)
+    {
+      gint           mid   = (lo + hi) / 2;
+      GimpListEntry *entry = g_ptr_array_index (list->entries, mid);
+
+      if (list->sort_func (entry->object, object) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+static gint
+gimp_list_index_compare_positions (GimpListEntry *entry1,
+                                   GimpListEntry *entry2,
+                                   GimpList      *list)
+{
+  return (gimp_list_index_get_position (list, entry1) -
+          gimp_list_index_get_position (list, entry2));
+}
+
+static void
+gimp_list_index_add_name (GimpList      *list,
+                          GimpListEntry *entry)
+{
+  const gchar *name = gimp_object_get_name (entry->object);
+  GSList      *entries;
+
+  if (! name)
+    return;
+
+  entry->name = g_strdup (name);
+
+  entries = g_hash_table_lookup (list->name_table, name);
+
+  g_hash_table_insert (list->name_table,
+                       g_strdup (name), g_slist_prepend (entries, entry));
+}
+
+static void
+gimp_list_index_remove_name (GimpList      *list,
+                             GimpListEntry *entry)
+{
+  GSList *entries;
+
+  if (! entry->name)
+    return;
+
+  entries = g_hash_table_lookup (list->name_table, entry->name);
+  entries = g_slist_remove (entries, entry);
+
+  if (entries)
+    g_hash_table_insert (list->name_table, g_strdup (entry->name), entries);
+  else
+    g_hash_table_remove (list->name_table, entry->name);
+
+  g_clear_pointer (&entry->name, g_free);
+}
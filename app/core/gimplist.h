@@ -43,6 +43,13 @@ struct _GimpList
   gboolean       unique_names;
   GCompareFunc   sort_func;
   gboolean       append;
+  gboolean       indexed;
+
+  /*  only used by indexed lists, see gimp_list_set_indexed()  */
+  GPtrArray     *entries;
+  GHashTable    *entry_table;
+  GHashTable    *name_table;
+  gint           n_valid_indices;
 };
 
 struct _GimpListClass
@@ -58,6 +65,10 @@ GimpContainer * gimp_list_new           (GType         children_type,
 GimpContainer * gimp_list_new_weak      (GType         children_type,
                                          gboolean      unique_names);
 
+void            gimp_list_set_indexed   (GimpList     *list,
+                                         gboolean      indexed);
+gboolean        gimp_list_get_indexed   (GimpList     *list);
+
 void            gimp_list_reverse       (GimpList     *list);
 void            gimp_list_set_sort_func (GimpList     *list,
                                          GCompareFunc  sort_func);
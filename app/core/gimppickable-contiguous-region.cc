@@ -55,6 +55,34 @@ typedef struct
   gint   level;
 } BorderPixel;
 
+typedef struct
+{
+  gfloat *diff;     /* the pixels' difference from the seed color */
+  guint8 *visited;  /* one bit per pixel, set for selected pixels   */
+} ContiguousTile;
+
+typedef struct
+{
+  GeglRectangle        extent;
+  gint                 tile_width;
+  gint                 tile_height;
+  gint                 n_tiles_x;
+  gint                 n_tiles_y;
+  ContiguousTile      *tiles;
+
+  GeglBuffer          *src_buffer;
+  const Babl          *format;
+  gfloat              *src;
+
+  const gfloat        *col;
+  gint                 n_components;
+  gboolean             has_alpha;
+  gboolean             select_transparent;
+  GimpSelectCriterion  select_criterion;
+  gboolean             antialias;
+  gfloat               threshold;
+} ContiguousRegion;
+
 
 /*  local function prototypes  */
 
@@ -115,6 +143,32 @@ static void     find_contiguous_region    (GeglBuffer          *src_buffer,
                                            gint                 y,
                                            const gfloat        *col);
 
+static void     find_contiguous_region_tiled
+                                          (GeglBuffer          *src_buffer,
+                                           GeglBuffer          *mask_buffer,
+                                           const Babl          *format,
+                                           gint                 n_components,
+                                           gboolean             has_alpha,
+                                           gboolean             select_transparent,
+                                           GimpSelectCriterion  select_criterion,
+                                           gboolean             antialias,
+                                           gfloat               threshold,
+                                           gboolean             diagonal_neighbors,
+                                           gint                 x,
+                                           gint                 y,
+                                           const gfloat        *col);
+
+static GeglBuffer *
+                contiguous_region_by_seed (GimpPickable        *pickable,
+                                           gboolean             antialias,
+                                           gfloat               threshold,
+                                           gboolean             select_transparent,
+                                           GimpSelectCriterion  select_criterion,
+                                           gboolean             diagonal_neighbors,
+                                           gint                 x,
+                                           gint                 y,
+                                           gboolean             sampled);
+
 static void            line_art_queue_pixel (GQueue              *queue,
                                              gint                 x,
                                              gint                 y,
@@ -133,59 +187,38 @@ gimp_pickable_contiguous_region_by_seed (GimpPickable        *pickable,
                                          gint                 x,
                                          gint                 y)
 {
-  GeglBuffer    *src_buffer;
-  GeglBuffer    *mask_buffer;
-  const Babl    *format;
-  GeglRectangle  extent;
-  gint           n_components;
-  gboolean       has_alpha;
-  gfloat         start_col[MAX_CHANNELS];
-
   g_return_val_if_fail (GIMP_IS_PICKABLE (pickable), NULL);
 
-  gimp_pickable_flush (pickable);
-  src_buffer = gimp_pickable_get_buffer (pickable);
-
-  format = choose_format (src_buffer, select_criterion,
-                          &n_components, &has_alpha);
-  gegl_buffer_sample (src_buffer, x, y, NULL, start_col, format,
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-
-  if (has_alpha)
-    {
-      if (select_transparent)
-        {
-          /*  don't select transparent regions if the start pixel isn't
-           *  fully transparent
-           */
-          if (start_col[n_components - 1] > 0)
-            select_transparent = FALSE;
-        }
-    }
-  else
-    {
-      select_transparent = FALSE;
-    }
-
-  extent = *gegl_buffer_get_extent (src_buffer);
-
-  mask_buffer = gegl_buffer_new (&extent, babl_format ("Y float"));
-
-  if (x >= extent.x && x < (extent.x + extent.width) &&
-      y >= extent.y && y < (extent.y + extent.height))
-    {
-      GIMP_TIMER_START();
-
-      find_contiguous_region (src_buffer, mask_buffer,
-                              format, n_components, has_alpha,
-                              select_transparent, select_criterion,
-                              antialias, threshold, diagonal_neighbors,
-                              x, y, start_col);
+  return contiguous_region_by_seed (pickable,
+                                    antialias, threshold,
+                                    select_transparent, select_criterion,
+                                    diagonal_neighbors,
+                                    x, y,
+                                    FALSE);
+}
 
-      GIMP_TIMER_END("foo");
-    }
+/*  the old, sampler-based implementation of
+ *  gimp_pickable_contiguous_region_by_seed(), which is only kept around
+ *  to test the tiled one against, see app/tests/test-contiguous-region.c
+ */
+GeglBuffer *
+gimp_pickable_contiguous_region_by_seed_sampled (GimpPickable        *pickable,
+                                                 gboolean             antialias,
+                                                 gfloat               threshold,
+                                                 gboolean             select_transparent,
+                                                 GimpSelectCriterion  select_criterion,
+                                                 gboolean             diagonal_neighbors,
+                                                 gint                 x,
+                                                 gint                 y)
+{
+  g_return_val_if_fail (GIMP_IS_PICKABLE (pickable), NULL);
 
-  return mask_buffer;
+  return contiguous_region_by_seed (pickable,
+                                    antialias, threshold,
+                                    select_transparent, select_criterion,
+                                    diagonal_neighbors,
+                                    x, y,
+                                    TRUE);
 }
 
 GeglBuffer *
@@ -690,6 +723,82 @@ gimp_pickable_contiguous_region_by_line_art (GimpPickable  *pickable,
 
 /*  private functions  */
 
+static GeglBuffer *
+contiguous_region_by_seed (GimpPickable        *pickable,
+                           gboolean             antialias,
+                           gfloat               threshold,
+                           gboolean             select_transparent,
+                           GimpSelectCriterion  select_criterion,
+                           gboolean             diagonal_neighbors,
+                           gint                 x,
+                           gint                 y,
+                           gboolean             sampled)
+{
+  GeglBuffer    *src_buffer;
+  GeglBuffer    *mask_buffer;
+  const Babl    *format;
+  GeglRectangle  extent;
+  gint           n_components;
+  gboolean       has_alpha;
+  gfloat         start_col[MAX_CHANNELS];
+
+  gimp_pickable_flush (pickable);
+  src_buffer = gimp_pickable_get_buffer (pickable);
+
+  format = choose_format (src_buffer, select_criterion,
+                          &n_components, &has_alpha);
+  gegl_buffer_sample (src_buffer, x, y, NULL, start_col, format,
+                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+
+  if (has_alpha)
+    {
+      if (select_transparent)
+        {
+          /*  don't select transparent regions if the start pixel isn't
+           *  fully transparent
+           */
+          if (start_col[n_components - 1] > 0)
+            select_transparent = FALSE;
+        }
+    }
+  else
+    {
+      select_transparent = FALSE;
+    }
+
+  extent = *gegl_buffer_get_extent (src_buffer);
+
+  mask_buffer = gegl_buffer_new (&extent, babl_format ("Y float"));
+
+  if (x >= extent.x && x < (extent.x + extent.width) &&
+      y >= extent.y && y < (extent.y + extent.height))
+    {
+      GIMP_TIMER_START();
+
+      if (sampled)
+        {
+          find_contiguous_region (src_buffer, mask_buffer,
+                                  format, n_components, has_alpha,
+                                  select_transparent, select_criterion,
+                                  antialias, threshold, diagonal_neighbors,
+                                  x, y, start_col);
+        }
+      else
+        {
+          find_contiguous_region_tiled (src_buffer, mask_buffer,
+                                        format, n_components, has_alpha,
+                                        select_transparent, select_criterion,
+                                        antialias, threshold,
+                                        diagonal_neighbors,
+                                        x, y, start_col);
+        }
+
+      GIMP_TIMER_END("foo");
+    }
+
+  return mask_buffer;
+}
+
 static const Babl *
 choose_format (GeglBuffer          *buffer,
                GimpSelectCriterion  select_criterion,
@@ -1185,6 +1294,345 @@ find_contiguous_region (GeglBuffer          *src_buffer,
 #endif
 }
 
+/*  the tiled implementation fetches each tile of the source once, in
+ *  a single gegl_buffer_get(), and immediately turns it into the
+ *  pixels' differences from the seed color.  segments are then found
+ *  by scanning the difference rows directly, crossing tile edges as
+ *  needed, and the selected pixels are tracked in a per-tile bitmap.
+ *  the mask is only written at the end, one tile at a time.
+ */
+
+static inline gboolean
+contiguous_tile_is_visited (const ContiguousTile *tile,
+                            gint                  offset)
+{
+  return (tile->visited[offset >> 3] >> (offset & 7)) & 1;
+}
+
+static inline void
+contiguous_tile_visit (ContiguousTile *tile,
+                       gint            offset)
+{
+  tile->visited[offset >> 3] |= 1 << (offset & 7);
+}
+
+static void
+contiguous_region_get_tile_rect (ContiguousRegion *region,
+                                 gint              tile_x,
+                                 gint              tile_y,
+                                 GeglRectangle    *rect)
+{
+  rect->x      = region->extent.x + tile_x * region->tile_width;
+  rect->y      = region->extent.y + tile_y * region->tile_height;
+  rect->width  = MIN (region->tile_width,
+                      region->extent.x + region->extent.width  - rect->x);
+  rect->height = MIN (region->tile_height,
+                      region->extent.y + region->extent.height - rect->y);
+}
+
+static void
+contiguous_region_load_tile (ContiguousRegion *region,
+                             ContiguousTile   *tile,
+                             gint              tile_x,
+                             gint              tile_y)
+{
+  GeglRectangle rect;
+  gint          x, y;
+
+  contiguous_region_get_tile_rect (region, tile_x, tile_y, &rect);
+
+  gegl_buffer_get (region->src_buffer, &rect, 1.0, region->format,
+                   region->src,
+                   region->tile_width * region->n_components * sizeof (gfloat),
+                   GEGL_ABYSS_NONE);
+
+  tile->diff    = g_new  (gfloat, region->tile_width * region->tile_height);
+  tile->visited = g_new0 (guint8,
+                          (region->tile_width * region->tile_height + 7) / 8);
+
+  for (y = 0; y < rect.height; y++)
+    {
+      const gfloat *s = region->src +
+                        y * region->tile_width * region->n_components;
+      gfloat       *d = tile->diff + y * region->tile_width;
+
+      for (x = 0; x < rect.width; x++)
+        {
+          d[x] = pixel_difference (region->col, s,
+                                   region->antialias,
+                                   region->threshold,
+                                   region->n_components,
+                                   region->has_alpha,
+                                   region->select_transparent,
+                                   region->select_criterion);
+
+          s += region->n_components;
+        }
+    }
+}
+
+/*  returns the tile containing (x, y), loading it if necessary, and the
+ *  offset of (x, y) within the tile
+ */
+static inline ContiguousTile *
+contiguous_region_get_tile (ContiguousRegion *region,
+                            gint              x,
+                            gint              y,
+                            gint             *offset)
+{
+  ContiguousTile *tile;
+  gint            tile_x;
+  gint            tile_y;
+
+  x -= region->extent.x;
+  y -= region->extent.y;
+
+  tile_x = x / region->tile_width;
+  tile_y = y / region->tile_height;
+
+  tile = &region->tiles[tile_y * region->n_tiles_x + tile_x];
+
+  if (! tile->diff)
+    contiguous_region_load_tile (region, tile, tile_x, tile_y);
+
+  *offset = (y - tile_y * region->tile_height) * region->tile_width +
+            (x - tile_x * region->tile_width);
+
+  return tile;
+}
+
+/*  selects pixels leftwards from (x, y), and returns the x coordinate of
+ *  the first unselected one
+ */
+static gint
+contiguous_region_scan_left (ContiguousRegion *region,
+                             gint              x,
+                             gint              y)
+{
+  while (x >= region->extent.x)
+    {
+      ContiguousTile *tile;
+      gint            offset;
+      gint            n;
+      gint            i;
+
+      tile = contiguous_region_get_tile (region, x, y, &offset);
+
+      n = (x - region->extent.x) % region->tile_width + 1;
+
+      for (i = 0; i < n; i++)
+        {
+          if (tile->diff[offset - i] == 0.0f)
+            return x - i;
+
+          contiguous_tile_visit (tile, offset - i);
+        }
+
+      x -= n;
+    }
+
+  return x;
+}
+
+/*  selects pixels rightwards from (x, y), and returns the x coordinate
+ *  of the first unselected one
+ */
+static gint
+contiguous_region_scan_right (ContiguousRegion *region,
+                              gint              x,
+                              gint              y)
+{
+  gint x_end = region->extent.x + region->extent.width;
+
+  while (x < x_end)
+    {
+      ContiguousTile *tile;
+      gint            offset;
+      gint            n;
+      gint            i;
+
+      tile = contiguous_region_get_tile (region, x, y, &offset);
+
+      n = MIN (x_end - x,
+               region->tile_width -
+               (x - region->extent.x) % region->tile_width);
+
+      for (i = 0; i < n; i++)
+        {
+          if (tile->diff[offset + i] == 0.0f)
+            return x + i;
+
+          contiguous_tile_visit (tile, offset + i);
+        }
+
+      x += n;
+    }
+
+  return x;
+}
+
+static void
+find_contiguous_region_tiled (GeglBuffer          *src_buffer,
+                              GeglBuffer          *mask_buffer,
+                              const Babl          *format,
+                              gint                 n_components,
+                              gboolean             has_alpha,
+                              gboolean             select_transparent,
+                              GimpSelectCriterion  select_criterion,
+                              gboolean             antialias,
+                              gfloat               threshold,
+                              gboolean             diagonal_neighbors,
+                              gint                 x,
+                              gint                 y,
+                              const gfloat        *col)
+{
+  ContiguousRegion  region;
+  gint              old_y;
+  gint              start, end;
+  gint              new_start, new_end;
+  GQueue           *segment_queue;
+
+  region.extent = *gegl_buffer_get_extent (src_buffer);
+
+  g_object_get (src_buffer,
+                "tile-width",  &region.tile_width,
+                "tile-height", &region.tile_height,
+                NULL);
+
+  region.n_tiles_x = (region.extent.width  + region.tile_width  - 1) /
+                     region.tile_width;
+  region.n_tiles_y = (region.extent.height + region.tile_height - 1) /
+                     region.tile_height;
+  region.tiles     = g_new0 (ContiguousTile,
+                             region.n_tiles_x * region.n_tiles_y);
+
+  region.src_buffer         = src_buffer;
+  region.format             = format;
+  region.src                = g_new (gfloat,
+                                     region.tile_width  *
+                                     region.tile_height *
+                                     n_components);
+
+  region.col                = col;
+  region.n_components       = n_components;
+  region.has_alpha          = has_alpha;
+  region.select_transparent = select_transparent;
+  region.select_criterion   = select_criterion;
+  region.antialias          = antialias;
+  region.threshold          = threshold;
+
+  segment_queue = g_queue_new ();
+
+  push_segment (segment_queue,
+                y, /* dummy values: */ -1, 0, 0,
+                y, x - 1, x + 1);
+
+  do
+    {
+      pop_segment (segment_queue,
+                   &y, &old_y, &start, &end);
+
+      for (x = start + 1; x < end; x++)
+        {
+          ContiguousTile *tile;
+          gint            offset;
+
+          tile = contiguous_region_get_tile (&region, x, y, &offset);
+
+          if (contiguous_tile_is_visited (tile, offset))
+            {
+              /* If the current pixel is selected, then we've already visited
+               * the next pixel.
+               */
+              x++;
+              continue;
+            }
+
+          if (tile->diff[offset] == 0.0f)
+            continue;
+
+          contiguous_tile_visit (tile, offset);
+
+          new_start = contiguous_region_scan_left  (&region, x - 1, y);
+          new_end   = contiguous_region_scan_right (&region, x + 1, y);
+
+          /* We can skip directly to `new_end + 1` on the next iteration,
+           * since we've just selected all pixels in the range `[x, new_end)`,
+           * and the pixel at `new_end` is above threshold.
+           */
+          x = new_end;
+
+          if (diagonal_neighbors)
+            {
+              if (new_start >= region.extent.x)
+                new_start--;
+
+              if (new_end < region.extent.x + region.extent.width)
+                new_end++;
+            }
+
+          if (y + 1 < region.extent.y + region.extent.height)
+            {
+              push_segment (segment_queue,
+                            y, old_y, start, end,
+                            y + 1, new_start, new_end);
+            }
+
+          if (y - 1 >= region.extent.y)
+            {
+              push_segment (segment_queue,
+                            y, old_y, start, end,
+                            y - 1, new_start, new_end);
+            }
+        }
+    }
+  while (! g_queue_is_empty (segment_queue));
+
+  g_queue_free (segment_queue);
+
+  g_free (region.src);
+
+  /*  write the selected pixels' differences to the mask, and free the
+   *  tiles
+   */
+  gegl_parallel_distribute_range (
+    region.n_tiles_x * region.n_tiles_y, /* each thread costs as much as */ 1,
+    [&] (gsize offset, gsize size)
+    {
+      const Babl *mask_format = babl_format ("Y float");
+      gsize       i;
+
+      for (i = offset; i < offset + size; i++)
+        {
+          ContiguousTile *tile = &region.tiles[i];
+          GeglRectangle   rect;
+          gint            j;
+
+          if (! tile->diff)
+            continue;
+
+          for (j = 0; j < region.tile_width * region.tile_height; j++)
+            {
+              if (! contiguous_tile_is_visited (tile, j))
+                tile->diff[j] = 0.0f;
+            }
+
+          contiguous_region_get_tile_rect (&region,
+                                           i % region.n_tiles_x,
+                                           i / region.n_tiles_x,
+                                           &rect);
+
+          gegl_buffer_set (mask_buffer, &rect, 0, mask_format,
+                           tile->diff, region.tile_width * sizeof (gfloat));
+
+          g_free (tile->diff);
+          g_free (tile->visited);
+        }
+    });
+
+  g_free (region.tiles);
+}
+
 static void
 line_art_queue_pixel (GQueue *queue,
                       gint    x,
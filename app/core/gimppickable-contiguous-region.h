@@ -28,6 +28,15 @@ GeglBuffer * gimp_pickable_contiguous_region_by_seed                (GimpPickabl
                                                                      gint                 x,
                                                                      gint                 y);
 
+GeglBuffer * gimp_pickable_contiguous_region_by_seed_sampled        (GimpPickable        *pickable,
+                                                                     gboolean             antialias,
+                                                                     gfloat               threshold,
+                                                                     gboolean             select_transparent,
+                                                                     GimpSelectCriterion  select_criterion,
+                                                                     gboolean             diagonal_neighbors,
+                                                                     gint                 x,
+                                                                     gint                 y);
+
 GeglBuffer * gimp_pickable_contiguous_region_by_color               (GimpPickable        *pickable,
                                                                      gboolean             antialias,
                                                                      gfloat               threshold,
@@ -896,6 +896,10 @@ gimp_projection_paint_area (GimpProjection *proj,
     {
       if (now)
         {
+          /*  the graph is only ever processed by one thread at a time;
+           *  the chunk is still rendered on all threads, by the graph's
+           *  operations, which parallelize themselves.
+           */
           gimp_tile_handler_validate_validate (
             proj->priv->validate_handler,
             proj->priv->buffer,
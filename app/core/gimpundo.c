@@ -89,6 +89,7 @@ static void          gimp_undo_real_pop            (GimpUndo            *undo,
                                                     GimpUndoAccumulator *accum);
 static void          gimp_undo_real_free           (GimpUndo            *undo,
                                                     GimpUndoMode         undo_mode);
+static void          gimp_undo_real_swap_out       (GimpUndo            *undo);
 
 static gboolean      gimp_undo_create_preview_idle (gpointer             data);
 static void       gimp_undo_create_preview_private (GimpUndo            *undo,
@@ -142,6 +143,7 @@ gimp_undo_class_init (GimpUndoClass *klass)
 
   klass->pop                        = gimp_undo_real_pop;
   klass->free                       = gimp_undo_real_free;
+  klass->swap_out                   = gimp_undo_real_swap_out;
 
   g_object_class_install_property (object_class, PROP_IMAGE,
                                    g_param_spec_object ("image", NULL, NULL,
@@ -345,6 +347,11 @@ gimp_undo_real_free (GimpUndo     *undo,
 {
 }
 
+static void
+gimp_undo_real_swap_out (GimpUndo *undo)
+{
+}
+
 void
 gimp_undo_pop (GimpUndo            *undo,
                GimpUndoMode         undo_mode,
@@ -368,6 +375,9 @@ gimp_undo_pop (GimpUndo            *undo,
     }
 
   g_signal_emit (undo, undo_signals[POP], 0, undo_mode, accum);
+
+  /*  popping the undo brought its data back into memory  */
+  undo->swapped = FALSE;
 }
 
 void
@@ -379,6 +389,24 @@ gimp_undo_free (GimpUndo     *undo,
   g_signal_emit (undo, undo_signals[FREE], 0, undo_mode);
 }
 
+/*  moves the data of an undo step which is not likely to be popped soon
+ *  out of memory.  the undo's memsize must reflect the new state as soon
+ *  as this function returns, even if the actual work happens in the
+ *  background.
+ */
+void
+gimp_undo_swap_out (GimpUndo *undo)
+{
+  g_return_if_fail (GIMP_IS_UNDO (undo));
+
+  if (! undo->swapped)
+    {
+      GIMP_UNDO_GET_CLASS (undo)->swap_out (undo);
+
+      undo->swapped = TRUE;
+    }
+}
+
 typedef struct _GimpUndoIdle GimpUndoIdle;
 
 struct _GimpUndoIdle
@@ -493,6 +521,9 @@ gimp_undo_create_preview_private (GimpUndo    *undo,
   undo->preview = gimp_viewable_get_new_preview (preview_viewable, context,
                                                  width, height);
 
+  /*  the preview counts towards the undo's memsize  */
+  gimp_image_undo_update_memsize (image, undo);
+
   gimp_viewable_invalidate_preview (GIMP_VIEWABLE (undo));
 }
 
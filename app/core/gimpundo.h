@@ -61,6 +61,10 @@ struct _GimpUndo
 
   GimpTempBuf      *preview;
   guint             preview_idle_id;
+
+  gint64            memsize;        /* memsize accounted by the undo stack */
+  gint64            gui_memsize;    /* gui_size accounted by the undo stack */
+  gboolean          swapped;        /* undo data was moved out of memory   */
 };
 
 struct _GimpUndoClass
@@ -72,6 +76,8 @@ struct _GimpUndoClass
                  GimpUndoAccumulator *accum);
   void (* free) (GimpUndo            *undo,
                  GimpUndoMode         undo_mode);
+
+  void (* swap_out) (GimpUndo        *undo);
 };
 
 
@@ -82,6 +88,7 @@ void          gimp_undo_pop             (GimpUndo            *undo,
                                          GimpUndoAccumulator *accum);
 void          gimp_undo_free            (GimpUndo            *undo,
                                          GimpUndoMode         undo_mode);
+void          gimp_undo_swap_out        (GimpUndo            *undo);
 
 void          gimp_undo_create_preview  (GimpUndo            *undo,
                                          GimpContext         *context,
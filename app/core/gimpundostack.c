@@ -38,6 +38,13 @@ static void    gimp_undo_stack_pop         (GimpUndo            *undo,
                                             GimpUndoAccumulator *accum);
 static void    gimp_undo_stack_free        (GimpUndo            *undo,
                                             GimpUndoMode         undo_mode);
+static void    gimp_undo_stack_real_swap_out
+                                           (GimpUndo            *undo);
+
+static void    gimp_undo_stack_account     (GimpUndoStack       *stack,
+                                            GimpUndo            *undo);
+static void    gimp_undo_stack_unaccount   (GimpUndoStack       *stack,
+                                            GimpUndo            *undo);
 
 
 G_DEFINE_TYPE (GimpUndoStack, gimp_undo_stack, GIMP_TYPE_UNDO)
@@ -58,6 +65,7 @@ gimp_undo_stack_class_init (GimpUndoStackClass *klass)
 
   undo_class->pop                = gimp_undo_stack_pop;
   undo_class->free               = gimp_undo_stack_free;
+  undo_class->swap_out           = gimp_undo_stack_real_swap_out;
 }
 
 static void
@@ -83,7 +91,14 @@ gimp_undo_stack_get_memsize (GimpObject *object,
   GimpUndoStack *stack   = GIMP_UNDO_STACK (object);
   gint64         memsize = 0;
 
-  memsize += gimp_object_get_memsize (GIMP_OBJECT (stack->undos), gui_size);
+  /*  the undos' memsize is tracked as they are added and removed,
+   *  so we don't need to walk the whole stack here
+   */
+  memsize += stack->undos_memsize;
+  memsize += gimp_container_get_n_children (stack->undos) * sizeof (GList);
+
+  if (gui_size)
+    *gui_size += stack->undos_gui_memsize;
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -104,6 +119,9 @@ gimp_undo_stack_pop (GimpUndo            *undo,
       GimpUndo *child = list->data;
 
       gimp_undo_pop (child, undo_mode, accum);
+
+      /*  popping may have swapped the child's data back in  */
+      gimp_undo_stack_account (stack, child);
     }
 }
 
@@ -121,10 +139,47 @@ gimp_undo_stack_free (GimpUndo     *undo,
       GimpUndo *child = list->data;
 
       gimp_undo_free (child, undo_mode);
+      child->memsize     = 0;
+      child->gui_memsize = 0;
       g_object_unref (child);
     }
 
   gimp_container_clear (stack->undos);
+
+  stack->undos_memsize     = 0;
+  stack->undos_gui_memsize = 0;
+}
+
+static void
+gimp_undo_stack_real_swap_out (GimpUndo *undo)
+{
+  gimp_undo_stack_swap_out (GIMP_UNDO_STACK (undo), 0);
+}
+
+static void
+gimp_undo_stack_account (GimpUndoStack *stack,
+                         GimpUndo      *undo)
+{
+  gint64 gui_memsize = 0;
+  gint64 memsize     = gimp_object_get_memsize (GIMP_OBJECT (undo),
+                                                &gui_memsize);
+
+  stack->undos_memsize     += memsize - undo->memsize;
+  stack->undos_gui_memsize += gui_memsize - undo->gui_memsize;
+
+  undo->memsize     = memsize;
+  undo->gui_memsize = gui_memsize;
+}
+
+static void
+gimp_undo_stack_unaccount (GimpUndoStack *stack,
+                           GimpUndo      *undo)
+{
+  stack->undos_memsize     -= undo->memsize;
+  stack->undos_gui_memsize -= undo->gui_memsize;
+
+  undo->memsize     = 0;
+  undo->gui_memsize = 0;
 }
 
 GimpUndoStack *
@@ -145,6 +200,8 @@ gimp_undo_stack_push_undo (GimpUndoStack *stack,
   g_return_if_fail (GIMP_IS_UNDO (undo));
 
   gimp_container_add (stack->undos, GIMP_OBJECT (undo));
+
+  gimp_undo_stack_account (stack, undo);
 }
 
 GimpUndo *
@@ -162,6 +219,8 @@ gimp_undo_stack_pop_undo (GimpUndoStack       *stack,
   if (undo)
     {
       gimp_container_remove (stack->undos, GIMP_OBJECT (undo));
+      gimp_undo_stack_unaccount (stack, undo);
+
       gimp_undo_pop (undo, undo_mode, accum);
 
       return undo;
@@ -183,6 +242,8 @@ gimp_undo_stack_free_bottom (GimpUndoStack *stack,
   if (undo)
     {
       gimp_container_remove (stack->undos, GIMP_OBJECT (undo));
+      gimp_undo_stack_unaccount (stack, undo);
+
       gimp_undo_free (undo, undo_mode);
 
       return undo;
@@ -206,3 +267,67 @@ gimp_undo_stack_get_depth (GimpUndoStack *stack)
 
   return gimp_container_get_n_children (stack->undos);
 }
+
+/*  re-reads the memsize of an undo whose size has changed, e.g. an undo
+ *  group which has been added to after it was pushed, an undo whose
+ *  preview has been created, or an undo which failed to swap out.  the
+ *  undo may be part of a group in the stack, in which case the groups
+ *  containing it are re-read too.  returns FALSE if the undo is not
+ *  part of the stack.
+ */
+gboolean
+gimp_undo_stack_update_memsize (GimpUndoStack *stack,
+                                GimpUndo      *undo)
+{
+  GList *list;
+
+  g_return_val_if_fail (GIMP_IS_UNDO_STACK (stack), FALSE);
+  g_return_val_if_fail (GIMP_IS_UNDO (undo), FALSE);
+
+  for (list = GIMP_LIST (stack->undos)->queue->head;
+       list;
+       list = g_list_next (list))
+    {
+      GimpUndo *child = list->data;
+
+      if (child == undo                  ||
+          (GIMP_IS_UNDO_STACK (child) &&
+           gimp_undo_stack_update_memsize (GIMP_UNDO_STACK (child), undo)))
+        {
+          gimp_undo_stack_account (stack, child);
+
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/*  swaps out the undos below the topmost 'n_keep' ones.  undos which are
+ *  already swapped out are skipped; since swapping can fail, or an undo
+ *  may be swapped back in, they don't mark the end of the undos which
+ *  still need to be swapped out.
+ */
+void
+gimp_undo_stack_swap_out (GimpUndoStack *stack,
+                          gint           n_keep)
+{
+  GList *list;
+
+  g_return_if_fail (GIMP_IS_UNDO_STACK (stack));
+  g_return_if_fail (n_keep >= 0);
+
+  for (list = g_list_nth (GIMP_LIST (stack->undos)->queue->head, n_keep);
+       list;
+       list = g_list_next (list))
+    {
+      GimpUndo *undo = list->data;
+
+      if (undo->swapped)
+        continue;
+
+      gimp_undo_swap_out (undo);
+
+      gimp_undo_stack_account (stack, undo);
+    }
+}
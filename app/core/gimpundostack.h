@@ -37,6 +37,8 @@ struct _GimpUndoStack
   GimpUndo       parent_instance;
 
   GimpContainer *undos;
+  gint64         undos_memsize;      /* sum of the undos' accounted memsize */
+  gint64         undos_gui_memsize;  /* sum of the undos' accounted gui_size */
 };
 
 struct _GimpUndoStackClass
@@ -60,5 +62,11 @@ GimpUndo      * gimp_undo_stack_free_bottom (GimpUndoStack       *stack,
 GimpUndo      * gimp_undo_stack_peek        (GimpUndoStack       *stack);
 gint            gimp_undo_stack_get_depth   (GimpUndoStack       *stack);
 
+gboolean        gimp_undo_stack_update_memsize
+                                            (GimpUndoStack       *stack,
+                                             GimpUndo            *undo);
+void            gimp_undo_stack_swap_out    (GimpUndoStack       *stack,
+                                             gint                 n_keep);
+
 
 #endif /* __GIMP_UNDO_STACK_H__ */
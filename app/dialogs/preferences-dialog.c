@@ -1503,6 +1503,13 @@ prefs_dialog_new (Gimp       *gimp,
                                  _("_Optimize image display for:"),
                                  GTK_GRID (grid), row++, size_group);
 
+    button = gimp_prop_check_button_new (color_config,
+                                         "display-use-lut",
+                                         _("Use _lookup tables for display "
+                                           "and soft-proofing"));
+    gtk_grid_attach (GTK_GRID (grid), button, 1, row, 1, 1);
+    row++;
+
     /*  Print Simulation (Soft-proofing)  */
     vbox2 = prefs_frame_new (_("Soft-Proofing"),
                              GTK_CONTAINER (vbox),
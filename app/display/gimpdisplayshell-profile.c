@@ -147,14 +147,21 @@ gimp_display_shell_profile_update (GimpDisplayShell *shell)
 
   if (! gimp_color_transform_can_gegl_copy (src_profile, filter_profile))
     {
+      GimpColorTransformFlags flags = 0;
+
+      flags |= GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION;
+      flags |= GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE;
+
+      if (gimp_color_config_get_display_use_lut (shell->color_config))
+        flags |= GIMP_COLOR_TRANSFORM_FLAGS_LUT;
+
       shell->filter_transform =
         gimp_color_transform_new (src_profile,
                                   src_format,
                                   filter_profile,
                                   filter_format,
                                   GIMP_COLOR_RENDERING_INTENT_RELATIVE_COLORIMETRIC,
-                                  GIMP_COLOR_TRANSFORM_FLAGS_BLACK_POINT_COMPENSATION |
-                                  GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE);
+                                  flags);
     }
 
   shell->profile_transform =
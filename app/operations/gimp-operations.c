@@ -57,6 +57,7 @@
 #include "gimpoperationdesaturate.h"
 #include "gimpoperationhuesaturation.h"
 #include "gimpoperationlevels.h"
+#include "gimpoperationpointfilterchain.h"
 #include "gimpoperationposterize.h"
 #include "gimpoperationthreshold.h"
 
@@ -91,6 +92,7 @@
 #include "layer-modes/gimpoperationbehind.h"
 #include "layer-modes/gimpoperationdissolve.h"
 #include "layer-modes/gimpoperationerase.h"
+#include "layer-modes/gimpoperationlayerstack.h"
 #include "layer-modes/gimpoperationmerge.h"
 #include "layer-modes/gimpoperationnormal.h"
 #include "layer-modes/gimpoperationpassthrough.h"
@@ -152,6 +154,7 @@ gimp_operations_init (Gimp *gimp)
   g_type_class_ref (GIMP_TYPE_OPERATION_DESATURATE);
   g_type_class_ref (GIMP_TYPE_OPERATION_HUE_SATURATION);
   g_type_class_ref (GIMP_TYPE_OPERATION_LEVELS);
+  g_type_class_ref (GIMP_TYPE_OPERATION_POINT_FILTER_CHAIN);
   g_type_class_ref (GIMP_TYPE_OPERATION_POSTERIZE);
   g_type_class_ref (GIMP_TYPE_OPERATION_THRESHOLD);
 
@@ -182,6 +185,7 @@ gimp_operations_init (Gimp *gimp)
   g_type_class_ref (GIMP_TYPE_OPERATION_PASS_THROUGH);
   g_type_class_ref (GIMP_TYPE_OPERATION_REPLACE);
   g_type_class_ref (GIMP_TYPE_OPERATION_ANTI_ERASE);
+  g_type_class_ref (GIMP_TYPE_OPERATION_LAYER_STACK);
 
   gimp_operation_config_register (gimp,
                                   "gimp:brightness-contrast",
@@ -67,6 +67,8 @@ gimp_operation_brightness_contrast_class_init (GimpOperationBrightnessContrastCl
 
   point_class->process         = gimp_operation_brightness_contrast_process;
 
+  GIMP_OPERATION_POINT_FILTER_CLASS (klass)->separable = TRUE;
+
   g_object_class_install_property (object_class,
                                    GIMP_OPERATION_POINT_FILTER_PROP_CONFIG,
                                    g_param_spec_object ("config",
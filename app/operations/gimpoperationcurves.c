@@ -69,6 +69,8 @@ gimp_operation_curves_class_init (GimpOperationCurvesClass *klass)
 
   point_class->process = gimp_operation_curves_process;
 
+  GIMP_OPERATION_POINT_FILTER_CLASS (klass)->separable = TRUE;
+
   g_object_class_install_property (object_class,
                                    GIMP_OPERATION_POINT_FILTER_PROP_TRC,
                                    g_param_spec_enum ("trc",
@@ -55,6 +55,11 @@ struct _GimpOperationPointFilter
 struct _GimpOperationPointFilterClass
 {
   GeglOperationPointFilterClass  parent_class;
+
+  /*  each output channel is a continuous function of the same input
+   *  channel, see gimpoperationpointfilterchain.c
+   */
+  gboolean                       separable;
 };
 
 
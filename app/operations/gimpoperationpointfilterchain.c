@@ -0,0 +1,673 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationpointfilterchain.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpconfig/gimpconfig.h"
+#include "libgimpmath/gimpmath.h"
+
+#include "operations-types.h"
+
+#include "gimpoperationpointfilterchain.h"
+
+#include "gimp-intl.h"
+
+
+/*  the chain runs a sequence of point filters as a single operation,
+ *  so that they take a single pass over memory.  if all of them are
+ *  separable, they are baked into a per-channel LUT over [0..1], which
+ *  is only used if it reproduces the chain within LUT_TOLERANCE;
+ *  otherwise, the filters are run one after the other on blocks small
+ *  enough to stay in cache.
+ */
+#define LUT_SIZE       1024
+#define LUT_TOLERANCE  (0.25 / 255.0)
+#define BLOCK_SIZE     1024
+
+
+/*  the filters, and their LUT, as used by process().  snapshots are
+ *  immutable, and replaced as a whole under the chain's mutex, so that
+ *  render threads keep using theirs while a new one is set up.
+ */
+struct _GimpPointFilterChainSnapshot
+{
+  GList    *operations;
+  gboolean  baked;      /*  whether the snapshot was checked for a LUT   */
+  GList    *configs;    /*  copies of the filters' configs when baked    */
+  gfloat   *lut;        /*  the LUT, if the chain can use one            */
+};
+
+
+static void       gimp_operation_point_filter_chain_dispose  (GObject             *object);
+static void       gimp_operation_point_filter_chain_finalize (GObject             *object);
+
+static void       gimp_operation_point_filter_chain_prepare  (GeglOperation       *operation);
+static gboolean   gimp_operation_point_filter_chain_process  (GeglOperation       *operation,
+                                                              void                *in_buf,
+                                                              void                *out_buf,
+                                                              glong                samples,
+                                                              const GeglRectangle *roi,
+                                                              gint                 level);
+
+static GimpPointFilterChainSnapshot *
+                  gimp_point_filter_chain_snapshot_new       (GList               *operations);
+static void       gimp_point_filter_chain_snapshot_clear     (GimpPointFilterChainSnapshot  *snapshot);
+static gboolean   gimp_point_filter_chain_snapshot_is_stale  (GimpPointFilterChainSnapshot  *snapshot);
+static void       gimp_point_filter_chain_snapshot_bake      (GimpPointFilterChainSnapshot  *snapshot);
+
+static GimpPointFilterChainSnapshot *
+                  gimp_operation_point_filter_chain_get_snapshot
+                                                             (GimpOperationPointFilterChain *chain);
+static void       gimp_operation_point_filter_chain_replace_snapshot
+                                                             (GimpOperationPointFilterChain *chain,
+                                                              GimpPointFilterChainSnapshot  *old_snapshot,
+                                                              GimpPointFilterChainSnapshot  *snapshot);
+
+static void       gimp_operation_point_filter_chain_watch    (GimpOperationPointFilterChain *chain,
+                                                              GList               *operations);
+static void       gimp_operation_point_filter_chain_unwatch  (GimpOperationPointFilterChain *chain);
+static void       gimp_operation_point_filter_chain_operation_notify
+                                                             (GObject             *operation,
+                                                              GParamSpec          *pspec,
+                                                              GimpOperationPointFilterChain *chain);
+static void       gimp_operation_point_filter_chain_config_notify
+                                                             (GObject             *config,
+                                                              GParamSpec          *pspec,
+                                                              GimpOperationPointFilterChain *chain);
+
+static void       gimp_operation_point_filter_chain_run      (GList               *operations,
+                                                              gfloat              *src,
+                                                              gfloat              *dest,
+                                                              glong                samples,
+                                                              const GeglRectangle *roi,
+                                                              gint                 level);
+
+
+G_DEFINE_TYPE (GimpOperationPointFilterChain, gimp_operation_point_filter_chain,
+               GIMP_TYPE_OPERATION_POINT_FILTER)
+
+#define parent_class gimp_operation_point_filter_chain_parent_class
+
+
+static void
+gimp_operation_point_filter_chain_class_init (GimpOperationPointFilterChainClass *klass)
+{
+  GObjectClass                  *object_class    = G_OBJECT_CLASS (klass);
+  GeglOperationClass            *operation_class = GEGL_OPERATION_CLASS (klass);
+  GeglOperationPointFilterClass *point_class     = GEGL_OPERATION_POINT_FILTER_CLASS (klass);
+
+  object_class->dispose      = gimp_operation_point_filter_chain_dispose;
+  object_class->finalize     = gimp_operation_point_filter_chain_finalize;
+
+  operation_class->prepare   = gimp_operation_point_filter_chain_prepare;
+
+  point_class->process       = gimp_operation_point_filter_chain_process;
+
+  gegl_operation_class_set_keys (operation_class,
+                                 "name",        "gimp:point-filter-chain",
+                                 "categories",  "color",
+                                 "description", _("Apply a sequence of point filters at once"),
+                                 NULL);
+}
+
+static void
+gimp_operation_point_filter_chain_init (GimpOperationPointFilterChain *self)
+{
+  g_mutex_init (&self->mutex);
+}
+
+static void
+gimp_operation_point_filter_chain_dispose (GObject *object)
+{
+  GimpOperationPointFilterChain *chain = GIMP_OPERATION_POINT_FILTER_CHAIN (object);
+
+  gimp_operation_point_filter_chain_unwatch (chain);
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gimp_operation_point_filter_chain_finalize (GObject *object)
+{
+  GimpOperationPointFilterChain *chain = GIMP_OPERATION_POINT_FILTER_CHAIN (object);
+
+  if (chain->snapshot)
+    {
+      g_atomic_rc_box_release_full (chain->snapshot,
+                                    (GDestroyNotify) gimp_point_filter_chain_snapshot_clear);
+      chain->snapshot = NULL;
+    }
+
+  g_mutex_clear (&chain->mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_operation_point_filter_chain_prepare (GeglOperation *operation)
+{
+  GimpOperationPointFilterChain *chain = GIMP_OPERATION_POINT_FILTER_CHAIN (operation);
+  GimpOperationPointFilter      *point = GIMP_OPERATION_POINT_FILTER (operation);
+  GimpPointFilterChainSnapshot  *snapshot;
+
+  snapshot = gimp_operation_point_filter_chain_get_snapshot (chain);
+
+  if (snapshot && snapshot->operations)
+    point->trc = GIMP_OPERATION_POINT_FILTER (snapshot->operations->data)->trc;
+
+  GEGL_OPERATION_CLASS (parent_class)->prepare (operation);
+
+  if (! snapshot)
+    return;
+
+  /*  only rebake the LUT if the filters' configs changed since the
+   *  last time
+   */
+  if (gimp_point_filter_chain_snapshot_is_stale (snapshot))
+    {
+      GimpPointFilterChainSnapshot *new_snapshot;
+
+      new_snapshot =
+        gimp_point_filter_chain_snapshot_new (snapshot->operations);
+
+      gimp_point_filter_chain_snapshot_bake (new_snapshot);
+
+      gimp_operation_point_filter_chain_replace_snapshot (chain,
+                                                          snapshot,
+                                                          new_snapshot);
+    }
+
+  g_atomic_rc_box_release_full (snapshot,
+                                (GDestroyNotify) gimp_point_filter_chain_snapshot_clear);
+}
+
+static gboolean
+gimp_operation_point_filter_chain_process (GeglOperation       *operation,
+                                           void                *in_buf,
+                                           void                *out_buf,
+                                           glong                samples,
+                                           const GeglRectangle *roi,
+                                           gint                 level)
+{
+  GimpOperationPointFilterChain *chain = GIMP_OPERATION_POINT_FILTER_CHAIN (operation);
+  GimpPointFilterChainSnapshot  *snapshot;
+  gfloat                        *src   = in_buf;
+  gfloat                        *dest  = out_buf;
+
+  snapshot = gimp_operation_point_filter_chain_get_snapshot (chain);
+
+  if (! snapshot)
+    {
+      if (src != dest)
+        memcpy (dest, src, 4 * samples * sizeof (gfloat));
+
+      return TRUE;
+    }
+
+  if (snapshot->lut)
+    {
+      const gfloat *lut = snapshot->lut;
+
+      while (samples--)
+        {
+          if (src[RED]   >= 0.0f && src[RED]   <= 1.0f &&
+              src[GREEN] >= 0.0f && src[GREEN] <= 1.0f &&
+              src[BLUE]  >= 0.0f && src[BLUE]  <= 1.0f &&
+              src[ALPHA] >= 0.0f && src[ALPHA] <= 1.0f)
+            {
+              gint c;
+
+              for (c = 0; c < 4; c++)
+                {
+                  gfloat        x = src[c] * LUT_SIZE;
+                  gint          i = MIN ((gint) x, LUT_SIZE - 1);
+                  const gfloat *l = lut + 4 * i + c;
+
+                  dest[c] = l[0] + (x - i) * (l[4] - l[0]);
+                }
+            }
+          else
+            {
+              /*  out-of-range pixels are not covered by the LUT  */
+              gimp_operation_point_filter_chain_run (snapshot->operations,
+                                                     src, dest, 1,
+                                                     roi, level);
+            }
+
+          src  += 4;
+          dest += 4;
+        }
+    }
+  else
+    {
+      while (samples > 0)
+        {
+          glong n = MIN (samples, BLOCK_SIZE);
+
+          gimp_operation_point_filter_chain_run (snapshot->operations,
+                                                 src, dest, n,
+                                                 roi, level);
+
+          src     += 4 * n;
+          dest    += 4 * n;
+          samples -= n;
+        }
+    }
+
+  g_atomic_rc_box_release_full (snapshot,
+                                (GDestroyNotify) gimp_point_filter_chain_snapshot_clear);
+
+  return TRUE;
+}
+
+
+/*  public functions  */
+
+/*  returns whether @operation can be run as part of a chain, following
+ *  @previous, if not NULL
+ */
+gboolean
+gimp_operation_point_filter_chain_can_fuse (GeglOperation *operation,
+                                            GeglOperation *previous)
+{
+  GeglOperationClass *point_filter_class;
+
+  g_return_val_if_fail (GEGL_IS_OPERATION (operation), FALSE);
+  g_return_val_if_fail (previous == NULL || GEGL_IS_OPERATION (previous),
+                        FALSE);
+
+  if (! GIMP_IS_OPERATION_POINT_FILTER (operation) ||
+      GIMP_IS_OPERATION_POINT_FILTER_CHAIN (operation))
+    {
+      return FALSE;
+    }
+
+  /*  the chain only knows how to set up the formats of filters which
+   *  don't override them
+   */
+  point_filter_class = g_type_class_peek (GIMP_TYPE_OPERATION_POINT_FILTER);
+
+  if (GEGL_OPERATION_GET_CLASS (operation)->prepare !=
+      point_filter_class->prepare)
+    {
+      return FALSE;
+    }
+
+  if (previous &&
+      GIMP_OPERATION_POINT_FILTER (operation)->trc !=
+      GIMP_OPERATION_POINT_FILTER (previous)->trc)
+    {
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*  sets the filters run by @chain.  the LUT, if any, is baked in the
+ *  next prepare(), and only if the filters actually changed.  the
+ *  filters' nodes are not part of the graph while they are chained, so
+ *  the chain invalidates itself when they, or their configs, change.
+ */
+void
+gimp_operation_point_filter_chain_set_operations (GimpOperationPointFilterChain *chain,
+                                                  GList                         *operations)
+{
+  GimpPointFilterChainSnapshot *snapshot;
+
+  g_return_if_fail (GIMP_IS_OPERATION_POINT_FILTER_CHAIN (chain));
+
+  snapshot = gimp_operation_point_filter_chain_get_snapshot (chain);
+
+  if (snapshot)
+    {
+      GList *list1;
+      GList *list2;
+
+      for (list1 = snapshot->operations, list2 = operations;
+           list1 && list2 && list1->data == list2->data;
+           list1 = g_list_next (list1), list2 = g_list_next (list2));
+
+      g_atomic_rc_box_release_full (snapshot,
+                                    (GDestroyNotify) gimp_point_filter_chain_snapshot_clear);
+
+      if (! list1 && ! list2)
+        return;
+    }
+
+  gimp_operation_point_filter_chain_replace_snapshot (
+    chain, NULL, gimp_point_filter_chain_snapshot_new (operations));
+
+  gimp_operation_point_filter_chain_watch (chain, operations);
+
+  gegl_operation_invalidate (GEGL_OPERATION (chain), NULL, TRUE);
+}
+
+
+/*  private functions  */
+
+static GimpPointFilterChainSnapshot *
+gimp_point_filter_chain_snapshot_new (GList *operations)
+{
+  GimpPointFilterChainSnapshot *snapshot;
+
+  snapshot = g_atomic_rc_box_new0 (GimpPointFilterChainSnapshot);
+
+  snapshot->operations = g_list_copy_deep (operations,
+                                           (GCopyFunc) g_object_ref, NULL);
+
+  return snapshot;
+}
+
+static void
+gimp_point_filter_chain_snapshot_clear (GimpPointFilterChainSnapshot *snapshot)
+{
+  GList *list;
+
+  for (list = snapshot->configs; list; list = g_list_next (list))
+    {
+      if (list->data)
+        g_object_unref (list->data);
+    }
+
+  g_list_free (snapshot->configs);
+  g_list_free_full (snapshot->operations, g_object_unref);
+  g_free (snapshot->lut);
+}
+
+/*  returns whether the filters' configs differ from the ones the
+ *  snapshot was baked with
+ */
+static gboolean
+gimp_point_filter_chain_snapshot_is_stale (GimpPointFilterChainSnapshot *snapshot)
+{
+  GList *list;
+  GList *configs;
+
+  if (! snapshot->baked)
+    return TRUE;
+
+  for (list = snapshot->operations, configs = snapshot->configs;
+       list && configs;
+       list = g_list_next (list), configs = g_list_next (configs))
+    {
+      GObject *config = GIMP_OPERATION_POINT_FILTER (list->data)->config;
+      GObject *copy   = configs->data;
+
+      if (! config && ! copy)
+        continue;
+
+      /*  configs which we can't compare are always considered changed  */
+      if (! GIMP_IS_CONFIG (config) || ! copy                    ||
+          G_OBJECT_TYPE (config) != G_OBJECT_TYPE (copy)          ||
+          ! gimp_config_is_equal_to (GIMP_CONFIG (config), GIMP_CONFIG (copy)))
+        {
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+static void
+gimp_point_filter_chain_snapshot_bake (GimpPointFilterChainSnapshot *snapshot)
+{
+  gfloat *ramp;
+  gfloat *lut = NULL;
+  GList  *list;
+  gint    n_samples;
+  gint    i;
+  gint    c;
+
+  /*  copy the configs first, so that changes made while baking are
+   *  noticed by the next prepare()
+   */
+  for (list = snapshot->operations; list; list = g_list_next (list))
+    {
+      GObject *config = GIMP_OPERATION_POINT_FILTER (list->data)->config;
+
+      if (GIMP_IS_CONFIG (config))
+        config = G_OBJECT (gimp_config_duplicate (GIMP_CONFIG (config)));
+      else if (config)
+        config = NULL;
+
+      snapshot->configs = g_list_prepend (snapshot->configs, config);
+    }
+
+  snapshot->configs = g_list_reverse (snapshot->configs);
+  snapshot->baked   = TRUE;
+
+  for (list = snapshot->operations; list; list = g_list_next (list))
+    {
+      if (! GIMP_OPERATION_POINT_FILTER_GET_CLASS (list->data)->separable)
+        return;
+    }
+
+  if (! snapshot->operations)
+    return;
+
+  /*  sample the chain at the LUT's entries, and halfway between them,
+   *  to check the interpolation error
+   */
+  n_samples = 2 * LUT_SIZE + 1;
+
+  ramp = g_new (gfloat, 4 * n_samples);
+
+  for (i = 0; i < n_samples; i++)
+    {
+      for (c = 0; c < 4; c++)
+        ramp[4 * i + c] = (gfloat) i / (n_samples - 1);
+    }
+
+  gimp_operation_point_filter_chain_run (snapshot->operations,
+                                         ramp, ramp, n_samples,
+                                         GEGL_RECTANGLE (0, 0, n_samples, 1),
+                                         0);
+
+  lut = g_new (gfloat, 4 * (LUT_SIZE + 1));
+
+  for (i = 0; i <= LUT_SIZE; i++)
+    {
+      for (c = 0; c < 4; c++)
+        lut[4 * i + c] = ramp[4 * (2 * i) + c];
+    }
+
+  for (i = 0; lut && i < LUT_SIZE; i++)
+    {
+      for (c = 0; c < 4; c++)
+        {
+          gfloat value = (lut[4 * i + c] + lut[4 * (i + 1) + c]) / 2.0f;
+
+          if (! (fabsf (value - ramp[4 * (2 * i + 1) + c]) <= LUT_TOLERANCE))
+            {
+              g_clear_pointer (&lut, g_free);
+
+              break;
+            }
+        }
+    }
+
+  g_free (ramp);
+
+  snapshot->lut = lut;
+}
+
+static GimpPointFilterChainSnapshot *
+gimp_operation_point_filter_chain_get_snapshot (GimpOperationPointFilterChain *chain)
+{
+  GimpPointFilterChainSnapshot *snapshot = NULL;
+
+  g_mutex_lock (&chain->mutex);
+
+  if (chain->snapshot)
+    snapshot = g_atomic_rc_box_acquire (chain->snapshot);
+
+  g_mutex_unlock (&chain->mutex);
+
+  return snapshot;
+}
+
+/*  replaces @chain's snapshot by @snapshot, taking ownership of it.  if
+ *  @old_snapshot is not NULL, only replaces it if it's still current,
+ *  and drops @snapshot otherwise.
+ */
+static void
+gimp_operation_point_filter_chain_replace_snapshot (GimpOperationPointFilterChain *chain,
+                                                    GimpPointFilterChainSnapshot  *old_snapshot,
+                                                    GimpPointFilterChainSnapshot  *snapshot)
+{
+  g_mutex_lock (&chain->mutex);
+
+  if (! old_snapshot || chain->snapshot == old_snapshot)
+    {
+      GimpPointFilterChainSnapshot *tmp = chain->snapshot;
+
+      chain->snapshot = snapshot;
+      snapshot        = tmp;
+    }
+
+  g_mutex_unlock (&chain->mutex);
+
+  if (snapshot)
+    {
+      g_atomic_rc_box_release_full (snapshot,
+                                    (GDestroyNotify) gimp_point_filter_chain_snapshot_clear);
+    }
+}
+
+static void
+gimp_operation_point_filter_chain_watch (GimpOperationPointFilterChain *chain,
+                                         GList                         *operations)
+{
+  GList *list;
+
+  gimp_operation_point_filter_chain_unwatch (chain);
+
+  for (list = operations; list; list = g_list_next (list))
+    {
+      GObject *operation = list->data;
+      GObject *config    = GIMP_OPERATION_POINT_FILTER (operation)->config;
+
+      chain->watched_operations = g_list_prepend (chain->watched_operations,
+                                                  g_object_ref (operation));
+
+      g_signal_connect (operation, "notify",
+                        G_CALLBACK (gimp_operation_point_filter_chain_operation_notify),
+                        chain);
+
+      if (config)
+        {
+          chain->watched_configs = g_list_prepend (chain->watched_configs,
+                                                   g_object_ref (config));
+
+          g_signal_connect (config, "notify",
+                            G_CALLBACK (gimp_operation_point_filter_chain_config_notify),
+                            chain);
+        }
+    }
+
+  chain->watched_operations = g_list_reverse (chain->watched_operations);
+}
+
+static void
+gimp_operation_point_filter_chain_unwatch (GimpOperationPointFilterChain *chain)
+{
+  GList *list;
+
+  for (list = chain->watched_operations; list; list = g_list_next (list))
+    {
+      g_signal_handlers_disconnect_by_func (list->data,
+                                            gimp_operation_point_filter_chain_operation_notify,
+                                            chain);
+    }
+
+  for (list = chain->watched_configs; list; list = g_list_next (list))
+    {
+      g_signal_handlers_disconnect_by_func (list->data,
+                                            gimp_operation_point_filter_chain_config_notify,
+                                            chain);
+    }
+
+  g_list_free_full (chain->watched_operations, g_object_unref);
+  g_list_free_full (chain->watched_configs,    g_object_unref);
+
+  chain->watched_operations = NULL;
+  chain->watched_configs    = NULL;
+}
+
+static void
+gimp_operation_point_filter_chain_operation_notify (GObject                       *operation,
+                                                    GParamSpec                    *pspec,
+                                                    GimpOperationPointFilterChain *chain)
+{
+  /*  a filter got a new config, watch it instead of the old one  */
+  if (! strcmp (pspec->name, "config"))
+    {
+      GList *operations = g_list_copy_deep (chain->watched_operations,
+                                            (GCopyFunc) g_object_ref, NULL);
+
+      gimp_operation_point_filter_chain_watch (chain, operations);
+
+      g_list_free_full (operations, g_object_unref);
+    }
+
+  gegl_operation_invalidate (GEGL_OPERATION (chain), NULL, TRUE);
+}
+
+static void
+gimp_operation_point_filter_chain_config_notify (GObject                       *config,
+                                                 GParamSpec                    *pspec,
+                                                 GimpOperationPointFilterChain *chain)
+{
+  gegl_operation_invalidate (GEGL_OPERATION (chain), NULL, TRUE);
+}
+
+static void
+gimp_operation_point_filter_chain_run (GList               *operations,
+                                       gfloat              *src,
+                                       gfloat              *dest,
+                                       glong                samples,
+                                       const GeglRectangle *roi,
+                                       gint                 level)
+{
+  GList *list;
+
+  for (list = operations; list; list = g_list_next (list))
+    {
+      GeglOperation                 *operation = list->data;
+      GeglOperationPointFilterClass *point_class;
+
+      point_class = GEGL_OPERATION_POINT_FILTER_GET_CLASS (operation);
+
+      /*  filters without a config pass their input through  */
+      if (! point_class->process (operation, src, dest, samples, roi, level) &&
+          src != dest)
+        {
+          memcpy (dest, src, 4 * samples * sizeof (gfloat));
+        }
+
+      src = dest;
+    }
+
+  if (src != dest)
+    memcpy (dest, src, 4 * samples * sizeof (gfloat));
+}
@@ -0,0 +1,66 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationpointfilterchain.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_OPERATION_POINT_FILTER_CHAIN_H__
+#define __GIMP_OPERATION_POINT_FILTER_CHAIN_H__
+
+
+#include "gimpoperationpointfilter.h"
+
+
+#define GIMP_TYPE_OPERATION_POINT_FILTER_CHAIN            (gimp_operation_point_filter_chain_get_type ())
+#define GIMP_OPERATION_POINT_FILTER_CHAIN(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_OPERATION_POINT_FILTER_CHAIN, GimpOperationPointFilterChain))
+#define GIMP_OPERATION_POINT_FILTER_CHAIN_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_OPERATION_POINT_FILTER_CHAIN, GimpOperationPointFilterChainClass))
+#define GIMP_IS_OPERATION_POINT_FILTER_CHAIN(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_OPERATION_POINT_FILTER_CHAIN))
+#define GIMP_IS_OPERATION_POINT_FILTER_CHAIN_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_OPERATION_POINT_FILTER_CHAIN))
+#define GIMP_OPERATION_POINT_FILTER_CHAIN_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_OPERATION_POINT_FILTER_CHAIN, GimpOperationPointFilterChainClass))
+
+
+typedef struct _GimpOperationPointFilterChain      GimpOperationPointFilterChain;
+typedef struct _GimpOperationPointFilterChainClass GimpOperationPointFilterChainClass;
+typedef struct _GimpPointFilterChainSnapshot       GimpPointFilterChainSnapshot;
+
+struct _GimpOperationPointFilterChain
+{
+  GimpOperationPointFilter      parent_instance;
+
+  GMutex                        mutex;
+  GimpPointFilterChainSnapshot *snapshot;
+
+  /*  the filters, and their configs, whose changes invalidate the chain  */
+  GList                        *watched_operations;
+  GList                        *watched_configs;
+};
+
+struct _GimpOperationPointFilterChainClass
+{
+  GimpOperationPointFilterClass  parent_class;
+};
+
+
+GType      gimp_operation_point_filter_chain_get_type       (void) G_GNUC_CONST;
+
+gboolean   gimp_operation_point_filter_chain_can_fuse       (GeglOperation                 *operation,
+                                                             GeglOperation                 *previous);
+
+void       gimp_operation_point_filter_chain_set_operations (GimpOperationPointFilterChain *chain,
+                                                             GList                         *operations);
+
+
+#endif /* __GIMP_OPERATION_POINT_FILTER_CHAIN_H__ */
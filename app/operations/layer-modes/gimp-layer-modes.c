@@ -21,9 +21,11 @@
 
 #include "config.h"
 
-#include <glib-object.h>
+#include <gio/gio.h>
 #include <gegl.h>
 
+#include "libgimpbase/gimpbase.h"
+
 #include "../operations-types.h"
 
 #include "gegl/gimp-babl.h"
@@ -1112,6 +1114,36 @@ static const GimpLayerMode layer_mode_groups[][2] =
 
 static GeglOperation *ops[G_N_ELEMENTS (layer_mode_infos)] = { 0 };
 
+/*  the blend functions of layer_mode_infos, replaced by their vectorized
+ *  versions where the CPU supports them
+ */
+static GimpLayerModeBlendFunc blend_functions[G_N_ELEMENTS (layer_mode_infos)];
+
+#if COMPILE_AVX2_INTRINISICS
+static const struct
+{
+  GimpLayerModeBlendFunc generic;
+  GimpLayerModeBlendFunc avx2;
+}
+blend_functions_avx2[] =
+{
+  { gimp_operation_layer_mode_blend_addition,
+    gimp_operation_layer_mode_blend_addition_avx2     },
+  { gimp_operation_layer_mode_blend_darken_only,
+    gimp_operation_layer_mode_blend_darken_only_avx2  },
+  { gimp_operation_layer_mode_blend_difference,
+    gimp_operation_layer_mode_blend_difference_avx2   },
+  { gimp_operation_layer_mode_blend_lighten_only,
+    gimp_operation_layer_mode_blend_lighten_only_avx2 },
+  { gimp_operation_layer_mode_blend_multiply,
+    gimp_operation_layer_mode_blend_multiply_avx2     },
+  { gimp_operation_layer_mode_blend_screen,
+    gimp_operation_layer_mode_blend_screen_avx2       },
+  { gimp_operation_layer_mode_blend_subtract,
+    gimp_operation_layer_mode_blend_subtract_avx2     }
+};
+#endif /* COMPILE_AVX2_INTRINISICS */
+
 /*  public functions  */
 
 void
@@ -1122,7 +1154,32 @@ gimp_layer_modes_init (void)
   for (i = 0; i < G_N_ELEMENTS (layer_mode_infos); i++)
     {
       gimp_assert ((GimpLayerMode) i == layer_mode_infos[i].layer_mode);
+
+      blend_functions[i] = layer_mode_infos[i].blend_function;
     }
+
+#if COMPILE_AVX2_INTRINISICS
+  if ((gimp_cpu_accel_get_support () & (GIMP_CPU_ACCEL_X86_AVX2 |
+                                        GIMP_CPU_ACCEL_X86_FMA)) ==
+      (GIMP_CPU_ACCEL_X86_AVX2 | GIMP_CPU_ACCEL_X86_FMA))
+    {
+      for (i = 0; i < G_N_ELEMENTS (layer_mode_infos); i++)
+        {
+          gint j;
+
+          for (j = 0; j < G_N_ELEMENTS (blend_functions_avx2); j++)
+            {
+              if (blend_functions[i] == blend_functions_avx2[j].generic)
+                {
+                  blend_functions[i] = blend_functions_avx2[j].avx2;
+                  break;
+                }
+            }
+        }
+    }
+#endif /* COMPILE_AVX2_INTRINISICS */
+
+  gimp_operation_layer_mode_init_composite_functions ();
 }
 
 void
@@ -1350,7 +1407,7 @@ gimp_layer_mode_get_blend_function (GimpLayerMode mode)
   if (! info)
     return NULL;
 
-  return info->blend_function;
+  return blend_functions[info - layer_mode_infos];
 }
 
 GimpLayerModeContext
@@ -0,0 +1,203 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayermode-blend-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gimpoperationlayermode-blend.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 and FMA */
+#include <immintrin.h>
+
+
+typedef enum
+{
+  BLEND_ADDITION,
+  BLEND_DARKEN_ONLY,
+  BLEND_DIFFERENCE,
+  BLEND_LIGHTEN_ONLY,
+  BLEND_MULTIPLY,
+  BLEND_SCREEN,
+  BLEND_SUBTRACT
+} BlendOp;
+
+
+/*  the blend functions below only handle the simple separable modes, whose
+ *  result doesn't depend on any per-pixel branching.  since comp[RED..BLUE]
+ *  is unconstrained where in[ALPHA] or layer[ALPHA] are zero, they blend
+ *  all pixels unconditionally, two pixels per iteration, and an odd
+ *  trailing pixel in the lower half of the vectors.
+ */
+
+static inline __m256
+blend_pixels (BlendOp op,
+              __m256  in,
+              __m256  layer)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+
+  switch (op)
+    {
+    case BLEND_ADDITION:
+      return _mm256_add_ps (in, layer);
+
+    case BLEND_DARKEN_ONLY:
+      return _mm256_min_ps (in, layer);
+
+    case BLEND_DIFFERENCE:
+      return _mm256_andnot_ps (_mm256_set1_ps (-0.0f),
+                               _mm256_sub_ps (in, layer));
+
+    case BLEND_LIGHTEN_ONLY:
+      return _mm256_max_ps (in, layer);
+
+    case BLEND_MULTIPLY:
+      return _mm256_mul_ps (in, layer);
+
+    case BLEND_SCREEN:
+      /* 1 - (1 - in) * (1 - layer) */
+      return _mm256_fnmadd_ps (_mm256_sub_ps (v_one, in),
+                               _mm256_sub_ps (v_one, layer),
+                               v_one);
+
+    case BLEND_SUBTRACT:
+      return _mm256_sub_ps (in, layer);
+    }
+
+  return in;
+}
+
+static inline void
+blend_avx2 (BlendOp        op,
+            const gfloat  *in,
+            const gfloat  *layer,
+            gfloat        *comp,
+            gint           samples)
+{
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 rgba_in    = _mm256_loadu_ps (in);
+      __m256 rgba_layer = _mm256_loadu_ps (layer);
+      __m256 rgba_comp;
+
+      rgba_comp = blend_pixels (op, rgba_in, rgba_layer);
+
+      /* comp[ALPHA] = layer[ALPHA] */
+      _mm256_storeu_ps (comp, _mm256_blend_ps (rgba_comp, rgba_layer, 0x88));
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+    }
+
+  if (samples)
+    {
+      __m128 rgba_in    = _mm_loadu_ps (in);
+      __m128 rgba_layer = _mm_loadu_ps (layer);
+      __m256 rgba_comp;
+
+      rgba_comp = blend_pixels (op,
+                                _mm256_castps128_ps256 (rgba_in),
+                                _mm256_castps128_ps256 (rgba_layer));
+
+      _mm_storeu_ps (comp, _mm_blend_ps (_mm256_castps256_ps128 (rgba_comp),
+                                         rgba_layer, 0x08));
+    }
+}
+
+
+void
+gimp_operation_layer_mode_blend_addition_avx2 (GeglOperation *operation,
+                                               const gfloat  *in,
+                                               const gfloat  *layer,
+                                               gfloat        *comp,
+                                               gint           samples)
+{
+  blend_avx2 (BLEND_ADDITION, in, layer, comp, samples);
+}
+
+void
+gimp_operation_layer_mode_blend_darken_only_avx2 (GeglOperation *operation,
+                                                  const gfloat  *in,
+                                                  const gfloat  *layer,
+                                                  gfloat        *comp,
+                                                  gint           samples)
+{
+  blend_avx2 (BLEND_DARKEN_ONLY, in, layer, comp, samples);
+}
+
+void
+gimp_operation_layer_mode_blend_difference_avx2 (GeglOperation *operation,
+                                                 const gfloat  *in,
+                                                 const gfloat  *layer,
+                                                 gfloat        *comp,
+                                                 gint           samples)
+{
+  blend_avx2 (BLEND_DIFFERENCE, in, layer, comp, samples);
+}
+
+void
+gimp_operation_layer_mode_blend_lighten_only_avx2 (GeglOperation *operation,
+                                                   const gfloat  *in,
+                                                   const gfloat  *layer,
+                                                   gfloat        *comp,
+                                                   gint           samples)
+{
+  blend_avx2 (BLEND_LIGHTEN_ONLY, in, layer, comp, samples);
+}
+
+void
+gimp_operation_layer_mode_blend_multiply_avx2 (GeglOperation *operation,
+                                               const gfloat  *in,
+                                               const gfloat  *layer,
+                                               gfloat        *comp,
+                                               gint           samples)
+{
+  blend_avx2 (BLEND_MULTIPLY, in, layer, comp, samples);
+}
+
+void
+gimp_operation_layer_mode_blend_screen_avx2 (GeglOperation *operation,
+                                             const gfloat  *in,
+                                             const gfloat  *layer,
+                                             gfloat        *comp,
+                                             gint           samples)
+{
+  blend_avx2 (BLEND_SCREEN, in, layer, comp, samples);
+}
+
+void
+gimp_operation_layer_mode_blend_subtract_avx2 (GeglOperation *operation,
+                                               const gfloat  *in,
+                                               const gfloat  *layer,
+                                               gfloat        *comp,
+                                               gint           samples)
+{
+  blend_avx2 (BLEND_SUBTRACT, in, layer, comp, samples);
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
@@ -187,6 +187,46 @@ void gimp_operation_layer_mode_blend_vivid_light       (GeglOperation *operation
                                                         gfloat        *comp,
                                                         gint           samples);
 
+#if COMPILE_AVX2_INTRINISICS
+
+void gimp_operation_layer_mode_blend_addition_avx2     (GeglOperation *operation,
+                                                        const gfloat  *in,
+                                                        const gfloat  *layer,
+                                                        gfloat        *comp,
+                                                        gint           samples);
+void gimp_operation_layer_mode_blend_darken_only_avx2  (GeglOperation *operation,
+                                                        const gfloat  *in,
+                                                        const gfloat  *layer,
+                                                        gfloat        *comp,
+                                                        gint           samples);
+void gimp_operation_layer_mode_blend_difference_avx2   (GeglOperation *operation,
+                                                        const gfloat  *in,
+                                                        const gfloat  *layer,
+                                                        gfloat        *comp,
+                                                        gint           samples);
+void gimp_operation_layer_mode_blend_lighten_only_avx2 (GeglOperation *operation,
+                                                        const gfloat  *in,
+                                                        const gfloat  *layer,
+                                                        gfloat        *comp,
+                                                        gint           samples);
+void gimp_operation_layer_mode_blend_multiply_avx2     (GeglOperation *operation,
+                                                        const gfloat  *in,
+                                                        const gfloat  *layer,
+                                                        gfloat        *comp,
+                                                        gint           samples);
+void gimp_operation_layer_mode_blend_screen_avx2       (GeglOperation *operation,
+                                                        const gfloat  *in,
+                                                        const gfloat  *layer,
+                                                        gfloat        *comp,
+                                                        gint           samples);
+void gimp_operation_layer_mode_blend_subtract_avx2     (GeglOperation *operation,
+                                                        const gfloat  *in,
+                                                        const gfloat  *layer,
+                                                        gfloat        *comp,
+                                                        gint           samples);
+
+#endif /* COMPILE_AVX2_INTRINISICS */
+
 
 /*  subtractive blend functions  */
 
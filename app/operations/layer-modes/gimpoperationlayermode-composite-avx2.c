@@ -0,0 +1,283 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayermode-composite-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gimpoperationlayermode-composite.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 and FMA */
+#include <immintrin.h>
+
+
+/*  these functions process two pixels per iteration, and leave an odd
+ *  trailing pixel to the generic functions.
+ */
+
+
+/* broadcast the alpha component of each of the two pixels in v */
+static inline __m256
+expand_alpha (__m256 v)
+{
+  return _mm256_permute_ps (v, _MM_SHUFFLE (3, 3, 3, 3));
+}
+
+/* multiply the alpha vector of two pixels by their mask values */
+static inline __m256
+apply_mask (__m256        alpha,
+            const gfloat *mask)
+{
+  if (mask)
+    {
+      alpha = _mm256_mul_ps (alpha, _mm256_setr_ps (mask[0], mask[0],
+                                                    mask[0], mask[0],
+                                                    mask[1], mask[1],
+                                                    mask[1], mask[1]));
+    }
+
+  return alpha;
+}
+
+static inline __m256
+is_zero (__m256 v)
+{
+  return _mm256_cmp_ps (v, _mm256_setzero_ps (), _CMP_EQ_OQ);
+}
+
+
+/*  non-subtractive compositing functions.  these functions expect comp[ALPHA]
+ *  to be the same as layer[ALPHA].  when in[ALPHA] or layer[ALPHA] are zero,
+ *  the value of comp[RED..BLUE] is unconstrained (in particular, it may be
+ *  NaN).
+ */
+
+
+void
+gimp_operation_layer_mode_composite_union_avx2 (const gfloat *in,
+                                                const gfloat *layer,
+                                                const gfloat *comp,
+                                                const gfloat *mask,
+                                                gfloat        opacity,
+                                                gfloat       *out,
+                                                gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 rgba_in    = _mm256_loadu_ps (in);
+      __m256 rgba_layer = _mm256_loadu_ps (layer);
+      __m256 rgba_comp  = _mm256_loadu_ps (comp);
+      __m256 in_alpha, layer_alpha, new_alpha, ratio, out_pixel;
+
+      in_alpha    = expand_alpha (rgba_in);
+      layer_alpha = _mm256_mul_ps (expand_alpha (rgba_layer), v_opacity);
+      layer_alpha = apply_mask (layer_alpha, mask);
+
+      /* new_alpha = layer_alpha + (1 - layer_alpha) * in_alpha */
+      new_alpha = _mm256_fmadd_ps (_mm256_sub_ps (v_one, layer_alpha),
+                                   in_alpha, layer_alpha);
+
+      /* out = ratio * (in_alpha * (comp - layer) + layer - in) + in */
+      ratio     = _mm256_div_ps (layer_alpha, new_alpha);
+      out_pixel = _mm256_fmadd_ps (in_alpha,
+                                   _mm256_sub_ps (rgba_comp, rgba_layer),
+                                   _mm256_sub_ps (rgba_layer, rgba_in));
+      out_pixel = _mm256_fmadd_ps (ratio, out_pixel, rgba_in);
+
+      /* take the layer's color where the backdrop is transparent, and the
+       * backdrop's color where nothing is composited
+       */
+      out_pixel = _mm256_blendv_ps (out_pixel, rgba_layer, is_zero (in_alpha));
+      out_pixel = _mm256_blendv_ps (out_pixel, rgba_in,
+                                    _mm256_or_ps (is_zero (layer_alpha),
+                                                  is_zero (new_alpha)));
+
+      _mm256_storeu_ps (out, _mm256_blend_ps (out_pixel, new_alpha, 0x88));
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+
+      if (mask)
+        mask += 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_union (in, layer, comp, mask,
+                                                 opacity, out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_backdrop_avx2 (const gfloat *in,
+                                                           const gfloat *layer,
+                                                           const gfloat *comp,
+                                                           const gfloat *mask,
+                                                           gfloat        opacity,
+                                                           gfloat       *out,
+                                                           gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 rgba_in   = _mm256_loadu_ps (in);
+      __m256 rgba_comp = _mm256_loadu_ps (comp);
+      __m256 layer_alpha, out_pixel;
+
+      layer_alpha = _mm256_mul_ps (expand_alpha (rgba_comp), v_opacity);
+      layer_alpha = apply_mask (layer_alpha, mask);
+
+      /* out = comp * layer_alpha + in * (1 - layer_alpha) */
+      out_pixel = _mm256_fmadd_ps (rgba_comp, layer_alpha,
+                                   _mm256_mul_ps (rgba_in,
+                                                  _mm256_sub_ps (v_one,
+                                                                 layer_alpha)));
+
+      out_pixel = _mm256_blendv_ps (out_pixel, rgba_in,
+                                    _mm256_or_ps (is_zero (expand_alpha (rgba_in)),
+                                                  is_zero (layer_alpha)));
+
+      _mm256_storeu_ps (out, _mm256_blend_ps (out_pixel, rgba_in, 0x88));
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+
+      if (mask)
+        mask += 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_backdrop (in, layer, comp,
+                                                            mask, opacity, out,
+                                                            samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_layer_avx2 (const gfloat *in,
+                                                        const gfloat *layer,
+                                                        const gfloat *comp,
+                                                        const gfloat *mask,
+                                                        gfloat        opacity,
+                                                        gfloat       *out,
+                                                        gint          samples)
+{
+  const __m256 v_one     = _mm256_set1_ps (1.0f);
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 rgba_in    = _mm256_loadu_ps (in);
+      __m256 rgba_layer = _mm256_loadu_ps (layer);
+      __m256 rgba_comp  = _mm256_loadu_ps (comp);
+      __m256 in_alpha, layer_alpha, out_pixel;
+
+      in_alpha    = expand_alpha (rgba_in);
+      layer_alpha = _mm256_mul_ps (expand_alpha (rgba_layer), v_opacity);
+      layer_alpha = apply_mask (layer_alpha, mask);
+
+      /* out = comp * in_alpha + layer * (1 - in_alpha) */
+      out_pixel = _mm256_fmadd_ps (rgba_comp, in_alpha,
+                                   _mm256_mul_ps (rgba_layer,
+                                                  _mm256_sub_ps (v_one,
+                                                                 in_alpha)));
+
+      out_pixel = _mm256_blendv_ps (out_pixel, rgba_layer, is_zero (in_alpha));
+      out_pixel = _mm256_blendv_ps (out_pixel, rgba_in, is_zero (layer_alpha));
+
+      _mm256_storeu_ps (out, _mm256_blend_ps (out_pixel, layer_alpha, 0x88));
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+
+      if (mask)
+        mask += 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_layer (in, layer, comp,
+                                                         mask, opacity, out,
+                                                         samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_intersection_avx2 (const gfloat *in,
+                                                       const gfloat *layer,
+                                                       const gfloat *comp,
+                                                       const gfloat *mask,
+                                                       gfloat        opacity,
+                                                       gfloat       *out,
+                                                       gint          samples)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 rgba_in   = _mm256_loadu_ps (in);
+      __m256 rgba_comp = _mm256_loadu_ps (comp);
+      __m256 new_alpha, out_pixel;
+
+      new_alpha = _mm256_mul_ps (_mm256_mul_ps (expand_alpha (rgba_in),
+                                                expand_alpha (rgba_comp)),
+                                 v_opacity);
+      new_alpha = apply_mask (new_alpha, mask);
+
+      out_pixel = _mm256_blendv_ps (rgba_comp, rgba_in, is_zero (new_alpha));
+
+      _mm256_storeu_ps (out, _mm256_blend_ps (out_pixel, new_alpha, 0x88));
+
+      in    += 8;
+      layer += 8;
+      comp  += 8;
+      out   += 8;
+
+      if (mask)
+        mask += 2;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_intersection (in, layer, comp,
+                                                        mask, opacity, out,
+                                                        samples);
+    }
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
@@ -0,0 +1,198 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayermode-composite-avx512.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "../operations-types.h"
+
+#include "gimpoperationlayermode-composite.h"
+
+
+#if COMPILE_AVX512F_INTRINISICS
+
+/* AVX-512F */
+#include <immintrin.h>
+
+
+/*  these functions process four pixels per iteration, and leave the
+ *  trailing pixels to the AVX2 functions.  only the composite modes used
+ *  by the default layer modes have AVX-512 versions.
+ */
+
+
+#define ALPHA_MASK 0x8888
+
+
+/* broadcast the alpha component of each of the four pixels in v */
+static inline __m512
+expand_alpha (__m512 v)
+{
+  return _mm512_permute_ps (v, _MM_SHUFFLE (3, 3, 3, 3));
+}
+
+/* multiply the alpha vector of four pixels by their mask values */
+static inline __m512
+apply_mask (__m512        alpha,
+            const gfloat *mask)
+{
+  if (mask)
+    {
+      const __m512i index = _mm512_setr_epi32 (0, 0, 0, 0, 1, 1, 1, 1,
+                                               2, 2, 2, 2, 3, 3, 3, 3);
+      __m512        v_mask;
+
+      v_mask = _mm512_permutexvar_ps (index,
+                                      _mm512_castps128_ps512 (_mm_loadu_ps (mask)));
+
+      alpha = _mm512_mul_ps (alpha, v_mask);
+    }
+
+  return alpha;
+}
+
+static inline __mmask16
+is_zero (__m512 v)
+{
+  return _mm512_cmp_ps_mask (v, _mm512_setzero_ps (), _CMP_EQ_OQ);
+}
+
+
+/*  non-subtractive compositing functions.  these functions expect comp[ALPHA]
+ *  to be the same as layer[ALPHA].  when in[ALPHA] or layer[ALPHA] are zero,
+ *  the value of comp[RED..BLUE] is unconstrained (in particular, it may be
+ *  NaN).
+ */
+
+
+void
+gimp_operation_layer_mode_composite_union_avx512 (const gfloat *in,
+                                                  const gfloat *layer,
+                                                  const gfloat *comp,
+                                                  const gfloat *mask,
+                                                  gfloat        opacity,
+                                                  gfloat       *out,
+                                                  gint          samples)
+{
+  const __m512 v_one     = _mm512_set1_ps (1.0f);
+  const __m512 v_opacity = _mm512_set1_ps (opacity);
+
+  for (; samples >= 4; samples -= 4)
+    {
+      __m512 rgba_in    = _mm512_loadu_ps (in);
+      __m512 rgba_layer = _mm512_loadu_ps (layer);
+      __m512 rgba_comp  = _mm512_loadu_ps (comp);
+      __m512 in_alpha, layer_alpha, new_alpha, ratio, out_pixel;
+
+      in_alpha    = expand_alpha (rgba_in);
+      layer_alpha = _mm512_mul_ps (expand_alpha (rgba_layer), v_opacity);
+      layer_alpha = apply_mask (layer_alpha, mask);
+
+      /* new_alpha = layer_alpha + (1 - layer_alpha) * in_alpha */
+      new_alpha = _mm512_fmadd_ps (_mm512_sub_ps (v_one, layer_alpha),
+                                   in_alpha, layer_alpha);
+
+      /* out = ratio * (in_alpha * (comp - layer) + layer - in) + in */
+      ratio     = _mm512_div_ps (layer_alpha, new_alpha);
+      out_pixel = _mm512_fmadd_ps (in_alpha,
+                                   _mm512_sub_ps (rgba_comp, rgba_layer),
+                                   _mm512_sub_ps (rgba_layer, rgba_in));
+      out_pixel = _mm512_fmadd_ps (ratio, out_pixel, rgba_in);
+
+      out_pixel = _mm512_mask_blend_ps (is_zero (in_alpha),
+                                        out_pixel, rgba_layer);
+      out_pixel = _mm512_mask_blend_ps (is_zero (layer_alpha) |
+                                        is_zero (new_alpha),
+                                        out_pixel, rgba_in);
+
+      _mm512_storeu_ps (out, _mm512_mask_blend_ps (ALPHA_MASK,
+                                                   out_pixel, new_alpha));
+
+      in    += 16;
+      layer += 16;
+      comp  += 16;
+      out   += 16;
+
+      if (mask)
+        mask += 4;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_union_avx2 (in, layer, comp, mask,
+                                                      opacity, out, samples);
+    }
+}
+
+void
+gimp_operation_layer_mode_composite_clip_to_backdrop_avx512 (const gfloat *in,
+                                                             const gfloat *layer,
+                                                             const gfloat *comp,
+                                                             const gfloat *mask,
+                                                             gfloat        opacity,
+                                                             gfloat       *out,
+                                                             gint          samples)
+{
+  const __m512 v_one     = _mm512_set1_ps (1.0f);
+  const __m512 v_opacity = _mm512_set1_ps (opacity);
+
+  for (; samples >= 4; samples -= 4)
+    {
+      __m512 rgba_in   = _mm512_loadu_ps (in);
+      __m512 rgba_comp = _mm512_loadu_ps (comp);
+      __m512 layer_alpha, out_pixel;
+
+      layer_alpha = _mm512_mul_ps (expand_alpha (rgba_comp), v_opacity);
+      layer_alpha = apply_mask (layer_alpha, mask);
+
+      /* out = comp * layer_alpha + in * (1 - layer_alpha) */
+      out_pixel = _mm512_fmadd_ps (rgba_comp, layer_alpha,
+                                   _mm512_mul_ps (rgba_in,
+                                                  _mm512_sub_ps (v_one,
+                                                                 layer_alpha)));
+
+      out_pixel = _mm512_mask_blend_ps (is_zero (expand_alpha (rgba_in)) |
+                                        is_zero (layer_alpha),
+                                        out_pixel, rgba_in);
+
+      _mm512_storeu_ps (out, _mm512_mask_blend_ps (ALPHA_MASK,
+                                                   out_pixel, rgba_in));
+
+      in    += 16;
+      layer += 16;
+      comp  += 16;
+      out   += 16;
+
+      if (mask)
+        mask += 4;
+    }
+
+  if (samples)
+    {
+      gimp_operation_layer_mode_composite_clip_to_backdrop_avx2 (in, layer,
+                                                                 comp, mask,
+                                                                 opacity, out,
+                                                                 samples);
+    }
+}
+
+#endif /* COMPILE_AVX512F_INTRINISICS */
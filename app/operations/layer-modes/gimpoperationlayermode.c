@@ -117,9 +117,6 @@ static gboolean        process_last_node                             (GeglOperat
                                                                       const GeglRectangle *roi,
                                                                       gint                 level);
 
-static void            gimp_operation_layer_mode_cache_fishes        (GimpOperationLayerMode *op,
-                                                                      const Babl             *preferred_format);
-
 
 G_DEFINE_TYPE (GimpOperationLayerMode, gimp_operation_layer_mode,
                GEGL_TYPE_OPERATION_POINT_COMPOSER3)
@@ -199,12 +196,6 @@ gimp_operation_layer_mode_class_init (GimpOperationLayerModeClass *klass)
                                                       GIMP_LAYER_COMPOSITE_UNION,
                                                       GIMP_PARAM_READWRITE |
                                                       G_PARAM_CONSTRUCT));
-
-
-#if COMPILE_SSE2_INTRINISICS
-  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
-    composite_clip_to_backdrop = gimp_operation_layer_mode_composite_clip_to_backdrop_sse2;
-#endif
 }
 
 static void
@@ -321,23 +312,7 @@ gimp_operation_layer_mode_prepare (GeglOperation *operation)
    */
   else
     {
-      self->is_last_node = TRUE;
-
-      /* if the layer mode doesn't affect the source, use a shortcut
-       * function that only applies the opacity/mask to the layer.
-       */
-      if (! (gimp_operation_layer_mode_get_affected_region (self) &
-             GIMP_LAYER_COMPOSITE_REGION_SOURCE))
-        {
-          self->function = process_last_node;
-        }
-      /* otherwise, use the original process function, but force the
-       * composite mode to UNION.
-       */
-      else
-        {
-          self->composite_mode = GIMP_LAYER_COMPOSITE_UNION;
-        }
+      gimp_operation_layer_mode_set_last_node (self);
 
       preferred_format = gegl_operation_get_source_format (operation, "aux");
     }
@@ -873,7 +848,73 @@ process_last_node (GeglOperation       *operation,
   return TRUE;
 }
 
-static void
+
+/*  public functions  */
+
+
+/* selects the compositing functions for the CPU.  called once, by
+ * gimp_layer_modes_init().
+ */
+void
+gimp_operation_layer_mode_init_composite_functions (void)
+{
+  GimpCpuAccelFlags accel = gimp_cpu_accel_get_support ();
+
+#if COMPILE_SSE2_INTRINISICS
+  if (accel & GIMP_CPU_ACCEL_X86_SSE2)
+    composite_clip_to_backdrop = gimp_operation_layer_mode_composite_clip_to_backdrop_sse2;
+#endif /* COMPILE_SSE2_INTRINISICS */
+
+#if COMPILE_AVX2_INTRINISICS
+  if ((accel & (GIMP_CPU_ACCEL_X86_AVX2 | GIMP_CPU_ACCEL_X86_FMA)) ==
+      (GIMP_CPU_ACCEL_X86_AVX2 | GIMP_CPU_ACCEL_X86_FMA))
+    {
+      composite_union            = gimp_operation_layer_mode_composite_union_avx2;
+      composite_clip_to_backdrop = gimp_operation_layer_mode_composite_clip_to_backdrop_avx2;
+      composite_clip_to_layer    = gimp_operation_layer_mode_composite_clip_to_layer_avx2;
+      composite_intersection     = gimp_operation_layer_mode_composite_intersection_avx2;
+
+#if COMPILE_AVX512F_INTRINISICS
+      if (accel & GIMP_CPU_ACCEL_X86_AVX512F)
+        {
+          composite_union            = gimp_operation_layer_mode_composite_union_avx512;
+          composite_clip_to_backdrop = gimp_operation_layer_mode_composite_clip_to_backdrop_avx512;
+        }
+#endif /* COMPILE_AVX512F_INTRINISICS */
+    }
+#endif /* COMPILE_AVX2_INTRINISICS */
+}
+
+/* sets up @op to render its layer over nothing, as the last node
+ * (corresponding to the bottom layer), as if using UNION mode.  called
+ * from prepare(), after selecting the layer mode's function and
+ * composite mode.
+ */
+void
+gimp_operation_layer_mode_set_last_node (GimpOperationLayerMode *op)
+{
+  g_return_if_fail (GIMP_IS_OPERATION_LAYER_MODE (op));
+
+  op->is_last_node = TRUE;
+
+  /* if the layer mode doesn't affect the source, use a shortcut
+   * function that only applies the opacity/mask to the layer.
+   */
+  if (! (gimp_operation_layer_mode_get_affected_region (op) &
+         GIMP_LAYER_COMPOSITE_REGION_SOURCE))
+    {
+      op->function = process_last_node;
+    }
+  /* otherwise, use the original process function, but force the
+   * composite mode to UNION.
+   */
+  else
+    {
+      op->composite_mode = GIMP_LAYER_COMPOSITE_UNION;
+    }
+}
+
+void
 gimp_operation_layer_mode_cache_fishes (GimpOperationLayerMode *op,
                                         const Babl             *preferred_format)
 {
@@ -889,6 +930,12 @@ gimp_operation_layer_mode_cache_fishes (GimpOperationLayerMode *op,
         preferred_format = gegl_operation_get_source_format (GEGL_OPERATION (op), "input");
       else
         preferred_format = gegl_operation_get_source_format (GEGL_OPERATION (op), "aux");
+
+      /* operations which are not connected, like the layers of a
+       * gimp:layer-stack, keep the fishes they were set up with.
+       */
+      if (! preferred_format && op->cached_fish_format)
+        return;
     }
 
   format = gimp_layer_mode_get_format (op->layer_mode,
@@ -935,10 +982,6 @@ gimp_operation_layer_mode_cache_fishes (GimpOperationLayerMode *op,
     }
 }
 
-
-/*  public functions  */
-
-
 GimpLayerCompositeRegion
 gimp_operation_layer_mode_get_affected_region (GimpOperationLayerMode *layer_mode)
 {
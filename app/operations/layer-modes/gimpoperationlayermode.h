@@ -85,7 +85,15 @@ struct _GimpOperationLayerModeClass
 
 GType                    gimp_operation_layer_mode_get_type            (void) G_GNUC_CONST;
 
+void                     gimp_operation_layer_mode_init_composite_functions
+                                                                       (void);
+
 GimpLayerCompositeRegion gimp_operation_layer_mode_get_affected_region (GimpOperationLayerMode *layer_mode);
 
+void                     gimp_operation_layer_mode_set_last_node       (GimpOperationLayerMode *op);
+
+void                     gimp_operation_layer_mode_cache_fishes        (GimpOperationLayerMode *op,
+                                                                        const Babl             *preferred_format);
+
 
 #endif /* __GIMP_OPERATION_LAYER_MODE_H__ */
@@ -0,0 +1,668 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayerstack.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl-plugin.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "../operations-types.h"
+
+#include "gimp-layer-modes.h"
+#include "gimpoperationlayermode.h"
+#include "gimpoperationlayerstack.h"
+
+
+/*  the stack composites a run of layers over its input in a single
+ *  pass.  each layer is processed by its mode's own process function,
+ *  in place, on blocks of BLOCK_SIZE pixels, so that the intermediate
+ *  results never leave the cache.
+ */
+#define BLOCK_SIZE 256
+
+
+typedef struct
+{
+  GimpOperationLayerStack *stack;
+  GeglBuffer              *input;
+  GeglBuffer              *output;
+  GeglBuffer              *layers[GIMP_OPERATION_LAYER_STACK_MAX_LAYERS];
+  GeglBuffer              *masks[GIMP_OPERATION_LAYER_STACK_MAX_LAYERS];
+  gint                     level;
+} ProcessData;
+
+
+static void            gimp_operation_layer_stack_finalize         (GObject                 *object);
+
+static void            gimp_operation_layer_stack_attach           (GeglOperation           *operation);
+static void            gimp_operation_layer_stack_prepare          (GeglOperation           *operation);
+static GeglRectangle   gimp_operation_layer_stack_get_bounding_box (GeglOperation           *operation);
+static gboolean        gimp_operation_layer_stack_process          (GeglOperation           *operation,
+                                                                    GeglOperationContext    *context,
+                                                                    const gchar             *output_prop,
+                                                                    const GeglRectangle     *result,
+                                                                    gint                     level);
+
+static gboolean        gimp_operation_layer_stack_connect_pad      (GeglNode                *node,
+                                                                    const gchar             *pad,
+                                                                    GeglNode                *mode_node,
+                                                                    const gchar             *mode_pad);
+static GeglRectangle   gimp_operation_layer_stack_get_layer_extent (GimpOperationLayerStack *stack,
+                                                                    gint                     i,
+                                                                    const GeglRectangle     *backdrop);
+static void            gimp_operation_layer_stack_process_area     (const GeglRectangle     *area,
+                                                                    ProcessData             *data);
+
+
+G_DEFINE_TYPE (GimpOperationLayerStack, gimp_operation_layer_stack,
+               GEGL_TYPE_OPERATION)
+
+#define parent_class gimp_operation_layer_stack_parent_class
+
+
+static const gchar  *layer_pads[GIMP_OPERATION_LAYER_STACK_MAX_LAYERS];
+static const gchar  *mask_pads[GIMP_OPERATION_LAYER_STACK_MAX_LAYERS];
+
+static const gfloat  zeros[4 * BLOCK_SIZE];
+
+
+static void
+gimp_operation_layer_stack_class_init (GimpOperationLayerStackClass *klass)
+{
+  GObjectClass       *object_class    = G_OBJECT_CLASS (klass);
+  GeglOperationClass *operation_class = GEGL_OPERATION_CLASS (klass);
+  gint                i;
+
+  gegl_operation_class_set_keys (operation_class,
+                                 "name",        "gimp:layer-stack",
+                                 "description", "GIMP layer stack operation",
+                                 NULL);
+
+  object_class->finalize            = gimp_operation_layer_stack_finalize;
+
+  operation_class->attach           = gimp_operation_layer_stack_attach;
+  operation_class->prepare          = gimp_operation_layer_stack_prepare;
+  operation_class->get_bounding_box = gimp_operation_layer_stack_get_bounding_box;
+  operation_class->process          = gimp_operation_layer_stack_process;
+
+  for (i = 0; i < GIMP_OPERATION_LAYER_STACK_MAX_LAYERS; i++)
+    {
+      gchar *name;
+
+      name = g_strdup_printf ("layer-%d", i);
+      layer_pads[i] = g_intern_string (name);
+      g_free (name);
+
+      name = g_strdup_printf ("mask-%d", i);
+      mask_pads[i] = g_intern_string (name);
+      g_free (name);
+    }
+}
+
+static void
+gimp_operation_layer_stack_init (GimpOperationLayerStack *self)
+{
+}
+
+static void
+gimp_operation_layer_stack_finalize (GObject *object)
+{
+  GimpOperationLayerStack *stack = GIMP_OPERATION_LAYER_STACK (object);
+  gint                     i;
+
+  for (i = 0; i < stack->n_layers; i++)
+    g_clear_object (&stack->layers[i].node);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gimp_operation_layer_stack_create_pad (GeglOperation *operation,
+                                       const gchar   *name,
+                                       GParamFlags    flags)
+{
+  GParamSpec *pspec;
+
+  pspec = g_param_spec_object (name, NULL, NULL,
+                               GEGL_TYPE_BUFFER,
+                               flags);
+
+  gegl_operation_create_pad (operation, pspec);
+  g_param_spec_sink (pspec);
+}
+
+static void
+gimp_operation_layer_stack_attach (GeglOperation *operation)
+{
+  gint i;
+
+  gimp_operation_layer_stack_create_pad (operation, "output",
+                                         G_PARAM_READABLE |
+                                         GEGL_PARAM_PAD_OUTPUT);
+  gimp_operation_layer_stack_create_pad (operation, "input",
+                                         G_PARAM_READWRITE |
+                                         GEGL_PARAM_PAD_INPUT);
+
+  for (i = 0; i < GIMP_OPERATION_LAYER_STACK_MAX_LAYERS; i++)
+    {
+      gimp_operation_layer_stack_create_pad (operation, layer_pads[i],
+                                             G_PARAM_READWRITE |
+                                             GEGL_PARAM_PAD_INPUT);
+      gimp_operation_layer_stack_create_pad (operation, mask_pads[i],
+                                             G_PARAM_READWRITE |
+                                             GEGL_PARAM_PAD_INPUT);
+    }
+}
+
+static void
+gimp_operation_layer_stack_prepare (GeglOperation *operation)
+{
+  GimpOperationLayerStack *stack  = GIMP_OPERATION_LAYER_STACK (operation);
+  const GeglRectangle     *input_extent;
+  const Babl              *format = NULL;
+  GeglRectangle            extent = {};
+  gint                     i;
+
+  input_extent = gegl_operation_source_get_bounding_box (operation, "input");
+
+  if (input_extent && ! gegl_rectangle_is_empty (input_extent))
+    {
+      extent = *input_extent;
+      format = gegl_operation_get_source_format (operation, "input");
+    }
+
+  /*  set up each layer the same way gimp_operation_layer_mode_prepare()
+   *  would, with the result of the layers below as its input
+   */
+  for (i = 0; i < stack->n_layers; i++)
+    {
+      GimpLayerStackLayer    *layer      = &stack->layers[i];
+      GimpOperationLayerMode *layer_mode = layer->operation;
+      const Babl             *preferred_format;
+      const GeglRectangle    *mask_extent;
+
+      layer_mode->composite_mode = layer_mode->prop_composite_mode;
+
+      if (layer_mode->composite_mode == GIMP_LAYER_COMPOSITE_AUTO)
+        {
+          layer_mode->composite_mode =
+            gimp_layer_mode_get_composite_mode (layer_mode->layer_mode);
+        }
+
+      layer_mode->function       = gimp_layer_mode_get_function       (layer_mode->layer_mode);
+      layer_mode->blend_function = gimp_layer_mode_get_blend_function (layer_mode->layer_mode);
+      layer_mode->opacity        = layer_mode->prop_opacity;
+
+      if (! gegl_rectangle_is_empty (&extent))
+        {
+          layer_mode->is_last_node = FALSE;
+
+          preferred_format = format;
+        }
+      else
+        {
+          /*  the layer is composited over nothing, like the bottom
+           *  layer's mode node
+           */
+          gimp_operation_layer_mode_set_last_node (layer_mode);
+
+          preferred_format = gegl_operation_get_source_format (operation,
+                                                               layer_pads[i]);
+        }
+
+      mask_extent = gegl_operation_source_get_bounding_box (operation,
+                                                            mask_pads[i]);
+
+      layer->has_mask      = mask_extent && ! gegl_rectangle_is_empty (mask_extent);
+      layer_mode->has_mask = layer->has_mask;
+
+      gimp_operation_layer_mode_cache_fishes (layer_mode, preferred_format);
+
+      layer->format      = gimp_layer_mode_get_format (layer_mode->layer_mode,
+                                                       layer_mode->blend_space,
+                                                       layer_mode->composite_space,
+                                                       layer_mode->composite_mode,
+                                                       preferred_format);
+      layer->mask_format = babl_format_with_space ("Y float", layer->format);
+
+      /*  the blocks are converted in place when the layers' formats
+       *  differ
+       */
+      if (i > 0 && layer->format != format)
+        layer->fish = babl_fish (format, layer->format);
+      else
+        layer->fish = NULL;
+
+      gegl_operation_set_format (operation, layer_pads[i], layer->format);
+      gegl_operation_set_format (operation, mask_pads[i],  layer->mask_format);
+
+      extent = gimp_operation_layer_stack_get_layer_extent (stack, i, &extent);
+      format = layer->format;
+    }
+
+  if (! format)
+    format = babl_format ("RGBA float");
+
+  gegl_operation_set_format (operation, "input",
+                             stack->n_layers > 0 ?
+                             stack->layers[0].format : format);
+  gegl_operation_set_format (operation, "output", format);
+}
+
+static GeglRectangle
+gimp_operation_layer_stack_get_bounding_box (GeglOperation *operation)
+{
+  GimpOperationLayerStack *stack  = GIMP_OPERATION_LAYER_STACK (operation);
+  const GeglRectangle     *in_rect;
+  GeglRectangle            result = {};
+  gint                     i;
+
+  in_rect = gegl_operation_source_get_bounding_box (operation, "input");
+
+  if (in_rect)
+    result = *in_rect;
+
+  for (i = 0; i < stack->n_layers; i++)
+    result = gimp_operation_layer_stack_get_layer_extent (stack, i, &result);
+
+  return result;
+}
+
+static gboolean
+gimp_operation_layer_stack_process (GeglOperation        *operation,
+                                    GeglOperationContext *context,
+                                    const gchar          *output_prop,
+                                    const GeglRectangle  *result,
+                                    gint                  level)
+{
+  GimpOperationLayerStack *stack = GIMP_OPERATION_LAYER_STACK (operation);
+  ProcessData              data  = {};
+  gint                     i;
+
+  data.stack = stack;
+  data.input = GEGL_BUFFER (gegl_operation_context_dup_object (context,
+                                                                "input"));
+  data.level = level;
+
+  if (stack->n_layers == 0)
+    {
+      gegl_operation_context_set_object (context, "output",
+                                         G_OBJECT (data.input));
+      g_clear_object (&data.input);
+
+      return TRUE;
+    }
+
+  for (i = 0; i < stack->n_layers; i++)
+    {
+      data.layers[i] =
+        GEGL_BUFFER (gegl_operation_context_dup_object (context,
+                                                         layer_pads[i]));
+      data.masks[i] =
+        GEGL_BUFFER (gegl_operation_context_dup_object (context,
+                                                         mask_pads[i]));
+    }
+
+  data.output = gegl_operation_context_get_target (context, "output");
+
+  gegl_parallel_distribute_area (
+    result, gegl_operation_get_pixels_per_thread (operation),
+    GEGL_SPLIT_STRATEGY_AUTO,
+    (GeglParallelDistributeAreaFunc) gimp_operation_layer_stack_process_area,
+    &data);
+
+  for (i = 0; i < stack->n_layers; i++)
+    {
+      g_clear_object (&data.layers[i]);
+      g_clear_object (&data.masks[i]);
+    }
+
+  g_clear_object (&data.input);
+
+  return TRUE;
+}
+
+
+/*  public functions  */
+
+/*  returns whether a layer's mode node running @operation can be
+ *  replaced by a layer in a stack
+ */
+gboolean
+gimp_operation_layer_stack_can_fuse (GeglOperation *operation)
+{
+  GimpOperationLayerModeClass *layer_mode_class;
+
+  g_return_val_if_fail (GEGL_IS_OPERATION (operation), FALSE);
+
+  if (! GIMP_IS_OPERATION_LAYER_MODE (operation))
+    return FALSE;
+
+  /*  the stack only knows what the default parent_process() does, which
+   *  REPLACE and PASS_THROUGH override
+   */
+  layer_mode_class = g_type_class_peek (GIMP_TYPE_OPERATION_LAYER_MODE);
+
+  return (GIMP_OPERATION_LAYER_MODE_GET_CLASS (operation)->parent_process ==
+          layer_mode_class->parent_process);
+}
+
+/*  sets the stack's layers to copies of @mode_nodes, bottom to top, and
+ *  connects the stack's layer and mask pads to the producers of their
+ *  "aux" and "aux2" pads.  the layers are set up in prepare(), so the
+ *  stack is invalidated if any of them changed.
+ */
+void
+gimp_operation_layer_stack_set_layers (GimpOperationLayerStack *stack,
+                                       GList                   *mode_nodes)
+{
+  GeglNode *node;
+  GList    *list;
+  gint      n_layers;
+  gboolean  changed = FALSE;
+  gint      i;
+
+  g_return_if_fail (GIMP_IS_OPERATION_LAYER_STACK (stack));
+
+  n_layers = g_list_length (mode_nodes);
+
+  g_return_if_fail (n_layers <= GIMP_OPERATION_LAYER_STACK_MAX_LAYERS);
+
+  node = GEGL_OPERATION (stack)->node;
+
+  for (list = mode_nodes, i = 0; list; list = g_list_next (list), i++)
+    {
+      GimpLayerStackLayer    *layer     = &stack->layers[i];
+      GeglNode               *mode_node = list->data;
+      const gchar            *operation;
+      GimpLayerMode           mode;
+      gdouble                 opacity;
+      GimpLayerColorSpace     blend_space;
+      GimpLayerColorSpace     composite_space;
+      GimpLayerCompositeMode  composite_mode;
+
+      operation = gegl_node_get_operation (mode_node);
+
+      if (! layer->node ||
+          g_strcmp0 (gegl_node_get_operation (layer->node), operation))
+        {
+          g_clear_object (&layer->node);
+
+          layer->node      = gegl_node_new_child (NULL,
+                                                  "operation", operation,
+                                                  NULL);
+          layer->operation = GIMP_OPERATION_LAYER_MODE (
+            gegl_node_get_gegl_operation (layer->node));
+
+          changed = TRUE;
+        }
+
+      gegl_node_get (mode_node,
+                     "layer-mode",      &mode,
+                     "opacity",         &opacity,
+                     "blend-space",     &blend_space,
+                     "composite-space", &composite_space,
+                     "composite-mode",  &composite_mode,
+                     NULL);
+
+      if (layer->operation->layer_mode          != mode            ||
+          layer->operation->prop_opacity        != opacity         ||
+          layer->operation->blend_space         != blend_space     ||
+          layer->operation->composite_space     != composite_space ||
+          layer->operation->prop_composite_mode != composite_mode)
+        {
+          gegl_node_set (layer->node,
+                         "layer-mode",      mode,
+                         "opacity",         opacity,
+                         "blend-space",     blend_space,
+                         "composite-space", composite_space,
+                         "composite-mode",  composite_mode,
+                         NULL);
+
+          changed = TRUE;
+        }
+
+      changed |= gimp_operation_layer_stack_connect_pad (node, layer_pads[i],
+                                                         mode_node, "aux");
+      changed |= gimp_operation_layer_stack_connect_pad (node, mask_pads[i],
+                                                         mode_node, "aux2");
+    }
+
+  for (; i < stack->n_layers; i++)
+    {
+      g_clear_object (&stack->layers[i].node);
+      stack->layers[i].operation = NULL;
+
+      gegl_node_disconnect (node, layer_pads[i]);
+      gegl_node_disconnect (node, mask_pads[i]);
+
+      changed = TRUE;
+    }
+
+  stack->n_layers = n_layers;
+
+  if (changed)
+    gegl_operation_invalidate (GEGL_OPERATION (stack), NULL, TRUE);
+}
+
+
+/*  private functions  */
+
+/*  connects @node's @pad to the producer of @mode_node's @mode_pad, if
+ *  any, and returns whether the connection changed
+ */
+static gboolean
+gimp_operation_layer_stack_connect_pad (GeglNode    *node,
+                                        const gchar *pad,
+                                        GeglNode    *mode_node,
+                                        const gchar *mode_pad)
+{
+  GeglNode *producer;
+  GeglNode *current;
+  gchar    *producer_pad = NULL;
+  gchar    *current_pad  = NULL;
+  gboolean  changed;
+
+  producer = gegl_node_get_producer (mode_node, mode_pad, &producer_pad);
+  current  = gegl_node_get_producer (node,      pad,      &current_pad);
+
+  changed = (producer != current ||
+             g_strcmp0 (producer_pad, current_pad));
+
+  if (changed)
+    {
+      if (producer)
+        gegl_node_connect (producer, producer_pad, node, pad);
+      else
+        gegl_node_disconnect (node, pad);
+    }
+
+  g_free (producer_pad);
+  g_free (current_pad);
+
+  return changed;
+}
+
+/*  returns the extent of the result of compositing layer @i over
+ *  @backdrop, see gimp_operation_layer_mode_get_bounding_box()
+ */
+static GeglRectangle
+gimp_operation_layer_stack_get_layer_extent (GimpOperationLayerStack *stack,
+                                             gint                     i,
+                                             const GeglRectangle     *backdrop)
+{
+  GeglOperation            *operation  = GEGL_OPERATION (stack);
+  GimpOperationLayerMode   *layer_mode = stack->layers[i].operation;
+  const GeglRectangle      *aux_rect;
+  const GeglRectangle      *mask_rect;
+  GeglRectangle             src_rect   = {};
+  GeglRectangle             result;
+  GimpLayerCompositeRegion  included_region;
+
+  aux_rect  = gegl_operation_source_get_bounding_box (operation, layer_pads[i]);
+  mask_rect = gegl_operation_source_get_bounding_box (operation, mask_pads[i]);
+
+  if (aux_rect)
+    {
+      src_rect = *aux_rect;
+
+      if (mask_rect)
+        gegl_rectangle_intersect (&src_rect, &src_rect, mask_rect);
+    }
+
+  if (layer_mode->is_last_node)
+    {
+      included_region = GIMP_LAYER_COMPOSITE_REGION_SOURCE;
+    }
+  else
+    {
+      included_region = gimp_layer_mode_get_included_region (layer_mode->layer_mode,
+                                                             layer_mode->composite_mode);
+    }
+
+  if (layer_mode->prop_opacity == 0.0)
+    included_region &= ~GIMP_LAYER_COMPOSITE_REGION_SOURCE;
+
+  gegl_rectangle_intersect (&result, &src_rect, backdrop);
+
+  if (included_region & GIMP_LAYER_COMPOSITE_REGION_SOURCE)
+    gegl_rectangle_bounding_box (&result, &result, &src_rect);
+
+  if (included_region & GIMP_LAYER_COMPOSITE_REGION_DESTINATION)
+    gegl_rectangle_bounding_box (&result, &result, backdrop);
+
+  return result;
+}
+
+static void
+gimp_operation_layer_stack_process_area (const GeglRectangle *area,
+                                         ProcessData         *data)
+{
+  GimpOperationLayerStack *stack    = data->stack;
+  gint                     n_layers = stack->n_layers;
+  GeglBufferIterator      *iter;
+  gint                     input_index = -1;
+  gint                     layer_index[GIMP_OPERATION_LAYER_STACK_MAX_LAYERS];
+  gint                     mask_index[GIMP_OPERATION_LAYER_STACK_MAX_LAYERS];
+  gint                     i;
+
+  iter = gegl_buffer_iterator_new (data->output, area, data->level,
+                                   stack->layers[n_layers - 1].format,
+                                   GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE,
+                                   2 + 2 * n_layers);
+
+  if (data->input)
+    {
+      input_index = gegl_buffer_iterator_add (iter, data->input,
+                                              area, data->level,
+                                              stack->layers[0].format,
+                                              GEGL_ACCESS_READ,
+                                              GEGL_ABYSS_NONE);
+    }
+
+  for (i = 0; i < n_layers; i++)
+    {
+      layer_index[i] = -1;
+      mask_index[i]  = -1;
+
+      if (data->layers[i])
+        {
+          layer_index[i] = gegl_buffer_iterator_add (iter, data->layers[i],
+                                                     area, data->level,
+                                                     stack->layers[i].format,
+                                                     GEGL_ACCESS_READ,
+                                                     GEGL_ABYSS_NONE);
+        }
+
+      if (data->masks[i])
+        {
+          mask_index[i] = gegl_buffer_iterator_add (iter, data->masks[i],
+                                                    area, data->level,
+                                                    stack->layers[i].mask_format,
+                                                    GEGL_ACCESS_READ,
+                                                    GEGL_ABYSS_NONE);
+        }
+    }
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const GeglRectangle *roi = &iter->items[0].roi;
+      gfloat              *out = iter->items[0].data;
+      gint                 y;
+
+      for (y = 0; y < roi->height; y++)
+        {
+          gint x;
+
+          for (x = 0; x < roi->width; x += BLOCK_SIZE)
+            {
+              GeglRectangle  block;
+              gint           offset = y * roi->width + x;
+              gfloat        *dest   = out + 4 * offset;
+
+              block.x      = roi->x + x;
+              block.y      = roi->y + y;
+              block.width  = MIN (BLOCK_SIZE, roi->width - x);
+              block.height = 1;
+
+              if (input_index >= 0)
+                {
+                  const gfloat *in = iter->items[input_index].data;
+
+                  memcpy (dest, in + 4 * offset,
+                          4 * block.width * sizeof (gfloat));
+                }
+              else
+                {
+                  memset (dest, 0, 4 * block.width * sizeof (gfloat));
+                }
+
+              /*  composite all layers over the block before moving on  */
+              for (i = 0; i < n_layers; i++)
+                {
+                  GimpLayerStackLayer *layer = &stack->layers[i];
+                  gpointer             aux   = (gpointer) zeros;
+                  gpointer             mask  = NULL;
+
+                  if (layer_index[i] >= 0)
+                    aux = (gfloat *) iter->items[layer_index[i]].data + 4 * offset;
+
+                  /*  a mask which is not included in the roi hides the
+                   *  layer, like in gimp_operation_layer_mode_parent_process()
+                   */
+                  if (mask_index[i] >= 0)
+                    mask = (gfloat *) iter->items[mask_index[i]].data + offset;
+                  else if (layer->has_mask)
+                    mask = (gpointer) zeros;
+
+                  if (layer->fish)
+                    babl_process (layer->fish, dest, dest, block.width);
+
+                  layer->operation->function (GEGL_OPERATION (layer->operation),
+                                              dest, aux, mask, dest,
+                                              block.width, &block,
+                                              data->level);
+                }
+            }
+        }
+    }
+}
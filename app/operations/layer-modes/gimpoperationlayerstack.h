@@ -0,0 +1,74 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationlayerstack.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_OPERATION_LAYER_STACK_H__
+#define __GIMP_OPERATION_LAYER_STACK_H__
+
+
+#include <gegl-plugin.h>
+
+
+/*  the maximal number of layers composited by a single stack operation  */
+#define GIMP_OPERATION_LAYER_STACK_MAX_LAYERS 32
+
+
+#define GIMP_TYPE_OPERATION_LAYER_STACK            (gimp_operation_layer_stack_get_type ())
+#define GIMP_OPERATION_LAYER_STACK(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_OPERATION_LAYER_STACK, GimpOperationLayerStack))
+#define GIMP_OPERATION_LAYER_STACK_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_OPERATION_LAYER_STACK, GimpOperationLayerStackClass))
+#define GIMP_IS_OPERATION_LAYER_STACK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_OPERATION_LAYER_STACK))
+#define GIMP_IS_OPERATION_LAYER_STACK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_OPERATION_LAYER_STACK))
+#define GIMP_OPERATION_LAYER_STACK_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_OPERATION_LAYER_STACK, GimpOperationLayerStackClass))
+
+
+typedef struct _GimpOperationLayerStack      GimpOperationLayerStack;
+typedef struct _GimpOperationLayerStackClass GimpOperationLayerStackClass;
+
+typedef struct
+{
+  GeglNode               *node;      /* private copy of the layer's mode node */
+  GimpOperationLayerMode *operation;
+  const Babl             *format;
+  const Babl             *mask_format;
+  const Babl             *fish;      /* from the previous layer's format */
+  gboolean                has_mask;
+} GimpLayerStackLayer;
+
+struct _GimpOperationLayerStack
+{
+  GeglOperation        parent_instance;
+
+  gint                 n_layers;
+  GimpLayerStackLayer  layers[GIMP_OPERATION_LAYER_STACK_MAX_LAYERS];
+};
+
+struct _GimpOperationLayerStackClass
+{
+  GeglOperationClass  parent_class;
+};
+
+
+GType      gimp_operation_layer_stack_get_type   (void) G_GNUC_CONST;
+
+gboolean   gimp_operation_layer_stack_can_fuse   (GeglOperation           *operation);
+
+void       gimp_operation_layer_stack_set_layers (GimpOperationLayerStack *stack,
+                                                  GList                   *mode_nodes);
+
+
+#endif /* __GIMP_OPERATION_LAYER_STACK_H__ */
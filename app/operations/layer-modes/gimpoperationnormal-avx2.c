@@ -0,0 +1,136 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpoperationnormal-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+
+#include "operations/operations-types.h"
+
+#include "gimpoperationnormal.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 and FMA */
+#include <immintrin.h>
+
+
+gboolean
+gimp_operation_normal_process_avx2 (GeglOperation       *op,
+                                    void                *in_p,
+                                    void                *layer_p,
+                                    void                *mask_p,
+                                    void                *out_p,
+                                    glong                samples,
+                                    const GeglRectangle *roi,
+                                    gint                 level)
+{
+  GimpOperationLayerMode *layer_mode = (gpointer) op;
+  const gfloat           *in         = in_p;
+  const gfloat           *layer      = layer_p;
+  const gfloat           *mask       = mask_p;
+  gfloat                 *out        = out_p;
+  const __m256            v_opacity  = _mm256_set1_ps (layer_mode->opacity);
+  const __m256            v_zero     = _mm256_setzero_ps ();
+  gboolean                union_mode;
+
+  switch (layer_mode->composite_mode)
+    {
+    case GIMP_LAYER_COMPOSITE_UNION:
+    case GIMP_LAYER_COMPOSITE_AUTO:
+      union_mode = TRUE;
+      break;
+
+    case GIMP_LAYER_COMPOSITE_CLIP_TO_BACKDROP:
+      union_mode = FALSE;
+      break;
+
+    default:
+      return gimp_operation_normal_process (op,
+                                            in_p, layer_p, mask_p, out_p,
+                                            samples, roi, level);
+    }
+
+  /* two pixels per iteration */
+  for (; samples >= 2; samples -= 2)
+    {
+      __m256 rgba_in    = _mm256_loadu_ps (in);
+      __m256 rgba_layer = _mm256_loadu_ps (layer);
+      __m256 in_alpha, layer_alpha, out_alpha, out_pixel;
+
+      in_alpha    = _mm256_permute_ps (rgba_in,    _MM_SHUFFLE (3, 3, 3, 3));
+      layer_alpha = _mm256_permute_ps (rgba_layer, _MM_SHUFFLE (3, 3, 3, 3));
+      layer_alpha = _mm256_mul_ps (layer_alpha, v_opacity);
+
+      if (mask)
+        {
+          layer_alpha = _mm256_mul_ps (layer_alpha,
+                                       _mm256_setr_ps (mask[0], mask[0],
+                                                       mask[0], mask[0],
+                                                       mask[1], mask[1],
+                                                       mask[1], mask[1]));
+          mask += 2;
+        }
+
+      if (union_mode)
+        {
+          __m256 layer_weight;
+
+          /* out_alpha = layer_alpha + in_alpha - layer_alpha * in_alpha */
+          out_alpha = _mm256_fnmadd_ps (layer_alpha, in_alpha,
+                                        _mm256_add_ps (layer_alpha, in_alpha));
+
+          /* out = in + (layer - in) * layer_alpha / out_alpha */
+          layer_weight = _mm256_div_ps (layer_alpha, out_alpha);
+          out_pixel    = _mm256_fmadd_ps (_mm256_sub_ps (rgba_layer, rgba_in),
+                                          layer_weight, rgba_in);
+        }
+      else
+        {
+          out_alpha = in_alpha;
+
+          /* out = in + (layer - in) * layer_alpha */
+          out_pixel = _mm256_fmadd_ps (_mm256_sub_ps (rgba_layer, rgba_in),
+                                       layer_alpha, rgba_in);
+        }
+
+      out_pixel = _mm256_blendv_ps (out_pixel, rgba_in,
+                                    _mm256_cmp_ps (out_alpha, v_zero,
+                                                   _CMP_EQ_OQ));
+
+      _mm256_storeu_ps (out, _mm256_blend_ps (out_pixel, out_alpha, 0x88));
+
+      in    += 8;
+      layer += 8;
+      out   += 8;
+    }
+
+  if (samples)
+    {
+      gimp_operation_normal_process (op,
+                                     (gfloat *) in, (gfloat *) layer,
+                                     (gfloat *) mask, out,
+                                     samples, roi, level);
+    }
+
+  return TRUE;
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
@@ -75,6 +75,13 @@ gimp_operation_normal_class_init (GimpOperationNormalClass *klass)
   if (gimp_cpu_accel_get_support() & GIMP_CPU_ACCEL_X86_SSE4_1)
     layer_mode_class->process = gimp_operation_normal_process_sse4;
 #endif /* COMPILE_SSE4_1_INTRINISICS */
+
+#if COMPILE_AVX2_INTRINISICS
+  if ((gimp_cpu_accel_get_support () & (GIMP_CPU_ACCEL_X86_AVX2 |
+                                        GIMP_CPU_ACCEL_X86_FMA)) ==
+      (GIMP_CPU_ACCEL_X86_AVX2 | GIMP_CPU_ACCEL_X86_FMA))
+    layer_mode_class->process = gimp_operation_normal_process_avx2;
+#endif /* COMPILE_AVX2_INTRINISICS */
 }
 
 static void
@@ -87,5 +87,18 @@ gboolean   gimp_operation_normal_process_sse4 (GeglOperation       *op,
 
 #endif /* COMPILE_SSE4_1_INTRINISICS */
 
+#if COMPILE_AVX2_INTRINISICS
+
+gboolean   gimp_operation_normal_process_avx2 (GeglOperation       *op,
+                                               void                *in,
+                                               void                *layer,
+                                               void                *mask,
+                                               void                *out,
+                                               glong                samples,
+                                               const GeglRectangle *roi,
+                                               gint                 level);
+
+#endif /* COMPILE_AVX2_INTRINISICS */
+
 
 #endif /* __GIMP_OPERATION_NORMAL_H__ */
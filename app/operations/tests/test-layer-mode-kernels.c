@@ -0,0 +1,302 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * test-layer-mode-kernels.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*  a small benchmark of the layer mode kernels: runs the generic and the
+ *  vectorized compositing and blending functions the CPU supports over the
+ *  same buffers, and prints their throughput, and how far their results
+ *  are from the generic ones.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <gegl-plugin.h>
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "operations/operations-types.h"
+
+#include "operations/layer-modes/gimpoperationlayermode-blend.h"
+#include "operations/layer-modes/gimpoperationlayermode-composite.h"
+
+
+#define N_PIXELS    (64 * 1024)
+#define MIN_TIME    (G_TIME_SPAN_SECOND / 4)
+
+
+typedef void (* CompositeFunc) (const gfloat *in,
+                                const gfloat *layer,
+                                const gfloat *comp,
+                                const gfloat *mask,
+                                gfloat        opacity,
+                                gfloat       *out,
+                                gint          samples);
+
+typedef struct
+{
+  const gchar            *name;
+  GimpCpuAccelFlags       accel;
+  CompositeFunc           composite;
+  GimpLayerModeBlendFunc  blend;
+} Kernel;
+
+typedef struct
+{
+  const gchar  *name;
+  const Kernel *kernels;
+} KernelGroup;
+
+
+#define AVX2 (GIMP_CPU_ACCEL_X86_AVX2 | GIMP_CPU_ACCEL_X86_FMA)
+#define AVX512 (AVX2 | GIMP_CPU_ACCEL_X86_AVX512F)
+
+static const Kernel union_kernels[] =
+{
+  { "generic", 0, gimp_operation_layer_mode_composite_union },
+#if COMPILE_AVX2_INTRINISICS
+  { "avx2",    AVX2, gimp_operation_layer_mode_composite_union_avx2 },
+#endif
+#if COMPILE_AVX512F_INTRINISICS
+  { "avx512",  AVX512, gimp_operation_layer_mode_composite_union_avx512 },
+#endif
+  { NULL }
+};
+
+static const Kernel clip_to_backdrop_kernels[] =
+{
+  { "generic", 0, gimp_operation_layer_mode_composite_clip_to_backdrop },
+#if COMPILE_SSE2_INTRINISICS
+  { "sse2",    GIMP_CPU_ACCEL_X86_SSE2,
+    gimp_operation_layer_mode_composite_clip_to_backdrop_sse2 },
+#endif
+#if COMPILE_AVX2_INTRINISICS
+  { "avx2",    AVX2, gimp_operation_layer_mode_composite_clip_to_backdrop_avx2 },
+#endif
+#if COMPILE_AVX512F_INTRINISICS
+  { "avx512",  AVX512, gimp_operation_layer_mode_composite_clip_to_backdrop_avx512 },
+#endif
+  { NULL }
+};
+
+static const Kernel clip_to_layer_kernels[] =
+{
+  { "generic", 0, gimp_operation_layer_mode_composite_clip_to_layer },
+#if COMPILE_AVX2_INTRINISICS
+  { "avx2",    AVX2, gimp_operation_layer_mode_composite_clip_to_layer_avx2 },
+#endif
+  { NULL }
+};
+
+static const Kernel intersection_kernels[] =
+{
+  { "generic", 0, gimp_operation_layer_mode_composite_intersection },
+#if COMPILE_AVX2_INTRINISICS
+  { "avx2",    AVX2, gimp_operation_layer_mode_composite_intersection_avx2 },
+#endif
+  { NULL }
+};
+
+#if COMPILE_AVX2_INTRINISICS
+#define BLEND_KERNELS(mode)                                             \
+static const Kernel mode##_kernels[] =                                  \
+{                                                                       \
+  { "generic", 0,    NULL, gimp_operation_layer_mode_blend_##mode },    \
+  { "avx2",    AVX2, NULL, gimp_operation_layer_mode_blend_##mode##_avx2 }, \
+  { NULL }                                                              \
+}
+#else
+#define BLEND_KERNELS(mode)                                             \
+static const Kernel mode##_kernels[] =                                  \
+{                                                                       \
+  { "generic", 0,    NULL, gimp_operation_layer_mode_blend_##mode },    \
+  { NULL }                                                              \
+}
+#endif
+
+BLEND_KERNELS (addition);
+BLEND_KERNELS (darken_only);
+BLEND_KERNELS (difference);
+BLEND_KERNELS (lighten_only);
+BLEND_KERNELS (multiply);
+BLEND_KERNELS (screen);
+BLEND_KERNELS (subtract);
+
+static const KernelGroup groups[] =
+{
+  { "composite union",            union_kernels            },
+  { "composite clip-to-backdrop", clip_to_backdrop_kernels },
+  { "composite clip-to-layer",    clip_to_layer_kernels    },
+  { "composite intersection",     intersection_kernels     },
+  { "blend addition",             addition_kernels         },
+  { "blend darken-only",          darken_only_kernels      },
+  { "blend difference",           difference_kernels       },
+  { "blend lighten-only",         lighten_only_kernels     },
+  { "blend multiply",             multiply_kernels         },
+  { "blend screen",               screen_kernels           },
+  { "blend subtract",             subtract_kernels         }
+};
+
+
+static gfloat *in;
+static gfloat *layer;
+static gfloat *comp;
+static gfloat *mask;
+static gfloat *reference;
+static gfloat *out;
+
+
+static void
+kernel_run (const Kernel *kernel,
+            gboolean      with_mask,
+            gfloat       *dest)
+{
+  if (kernel->composite)
+    {
+      kernel->composite (in, layer, comp, with_mask ? mask : NULL, 0.75f,
+                         dest, N_PIXELS);
+    }
+  else
+    {
+      kernel->blend (NULL, in, layer, dest, N_PIXELS);
+    }
+}
+
+static gdouble
+kernel_max_error (void)
+{
+  gdouble max_error = 0.0;
+  gint    i;
+
+  for (i = 0; i < 4 * N_PIXELS; i++)
+    {
+      /* blended colors are unconstrained where either alpha is zero */
+      if (in[i | ALPHA] == 0.0f || layer[i | ALPHA] == 0.0f)
+        continue;
+
+      max_error = MAX (max_error, fabs (out[i] - reference[i]));
+    }
+
+  return max_error;
+}
+
+static void
+kernel_group_run (const KernelGroup *group,
+                  gboolean           with_mask)
+{
+  GimpCpuAccelFlags accel = gimp_cpu_accel_get_support ();
+  const Kernel     *kernel;
+
+  g_printerr ("  %s%s:\n", group->name, with_mask ? ", masked" : "");
+
+  kernel_run (&group->kernels[0], with_mask, reference);
+
+  for (kernel = group->kernels; kernel->name; kernel++)
+    {
+      gint64 start_time;
+      gint64 elapsed;
+      gint   n_runs = 0;
+
+      if ((accel & kernel->accel) != kernel->accel)
+        {
+          g_printerr ("    %-8s: not supported\n", kernel->name);
+          continue;
+        }
+
+      start_time = g_get_monotonic_time ();
+
+      do
+        {
+          kernel_run (kernel, with_mask, out);
+
+          n_runs++;
+          elapsed = g_get_monotonic_time () - start_time;
+        }
+      while (elapsed < MIN_TIME);
+
+      g_printerr ("    %-8s: %8.1f Mpixels/s  max error %g\n",
+                  kernel->name,
+                  (gdouble) n_runs * N_PIXELS / elapsed,
+                  kernel_max_error ());
+    }
+}
+
+int
+main (void)
+{
+  GRand *rand = g_rand_new_with_seed (0);
+  gint   i;
+
+  in        = g_new (gfloat, 4 * N_PIXELS);
+  layer     = g_new (gfloat, 4 * N_PIXELS);
+  comp      = g_new (gfloat, 4 * N_PIXELS);
+  mask      = g_new (gfloat,     N_PIXELS);
+  reference = g_new (gfloat, 4 * N_PIXELS);
+  out       = g_new (gfloat, 4 * N_PIXELS);
+
+  /* random pixels, with some fully transparent and fully opaque ones */
+  for (i = 0; i < 4 * N_PIXELS; i++)
+    {
+      in[i]    = g_rand_double (rand);
+      layer[i] = g_rand_double (rand);
+
+      if ((i & 3) == ALPHA)
+        {
+          switch (g_rand_int_range (rand, 0, 8))
+            {
+            case 0: in[i]    = 0.0f; break;
+            case 1: in[i]    = 1.0f; break;
+            case 2: layer[i] = 0.0f; break;
+            case 3: layer[i] = 1.0f; break;
+            }
+        }
+    }
+
+  for (i = 0; i < N_PIXELS; i++)
+    mask[i] = g_rand_double (rand);
+
+  /* composite the multiply blend result */
+  gimp_operation_layer_mode_blend_multiply (NULL, in, layer, comp, N_PIXELS);
+
+  g_printerr ("Testing layer mode kernels...\n");
+
+  for (i = 0; i < G_N_ELEMENTS (groups); i++)
+    {
+      kernel_group_run (&groups[i], FALSE);
+
+      if (groups[i].kernels[0].composite)
+        kernel_group_run (&groups[i], TRUE);
+    }
+
+  g_printerr ("\n");
+
+  g_free (in);
+  g_free (layer);
+  g_free (comp);
+  g_free (mask);
+  g_free (reference);
+  g_free (out);
+
+  g_rand_free (rand);
+
+  return EXIT_SUCCESS;
+}
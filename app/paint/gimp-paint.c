@@ -37,6 +37,7 @@
 #include "gimpmybrushcore.h"
 #include "gimppaintoptions.h"
 #include "gimppaintbrush.h"
+#include "gimppaintcore-loops.h"
 #include "gimppencil.h"
 #include "gimpperspectiveclone.h"
 #include "gimpsmudge.h"
@@ -77,6 +78,8 @@ gimp_paint_init (Gimp *gimp)
 
   g_return_if_fail (GIMP_IS_GIMP (gimp));
 
+  gimp_paint_core_loops_init ();
+
   gimp->paint_info_list = gimp_list_new (GIMP_TYPE_PAINT_INFO, FALSE);
   gimp_object_set_static_name (GIMP_OBJECT (gimp->paint_info_list),
                                "paint infos");
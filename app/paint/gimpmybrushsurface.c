@@ -32,6 +32,38 @@
 #include "gimpmybrushsurface.h"
 
 
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+
+typedef struct
+{
+  GeglRectangle roi;
+  float         x;
+  float         y;
+  float         radius;
+  float         color_r;
+  float         color_g;
+  float         color_b;
+  float         color_a;
+  float         hardness;
+  float         aspect_ratio;
+  float         cs;
+  float         sn;
+  float         one_over_radius2;
+  float         segment1_slope;
+  float         segment2_slope;
+  float         r_aa_start;
+  float         normal_mode;
+  float         colorize;
+} GimpMybrushDab;
+
+typedef struct
+{
+  GimpMybrushSurface *surface;
+  GArray             *tiles;
+} FlushData;
+
 struct _GimpMybrushSurface
 {
   MyPaintSurface surface;
@@ -42,6 +74,10 @@ struct _GimpMybrushSurface
   GeglRectangle dirty;
   GimpComponentMask component_mask;
   GimpMybrushOptions *options;
+
+  /* dabs drawn since the last flush, rendered together, a tile at a time */
+  GArray     *dabs;
+  gint        atomic;
 };
 
 /* --- Taken from mypaint-tiled-surface.c --- */
@@ -229,6 +265,9 @@ calculate_dab_roi (float x,
   return *GEGL_RECTANGLE (x0, y0, x1 - x0, y1 - y0);
 }
 
+static void gimp_mypaint_surface_flush (GimpMybrushSurface *surface);
+
+
 static void
 gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
                                 float           x,
@@ -242,6 +281,9 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
   GeglRectangle dabRect;
 
+  /* smudging must see the dabs drawn so far */
+  gimp_mypaint_surface_flush (surface);
+
   if (radius < 1.0f)
     radius = 1.0f;
 
@@ -335,64 +377,128 @@ gimp_mypaint_surface_get_color (MyPaintSurface *base_surface,
 
 }
 
-static int
-gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
-                               float           x,
-                               float           y,
-                               float           radius,
-                               float           color_r,
-                               float           color_g,
-                               float           color_b,
-                               float           opaque,
-                               float           hardness,
-                               float           color_a,
-                               float           aspect_ratio,
-                               float           angle,
-                               float           lock_alpha,
-                               float           colorize)
+/* Render the part of a dab that falls into a single chunk of the buffer.
+ * pixels and mask point to the chunk's first pixel.
+ */
+static void
+gimp_mypaint_surface_render_dab (GimpMybrushSurface   *surface,
+                                 const GimpMybrushDab *dab,
+                                 const GeglRectangle  *chunk,
+                                 float                *pixels,
+                                 const float          *mask_pixels)
 {
-  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
-  GeglBufferIterator *iter;
-  GeglRectangle       dabRect;
-  GimpComponentMask   component_mask = surface->component_mask;
+  GimpComponentMask component_mask = surface->component_mask;
+  gboolean          no_erasing     = surface->options->no_erasing;
+  GeglRectangle     rect;
+  int               iy, ix;
 
-  const float one_over_radius2 = 1.0f / (radius * radius);
-  const double angle_rad = angle / 360 * 2 * M_PI;
-  const float cs = cos(angle_rad);
-  const float sn = sin(angle_rad);
-  float normal_mode;
-  float segment1_slope;
-  float segment2_slope;
-  float r_aa_start;
+  if (! gegl_rectangle_intersect (&rect, &dab->roi, chunk))
+    return;
 
-  hardness = CLAMP (hardness, 0.0f, 1.0f);
-  segment1_slope = -(1.0f / hardness - 1.0f);
-  segment2_slope = -hardness / (1.0f - hardness);
-  aspect_ratio = MAX (1.0f, aspect_ratio);
+  for (iy = rect.y; iy < rect.y + rect.height; iy++)
+    {
+      int          offset = (iy - chunk->y) * chunk->width + (rect.x - chunk->x);
+      float       *pixel  = pixels + offset * 4;
+      const float *mask   = mask_pixels ? mask_pixels + offset : NULL;
+
+      for (ix = rect.x; ix < rect.x + rect.width; ix++)
+        {
+          float rr, base_alpha, alpha, dst_alpha, r, g, b, a;
+          if (dab->radius < 3.0f)
+            rr = calculate_rr_antialiased (ix, iy, dab->x, dab->y, dab->aspect_ratio, dab->sn, dab->cs, dab->one_over_radius2, dab->r_aa_start);
+          else
+            rr = calculate_rr (ix, iy, dab->x, dab->y, dab->aspect_ratio, dab->sn, dab->cs, dab->one_over_radius2);
+          base_alpha = calculate_alpha_for_rr (rr, dab->hardness, dab->segment1_slope, dab->segment2_slope);
+          alpha = base_alpha * dab->normal_mode;
+          if (mask)
+            alpha *= *mask;
+          dst_alpha = pixel[ALPHA];
+          /* a = alpha * color_a + dst_alpha * (1.0f - alpha);
+           * which converts to: */
+          a = alpha * (dab->color_a - dst_alpha) + dst_alpha;
+          r = pixel[RED];
+          g = pixel[GREEN];
+          b = pixel[BLUE];
+
+          if (a > 0.0f)
+            {
+              /* By definition the ratio between each color[] and pixel[] component in a non-pre-multipled blend always sums to 1.0f.
+               * Originally this would have been "(color[n] * alpha * color_a + pixel[n] * dst_alpha * (1.0f - alpha)) / a",
+               * instead we only calculate the cheaper term. */
+              float src_term = (alpha * dab->color_a) / a;
+              float dst_term = 1.0f - src_term;
+              r = dab->color_r * src_term + r * dst_term;
+              g = dab->color_g * src_term + g * dst_term;
+              b = dab->color_b * src_term + b * dst_term;
+            }
 
-  r_aa_start = radius - 1.0f;
-  r_aa_start = MAX (r_aa_start, 0);
-  r_aa_start = (r_aa_start * r_aa_start) / aspect_ratio;
+          if (dab->colorize > 0.0f && base_alpha > 0.0f)
+            {
+              alpha = base_alpha * dab->colorize;
+              a = alpha + dst_alpha - alpha * dst_alpha;
+              if (a > 0.0f)
+                {
+                  GimpHSL pixel_hsl, out_hsl;
+                  GimpRGB pixel_rgb = {dab->color_r, dab->color_g, dab->color_b};
+                  GimpRGB out_rgb   = {r, g, b};
+                  float src_term = alpha / a;
+                  float dst_term = 1.0f - src_term;
 
-  normal_mode = opaque * (1.0f - colorize);
-  colorize = opaque * colorize;
+                  gimp_rgb_to_hsl (&pixel_rgb, &pixel_hsl);
+                  gimp_rgb_to_hsl (&out_rgb, &out_hsl);
 
-  /* FIXME: This should use the real matrix values to trim aspect_ratio dabs */
-  dabRect = calculate_dab_roi (x, y, radius);
-  gegl_rectangle_intersect (&dabRect, &dabRect, gegl_buffer_get_extent (surface->buffer));
+                  out_hsl.h = pixel_hsl.h;
+                  out_hsl.s = pixel_hsl.s;
+                  gimp_hsl_to_rgb (&out_hsl, &out_rgb);
 
-  if (dabRect.width <= 0 || dabRect.height <= 0)
-    return 0;
+                  r = (float)out_rgb.r * src_term + r * dst_term;
+                  g = (float)out_rgb.g * src_term + g * dst_term;
+                  b = (float)out_rgb.b * src_term + b * dst_term;
+                }
+            }
 
-  gegl_rectangle_bounding_box (&surface->dirty, &surface->dirty, &dabRect);
+          if (no_erasing)
+            a = MAX (a, pixel[ALPHA]);
+
+          if (component_mask != GIMP_COMPONENT_MASK_ALL)
+            {
+              if (component_mask & GIMP_COMPONENT_MASK_RED)
+                pixel[RED]   = r;
+              if (component_mask & GIMP_COMPONENT_MASK_GREEN)
+                pixel[GREEN] = g;
+              if (component_mask & GIMP_COMPONENT_MASK_BLUE)
+                pixel[BLUE]  = b;
+              if (component_mask & GIMP_COMPONENT_MASK_ALPHA)
+                pixel[ALPHA] = a;
+            }
+          else
+            {
+              pixel[RED]   = r;
+              pixel[GREEN] = g;
+              pixel[BLUE]  = b;
+              pixel[ALPHA] = a;
+            }
 
-  iter = gegl_buffer_iterator_new (surface->buffer, &dabRect, 0,
+          pixel += 4;
+          if (mask)
+            mask += 1;
+        }
+    }
+}
+
+static void
+gimp_mypaint_surface_flush_tile (GimpMybrushSurface  *surface,
+                                 const GeglRectangle *tile)
+{
+  GeglBufferIterator *iter;
+
+  iter = gegl_buffer_iterator_new (surface->buffer, tile, 0,
                                    babl_format ("R'G'B'A float"),
                                    GEGL_BUFFER_READWRITE,
                                    GEGL_ABYSS_NONE, 2);
   if (surface->paint_mask)
     {
-      GeglRectangle mask_roi = dabRect;
+      GeglRectangle mask_roi = *tile;
       mask_roi.x -= surface->paint_mask_x;
       mask_roi.y -= surface->paint_mask_y;
       gegl_buffer_iterator_add (iter, surface->paint_mask, &mask_roi, 0,
@@ -402,109 +508,205 @@ gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
 
   while (gegl_buffer_iterator_next (iter))
     {
-      float *pixel = (float *)iter->items[0].data;
+      float *pixels = (float *)iter->items[0].data;
       float *mask;
-      int iy, ix;
+      guint  i;
 
       if (surface->paint_mask)
         mask = iter->items[1].data;
       else
         mask = NULL;
 
-      for (iy = iter->items[0].roi.y; iy < iter->items[0].roi.y + iter->items[0].roi.height; iy++)
+      /* render the dabs in the order they were drawn */
+      for (i = 0; i < surface->dabs->len; i++)
         {
-          for (ix = iter->items[0].roi.x; ix < iter->items[0].roi.x +  iter->items[0].roi.width; ix++)
-            {
-              float rr, base_alpha, alpha, dst_alpha, r, g, b, a;
-              if (radius < 3.0f)
-                rr = calculate_rr_antialiased (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2, r_aa_start);
-              else
-                rr = calculate_rr (ix, iy, x, y, aspect_ratio, sn, cs, one_over_radius2);
-              base_alpha = calculate_alpha_for_rr (rr, hardness, segment1_slope, segment2_slope);
-              alpha = base_alpha * normal_mode;
-              if (mask)
-                alpha *= *mask;
-              dst_alpha = pixel[ALPHA];
-              /* a = alpha * color_a + dst_alpha * (1.0f - alpha);
-               * which converts to: */
-              a = alpha * (color_a - dst_alpha) + dst_alpha;
-              r = pixel[RED];
-              g = pixel[GREEN];
-              b = pixel[BLUE];
+          gimp_mypaint_surface_render_dab (surface,
+                                           &g_array_index (surface->dabs,
+                                                           GimpMybrushDab, i),
+                                           &iter->items[0].roi,
+                                           pixels, mask);
+        }
+    }
+}
 
-              if (a > 0.0f)
-                {
-                  /* By definition the ratio between each color[] and pixel[] component in a non-pre-multipled blend always sums to 1.0f.
-                   * Originally this would have been "(color[n] * alpha * color_a + pixel[n] * dst_alpha * (1.0f - alpha)) / a",
-                   * instead we only calculate the cheaper term. */
-                  float src_term = (alpha * color_a) / a;
-                  float dst_term = 1.0f - src_term;
-                  r = color_r * src_term + r * dst_term;
-                  g = color_g * src_term + g * dst_term;
-                  b = color_b * src_term + b * dst_term;
-                }
+static void
+gimp_mypaint_surface_flush_tiles (gsize      offset,
+                                  gsize      size,
+                                  FlushData *data)
+{
+  gsize i;
 
-              if (colorize > 0.0f && base_alpha > 0.0f)
-                {
-                  alpha = base_alpha * colorize;
-                  a = alpha + dst_alpha - alpha * dst_alpha;
-                  if (a > 0.0f)
-                    {
-                      GimpHSL pixel_hsl, out_hsl;
-                      GimpRGB pixel_rgb = {color_r, color_g, color_b};
-                      GimpRGB out_rgb   = {r, g, b};
-                      float src_term = alpha / a;
-                      float dst_term = 1.0f - src_term;
-
-                      gimp_rgb_to_hsl (&pixel_rgb, &pixel_hsl);
-                      gimp_rgb_to_hsl (&out_rgb, &out_hsl);
-
-                      out_hsl.h = pixel_hsl.h;
-                      out_hsl.s = pixel_hsl.s;
-                      gimp_hsl_to_rgb (&out_hsl, &out_rgb);
-
-                      r = (float)out_rgb.r * src_term + r * dst_term;
-                      g = (float)out_rgb.g * src_term + g * dst_term;
-                      b = (float)out_rgb.b * src_term + b * dst_term;
-                    }
-                }
+  for (i = offset; i < offset + size; i++)
+    {
+      gimp_mypaint_surface_flush_tile (data->surface,
+                                       &g_array_index (data->tiles,
+                                                       GeglRectangle, i));
+    }
+}
+
+/* Render all queued dabs.  Each tile touched by any of the dabs is
+ * fetched once, and the tiles are processed in parallel.
+ */
+static void
+gimp_mypaint_surface_flush (GimpMybrushSurface *surface)
+{
+  FlushData      data;
+  GeglRectangle  area = { 0, };
+  GArray        *tiles;
+  gboolean      *touched;
+  gint           tile_width;
+  gint           tile_height;
+  gint           x0, y0;
+  gint           n_tiles_x;
+  gint           n_tiles_y;
+  gint           tx, ty;
+  guint          i;
+
+  if (! surface->dabs->len)
+    return;
+
+  for (i = 0; i < surface->dabs->len; i++)
+    {
+      GimpMybrushDab *dab = &g_array_index (surface->dabs, GimpMybrushDab, i);
 
-              if (surface->options->no_erasing)
-                a = MAX (a, pixel[ALPHA]);
+      gegl_rectangle_bounding_box (&area, &area, &dab->roi);
+    }
 
-              if (component_mask != GIMP_COMPONENT_MASK_ALL)
-                {
-                  if (component_mask & GIMP_COMPONENT_MASK_RED)
-                    pixel[RED]   = r;
-                  if (component_mask & GIMP_COMPONENT_MASK_GREEN)
-                    pixel[GREEN] = g;
-                  if (component_mask & GIMP_COMPONENT_MASK_BLUE)
-                    pixel[BLUE]  = b;
-                  if (component_mask & GIMP_COMPONENT_MASK_ALPHA)
-                    pixel[ALPHA] = a;
-                }
-              else
-                {
-                  pixel[RED]   = r;
-                  pixel[GREEN] = g;
-                  pixel[BLUE]  = b;
-                  pixel[ALPHA] = a;
-                }
+  g_object_get (surface->buffer,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
 
-              pixel += 4;
-              if (mask)
-                mask += 1;
-            }
-        }
+  /* the grid of the buffer's tiles covering the dabs */
+  x0 = area.x - ((area.x % tile_width)  + tile_width)  % tile_width;
+  y0 = area.y - ((area.y % tile_height) + tile_height) % tile_height;
+
+  n_tiles_x = (area.x + area.width  - x0 + tile_width  - 1) / tile_width;
+  n_tiles_y = (area.y + area.height - y0 + tile_height - 1) / tile_height;
+
+  touched = g_new0 (gboolean, n_tiles_x * n_tiles_y);
+
+  for (i = 0; i < surface->dabs->len; i++)
+    {
+      GimpMybrushDab *dab = &g_array_index (surface->dabs, GimpMybrushDab, i);
+      gint            tx1 = (dab->roi.x - x0) / tile_width;
+      gint            ty1 = (dab->roi.y - y0) / tile_height;
+      gint            tx2 = (dab->roi.x + dab->roi.width  - 1 - x0) / tile_width;
+      gint            ty2 = (dab->roi.y + dab->roi.height - 1 - y0) / tile_height;
+
+      for (ty = ty1; ty <= ty2; ty++)
+        for (tx = tx1; tx <= tx2; tx++)
+          touched[ty * n_tiles_x + tx] = TRUE;
     }
 
+  tiles = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
+
+  for (ty = 0; ty < n_tiles_y; ty++)
+    for (tx = 0; tx < n_tiles_x; tx++)
+      {
+        GeglRectangle tile;
+
+        if (! touched[ty * n_tiles_x + tx])
+          continue;
+
+        gegl_rectangle_intersect (&tile,
+                                  GEGL_RECTANGLE (x0 + tx * tile_width,
+                                                  y0 + ty * tile_height,
+                                                  tile_width, tile_height),
+                                  &area);
+
+        g_array_append_val (tiles, tile);
+      }
+
+  g_free (touched);
+
+  data.surface = surface;
+  data.tiles   = tiles;
+
+  gegl_parallel_distribute_range (tiles->len,
+                                  PIXELS_PER_THREAD /
+                                  (tile_width * tile_height),
+                                  (GeglParallelDistributeRangeFunc)
+                                    gimp_mypaint_surface_flush_tiles,
+                                  &data);
+
+  g_array_free (tiles, TRUE);
+
+  g_array_set_size (surface->dabs, 0);
+}
+
+static int
+gimp_mypaint_surface_draw_dab (MyPaintSurface *base_surface,
+                               float           x,
+                               float           y,
+                               float           radius,
+                               float           color_r,
+                               float           color_g,
+                               float           color_b,
+                               float           opaque,
+                               float           hardness,
+                               float           color_a,
+                               float           aspect_ratio,
+                               float           angle,
+                               float           lock_alpha,
+                               float           colorize)
+{
+  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
+  GimpMybrushDab      dab;
+  GeglRectangle       dabRect;
+
+  const double angle_rad = angle / 360 * 2 * M_PI;
+
+  /* FIXME: This should use the real matrix values to trim aspect_ratio dabs */
+  dabRect = calculate_dab_roi (x, y, radius);
+  gegl_rectangle_intersect (&dabRect, &dabRect, gegl_buffer_get_extent (surface->buffer));
+
+  if (dabRect.width <= 0 || dabRect.height <= 0)
+    return 0;
+
+  gegl_rectangle_bounding_box (&surface->dirty, &surface->dirty, &dabRect);
+
+  hardness = CLAMP (hardness, 0.0f, 1.0f);
+  aspect_ratio = MAX (1.0f, aspect_ratio);
+
+  dab.roi              = dabRect;
+  dab.x                = x;
+  dab.y                = y;
+  dab.radius           = radius;
+  dab.color_r          = color_r;
+  dab.color_g          = color_g;
+  dab.color_b          = color_b;
+  dab.color_a          = color_a;
+  dab.hardness         = hardness;
+  dab.aspect_ratio     = aspect_ratio;
+  dab.cs               = cos (angle_rad);
+  dab.sn               = sin (angle_rad);
+  dab.one_over_radius2 = 1.0f / (radius * radius);
+  dab.segment1_slope   = -(1.0f / hardness - 1.0f);
+  dab.segment2_slope   = -hardness / (1.0f - hardness);
+
+  dab.r_aa_start = radius - 1.0f;
+  dab.r_aa_start = MAX (dab.r_aa_start, 0);
+  dab.r_aa_start = (dab.r_aa_start * dab.r_aa_start) / aspect_ratio;
+
+  dab.normal_mode = opaque * (1.0f - colorize);
+  dab.colorize    = opaque * colorize;
+
+  g_array_append_val (surface->dabs, dab);
+
+  /* dabs are rendered in end_atomic(), unless we're outside of one */
+  if (! surface->atomic)
+    gimp_mypaint_surface_flush (surface);
+
   return 1;
 }
 
 static void
 gimp_mypaint_surface_begin_atomic (MyPaintSurface *base_surface)
 {
+  GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
 
+  surface->atomic++;
 }
 
 static void
@@ -513,6 +715,12 @@ gimp_mypaint_surface_end_atomic (MyPaintSurface   *base_surface,
 {
   GimpMybrushSurface *surface = (GimpMybrushSurface *)base_surface;
 
+  g_return_if_fail (surface->atomic > 0);
+
+  surface->atomic--;
+
+  gimp_mypaint_surface_flush (surface);
+
   roi->x         = surface->dirty.x;
   roi->y         = surface->dirty.y;
   roi->width     = surface->dirty.width;
@@ -527,6 +735,7 @@ gimp_mypaint_surface_destroy (MyPaintSurface *base_surface)
 
   g_clear_object (&surface->buffer);
   g_clear_object (&surface->paint_mask);
+  g_array_free (surface->dabs, TRUE);
   g_free (surface);
 }
 
@@ -556,6 +765,8 @@ gimp_mypaint_surface_new (GeglBuffer         *buffer,
   surface->paint_mask_x         = paint_mask_x;
   surface->paint_mask_y         = paint_mask_y;
   surface->dirty                = *GEGL_RECTANGLE (0, 0, 0, 0);
+  surface->dabs                 = g_array_new (FALSE, FALSE,
+                                               sizeof (GimpMybrushDab));
 
   return surface;
 }
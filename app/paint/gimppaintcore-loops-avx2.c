@@ -0,0 +1,247 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppaintcore-loops-avx2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gimppaintcore-loops-avx2.h"
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+/* AVX2 and FMA */
+#include <immintrin.h>
+
+
+/*  row kernels of gimp_paint_core_loops_process().  they process eight
+ *  pixels per iteration, and the trailing pixels one at a time.
+ */
+
+
+static inline __m256
+load_mask_u8 (const guint8 *mask)
+{
+  __m256i v = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) mask));
+
+  return _mm256_div_ps (_mm256_cvtepi32_ps (v), _mm256_set1_ps (255.0f));
+}
+
+static inline __m256
+combine_paint_mask (__m256   canvas,
+                    __m256   mask,
+                    __m256   opacity,
+                    gboolean stipple)
+{
+  if (stipple)
+    {
+      /* canvas += (1 - canvas) * mask * opacity */
+      return _mm256_fmadd_ps (_mm256_mul_ps (_mm256_sub_ps (_mm256_set1_ps (1.0f),
+                                                            canvas),
+                                             mask),
+                              opacity, canvas);
+    }
+  else
+    {
+      __m256 result;
+
+      /* if (opacity > canvas) canvas += (opacity - canvas) * mask * opacity */
+      result = _mm256_fmadd_ps (_mm256_mul_ps (_mm256_sub_ps (opacity, canvas),
+                                               mask),
+                                opacity, canvas);
+
+      return _mm256_blendv_ps (canvas, result,
+                               _mm256_cmp_ps (opacity, canvas, _CMP_GT_OQ));
+    }
+}
+
+static inline gfloat
+combine_paint_mask_1 (gfloat   canvas,
+                      gfloat   mask,
+                      gfloat   opacity,
+                      gboolean stipple)
+{
+  if (stipple)
+    canvas += (1.0f - canvas) * mask * opacity;
+  else if (opacity > canvas)
+    canvas += (opacity - canvas) * mask * opacity;
+
+  return canvas;
+}
+
+/* multiplies the alpha components of the eight pixels at paint by alpha */
+static inline void
+multiply_paint_alpha (gfloat *paint,
+                      __m256  alpha)
+{
+  const __m256 v_one = _mm256_set1_ps (1.0f);
+  gint         i;
+
+  for (i = 0; i < 4; i++)
+    {
+      const __m256i index = _mm256_setr_epi32 (2 * i,     2 * i,
+                                               2 * i,     2 * i,
+                                               2 * i + 1, 2 * i + 1,
+                                               2 * i + 1, 2 * i + 1);
+      __m256        scale;
+
+      scale = _mm256_blend_ps (v_one,
+                               _mm256_permutevar8x32_ps (alpha, index),
+                               0x88);
+
+      _mm256_storeu_ps (paint + 8 * i,
+                        _mm256_mul_ps (_mm256_loadu_ps (paint + 8 * i), scale));
+    }
+}
+
+
+void
+gimp_paint_core_loops_combine_paint_mask_u8_avx2 (gfloat       *canvas,
+                                                  const guint8 *mask,
+                                                  gfloat        opacity,
+                                                  gboolean      stipple,
+                                                  gint          width)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; width >= 8; width -= 8)
+    {
+      _mm256_storeu_ps (canvas,
+                        combine_paint_mask (_mm256_loadu_ps (canvas),
+                                            load_mask_u8 (mask),
+                                            v_opacity, stipple));
+
+      canvas += 8;
+      mask   += 8;
+    }
+
+  for (; width > 0; width--)
+    {
+      *canvas = combine_paint_mask_1 (*canvas, *mask / 255.0f,
+                                      opacity, stipple);
+
+      canvas++;
+      mask++;
+    }
+}
+
+void
+gimp_paint_core_loops_combine_paint_mask_float_avx2 (gfloat       *canvas,
+                                                     const gfloat *mask,
+                                                     gfloat        opacity,
+                                                     gboolean      stipple,
+                                                     gint          width)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; width >= 8; width -= 8)
+    {
+      _mm256_storeu_ps (canvas,
+                        combine_paint_mask (_mm256_loadu_ps (canvas),
+                                            _mm256_loadu_ps (mask),
+                                            v_opacity, stipple));
+
+      canvas += 8;
+      mask   += 8;
+    }
+
+  for (; width > 0; width--)
+    {
+      *canvas = combine_paint_mask_1 (*canvas, *mask, opacity, stipple);
+
+      canvas++;
+      mask++;
+    }
+}
+
+void
+gimp_paint_core_loops_canvas_to_paint_buf_alpha_avx2 (gfloat       *paint,
+                                                      const gfloat *canvas,
+                                                      gint          width)
+{
+  for (; width >= 8; width -= 8)
+    {
+      multiply_paint_alpha (paint, _mm256_loadu_ps (canvas));
+
+      paint  += 32;
+      canvas += 8;
+    }
+
+  for (; width > 0; width--)
+    {
+      paint[3] *= *canvas;
+
+      paint  += 4;
+      canvas += 1;
+    }
+}
+
+void
+gimp_paint_core_loops_paint_mask_to_paint_buf_alpha_u8_avx2 (gfloat       *paint,
+                                                             const guint8 *mask,
+                                                             gfloat        opacity,
+                                                             gint          width)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; width >= 8; width -= 8)
+    {
+      multiply_paint_alpha (paint,
+                            _mm256_mul_ps (load_mask_u8 (mask), v_opacity));
+
+      paint += 32;
+      mask  += 8;
+    }
+
+  for (; width > 0; width--)
+    {
+      paint[3] *= *mask / 255.0f * opacity;
+
+      paint += 4;
+      mask  += 1;
+    }
+}
+
+void
+gimp_paint_core_loops_paint_mask_to_paint_buf_alpha_float_avx2 (gfloat       *paint,
+                                                                const gfloat *mask,
+                                                                gfloat        opacity,
+                                                                gint          width)
+{
+  const __m256 v_opacity = _mm256_set1_ps (opacity);
+
+  for (; width >= 8; width -= 8)
+    {
+      multiply_paint_alpha (paint,
+                            _mm256_mul_ps (_mm256_loadu_ps (mask), v_opacity));
+
+      paint += 32;
+      mask  += 8;
+    }
+
+  for (; width > 0; width--)
+    {
+      paint[3] *= *mask * opacity;
+
+      paint += 4;
+      mask  += 1;
+    }
+}
+
+#endif /* COMPILE_AVX2_INTRINISICS */
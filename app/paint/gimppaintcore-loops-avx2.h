@@ -0,0 +1,55 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimppaintcore-loops-avx2.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_PAINT_CORE_LOOPS_AVX2_H__
+#define __GIMP_PAINT_CORE_LOOPS_AVX2_H__
+
+
+#if COMPILE_AVX2_INTRINISICS
+
+void   gimp_paint_core_loops_combine_paint_mask_u8_avx2          (gfloat       *canvas,
+                                                                  const guint8 *mask,
+                                                                  gfloat        opacity,
+                                                                  gboolean      stipple,
+                                                                  gint          width);
+void   gimp_paint_core_loops_combine_paint_mask_float_avx2       (gfloat       *canvas,
+                                                                  const gfloat *mask,
+                                                                  gfloat        opacity,
+                                                                  gboolean      stipple,
+                                                                  gint          width);
+
+void   gimp_paint_core_loops_canvas_to_paint_buf_alpha_avx2      (gfloat       *paint,
+                                                                  const gfloat *canvas,
+                                                                  gint          width);
+
+void   gimp_paint_core_loops_paint_mask_to_paint_buf_alpha_u8_avx2
+                                                                 (gfloat       *paint,
+                                                                  const guint8 *mask,
+                                                                  gfloat        opacity,
+                                                                  gint          width);
+void   gimp_paint_core_loops_paint_mask_to_paint_buf_alpha_float_avx2
+                                                                 (gfloat       *paint,
+                                                                  const gfloat *mask,
+                                                                  gfloat        opacity,
+                                                                  gint          width);
+
+#endif /* COMPILE_AVX2_INTRINISICS */
+
+
+#endif /* __GIMP_PAINT_CORE_LOOPS_AVX2_H__ */
@@ -22,6 +22,8 @@
 extern "C"
 {
 
+#include "libgimpbase/gimpbase.h"
+
 #include "paint-types.h"
 
 #include "gegl/gimp-babl.h"
@@ -35,6 +37,7 @@ extern "C"
 #include "operations/layer-modes/gimpoperationlayermode.h"
 
 #include "gimppaintcore-loops.h"
+#include "gimppaintcore-loops-avx2.h"
 
 } /* extern "C" */
 
@@ -229,6 +232,110 @@ static inline gfloat
 value_to_float (T value) = delete;
 
 
+/* Row kernels:
+ *
+ * Vectorized versions of the per-row loops of some of the algorithms below,
+ * selected for the CPU by gimp_paint_core_loops_init().  When a kernel is
+ * not available, the algorithms fall back to their own loops.
+ */
+
+static struct
+{
+  void (* combine_paint_mask_u8)               (gfloat       *canvas,
+                                                const guint8 *mask,
+                                                gfloat        opacity,
+                                                gboolean      stipple,
+                                                gint          width);
+  void (* combine_paint_mask_float)            (gfloat       *canvas,
+                                                const gfloat *mask,
+                                                gfloat        opacity,
+                                                gboolean      stipple,
+                                                gint          width);
+  void (* canvas_to_paint_buf_alpha)           (gfloat       *paint,
+                                                const gfloat *canvas,
+                                                gint          width);
+  void (* paint_mask_to_paint_buf_alpha_u8)    (gfloat       *paint,
+                                                const guint8 *mask,
+                                                gfloat        opacity,
+                                                gint          width);
+  void (* paint_mask_to_paint_buf_alpha_float) (gfloat       *paint,
+                                                const gfloat *mask,
+                                                gfloat        opacity,
+                                                gint          width);
+} row_kernels;
+
+static inline gboolean
+row_kernel_combine_paint_mask (gfloat       *canvas,
+                               const guint8 *mask,
+                               gfloat        opacity,
+                               gboolean      stipple,
+                               gint          width)
+{
+  if (! row_kernels.combine_paint_mask_u8)
+    return FALSE;
+
+  row_kernels.combine_paint_mask_u8 (canvas, mask, opacity, stipple, width);
+
+  return TRUE;
+}
+
+static inline gboolean
+row_kernel_combine_paint_mask (gfloat       *canvas,
+                               const gfloat *mask,
+                               gfloat        opacity,
+                               gboolean      stipple,
+                               gint          width)
+{
+  if (! row_kernels.combine_paint_mask_float)
+    return FALSE;
+
+  row_kernels.combine_paint_mask_float (canvas, mask, opacity, stipple, width);
+
+  return TRUE;
+}
+
+static inline gboolean
+row_kernel_canvas_to_paint_buf_alpha (gfloat       *paint,
+                                      const gfloat *canvas,
+                                      gint          width)
+{
+  if (! row_kernels.canvas_to_paint_buf_alpha)
+    return FALSE;
+
+  row_kernels.canvas_to_paint_buf_alpha (paint, canvas, width);
+
+  return TRUE;
+}
+
+static inline gboolean
+row_kernel_paint_mask_to_paint_buf_alpha (gfloat       *paint,
+                                          const guint8 *mask,
+                                          gfloat        opacity,
+                                          gint          width)
+{
+  if (! row_kernels.paint_mask_to_paint_buf_alpha_u8)
+    return FALSE;
+
+  row_kernels.paint_mask_to_paint_buf_alpha_u8 (paint, mask, opacity, width);
+
+  return TRUE;
+}
+
+static inline gboolean
+row_kernel_paint_mask_to_paint_buf_alpha (gfloat       *paint,
+                                          const gfloat *mask,
+                                          gfloat        opacity,
+                                          gint          width)
+{
+  if (! row_kernels.paint_mask_to_paint_buf_alpha_float)
+    return FALSE;
+
+  row_kernels.paint_mask_to_paint_buf_alpha_float (paint, mask, opacity, width);
+
+  return TRUE;
+}
+
+
 /* AlgorithmBase:
  *
  * The base class of the algorithm hierarchy.
@@ -1205,6 +1312,19 @@ struct CombinePaintMaskToCanvasBufferToPaintBufAlpha : Base
     gfloat          *paint_pixel  = &this->paint_data[paint_offset];
     gint             x;
 
+    /* the row kernels are always selected together */
+    if (row_kernel_combine_paint_mask (state->canvas_pixel, mask_pixel,
+                                       params->paint_opacity, Base::stipple,
+                                       rect->width))
+      {
+        row_kernel_canvas_to_paint_buf_alpha (paint_pixel, state->canvas_pixel,
+                                              rect->width);
+
+        state->canvas_pixel += rect->width;
+
+        return;
+      }
+
     for (x = 0; x < rect->width; x++)
       {
         if (Base::stipple)
@@ -1303,6 +1423,15 @@ struct CombinePaintMaskToCanvasBuffer : Base
     const mask_type *mask_pixel  = &this->mask_data[mask_offset];
     gint             x;
 
+    if (row_kernel_combine_paint_mask (state->canvas_pixel, mask_pixel,
+                                       params->paint_opacity, Base::stipple,
+                                       rect->width))
+      {
+        state->canvas_pixel += rect->width;
+
+        return;
+      }
+
     for (x = 0; x < rect->width; x++)
       {
         if (Base::stipple)
@@ -1395,6 +1524,14 @@ struct CanvasBufferToPaintBufAlpha : Base
     gfloat *paint_pixel  = &this->paint_data[paint_offset];
     gint    x;
 
+    if (row_kernel_canvas_to_paint_buf_alpha (paint_pixel, state->canvas_pixel,
+                                              rect->width))
+      {
+        state->canvas_pixel += rect->width;
+
+        return;
+      }
+
     for (x = 0; x < rect->width; x++)
       {
         paint_pixel[3] *= *state->canvas_pixel;
@@ -1467,6 +1604,13 @@ struct PaintMaskToPaintBufAlpha : Base
     const mask_type *mask_pixel   = &this->mask_data[mask_offset];
     gint             x;
 
+    if (row_kernel_paint_mask_to_paint_buf_alpha (paint_pixel, mask_pixel,
+                                                  params->paint_opacity,
+                                                  rect->width))
+      {
+        return;
+      }
+
     for (x = 0; x < rect->width; x++)
       {
         paint_pixel[3] *= value_to_float (*mask_pixel) * params->paint_opacity;
@@ -2263,3 +2407,30 @@ gimp_paint_core_loops_process (const GimpPaintCoreLoopsParams *params,
     dispatch_do_layer_blend,
     dispatch_mask_components);
 }
+
+/* gimp_paint_core_loops_init():
+ *
+ * Selects the row kernels for the CPU.  Called once, by gimp_paint_init().
+ */
+
+void
+gimp_paint_core_loops_init (void)
+{
+#if COMPILE_AVX2_INTRINISICS
+  if ((gimp_cpu_accel_get_support () & (GIMP_CPU_ACCEL_X86_AVX2 |
+                                        GIMP_CPU_ACCEL_X86_FMA)) ==
+      (GIMP_CPU_ACCEL_X86_AVX2 | GIMP_CPU_ACCEL_X86_FMA))
+    {
+      row_kernels.combine_paint_mask_u8 =
+        gimp_paint_core_loops_combine_paint_mask_u8_avx2;
+      row_kernels.combine_paint_mask_float =
+        gimp_paint_core_loops_combine_paint_mask_float_avx2;
+      row_kernels.canvas_to_paint_buf_alpha =
+        gimp_paint_core_loops_canvas_to_paint_buf_alpha_avx2;
+      row_kernels.paint_mask_to_paint_buf_alpha_u8 =
+        gimp_paint_core_loops_paint_mask_to_paint_buf_alpha_u8_avx2;
+      row_kernels.paint_mask_to_paint_buf_alpha_float =
+        gimp_paint_core_loops_paint_mask_to_paint_buf_alpha_float_avx2;
+    }
+#endif /* COMPILE_AVX2_INTRINISICS */
+}
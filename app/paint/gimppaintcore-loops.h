@@ -63,6 +63,8 @@ typedef struct
 } GimpPaintCoreLoopsParams;
 
 
+void   gimp_paint_core_loops_init    (void);
+
 void   gimp_paint_core_loops_process (const GimpPaintCoreLoopsParams *params,
                                       GimpPaintCoreLoopsAlgorithm     algorithms);
 
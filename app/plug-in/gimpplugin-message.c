@@ -36,6 +36,7 @@
 #include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
+#include "core/gimp-utils.h"
 #include "core/gimpdrawable.h"
 #include "core/gimpdrawable-shadow.h"
 
@@ -63,6 +64,8 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static void gimp_plug_in_handle_drawable_map     (GimpPlugIn      *plug_in,
+                                                  GPDrawableMapReq *request);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
@@ -160,6 +163,28 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_DRAWABLE_MAP_REQ:
+      gimp_plug_in_handle_drawable_map (plug_in, msg->data);
+      break;
+
+    case GP_DRAWABLE_MAP:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "sent a DRAWABLE_MAP message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
+
+    case GP_DRAWABLE_MAP_ACK:
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "sent a DRAWABLE_MAP_ACK message.  This should not happen.",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file));
+      gimp_plug_in_close (plug_in, TRUE);
+      break;
     }
 }
 
@@ -204,6 +229,7 @@ gimp_plug_in_handle_tile_put (GimpPlugIn *plug_in,
   tile_data.height      = 0;
   tile_data.use_shm     = (plug_in->manager->shm != NULL);
   tile_data.data        = NULL;
+  tile_data.n_tiles     = 0;
 
   if (! gp_tile_data_write (plug_in->my_write, &tile_data, plug_in))
     {
@@ -350,7 +376,11 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   GeglBuffer      *buffer;
   const Babl      *format;
   GeglRectangle    tile_rect;
-  gint             tile_size;
+  GeglRectangle    region_rect;
+  guchar          *data;
+  gint             bpp;
+  gint             n_tiles;
+  gint             i;
 
   drawable = (GimpDrawable *) gimp_item_get_by_id (plug_in->manager->gimp,
                                                    request->drawable_id);
@@ -407,30 +437,66 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
     }
 
   format = gegl_buffer_get_format (buffer);
+  bpp    = babl_format_get_bytes_per_pixel (format);
+
+  /*  extend the request to the following tiles of the same tile row,
+   *  so the plug-in can read ahead without a round trip per tile
+   */
+  n_tiles     = CLAMP (request->n_tiles, 1, GP_TILE_REGION_MAX_TILES);
+  region_rect = tile_rect;
+
+  for (i = 1; i < n_tiles; i++)
+    {
+      GeglRectangle rect;
+
+      if (! gimp_gegl_buffer_get_tile_rect (buffer,
+                                            GIMP_PLUG_IN_TILE_WIDTH,
+                                            GIMP_PLUG_IN_TILE_HEIGHT,
+                                            request->tile_num + i,
+                                            &rect) ||
+          rect.y != region_rect.y)
+        {
+          break;
+        }
+
+      region_rect.width += rect.width;
+    }
 
-  tile_size = (babl_format_get_bytes_per_pixel (format) *
-               tile_rect.width * tile_rect.height);
+  n_tiles = i;
 
   tile_data.drawable_id = request->drawable_id;
   tile_data.tile_num    = request->tile_num;
   tile_data.shadow      = request->shadow;
-  tile_data.bpp         = babl_format_get_bytes_per_pixel (format);
-  tile_data.width       = tile_rect.width;
-  tile_data.height      = tile_rect.height;
+  tile_data.bpp         = bpp;
+  tile_data.width       = region_rect.width;
+  tile_data.height      = region_rect.height;
   tile_data.use_shm     = (plug_in->manager->shm != NULL);
+  tile_data.data        = NULL;
+  tile_data.n_tiles     = n_tiles;
 
   if (tile_data.use_shm)
     {
-      gegl_buffer_get (buffer, &tile_rect, 1.0, format,
-                       gimp_plug_in_shm_get_addr (plug_in->manager->shm),
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      data = gimp_plug_in_shm_get_addr (plug_in->manager->shm);
     }
   else
     {
-      tile_data.data = g_malloc (tile_size);
+      tile_data.data = g_malloc (region_rect.width * region_rect.height * bpp);
+
+      data = tile_data.data;
+    }
+
+  /*  every tile is stored contiguously, one after the other  */
+  for (i = 0; i < n_tiles; i++)
+    {
+      gimp_gegl_buffer_get_tile_rect (buffer,
+                                      GIMP_PLUG_IN_TILE_WIDTH,
+                                      GIMP_PLUG_IN_TILE_HEIGHT,
+                                      request->tile_num + i,
+                                      &tile_rect);
 
       gegl_buffer_get (buffer, &tile_rect, 1.0, format,
-                       tile_data.data,
+                       data + (gsize) (tile_rect.x - region_rect.x) *
+                              region_rect.height * bpp,
                        GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
     }
 
@@ -438,10 +504,13 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
                     "%s: ERROR", G_STRFUNC);
+      g_free (tile_data.data);
       gimp_plug_in_close (plug_in, TRUE);
       return;
     }
 
+  g_free (tile_data.data);
+
   if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
     {
       gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
@@ -461,6 +530,92 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   gimp_wire_destroy (&msg);
 }
 
+static void
+gimp_plug_in_handle_drawable_map (GimpPlugIn       *plug_in,
+                                  GPDrawableMapReq *request)
+{
+  GPDrawableMap    drawable_map;
+  GimpWireMessage  msg;
+  GimpDrawable    *drawable;
+  GeglBuffer      *buffer;
+
+  g_return_if_fail (request != NULL);
+
+  drawable = (GimpDrawable *) gimp_item_get_by_id (plug_in->manager->gimp,
+                                                   request->drawable_id);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "tried mapping invalid drawable %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    request->drawable_id);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-in \"%s\"\n(%s)\n\n"
+                    "tried mapping drawable %d which was removed "
+                    "from the image (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_file_get_utf8_name (plug_in->file),
+                    request->drawable_id);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  buffer = gimp_drawable_get_buffer (drawable);
+
+  drawable_map.drawable_id = request->drawable_id;
+  drawable_map.bpp         = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (buffer));
+  drawable_map.width       = gegl_buffer_get_width  (buffer);
+  drawable_map.height      = gegl_buffer_get_height (buffer);
+  drawable_map.pid         = gimp_get_pid ();
+
+  /*  note that this copies the whole drawable, the plug-in maps the
+   *  copy instead of fetching the tiles one at a time
+   */
+  drawable_map.fd          = gimp_plug_in_shm_snapshot_buffer (buffer);
+
+  if (! gp_drawable_map_write (plug_in->my_write, &drawable_map, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_shm_snapshot_free (drawable_map.fd);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  if (drawable_map.fd == -1)
+    return;
+
+  /*  keep the snapshot open until the plug-in has mapped it  */
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_shm_snapshot_free (drawable_map.fd);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  gimp_plug_in_shm_snapshot_free (drawable_map.fd);
+
+  if (msg.type != GP_DRAWABLE_MAP_ACK)
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "expected drawable map ack and received: %d", msg.type);
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  gimp_wire_destroy (&msg);
+}
+
 static void
 gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
                                 GimpPlugInProcFrame *proc_frame,
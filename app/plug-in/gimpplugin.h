@@ -25,7 +25,7 @@
 #include "gimppluginprocframe.h"
 
 
-#define WRITE_BUFFER_SIZE  512
+#define WRITE_BUFFER_SIZE  8192
 
 
 #define GIMP_TYPE_PLUG_IN            (gimp_plug_in_get_type ())
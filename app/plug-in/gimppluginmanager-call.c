@@ -55,6 +55,26 @@
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  GimpPlugInManager      *manager;
+  GimpContext            *context;
+  GimpPlugInCallMode      call_mode;
+  GMainContext           *main_context;
+  gint                    n_running;
+  GimpPlugInCallDoneFunc  done_func;
+  gpointer                user_data;
+} CallParallel;
+
+typedef struct
+{
+  CallParallel  *call;
+  GimpPlugInDef *plug_in_def;
+  GimpPlugIn    *plug_in;
+  gint64         start_time;
+} CallParallelPlugIn;
+
+
 static void
 gimp_allow_set_foreground_window (GimpPlugIn *plug_in)
 {
@@ -146,6 +166,149 @@ gimp_plug_in_manager_call_init (GimpPlugInManager *manager,
     }
 }
 
+static void
+gimp_plug_in_manager_call_parallel_done (CallParallelPlugIn *data)
+{
+  CallParallel *call = data->call;
+
+  if (call->done_func)
+    call->done_func (data->plug_in_def,
+                     g_get_monotonic_time () - data->start_time,
+                     call->user_data);
+
+  g_clear_object (&data->plug_in);
+  g_slice_free (CallParallelPlugIn, data);
+}
+
+static gboolean
+gimp_plug_in_manager_call_parallel_recv (GIOChannel         *channel,
+                                         GIOCondition        cond,
+                                         CallParallelPlugIn *data)
+{
+  GimpPlugIn      *plug_in = data->plug_in;
+  GimpWireMessage  msg;
+
+#ifdef G_OS_WIN32
+  /* see gimp_plug_in_recv_message() */
+  if (cond == 0)
+    return G_SOURCE_CONTINUE;
+#endif
+
+  /*  same as the synchronous loop in gimp_plug_in_manager_call_query(),
+   *  one message at a time
+   */
+  if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+    {
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+  else
+    {
+      gimp_plug_in_handle_message (plug_in, &msg);
+      gimp_wire_destroy (&msg);
+    }
+
+  if (plug_in->open)
+    return G_SOURCE_CONTINUE;
+
+  data->call->n_running--;
+
+  gimp_plug_in_manager_call_parallel_done (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gimp_plug_in_manager_call_parallel_start (CallParallel  *call,
+                                          GimpPlugInDef *plug_in_def)
+{
+  CallParallelPlugIn *data;
+
+  data = g_slice_new0 (CallParallelPlugIn);
+
+  data->call        = call;
+  data->plug_in_def = plug_in_def;
+  data->start_time  = g_get_monotonic_time ();
+
+  data->plug_in = gimp_plug_in_new (call->manager, call->context, NULL,
+                                    NULL, plug_in_def->file);
+
+  if (data->plug_in)
+    {
+      data->plug_in->plug_in_def = plug_in_def;
+
+      if (gimp_plug_in_open (data->plug_in, call->call_mode, TRUE))
+        {
+          GSource *source;
+
+          source = g_io_create_watch (data->plug_in->my_read,
+                                      G_IO_IN  | G_IO_PRI |
+                                      G_IO_ERR | G_IO_HUP);
+
+          g_source_set_callback (source,
+                                 (GSourceFunc) gimp_plug_in_manager_call_parallel_recv,
+                                 data, NULL);
+
+          g_source_attach (source, call->main_context);
+          g_source_unref (source);
+
+          call->n_running++;
+
+          return;
+        }
+    }
+
+  gimp_plug_in_manager_call_parallel_done (data);
+}
+
+void
+gimp_plug_in_manager_call_parallel (GimpPlugInManager      *manager,
+                                    GimpContext            *context,
+                                    GSList                 *plug_in_defs,
+                                    GimpPlugInCallMode      call_mode,
+                                    gint                    max_running,
+                                    GimpPlugInCallDoneFunc  done_func,
+                                    gpointer                user_data)
+{
+  CallParallel  call = { 0, };
+  GSList       *list;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
+  g_return_if_fail (call_mode == GIMP_PLUG_IN_CALL_QUERY ||
+                    call_mode == GIMP_PLUG_IN_CALL_INIT);
+
+  /*  a plug-in being debugged would have to wait for the others  */
+  if (manager->debug)
+    max_running = 1;
+
+  call.manager      = manager;
+  call.context      = context;
+  call.call_mode    = call_mode;
+  call.main_context = g_main_context_new ();
+  call.done_func    = done_func;
+  call.user_data    = user_data;
+
+  /*  the plug-ins' messages are dispatched from a private main
+   *  context, so that nothing else is dispatched while we wait
+   */
+  list = plug_in_defs;
+
+  while (list || call.n_running > 0)
+    {
+      while (list && call.n_running < MAX (max_running, 1))
+        {
+          gimp_plug_in_manager_call_parallel_start (&call, list->data);
+
+          list = g_slist_next (list);
+        }
+
+      if (call.n_running > 0)
+        g_main_context_iteration (call.main_context, TRUE);
+    }
+
+  g_main_context_unref (call.main_context);
+}
+
 GimpValueArray *
 gimp_plug_in_manager_call_run (GimpPlugInManager   *manager,
                                GimpContext         *context,
@@ -25,6 +25,11 @@
 #endif
 
 
+typedef void (* GimpPlugInCallDoneFunc) (GimpPlugInDef *plug_in_def,
+                                         gint64         elapsed,
+                                         gpointer       user_data);
+
+
 /*  Call the plug-in's query() function
  */
 void             gimp_plug_in_manager_call_query    (GimpPlugInManager      *manager,
@@ -37,6 +42,17 @@ void             gimp_plug_in_manager_call_init     (GimpPlugInManager      *man
                                                      GimpContext            *context,
                                                      GimpPlugInDef          *plug_in_def);
 
+/*  Call the query() or init() function of a list of plug-ins, running
+ *  at most @max_running of them at the same time
+ */
+void             gimp_plug_in_manager_call_parallel (GimpPlugInManager      *manager,
+                                                     GimpContext            *context,
+                                                     GSList                 *plug_in_defs,
+                                                     GimpPlugInCallMode      call_mode,
+                                                     gint                    max_running,
+                                                     GimpPlugInCallDoneFunc  done_func,
+                                                     gpointer                user_data);
+
 /*  Run a plug-in as if it were a procedure database procedure
  */
 GimpValueArray * gimp_plug_in_manager_call_run      (GimpPlugInManager      *manager,
@@ -51,6 +51,16 @@
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  GimpPlugInManager  *manager;
+  GimpPlugInCallMode  call_mode;
+  GimpInitStatusFunc  status_callback;
+  gint                nth;
+  gint                n_plugins;
+} CallAllData;
+
+
 static void    gimp_plug_in_manager_search            (GimpPlugInManager    *manager,
                                                        GimpInitStatusFunc    status_callback);
 static void    gimp_plug_in_manager_search_directory  (GimpPlugInManager    *manager,
@@ -65,6 +75,13 @@ static void    gimp_plug_in_manager_query_new         (GimpPlugInManager    *man
 static void    gimp_plug_in_manager_init_plug_ins     (GimpPlugInManager    *manager,
                                                        GimpContext          *context,
                                                        GimpInitStatusFunc    status_callback);
+static void    gimp_plug_in_manager_call_all          (GimpPlugInManager    *manager,
+                                                       GimpContext          *context,
+                                                       GimpPlugInCallMode    call_mode,
+                                                       GimpInitStatusFunc    status_callback);
+static void    gimp_plug_in_manager_call_done         (GimpPlugInDef        *plug_in_def,
+                                                       gint64                elapsed,
+                                                       gpointer              user_data);
 static void    gimp_plug_in_manager_run_extensions    (GimpPlugInManager    *manager,
                                                        GimpContext          *context,
                                                        GimpInitStatusFunc    status_callback);
@@ -79,7 +96,7 @@ static void    gimp_plug_in_manager_add_to_db         (GimpPlugInManager    *man
 static void    gimp_plug_in_manager_sort_file_procs   (GimpPlugInManager    *manager);
 static gint    gimp_plug_in_manager_file_proc_compare (gconstpointer         a,
                                                        gconstpointer         b,
-                                                       gpointer              data);
+                                                       gpointer              user_data);
 
 
 
@@ -460,31 +477,11 @@ gimp_plug_in_manager_query_new (GimpPlugInManager  *manager,
 
   if (n_plugins)
     {
-      gint nth;
-
       manager->write_pluginrc = TRUE;
 
-      for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
-        {
-          GimpPlugInDef *plug_in_def = list->data;
-
-          if (plug_in_def->needs_query)
-            {
-              gchar *basename;
-
-              basename =
-                g_path_get_basename (gimp_file_get_utf8_name (plug_in_def->file));
-              status_callback (NULL, basename,
-                               (gdouble) nth++ / (gdouble) n_plugins);
-              g_free (basename);
-
-              if (manager->gimp->be_verbose)
-                g_print ("Querying plug-in: '%s'\n",
-                         gimp_file_get_utf8_name (plug_in_def->file));
-
-              gimp_plug_in_manager_call_query (manager, context, plug_in_def);
-            }
-        }
+      gimp_plug_in_manager_call_all (manager, context,
+                                     GIMP_PLUG_IN_CALL_QUERY,
+                                     status_callback);
     }
 
   status_callback (NULL, "", 1.0);
@@ -511,32 +508,77 @@ gimp_plug_in_manager_init_plug_ins (GimpPlugInManager  *manager,
 
   if (n_plugins)
     {
-      gint nth;
-
-      for (list = manager->plug_in_defs, nth = 0; list; list = list->next)
-        {
-          GimpPlugInDef *plug_in_def = list->data;
+      gimp_plug_in_manager_call_all (manager, context,
+                                     GIMP_PLUG_IN_CALL_INIT,
+                                     status_callback);
+    }
 
-          if (plug_in_def->has_init)
-            {
-              gchar *basename;
+  status_callback (NULL, "", 1.0);
+}
 
-              basename =
-                g_path_get_basename (gimp_file_get_utf8_name (plug_in_def->file));
-              status_callback (NULL, basename,
-                               (gdouble) nth++ / (gdouble) n_plugins);
-              g_free (basename);
+/* calls the query() or init() function of all plug-ins which need it,
+ * several of them at once
+ */
+static void
+gimp_plug_in_manager_call_all (GimpPlugInManager  *manager,
+                               GimpContext        *context,
+                               GimpPlugInCallMode  call_mode,
+                               GimpInitStatusFunc  status_callback)
+{
+  CallAllData  data = { 0, };
+  GSList      *plug_in_defs = NULL;
+  GSList      *list;
 
-              if (manager->gimp->be_verbose)
-                g_print ("Initializing plug-in: '%s'\n",
-                         gimp_file_get_utf8_name (plug_in_def->file));
+  for (list = manager->plug_in_defs; list; list = list->next)
+    {
+      GimpPlugInDef *plug_in_def = list->data;
 
-              gimp_plug_in_manager_call_init (manager, context, plug_in_def);
-            }
+      if (call_mode == GIMP_PLUG_IN_CALL_QUERY ?
+          plug_in_def->needs_query : plug_in_def->has_init)
+        {
+          plug_in_defs = g_slist_prepend (plug_in_defs, plug_in_def);
         }
     }
 
-  status_callback (NULL, "", 1.0);
+  plug_in_defs = g_slist_reverse (plug_in_defs);
+
+  data.manager         = manager;
+  data.call_mode       = call_mode;
+  data.status_callback = status_callback;
+  data.n_plugins       = g_slist_length (plug_in_defs);
+
+  /*  the plug-ins only add their procedures to their own plug-in def,
+   *  which are added to the PDB later, in order, so it doesn't matter
+   *  in which order they finish
+   */
+  gimp_plug_in_manager_call_parallel (manager, context, plug_in_defs,
+                                      call_mode,
+                                      GIMP_GEGL_CONFIG (manager->gimp->config)->num_processors,
+                                      gimp_plug_in_manager_call_done,
+                                      &data);
+
+  g_slist_free (plug_in_defs);
+}
+
+static void
+gimp_plug_in_manager_call_done (GimpPlugInDef *plug_in_def,
+                                gint64         elapsed,
+                                gpointer       user_data)
+{
+  CallAllData *data = user_data;
+  gchar       *basename;
+
+  basename = g_path_get_basename (gimp_file_get_utf8_name (plug_in_def->file));
+  data->status_callback (NULL, basename,
+                         (gdouble) ++data->nth / (gdouble) data->n_plugins);
+  g_free (basename);
+
+  if (data->manager->gimp->be_verbose)
+    g_print ("%s plug-in: '%s' (%.3f s)\n",
+             data->call_mode == GIMP_PLUG_IN_CALL_QUERY ?
+             "Queried" : "Initialized",
+             gimp_file_get_utf8_name (plug_in_def->file),
+             (gdouble) elapsed / G_TIME_SPAN_SECOND);
 }
 
 /* run automatically started extensions */
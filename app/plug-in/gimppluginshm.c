@@ -17,6 +17,8 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE  /* for memfd_create() */
+
 #include "config.h"
 
 #include <sys/types.h>
@@ -44,6 +46,18 @@
 
 #endif /* USE_POSIX_SHM */
 
+/*  plug-ins open drawable snapshots through our /proc/<pid>/fd, which
+ *  only works like that on Linux
+ */
+#if defined(HAVE_MEMFD_CREATE) && defined(__linux__)
+#define USE_MEMFD_SNAPSHOT 1
+#endif
+
+#ifdef USE_MEMFD_SNAPSHOT
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 #include <gio/gio.h>
 #include <gegl.h>
 
@@ -62,6 +76,9 @@
 
 #endif /* G_OS_WIN32 || G_WITH_CYGWIN */
 
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
 #include "plug-in-types.h"
 
 #include "core/gimp-utils.h"
@@ -71,7 +88,9 @@
 #include "gimp-log.h"
 
 
-#define TILE_MAP_SIZE (GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * 32)
+/*  large enough for a full region of GP_TILE_REGION_MAX_TILES tiles  */
+#define TILE_MAP_SIZE (GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * 32 * \
+                       GP_TILE_REGION_MAX_TILES)
 
 #define ERRMSG_SHM_DISABLE "Disabling shared memory tile transport"
 
@@ -305,3 +324,109 @@ gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
 
   return shm->shm_addr;
 }
+
+/*  Copies @buffer into a new anonymous memory file, tile by tile, every
+ *  tile padded to GIMP_PLUG_IN_TILE_WIDTH x GIMP_PLUG_IN_TILE_HEIGHT
+ *  pixels, so that a plug-in can map the snapshot and use its tiles
+ *  in place. Returns the file descriptor, or -1 if not supported.
+ */
+gint
+gimp_plug_in_shm_snapshot_buffer (GeglBuffer *buffer)
+{
+#ifdef USE_MEMFD_SNAPSHOT
+  const Babl *format;
+  guchar     *addr;
+  gint        fd;
+  gint        width;
+  gint        height;
+  gint        bpp;
+  gint        ntile_rows;
+  gint        ntile_cols;
+  gsize       tile_size;
+  gsize       size;
+  gint        row;
+  gint        col;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), -1);
+
+  format     = gegl_buffer_get_format (buffer);
+  width      = gegl_buffer_get_width  (buffer);
+  height     = gegl_buffer_get_height (buffer);
+  bpp        = babl_format_get_bytes_per_pixel (format);
+  ntile_rows = (height + GIMP_PLUG_IN_TILE_HEIGHT - 1) / GIMP_PLUG_IN_TILE_HEIGHT;
+  ntile_cols = (width  + GIMP_PLUG_IN_TILE_WIDTH  - 1) / GIMP_PLUG_IN_TILE_WIDTH;
+
+  tile_size = (gsize) GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * bpp;
+  size      = tile_size * ntile_rows * ntile_cols;
+
+  if (size == 0)
+    return -1;
+
+  fd = memfd_create ("gimp-drawable", MFD_CLOEXEC);
+
+  if (fd == -1)
+    {
+      GIMP_LOG (SHM, "memfd_create() failed: %s", g_strerror (errno));
+
+      return -1;
+    }
+
+  if (ftruncate (fd, size) == -1)
+    {
+      GIMP_LOG (SHM, "ftruncate() failed: %s", g_strerror (errno));
+
+      close (fd);
+
+      return -1;
+    }
+
+  addr = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  if (addr == MAP_FAILED)
+    {
+      GIMP_LOG (SHM, "mmap() failed: %s", g_strerror (errno));
+
+      close (fd);
+
+      return -1;
+    }
+
+  for (row = 0; row < ntile_rows; row++)
+    {
+      for (col = 0; col < ntile_cols; col++)
+        {
+          GeglRectangle rect;
+
+          gegl_rectangle_intersect (&rect,
+                                    GEGL_RECTANGLE (col * GIMP_PLUG_IN_TILE_WIDTH,
+                                                    row * GIMP_PLUG_IN_TILE_HEIGHT,
+                                                    GIMP_PLUG_IN_TILE_WIDTH,
+                                                    GIMP_PLUG_IN_TILE_HEIGHT),
+                                    GEGL_RECTANGLE (0, 0, width, height));
+
+          gegl_buffer_get (buffer, &rect, 1.0, format,
+                           addr + (row * ntile_cols + col) * tile_size,
+                           GIMP_PLUG_IN_TILE_WIDTH * bpp,
+                           GEGL_ABYSS_NONE);
+        }
+    }
+
+  munmap (addr, size);
+
+  GIMP_LOG (SHM, "created drawable snapshot fd = %d (%" G_GSIZE_FORMAT " bytes)",
+            fd, size);
+
+  return fd;
+#else
+  return -1;
+#endif
+}
+
+void
+gimp_plug_in_shm_snapshot_free (gint fd)
+{
+#ifdef USE_MEMFD_SNAPSHOT
+  if (fd != -1)
+    close (fd);
+#endif
+}
@@ -27,5 +27,8 @@ void            gimp_plug_in_shm_free     (GimpPlugInShm *shm);
 gint            gimp_plug_in_shm_get_id   (GimpPlugInShm *shm);
 guchar        * gimp_plug_in_shm_get_addr (GimpPlugInShm *shm);
 
+gint            gimp_plug_in_shm_snapshot_buffer (GeglBuffer *buffer);
+void            gimp_plug_in_shm_snapshot_free   (gint        fd);
+
 
 #endif /* __GIMP_PLUG_IN_SHM_H__ */
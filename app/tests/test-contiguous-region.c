@@ -0,0 +1,306 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+#include "core/gimppickable.h"
+#include "core/gimppickable-contiguous-region.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+/*  the image size; run with "-m perf" to get meaningful timings of the
+ *  tiled implementation against the sampler-based one
+ */
+#define GIMP_TEST_IMAGE_SIZE      (g_test_perf () ? 4096 : 300)
+
+#define ADD_IMAGE_TEST(function) \
+  g_test_add ("/gimp-contiguous-region/" #function, \
+              GimpTestFixture, \
+              gimp, \
+              gimp_test_image_setup, \
+              function, \
+              gimp_test_image_teardown);
+
+
+typedef struct
+{
+  GimpImage *image;
+  GimpLayer *layer;
+} GimpTestFixture;
+
+typedef enum
+{
+  PATTERN_NOISE,
+  PATTERN_GRADIENT
+} Pattern;
+
+
+static void
+gimp_test_image_setup (GimpTestFixture *fixture,
+                       gconstpointer    data)
+{
+  Gimp *gimp = GIMP (data);
+
+  fixture->image = gimp_image_new (gimp,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   GIMP_RGB,
+                                   GIMP_PRECISION_U8_NON_LINEAR);
+
+  fixture->layer = gimp_layer_new (fixture->image,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   GIMP_TEST_IMAGE_SIZE,
+                                   babl_format ("R'G'B'A u8"),
+                                   "Test Layer",
+                                   GIMP_OPACITY_OPAQUE,
+                                   GIMP_LAYER_MODE_NORMAL);
+
+  gimp_image_add_layer (fixture->image,
+                        fixture->layer,
+                        GIMP_IMAGE_ACTIVE_PARENT,
+                        0,
+                        FALSE);
+}
+
+static void
+gimp_test_image_teardown (GimpTestFixture *fixture,
+                          gconstpointer    data)
+{
+  g_object_unref (fixture->image);
+}
+
+static void
+gimp_test_fill_layer (GimpTestFixture *fixture,
+                      Pattern          pattern)
+{
+  GeglBuffer *buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (fixture->layer));
+  gint        size   = GIMP_TEST_IMAGE_SIZE;
+  guint8     *data;
+  guint32     seed   = 1;
+  gint        x, y;
+
+  data = g_new (guint8, size * size * 4);
+
+  for (y = 0; y < size; y++)
+    {
+      guint8 *d = data + y * size * 4;
+
+      for (x = 0; x < size; x++)
+        {
+          guint8 value;
+
+          switch (pattern)
+            {
+            case PATTERN_NOISE:
+              /*  mostly open, with enough walls to make for many short,
+               *  ragged segments
+               */
+              seed  = seed * 1103515245 + 12345;
+              value = ((seed >> 16) % 100) < 35 ? 0 : 255;
+              break;
+
+            case PATTERN_GRADIENT:
+            default:
+              value = ((x + y) / 4) & 0xff;
+              break;
+            }
+
+          d[0] = value;
+          d[1] = value;
+          d[2] = value;
+          d[3] = 255;
+
+          d += 4;
+        }
+    }
+
+  gegl_buffer_set (buffer, GEGL_RECTANGLE (0, 0, size, size), 0,
+                   babl_format ("R'G'B'A u8"), data, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (data);
+}
+
+static GeglBuffer *
+gimp_test_contiguous_region (GimpTestFixture *fixture,
+                             gboolean         sampled,
+                             gboolean         antialias,
+                             gfloat           threshold,
+                             gboolean         diagonal_neighbors)
+{
+  GeglBuffer *(* by_seed) (GimpPickable        *pickable,
+                           gboolean             antialias,
+                           gfloat               threshold,
+                           gboolean             select_transparent,
+                           GimpSelectCriterion  select_criterion,
+                           gboolean             diagonal_neighbors,
+                           gint                 x,
+                           gint                 y);
+  GeglBuffer  *mask;
+  gdouble      elapsed;
+
+  if (sampled)
+    by_seed = gimp_pickable_contiguous_region_by_seed_sampled;
+  else
+    by_seed = gimp_pickable_contiguous_region_by_seed;
+
+  g_test_timer_start ();
+
+  mask = by_seed (GIMP_PICKABLE (fixture->layer),
+                  antialias,
+                  threshold,
+                  FALSE,
+                  GIMP_SELECT_CRITERION_COMPOSITE,
+                  diagonal_neighbors,
+                  GIMP_TEST_IMAGE_SIZE / 2,
+                  GIMP_TEST_IMAGE_SIZE / 2);
+
+  elapsed = g_test_timer_elapsed ();
+
+  g_test_message ("%s: %.3f s", sampled ? "sampled" : "tiled", elapsed);
+
+  return mask;
+}
+
+/*  checks that both implementations produce the same mask  */
+static void
+gimp_test_contiguous_region_compare (GimpTestFixture *fixture,
+                                     gboolean         antialias,
+                                     gfloat           threshold,
+                                     gboolean         diagonal_neighbors)
+{
+  GeglBuffer    *sampled_mask;
+  GeglBuffer    *tiled_mask;
+  GeglRectangle  rect = { 0, 0, GIMP_TEST_IMAGE_SIZE, GIMP_TEST_IMAGE_SIZE };
+  gfloat        *sampled_data;
+  gfloat        *tiled_data;
+  gint           n_selected = 0;
+  gint           i;
+
+  sampled_mask = gimp_test_contiguous_region (fixture, TRUE,
+                                              antialias, threshold,
+                                              diagonal_neighbors);
+  tiled_mask   = gimp_test_contiguous_region (fixture, FALSE,
+                                              antialias, threshold,
+                                              diagonal_neighbors);
+
+  sampled_data = g_new (gfloat, rect.width * rect.height);
+  tiled_data   = g_new (gfloat, rect.width * rect.height);
+
+  gegl_buffer_get (sampled_mask, &rect, 1.0, babl_format ("Y float"),
+                   sampled_data, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (tiled_mask, &rect, 1.0, babl_format ("Y float"),
+                   tiled_data, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  for (i = 0; i < rect.width * rect.height; i++)
+    {
+      if (tiled_data[i] != 0.0f)
+        n_selected++;
+    }
+
+  /*  make sure the test is actually selecting something beyond the seed  */
+  g_assert_cmpint (n_selected, >, 1);
+
+  g_assert (memcmp (sampled_data, tiled_data,
+                    rect.width * rect.height * sizeof (gfloat)) == 0);
+
+  g_free (sampled_data);
+  g_free (tiled_data);
+
+  g_object_unref (sampled_mask);
+  g_object_unref (tiled_mask);
+}
+
+/**
+ * noise:
+ * @fixture:
+ * @data:
+ *
+ * Test that both implementations agree on an image consisting of many
+ * short segments, with and without diagonal neighbors.
+ **/
+static void
+noise (GimpTestFixture *fixture,
+       gconstpointer    data)
+{
+  gimp_test_fill_layer (fixture, PATTERN_NOISE);
+
+  gimp_test_contiguous_region_compare (fixture, FALSE, 0.5, FALSE);
+  gimp_test_contiguous_region_compare (fixture, FALSE, 0.5, TRUE);
+}
+
+/**
+ * gradient:
+ * @fixture:
+ * @data:
+ *
+ * Test that both implementations agree on an antialiased selection of
+ * a gradient, which ends in the middle of tiles.
+ **/
+static void
+gradient (GimpTestFixture *fixture,
+          gconstpointer    data)
+{
+  gimp_test_fill_layer (fixture, PATTERN_GRADIENT);
+
+  gimp_test_contiguous_region_compare (fixture, TRUE, 0.2, FALSE);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_IMAGE_TEST (noise);
+  ADD_IMAGE_TEST (gradient);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
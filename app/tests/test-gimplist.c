@@ -0,0 +1,279 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib-object.h>
+
+#include "core/core-types.h"
+
+#include "core/gimplist.h"
+
+
+#define ADD_TEST(function) \
+  g_test_add ("/gimplist/" #function, \
+              GimpTestFixture, \
+              NULL, \
+              gimp_test_list_setup, \
+              gimp_test_list_ ## function, \
+              gimp_test_list_teardown);
+
+#define N_OBJECTS 32
+
+
+typedef struct
+{
+  GimpContainer *list;
+  GimpContainer *indexed_list;
+} GimpTestFixture;
+
+
+static void
+gimp_test_list_setup (GimpTestFixture *fixture,
+                      gconstpointer    data)
+{
+  fixture->list         = gimp_list_new (GIMP_TYPE_OBJECT, TRUE);
+  fixture->indexed_list = gimp_list_new (GIMP_TYPE_OBJECT, TRUE);
+
+  gimp_list_set_indexed (GIMP_LIST (fixture->indexed_list), TRUE);
+}
+
+static void
+gimp_test_list_teardown (GimpTestFixture *fixture,
+                         gconstpointer    data)
+{
+  g_clear_object (&fixture->list);
+  g_clear_object (&fixture->indexed_list);
+}
+
+static void
+gimp_test_list_add_objects (GimpTestFixture *f,
+                            gint             n_objects,
+                            const gchar     *name)
+{
+  gint i;
+
+  for (i = 0; i < n_objects; i++)
+    {
+      GimpObject *object = g_object_new (GIMP_TYPE_OBJECT,
+                                         "name", name,
+                                         NULL);
+
+      gimp_container_add (f->list, object);
+      g_object_unref (object);
+
+      object = g_object_new (GIMP_TYPE_OBJECT,
+                             "name", name,
+                             NULL);
+
+      gimp_container_add (f->indexed_list, object);
+      g_object_unref (object);
+    }
+}
+
+/*  checks that the indexed list agrees with the plain one, and with
+ *  its own queue
+ */
+static void
+gimp_test_list_check (GimpTestFixture *f)
+{
+  GList *iter;
+  GList *indexed_iter;
+  gint   i;
+
+  g_assert_cmpint (gimp_container_get_n_children (f->list), ==,
+                   gimp_container_get_n_children (f->indexed_list));
+
+  for (iter         = GIMP_LIST (f->list)->queue->head,
+       indexed_iter = GIMP_LIST (f->indexed_list)->queue->head, i = 0;
+       iter && indexed_iter;
+       iter         = g_list_next (iter),
+       indexed_iter = g_list_next (indexed_iter), i++)
+    {
+      GimpObject *object = indexed_iter->data;
+
+      g_assert_cmpstr (gimp_object_get_name (iter->data), ==,
+                       gimp_object_get_name (object));
+
+      g_assert (gimp_container_get_child_by_index (f->indexed_list, i) ==
+                object);
+      g_assert_cmpint (gimp_container_get_child_index (f->indexed_list,
+                                                       object), ==, i);
+      g_assert (gimp_container_get_child_by_name (f->indexed_list,
+                                                  gimp_object_get_name (object)) ==
+                object);
+      g_assert (gimp_container_have (f->indexed_list, object));
+    }
+
+  g_assert (iter == NULL && indexed_iter == NULL);
+
+  g_assert (gimp_container_get_child_by_index (f->indexed_list, i) == NULL);
+}
+
+/**
+ * gimp_test_list_add:
+ *
+ * Test that adding children keeps the index in sync, and that names
+ * are uniquefied the same way.
+ **/
+static void
+gimp_test_list_add (GimpTestFixture *f,
+                    gconstpointer    data)
+{
+  gimp_test_list_add_objects (f, N_OBJECTS, "Layer");
+
+  gimp_test_list_check (f);
+
+  g_assert (gimp_container_get_child_by_name (f->indexed_list,
+                                              "Layer #1") != NULL);
+  g_assert (gimp_container_get_child_by_name (f->indexed_list,
+                                              "Layer #99") == NULL);
+}
+
+/**
+ * gimp_test_list_remove_and_reorder:
+ *
+ * Test that removing and reordering children keeps the index in sync.
+ **/
+static void
+gimp_test_list_remove_and_reorder (GimpTestFixture *f,
+                                   gconstpointer    data)
+{
+  gint i;
+
+  gimp_test_list_add_objects (f, N_OBJECTS, "Layer");
+
+  for (i = 0; i < N_OBJECTS / 2; i++)
+    {
+      gint index = (i * 7) % gimp_container_get_n_children (f->list);
+
+      gimp_container_reorder (f->list,
+                              gimp_container_get_child_by_index (f->list,
+                                                                 index),
+                              i);
+      gimp_container_reorder (f->indexed_list,
+                              gimp_container_get_child_by_index (f->indexed_list,
+                                                                 index),
+                              i);
+
+      gimp_test_list_check (f);
+
+      index = (i * 5) % gimp_container_get_n_children (f->list);
+
+      gimp_container_remove (f->list,
+                             gimp_container_get_child_by_index (f->list,
+                                                                index));
+      gimp_container_remove (f->indexed_list,
+                             gimp_container_get_child_by_index (f->indexed_list,
+                                                                index));
+
+      gimp_test_list_check (f);
+    }
+}
+
+/**
+ * gimp_test_list_rename:
+ *
+ * Test that renaming a child updates the name lookup.
+ **/
+static void
+gimp_test_list_rename (GimpTestFixture *f,
+                       gconstpointer    data)
+{
+  GimpObject *object;
+
+  gimp_test_list_add_objects (f, 4, "Layer");
+
+  object = gimp_container_get_child_by_name (f->indexed_list, "Layer #2");
+  gimp_object_set_name (object, "Background");
+
+  g_assert (gimp_container_get_child_by_name (f->indexed_list,
+                                              "Layer #2") == NULL);
+  g_assert (gimp_container_get_child_by_name (f->indexed_list,
+                                              "Background") == object);
+
+  /*  renaming to a name in use must uniquefy it  */
+  gimp_object_set_name (object, "Layer");
+
+  g_assert_cmpstr (gimp_object_get_name (object), ==, "Layer #2");
+  g_assert (gimp_container_get_child_by_name (f->indexed_list,
+                                              "Layer #2") == object);
+}
+
+/**
+ * gimp_test_list_sort:
+ *
+ * Test that sorted insertion and sorting keep the index in sync.
+ **/
+static void
+gimp_test_list_sort (GimpTestFixture *f,
+                     gconstpointer    data)
+{
+  gint i;
+
+  gimp_list_set_sort_func (GIMP_LIST (f->list),
+                           (GCompareFunc) gimp_object_name_collate);
+  gimp_list_set_sort_func (GIMP_LIST (f->indexed_list),
+                           (GCompareFunc) gimp_object_name_collate);
+
+  for (i = 0; i < N_OBJECTS; i++)
+    {
+      gchar *name = g_strdup_printf ("%c", 'a' + (i * 11) % 26);
+
+      gimp_test_list_add_objects (f, 1, name);
+
+      g_free (name);
+    }
+
+  gimp_test_list_check (f);
+
+  gimp_list_reverse (GIMP_LIST (f->list));
+  gimp_list_reverse (GIMP_LIST (f->indexed_list));
+
+  gimp_test_list_check (f);
+}
+
+/**
+ * gimp_test_list_set_indexed:
+ *
+ * Test that a list can be indexed after children were added.
+ **/
+static void
+gimp_test_list_set_indexed (GimpTestFixture *f,
+                            gconstpointer    data)
+{
+  gimp_list_set_indexed (GIMP_LIST (f->indexed_list), FALSE);
+
+  gimp_test_list_add_objects (f, N_OBJECTS, "Layer");
+
+  gimp_list_set_indexed (GIMP_LIST (f->indexed_list), TRUE);
+
+  gimp_test_list_check (f);
+}
+
+int main(int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (add);
+  ADD_TEST (remove_and_reorder);
+  ADD_TEST (rename);
+  ADD_TEST (sort);
+  ADD_TEST (set_indexed);
+
+  return g_test_run ();
+}
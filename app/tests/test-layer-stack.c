@@ -0,0 +1,318 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl-plugin.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+#include "operations/operations-types.h"
+
+#include "core/gimp.h"
+
+#include "gegl/gimp-gegl-nodes.h"
+
+#include "operations/layer-modes/gimpoperationlayerstack.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+#define WIDTH      64
+#define HEIGHT     4
+
+#define TOLERANCE  1e-4
+
+#define ADD_TEST(function) \
+  g_test_add ("/gimp-layer-stack/" #function, \
+              GimpTestFixture, \
+              NULL, \
+              gimp_test_setup, \
+              function, \
+              gimp_test_teardown);
+
+
+typedef struct
+{
+  GeglBuffer *backdrop;
+  GeglBuffer *layers[2];
+  GeglBuffer *mask;
+} GimpTestFixture;
+
+
+static const GimpLayerMode modes[] =
+{
+  GIMP_LAYER_MODE_NORMAL,
+  GIMP_LAYER_MODE_MULTIPLY,
+  GIMP_LAYER_MODE_SCREEN,
+  GIMP_LAYER_MODE_DIFFERENCE,
+  GIMP_LAYER_MODE_HSV_HUE,
+  GIMP_LAYER_MODE_LCH_COLOR,
+  GIMP_LAYER_MODE_ERASE,
+  GIMP_LAYER_MODE_MERGE,
+  GIMP_LAYER_MODE_SPLIT,
+  GIMP_LAYER_MODE_NORMAL_LEGACY,
+  GIMP_LAYER_MODE_MULTIPLY_LEGACY
+};
+
+static const GimpLayerCompositeMode composite_modes[] =
+{
+  GIMP_LAYER_COMPOSITE_AUTO,
+  GIMP_LAYER_COMPOSITE_UNION,
+  GIMP_LAYER_COMPOSITE_CLIP_TO_BACKDROP,
+  GIMP_LAYER_COMPOSITE_CLIP_TO_LAYER,
+  GIMP_LAYER_COMPOSITE_INTERSECTION
+};
+
+
+static GeglBuffer *
+gimp_test_buffer_new (GRand       *rand,
+                      const gchar *format_name)
+{
+  const Babl *format   = babl_format (format_name);
+  gint        n_values = WIDTH * HEIGHT *
+                         babl_format_get_n_components (format);
+  gfloat     *data     = g_new (gfloat, n_values);
+  GeglBuffer *buffer;
+  gint        i;
+
+  for (i = 0; i < n_values; i++)
+    data[i] = g_rand_double (rand);
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, WIDTH, HEIGHT), format);
+
+  gegl_buffer_set (buffer, NULL, 0, format, data, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (data);
+
+  return buffer;
+}
+
+static void
+gimp_test_setup (GimpTestFixture *fixture,
+                 gconstpointer    data)
+{
+  GRand *rand = g_rand_new_with_seed (0);
+
+  fixture->backdrop  = gimp_test_buffer_new (rand, "RGBA float");
+  fixture->layers[0] = gimp_test_buffer_new (rand, "RGBA float");
+  fixture->layers[1] = gimp_test_buffer_new (rand, "RGBA float");
+  fixture->mask      = gimp_test_buffer_new (rand, "Y float");
+
+  g_rand_free (rand);
+}
+
+static void
+gimp_test_teardown (GimpTestFixture *fixture,
+                    gconstpointer    data)
+{
+  g_object_unref (fixture->backdrop);
+  g_object_unref (fixture->layers[0]);
+  g_object_unref (fixture->layers[1]);
+  g_object_unref (fixture->mask);
+}
+
+static GeglNode *
+gimp_test_buffer_source (GeglNode   *graph,
+                         GeglBuffer *buffer)
+{
+  return gegl_node_new_child (graph,
+                              "operation", "gegl:buffer-source",
+                              "buffer",    buffer,
+                              NULL);
+}
+
+/*  composites the fixture's two layers, both using @mode, the top one
+ *  with a mask, over the backdrop, if @with_backdrop, once with a mode
+ *  node per layer, and once with a layer stack, and compares the
+ *  results
+ */
+static void
+gimp_test_layer_stack_compare (GimpTestFixture        *fixture,
+                               GimpLayerMode           mode,
+                               GimpLayerCompositeMode  composite_mode,
+                               gboolean                with_backdrop)
+{
+  GeglNode *graph    = gegl_node_new ();
+  GeglNode *backdrop = NULL;
+  GeglNode *mode_nodes[2];
+  GeglNode *stack;
+  GList    *list     = NULL;
+  gfloat   *expected = g_new (gfloat, 4 * WIDTH * HEIGHT);
+  gfloat   *result   = g_new (gfloat, 4 * WIDTH * HEIGHT);
+  gint      i;
+
+  if (with_backdrop)
+    backdrop = gimp_test_buffer_source (graph, fixture->backdrop);
+
+  for (i = 0; i < 2; i++)
+    {
+      mode_nodes[i] = gegl_node_new_child (graph,
+                                           "operation", "gimp:normal",
+                                           NULL);
+
+      gimp_gegl_mode_node_set_mode (mode_nodes[i], mode,
+                                    GIMP_LAYER_COLOR_SPACE_AUTO,
+                                    GIMP_LAYER_COLOR_SPACE_AUTO,
+                                    composite_mode);
+      gimp_gegl_mode_node_set_opacity (mode_nodes[i], 0.75);
+
+      gegl_node_connect (gimp_test_buffer_source (graph, fixture->layers[i]),
+                         "output",
+                         mode_nodes[i], "aux");
+
+      list = g_list_append (list, mode_nodes[i]);
+    }
+
+  gegl_node_connect (gimp_test_buffer_source (graph, fixture->mask),
+                     "output",
+                     mode_nodes[1], "aux2");
+
+  if (backdrop)
+    gegl_node_link (backdrop, mode_nodes[0]);
+
+  gegl_node_link (mode_nodes[0], mode_nodes[1]);
+
+  if (! gimp_operation_layer_stack_can_fuse (
+         gegl_node_get_gegl_operation (mode_nodes[0])))
+    {
+      g_list_free (list);
+      g_object_unref (graph);
+      g_free (expected);
+      g_free (result);
+
+      return;
+    }
+
+  stack = gegl_node_new_child (graph,
+                               "operation", "gimp:layer-stack",
+                               NULL);
+
+  if (backdrop)
+    gegl_node_link (backdrop, stack);
+
+  gimp_operation_layer_stack_set_layers (
+    GIMP_OPERATION_LAYER_STACK (gegl_node_get_gegl_operation (stack)),
+    list);
+
+  gegl_node_blit (mode_nodes[1], 1.0, GEGL_RECTANGLE (0, 0, WIDTH, HEIGHT),
+                  babl_format ("RGBA float"), expected,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+  gegl_node_blit (stack, 1.0, GEGL_RECTANGLE (0, 0, WIDTH, HEIGHT),
+                  babl_format ("RGBA float"), result,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+
+  for (i = 0; i < WIDTH * HEIGHT; i++)
+    {
+      const gfloat *e = expected + 4 * i;
+      const gfloat *r = result   + 4 * i;
+      gint          c;
+
+      g_assert_cmpfloat_with_epsilon (r[3], e[3], TOLERANCE);
+
+      /*  the color of fully transparent pixels is undefined  */
+      if (e[3] == 0.0f)
+        continue;
+
+      for (c = 0; c < 3; c++)
+        g_assert_cmpfloat_with_epsilon (r[c], e[c], TOLERANCE);
+    }
+
+  g_list_free (list);
+  g_object_unref (graph);
+  g_free (expected);
+  g_free (result);
+}
+
+/**
+ * modes:
+ * @fixture:
+ * @data:
+ *
+ * Test that a layer stack gives the same result as a mode node per
+ * layer, across layer modes and composite modes.
+ **/
+static void
+modes (GimpTestFixture *fixture,
+       gconstpointer    data)
+{
+  gint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (modes); i++)
+    for (j = 0; j < G_N_ELEMENTS (composite_modes); j++)
+      {
+        gimp_test_layer_stack_compare (fixture, modes[i], composite_modes[j],
+                                       TRUE);
+      }
+}
+
+/**
+ * last_node:
+ * @fixture:
+ * @data:
+ *
+ * Test that a layer stack without a backdrop renders its bottom layer
+ * the way the bottom layer's mode node does, including for modes which
+ * don't affect the layer, like Erase and Split.
+ **/
+static void
+last_node (GimpTestFixture *fixture,
+           gconstpointer    data)
+{
+  gint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (modes); i++)
+    for (j = 0; j < G_N_ELEMENTS (composite_modes); j++)
+      {
+        gimp_test_layer_stack_compare (fixture, modes[i], composite_modes[j],
+                                       FALSE);
+      }
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (modes);
+  ADD_TEST (last_node);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
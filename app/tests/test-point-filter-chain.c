@@ -0,0 +1,301 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <math.h>
+
+#include <gegl-plugin.h>
+#include <gtk/gtk.h>
+
+#include "core/core-types.h"
+#include "operations/operations-types.h"
+
+#include "core/gimp.h"
+
+#include "operations/gimpbrightnesscontrastconfig.h"
+#include "operations/gimplevelsconfig.h"
+#include "operations/gimpoperationpointfilterchain.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+/*  the input ramp, which extends beyond [0..1] on both sides  */
+#define N_PIXELS     4096
+#define RAMP_MIN     (-0.5)
+#define RAMP_MAX     1.5
+
+/*  the error allowed for in-range pixels, which go through the LUT  */
+#define IN_RANGE_TOLERANCE   (1.0 / 255.0)
+
+/*  out-of-range pixels run through the filters themselves  */
+#define OUT_OF_RANGE_TOLERANCE  1e-6
+
+#define ADD_TEST(function) \
+  g_test_add ("/gimp-point-filter-chain/" #function, \
+              GimpTestFixture, \
+              NULL, \
+              gimp_test_setup, \
+              function, \
+              gimp_test_teardown);
+
+
+typedef struct
+{
+  GimpLevelsConfig             *levels_config;
+  GimpBrightnessContrastConfig *bc_config;
+
+  GeglNode                     *levels;
+  GeglNode                     *bc;
+
+  GeglNode                     *graph;
+  GeglNode                     *chain;
+
+  gfloat                       *input;
+  GeglBuffer                   *buffer;
+} GimpTestFixture;
+
+
+static void
+gimp_test_setup (GimpTestFixture *fixture,
+                 gconstpointer    data)
+{
+  GList    *operations = NULL;
+  GeglNode *source;
+  gint      i;
+
+  fixture->levels_config = g_object_new (GIMP_TYPE_LEVELS_CONFIG, NULL);
+
+  g_object_set (fixture->levels_config,
+                "channel",      GIMP_HISTOGRAM_VALUE,
+                "low-input",    0.1,
+                "gamma",        1.6,
+                "clamp-input",  FALSE,
+                "clamp-output", FALSE,
+                NULL);
+
+  fixture->bc_config = g_object_new (GIMP_TYPE_BRIGHTNESS_CONTRAST_CONFIG,
+                                     "brightness", 0.2,
+                                     "contrast",   0.1,
+                                     NULL);
+
+  fixture->levels = gegl_node_new_child (NULL,
+                                         "operation", "gimp:levels",
+                                         "config",    fixture->levels_config,
+                                         NULL);
+  fixture->bc     = gegl_node_new_child (NULL,
+                                         "operation", "gimp:brightness-contrast",
+                                         "config",    fixture->bc_config,
+                                         NULL);
+
+  fixture->graph  = gegl_node_new ();
+  fixture->chain  = gegl_node_new_child (fixture->graph,
+                                         "operation", "gimp:point-filter-chain",
+                                         NULL);
+
+  operations = g_list_append (operations,
+                              gegl_node_get_gegl_operation (fixture->levels));
+  operations = g_list_append (operations,
+                              gegl_node_get_gegl_operation (fixture->bc));
+
+  gimp_operation_point_filter_chain_set_operations (
+    GIMP_OPERATION_POINT_FILTER_CHAIN (
+      gegl_node_get_gegl_operation (fixture->chain)),
+    operations);
+
+  g_list_free (operations);
+
+  fixture->input = g_new (gfloat, 4 * N_PIXELS);
+
+  for (i = 0; i < N_PIXELS; i++)
+    {
+      gdouble value = RAMP_MIN + (RAMP_MAX - RAMP_MIN) * i / (N_PIXELS - 1);
+
+      fixture->input[4 * i + 0] = value;
+      fixture->input[4 * i + 1] = 1.0 - value;
+      fixture->input[4 * i + 2] = value * value;
+      fixture->input[4 * i + 3] = CLAMP (value, 0.0, 1.0);
+    }
+
+  /*  the chain is rendered through the graph, with a cache, like in the
+   *  projection
+   */
+  fixture->buffer = gegl_buffer_linear_new_from_data (fixture->input,
+                                                      babl_format ("RGBA float"),
+                                                      GEGL_RECTANGLE (0, 0,
+                                                                      N_PIXELS, 1),
+                                                      GEGL_AUTO_ROWSTRIDE,
+                                                      NULL, NULL);
+
+  source = gegl_node_new_child (fixture->graph,
+                                "operation", "gegl:buffer-source",
+                                "buffer",    fixture->buffer,
+                                NULL);
+
+  gegl_node_link (source, fixture->chain);
+}
+
+static void
+gimp_test_teardown (GimpTestFixture *fixture,
+                    gconstpointer    data)
+{
+  g_object_unref (fixture->graph);
+  g_object_unref (fixture->buffer);
+  g_free (fixture->input);
+  g_object_unref (fixture->bc);
+  g_object_unref (fixture->levels);
+  g_object_unref (fixture->bc_config);
+  g_object_unref (fixture->levels_config);
+}
+
+/*  runs @node's operation over @pixels, in place, to get the result of
+ *  the unfused filters
+ */
+static void
+gimp_test_process (GeglNode *node,
+                   gfloat   *pixels)
+{
+  GeglOperation *operation = gegl_node_get_gegl_operation (node);
+
+  gegl_operation_prepare (operation);
+
+  GEGL_OPERATION_POINT_FILTER_GET_CLASS (operation)->process (
+    operation, pixels, pixels, N_PIXELS,
+    GEGL_RECTANGLE (0, 0, N_PIXELS, 1), 0);
+}
+
+/*  compares the fused chain against the unfused filters, on pixels both
+ *  inside and outside of [0..1]
+ */
+static void
+gimp_test_point_filter_chain_compare (GimpTestFixture *fixture)
+{
+  gfloat *expected;
+  gfloat *result;
+  gint    i;
+
+  expected = g_memdup2 (fixture->input, 4 * N_PIXELS * sizeof (gfloat));
+  result   = g_new (gfloat, 4 * N_PIXELS);
+
+  gimp_test_process (fixture->levels, expected);
+  gimp_test_process (fixture->bc,     expected);
+
+  gegl_node_blit (fixture->chain, 1.0, GEGL_RECTANGLE (0, 0, N_PIXELS, 1),
+                  babl_format ("RGBA float"), result,
+                  GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_CACHE);
+
+  for (i = 0; i < N_PIXELS; i++)
+    {
+      const gfloat *src       = fixture->input + 4 * i;
+      gdouble       tolerance = IN_RANGE_TOLERANCE;
+      gint          c;
+
+      /*  the LUT is only used if all of the pixel's channels are in
+       *  range
+       */
+      for (c = 0; c < 4; c++)
+        {
+          if (src[c] < 0.0f || src[c] > 1.0f)
+            tolerance = OUT_OF_RANGE_TOLERANCE;
+        }
+
+      for (c = 0; c < 4; c++)
+        {
+          g_assert_cmpfloat_with_epsilon (result[4 * i + c],
+                                          expected[4 * i + c],
+                                          tolerance);
+        }
+    }
+
+  g_free (result);
+  g_free (expected);
+}
+
+/**
+ * ramp:
+ * @fixture:
+ * @data:
+ *
+ * Test that the point filter chain, with its LUT, gives the same
+ * result as running its filters one after the other, including on
+ * pixels outside of [0..1].
+ **/
+static void
+ramp (GimpTestFixture *fixture,
+      gconstpointer    data)
+{
+  gimp_test_point_filter_chain_compare (fixture);
+}
+
+/**
+ * config_change:
+ * @fixture:
+ * @data:
+ *
+ * Test that changes to the filters' configs invalidate the chain,
+ * whose filters are not part of the graph, and rebake its LUT.
+ **/
+static void
+config_change (GimpTestFixture *fixture,
+               gconstpointer    data)
+{
+  gimp_test_point_filter_chain_compare (fixture);
+
+  g_object_set (fixture->levels_config,
+                "channel", GIMP_HISTOGRAM_VALUE,
+                "gamma",   0.5,
+                NULL);
+  g_object_set (fixture->bc_config,
+                "brightness", -0.3,
+                NULL);
+
+  gimp_test_point_filter_chain_compare (fixture);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We share the same application instance across all tests */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (ramp);
+  ADD_TEST (config_change);
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp3_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
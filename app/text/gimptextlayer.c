@@ -60,6 +60,12 @@
 #include "gimp-intl.h"
 
 
+/*  the granularity at which a new rendering is compared against the
+ *  previous one, to find the parts of the layer which need updating
+ */
+#define RENDER_TILE_SIZE 64
+
+
 enum
 {
   PROP_0,
@@ -70,7 +76,15 @@ enum
 
 struct _GimpTextLayerPrivate
 {
-  GimpTextDirection base_dir;
+  GimpTextDirection   base_dir;
+
+  /*  hashes of the tiles of the last rendering, as long as it's what
+   *  the layer contains
+   */
+  guint64            *tile_hashes;
+  gint                tiles_width;
+  gint                tiles_height;
+  GimpColorTransform *tiles_transform;
 };
 
 static void       gimp_text_layer_finalize       (GObject           *object);
@@ -106,6 +120,11 @@ static void       gimp_text_layer_push_undo      (GimpDrawable      *drawable,
                                                   gint               width,
                                                   gint               height);
 
+static void       gimp_text_layer_swap_pixels    (GimpDrawable      *drawable,
+                                                  GeglBuffer        *buffer,
+                                                  gint               x,
+                                                  gint               y);
+
 static void       gimp_text_layer_convert_type   (GimpLayer         *layer,
                                                   GimpImage         *dest_image,
                                                   const Babl        *new_format,
@@ -120,6 +139,17 @@ static void       gimp_text_layer_text_changed   (GimpTextLayer     *layer);
 static gboolean   gimp_text_layer_render         (GimpTextLayer     *layer);
 static void       gimp_text_layer_render_layout  (GimpTextLayer     *layer,
                                                   GimpTextLayout    *layout);
+static gint       gimp_text_layer_get_n_tiles    (gint               width,
+                                                  gint               height);
+static cairo_region_t *
+                  gimp_text_layer_get_dirty_region
+                                                 (GimpTextLayer      *layer,
+                                                  cairo_surface_t    *surface,
+                                                  GeglBuffer         *buffer,
+                                                  GimpColorTransform *transform,
+                                                  guint64           **tile_hashes);
+static void       gimp_text_layer_clear_tile_hashes
+                                                 (GimpTextLayer     *layer);
 
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpTextLayer, gimp_text_layer, GIMP_TYPE_LAYER)
@@ -166,6 +196,7 @@ gimp_text_layer_class_init (GimpTextLayerClass *klass)
 
   drawable_class->set_buffer        = gimp_text_layer_set_buffer;
   drawable_class->push_undo         = gimp_text_layer_push_undo;
+  drawable_class->swap_pixels       = gimp_text_layer_swap_pixels;
 
   layer_class->convert_type         = gimp_text_layer_convert_type;
 
@@ -202,6 +233,8 @@ gimp_text_layer_finalize (GObject *object)
 {
   GimpTextLayer *layer = GIMP_TEXT_LAYER (object);
 
+  gimp_text_layer_clear_tile_hashes (layer);
+
   g_clear_object (&layer->text);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -251,6 +284,9 @@ gimp_text_layer_set_property (GObject      *object,
       break;
     case PROP_MODIFIED:
       text_layer->modified = g_value_get_boolean (value);
+
+      if (text_layer->modified)
+        gimp_text_layer_clear_tile_hashes (text_layer);
       break;
 
     default:
@@ -269,6 +305,13 @@ gimp_text_layer_get_memsize (GimpObject *object,
   memsize += gimp_object_get_memsize (GIMP_OBJECT (text_layer->text),
                                       gui_size);
 
+  if (text_layer->private->tile_hashes)
+    {
+      memsize += (sizeof (guint64) *
+                  gimp_text_layer_get_n_tiles (text_layer->private->tiles_width,
+                                               text_layer->private->tiles_height));
+    }
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -338,6 +381,8 @@ gimp_text_layer_set_buffer (GimpDrawable        *drawable,
   GimpTextLayer *layer = GIMP_TEXT_LAYER (drawable);
   GimpImage     *image = gimp_item_get_image (GIMP_ITEM (layer));
 
+  gimp_text_layer_clear_tile_hashes (layer);
+
   if (push_undo && ! layer->modified)
     gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_DRAWABLE_MOD,
                                  undo_desc);
@@ -368,6 +413,8 @@ gimp_text_layer_push_undo (GimpDrawable *drawable,
   GimpTextLayer *layer = GIMP_TEXT_LAYER (drawable);
   GimpImage     *image = gimp_item_get_image (GIMP_ITEM (layer));
 
+  gimp_text_layer_clear_tile_hashes (layer);
+
   if (! layer->modified)
     gimp_image_undo_group_start (image, GIMP_UNDO_GROUP_DRAWABLE, undo_desc);
 
@@ -385,6 +432,17 @@ gimp_text_layer_push_undo (GimpDrawable *drawable,
     }
 }
 
+static void
+gimp_text_layer_swap_pixels (GimpDrawable *drawable,
+                             GeglBuffer   *buffer,
+                             gint          x,
+                             gint          y)
+{
+  gimp_text_layer_clear_tile_hashes (GIMP_TEXT_LAYER (drawable));
+
+  GIMP_DRAWABLE_CLASS (parent_class)->swap_pixels (drawable, buffer, x, y);
+}
+
 static void
 gimp_text_layer_convert_type (GimpLayer         *layer,
                               GimpImage         *dest_image,
@@ -499,6 +557,10 @@ gimp_text_layer_set_text (GimpTextLayer *layer,
                                G_CALLBACK (gimp_text_layer_text_changed),
                                layer, G_CONNECT_SWAPPED);
     }
+  else
+    {
+      gimp_text_layer_clear_tile_hashes (layer);
+    }
 
   g_object_notify (G_OBJECT (layer), "text");
   gimp_viewable_invalidate_preview (GIMP_VIEWABLE (layer));
@@ -932,8 +994,12 @@ gimp_text_layer_render_layout (GimpTextLayer  *layer,
   GimpColorTransform *transform;
   cairo_t            *cr;
   cairo_surface_t    *surface;
+  cairo_region_t     *region;
+  guint64            *tile_hashes;
   gint                width;
   gint                height;
+  gint                n_rects;
+  gint                i;
   cairo_status_t      status;
 
   g_return_if_fail (gimp_drawable_has_alpha (drawable));
@@ -1014,26 +1080,225 @@ gimp_text_layer_render_layout (GimpTextLayer  *layer,
 
   cairo_surface_flush (surface);
 
+  transform = gimp_image_get_color_transform_from_srgb_u8 (image);
+
   buffer = gimp_cairo_surface_create_buffer (surface);
 
-  transform = gimp_image_get_color_transform_from_srgb_u8 (image);
+  region = gimp_text_layer_get_dirty_region (layer, surface, buffer, transform,
+                                             &tile_hashes);
+
+  n_rects = cairo_region_num_rectangles (region);
+
+  for (i = 0; i < n_rects; i++)
+    {
+      cairo_rectangle_int_t  rectangle;
+      GeglRectangle          rect;
+
+      cairo_region_get_rectangle (region, i, &rectangle);
+
+      rect = *GEGL_RECTANGLE (rectangle.x,     rectangle.y,
+                              rectangle.width, rectangle.height);
+
+      if (transform)
+        {
+          gimp_color_transform_process_buffer (transform,
+                                               buffer,
+                                               &rect,
+                                               gimp_drawable_get_buffer (drawable),
+                                               &rect);
+        }
+      else
+        {
+          gimp_gegl_buffer_copy (buffer, &rect, GEGL_ABYSS_NONE,
+                                 gimp_drawable_get_buffer (drawable), &rect);
+        }
+
+      gimp_drawable_update (drawable,
+                            rect.x, rect.y, rect.width, rect.height);
+    }
+
+  g_object_unref (buffer);
+  cairo_region_destroy (region);
+  cairo_surface_destroy (surface);
+
+  /*  keep the tile hashes around, to compare the next rendering against  */
+  gimp_text_layer_clear_tile_hashes (layer);
+
+  layer->private->tile_hashes  = tile_hashes;
+  layer->private->tiles_width  = width;
+  layer->private->tiles_height = height;
 
   if (transform)
+    layer->private->tiles_transform = g_object_ref (transform);
+}
+
+static gint
+gimp_text_layer_get_n_tiles (gint width,
+                             gint height)
+{
+  return (((width  + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE) *
+          ((height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE));
+}
+
+/*  a 64 bit FNV-1a hash of a tile of a rendering  */
+static guint64
+gimp_text_layer_hash_tile (const guchar                *data,
+                           gint                         stride,
+                           const cairo_rectangle_int_t *rect)
+{
+  guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+  gint    y;
+
+  for (y = rect->y; y < rect->y + rect->height; y++)
     {
-      gimp_color_transform_process_buffer (transform,
-                                           buffer,
-                                           NULL,
-                                           gimp_drawable_get_buffer (drawable),
-                                           NULL);
+      const guchar *row = data + y * stride + rect->x * 4;
+      gint          i;
+
+      for (i = 0; i < rect->width * 4; i++)
+        {
+          hash ^= row[i];
+          hash *= G_GUINT64_CONSTANT (0x100000001b3);
+        }
+    }
+
+  return hash;
+}
+
+/*  returns whether the layer already contains the tile @rect of the
+ *  rendering in @buffer, converted like gimp_text_layer_render_layout()
+ *  would.  @new_data and @old_data are scratch space for a tile in the
+ *  layer's format, and @src_data for a tile in @buffer's format.
+ */
+static gboolean
+gimp_text_layer_tile_matches (GimpTextLayer               *layer,
+                              GeglBuffer                  *buffer,
+                              GimpColorTransform          *transform,
+                              const cairo_rectangle_int_t *rect,
+                              guchar                      *src_data,
+                              guchar                      *new_data,
+                              guchar                      *old_data)
+{
+  GimpDrawable  *drawable = GIMP_DRAWABLE (layer);
+  const Babl    *format   = gimp_drawable_get_format (drawable);
+  GeglRectangle  tile_rect;
+  gsize          n_pixels;
+
+  tile_rect = *GEGL_RECTANGLE (rect->x, rect->y, rect->width, rect->height);
+  n_pixels  = (gsize) rect->width * rect->height;
+
+  if (transform)
+    {
+      const Babl *src_format = gegl_buffer_get_format (buffer);
+
+      gegl_buffer_get (buffer, &tile_rect, 1.0, src_format, src_data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      gimp_color_transform_process_pixels (transform,
+                                           src_format, src_data,
+                                           format,     new_data,
+                                           n_pixels);
     }
   else
     {
-      gimp_gegl_buffer_copy (buffer, NULL, GEGL_ABYSS_NONE,
-                             gimp_drawable_get_buffer (drawable), NULL);
+      gegl_buffer_get (buffer, &tile_rect, 1.0, format, new_data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
     }
 
-  g_object_unref (buffer);
-  cairo_surface_destroy (surface);
+  gegl_buffer_get (gimp_drawable_get_buffer (drawable), &tile_rect, 1.0,
+                   format, old_data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  return ! memcmp (new_data, old_data,
+                   n_pixels * babl_format_get_bytes_per_pixel (format));
+}
+
+/*  returns the parts of @surface which differ from the last rendering,
+ *  or all of it, if the last rendering can't be used to tell, and the
+ *  hashes of @surface's tiles in @tile_hashes.  tiles whose hash is
+ *  unchanged are compared against the layer's pixels, to rule out hash
+ *  collisions.  @buffer is a buffer wrapping @surface.
+ */
+static cairo_region_t *
+gimp_text_layer_get_dirty_region (GimpTextLayer       *layer,
+                                  cairo_surface_t     *surface,
+                                  GeglBuffer          *buffer,
+                                  GimpColorTransform  *transform,
+                                  guint64            **tile_hashes)
+{
+  const guint64         *old_hashes = layer->private->tile_hashes;
+  guint64               *hashes;
+  cairo_region_t        *region;
+  cairo_rectangle_int_t  rect;
+  const guchar          *data;
+  guchar                *src_data   = NULL;
+  guchar                *new_data   = NULL;
+  guchar                *old_data   = NULL;
+  gint                   width;
+  gint                   height;
+  gint                   stride;
+  gint                   i;
+
+  width  = cairo_image_surface_get_width  (surface);
+  height = cairo_image_surface_get_height (surface);
+  data   = cairo_image_surface_get_data   (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  if (layer->private->tiles_width     != width  ||
+      layer->private->tiles_height    != height ||
+      layer->private->tiles_transform != transform)
+    {
+      old_hashes = NULL;
+    }
+
+  hashes = g_new (guint64, gimp_text_layer_get_n_tiles (width, height));
+  region = cairo_region_create ();
+
+  if (old_hashes)
+    {
+      const Babl *format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
+      gsize       size   = RENDER_TILE_SIZE * RENDER_TILE_SIZE;
+
+      src_data = g_malloc (size * 4);
+      new_data = g_malloc (size * babl_format_get_bytes_per_pixel (format));
+      old_data = g_malloc (size * babl_format_get_bytes_per_pixel (format));
+    }
+
+  for (rect.y = 0, i = 0; rect.y < height; rect.y += RENDER_TILE_SIZE)
+    {
+      rect.height = MIN (RENDER_TILE_SIZE, height - rect.y);
+
+      for (rect.x = 0; rect.x < width; rect.x += RENDER_TILE_SIZE, i++)
+        {
+          rect.width = MIN (RENDER_TILE_SIZE, width - rect.x);
+
+          hashes[i] = gimp_text_layer_hash_tile (data, stride, &rect);
+
+          if (! old_hashes                                       ||
+              hashes[i] != old_hashes[i]                         ||
+              ! gimp_text_layer_tile_matches (layer, buffer, transform,
+                                              &rect,
+                                              src_data, new_data, old_data))
+            {
+              cairo_region_union_rectangle (region, &rect);
+            }
+        }
+    }
+
+  g_free (src_data);
+  g_free (new_data);
+  g_free (old_data);
+
+  *tile_hashes = hashes;
+
+  return region;
+}
+
+static void
+gimp_text_layer_clear_tile_hashes (GimpTextLayer *layer)
+{
+  g_clear_pointer (&layer->private->tile_hashes, g_free);
+  g_clear_object (&layer->private->tiles_transform);
 
-  gimp_drawable_update (drawable, 0, 0, width, height);
+  layer->private->tiles_width  = 0;
+  layer->private->tiles_height = 0;
 }
@@ -64,6 +64,7 @@
 #include "core/gimp-parallel.h"
 #include "core/gimpasync.h"
 #include "core/gimpbacktrace.h"
+#include "core/gimpbrushcache.h"
 #include "core/gimptempbuf.h"
 #include "core/gimpwaitable.h"
 
@@ -155,6 +156,8 @@ typedef enum
   VARIABLE_TILE_ALLOC_TOTAL,
   VARIABLE_SCRATCH_TOTAL,
   VARIABLE_TEMP_BUF_TOTAL,
+  VARIABLE_BRUSH_CACHE_TOTAL,
+  VARIABLE_BRUSH_CACHE_HIT_MISS,
 
 
   N_VARIABLES,
@@ -764,6 +767,24 @@ static const VariableInfo variables[] =
     .type             = VARIABLE_TYPE_SIZE,
     .sample_func      = gimp_dashboard_sample_function,
     .data             = gimp_temp_buf_get_total_memsize
+  },
+
+  [VARIABLE_BRUSH_CACHE_TOTAL] =
+  { .name             = "brush-cache-total",
+    .title            = NC_("dashboard-variable", "Brush cache"),
+    .description      = N_("Total size of cached transformed brushes"),
+    .type             = VARIABLE_TYPE_SIZE,
+    .sample_func      = gimp_dashboard_sample_function,
+    .data             = gimp_brush_caches_get_memsize
+  },
+
+  [VARIABLE_BRUSH_CACHE_HIT_MISS] =
+  { .name             = "brush-cache-hit-miss",
+    .title            = NC_("dashboard-variable", "Brush hit/miss"),
+    .description      = N_("Brush cache hit/miss ratio"),
+    .type             = VARIABLE_TYPE_INT_RATIO,
+    .sample_func      = gimp_dashboard_sample_function,
+    .data             = gimp_brush_caches_get_hit_miss
   }
 };
 
@@ -981,6 +1002,12 @@ static const GroupInfo groups[] =
                           { .variable       = VARIABLE_TEMP_BUF_TOTAL,
                             .default_active = TRUE
                           },
+                          { .variable       = VARIABLE_BRUSH_CACHE_TOTAL,
+                            .default_active = FALSE
+                          },
+                          { .variable       = VARIABLE_BRUSH_CACHE_HIT_MISS,
+                            .default_active = FALSE
+                          },
 
                           {}
                         }
@@ -2035,8 +2062,13 @@ gimp_dashboard_sample_function (GimpDashboard *dashboard,
       variable_data->value.rate_of_change = CALL_FUNC (gdouble);
       break;
 
-    case VARIABLE_TYPE_SIZE_RATIO:
     case VARIABLE_TYPE_INT_RATIO:
+      ((void (*) (gint *, gint *)) variable_info->data) (
+        &variable_data->value.int_ratio.antecedent,
+        &variable_data->value.int_ratio.consequent);
+      break;
+
+    case VARIABLE_TYPE_SIZE_RATIO:
       g_return_if_reached ();
       break;
     }
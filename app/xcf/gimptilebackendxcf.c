@@ -0,0 +1,545 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimptilebackendxcf.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <cairo.h>
+#include <gegl.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "xcf-private.h"
+#include "xcf-utils.h"
+
+#include "gimptilebackendxcf.h"
+
+#include "gimp-log.h"
+
+
+typedef enum
+{
+  TILE_IN_FILE,   /* the tile's data is read from the file       */
+  TILE_IN_STORE,  /* the tile has been written to the store      */
+  TILE_EMPTY      /* the tile has been voided, and reads as zero */
+} TileState;
+
+struct _GimpTileBackendXcfInput
+{
+  gint                ref_count;
+  GInputStream       *input;
+  GMutex              mutex;
+};
+
+struct _GimpTileBackendXcfPrivate
+{
+  GimpTileBackendXcfInput *input;
+  gint                     file_version;
+  XcfCompressionType       compression;
+
+  gint                     width;
+  gint                     height;
+  gint                     bpp;
+  gint                     n_tile_rows;
+  gint                     n_tile_cols;
+
+  goffset                 *offsets;
+  goffset                  max_data_length;
+
+  guint8                  *tile_state;
+  GeglBuffer              *store;
+};
+
+
+static void       gimp_tile_backend_xcf_finalize   (GObject            *object);
+
+static gpointer   gimp_tile_backend_xcf_command    (GeglTileSource     *tile_store,
+                                                    GeglTileCommand     command,
+                                                    gint                x,
+                                                    gint                y,
+                                                    gint                z,
+                                                    gpointer            data);
+
+static gboolean   gimp_tile_backend_xcf_get_rect   (GimpTileBackendXcf *backend_xcf,
+                                                    gint                x,
+                                                    gint                y,
+                                                    GeglRectangle      *rect);
+static GeglTile * gimp_tile_backend_xcf_read       (GimpTileBackendXcf *backend_xcf,
+                                                    gint                x,
+                                                    gint                y);
+static GeglTile * gimp_tile_backend_xcf_read_store (GimpTileBackendXcf *backend_xcf,
+                                                    gint                x,
+                                                    gint                y);
+static void       gimp_tile_backend_xcf_write      (GimpTileBackendXcf *backend_xcf,
+                                                    gint                x,
+                                                    gint                y,
+                                                    GeglTile           *tile);
+
+
+G_DEFINE_TYPE_WITH_PRIVATE (GimpTileBackendXcf, gimp_tile_backend_xcf,
+                            GEGL_TYPE_TILE_BACKEND)
+
+#define parent_class gimp_tile_backend_xcf_parent_class
+
+
+static void
+gimp_tile_backend_xcf_class_init (GimpTileBackendXcfClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gimp_tile_backend_xcf_finalize;
+}
+
+static void
+gimp_tile_backend_xcf_init (GimpTileBackendXcf *backend)
+{
+  GeglTileSource *source = GEGL_TILE_SOURCE (backend);
+
+  backend->priv = gimp_tile_backend_xcf_get_instance_private (backend);
+
+  source->command = gimp_tile_backend_xcf_command;
+}
+
+static void
+gimp_tile_backend_xcf_finalize (GObject *object)
+{
+  GimpTileBackendXcf        *backend_xcf = GIMP_TILE_BACKEND_XCF (object);
+  GimpTileBackendXcfPrivate *priv        = backend_xcf->priv;
+
+  g_clear_pointer (&priv->input, gimp_tile_backend_xcf_input_unref);
+  g_clear_object (&priv->store);
+
+  g_clear_pointer (&priv->offsets,    g_free);
+  g_clear_pointer (&priv->tile_state, g_free);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gpointer
+gimp_tile_backend_xcf_command (GeglTileSource  *tile_store,
+                               GeglTileCommand  command,
+                               gint             x,
+                               gint             y,
+                               gint             z,
+                               gpointer         data)
+{
+  GimpTileBackendXcf        *backend_xcf = GIMP_TILE_BACKEND_XCF (tile_store);
+  GimpTileBackendXcfPrivate *priv        = backend_xcf->priv;
+  gpointer                   result      = NULL;
+  GeglRectangle              rect;
+
+  switch (command)
+    {
+    case GEGL_TILE_GET:
+      /* mipmapped tiles are rendered locally by the tile cache */
+      if (z == 0 && gimp_tile_backend_xcf_get_rect (backend_xcf, x, y, &rect))
+        {
+          switch (priv->tile_state[y * priv->n_tile_cols + x])
+            {
+            case TILE_IN_FILE:
+              result = gimp_tile_backend_xcf_read (backend_xcf, x, y);
+              break;
+
+            case TILE_IN_STORE:
+              result = gimp_tile_backend_xcf_read_store (backend_xcf, x, y);
+              break;
+
+            case TILE_EMPTY:
+              break;
+            }
+        }
+      break;
+
+    case GEGL_TILE_SET:
+      if (z == 0 && gimp_tile_backend_xcf_get_rect (backend_xcf, x, y, &rect))
+        gimp_tile_backend_xcf_write (backend_xcf, x, y, data);
+
+      gegl_tile_mark_as_stored (data);
+      break;
+
+    case GEGL_TILE_VOID:
+      if (z == 0 && gimp_tile_backend_xcf_get_rect (backend_xcf, x, y, &rect))
+        priv->tile_state[y * priv->n_tile_cols + x] = TILE_EMPTY;
+      break;
+
+    case GEGL_TILE_EXIST:
+      if (z == 0 && gimp_tile_backend_xcf_get_rect (backend_xcf, x, y, &rect))
+        {
+          result = GINT_TO_POINTER (priv->tile_state[y * priv->n_tile_cols + x] !=
+                                    TILE_EMPTY);
+        }
+      break;
+
+    case GEGL_TILE_FLUSH:
+      break;
+
+    default:
+      result = gegl_tile_backend_command (GEGL_TILE_BACKEND (tile_store),
+                                          command, x, y, z, data);
+      break;
+    }
+
+  return result;
+}
+
+
+/*  public functions  */
+
+/**
+ * gimp_tile_backend_xcf_input_new:
+ * @file:  a local XCF file.
+ * @error: return location for an error.
+ *
+ * Opens a stream on @file, which is shared by the backends of all the
+ * drawables of one image.  Reads from it are serialized by a lock of its
+ * own, so that backends of different images never wait for each other.
+ *
+ * Returns: the new input, or %NULL if @file could not be opened.
+ **/
+GimpTileBackendXcfInput *
+gimp_tile_backend_xcf_input_new (GFile   *file,
+                                 GError **error)
+{
+  GimpTileBackendXcfInput *input;
+  GInputStream            *stream;
+
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  stream = G_INPUT_STREAM (g_file_read (file, NULL, error));
+
+  if (! stream)
+    return NULL;
+
+  if (! G_IS_SEEKABLE (stream) || ! g_seekable_can_seek (G_SEEKABLE (stream)))
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "stream is not seekable");
+      g_object_unref (stream);
+
+      return NULL;
+    }
+
+  input = g_slice_new0 (GimpTileBackendXcfInput);
+
+  input->ref_count = 1;
+  input->input     = stream;
+
+  g_mutex_init (&input->mutex);
+
+  return input;
+}
+
+GimpTileBackendXcfInput *
+gimp_tile_backend_xcf_input_ref (GimpTileBackendXcfInput *input)
+{
+  g_return_val_if_fail (input != NULL, NULL);
+
+  g_atomic_int_inc (&input->ref_count);
+
+  return input;
+}
+
+void
+gimp_tile_backend_xcf_input_unref (GimpTileBackendXcfInput *input)
+{
+  g_return_if_fail (input != NULL);
+
+  if (g_atomic_int_dec_and_test (&input->ref_count))
+    {
+      g_mutex_clear (&input->mutex);
+      g_object_unref (input->input);
+
+      g_slice_free (GimpTileBackendXcfInput, input);
+    }
+}
+
+/**
+ * gimp_tile_backend_xcf_input_read:
+ * @input:  a #GimpTileBackendXcfInput.
+ * @offset: the file offset to read from.
+ * @buffer: the buffer to read into.
+ * @count:  the number of bytes to read.
+ *
+ * Reads up to @count bytes at @offset.  This may be called from any
+ * thread.
+ *
+ * Returns: the number of bytes read, which is less than @count at the
+ *          end of the file.
+ **/
+gsize
+gimp_tile_backend_xcf_input_read (GimpTileBackendXcfInput *input,
+                                  goffset                  offset,
+                                  guchar                  *buffer,
+                                  gsize                    count)
+{
+  gsize bytes_read = 0;
+
+  g_return_val_if_fail (input != NULL, 0);
+
+  g_mutex_lock (&input->mutex);
+
+  if (g_seekable_seek (G_SEEKABLE (input->input), offset, G_SEEK_SET,
+                       NULL, NULL))
+    {
+      g_input_stream_read_all (input->input, buffer, count,
+                               &bytes_read, NULL, NULL);
+    }
+
+  g_mutex_unlock (&input->mutex);
+
+  return bytes_read;
+}
+
+/**
+ * gimp_tile_backend_xcf_new:
+ * @input:           the image's shared XCF input.
+ * @file_version:    the XCF file version.
+ * @compression:     the XCF file's tile compression.
+ * @format:          the drawable's format.
+ * @width:           the level's width.
+ * @height:          the level's height.
+ * @offsets:         the level's tile offset table, which is taken over by
+ *                   the backend.
+ * @max_data_length: the maximal on-disk length of a tile.
+ *
+ * Returns: a new backend, whose tiles use the XCF tile size.
+ **/
+GeglTileBackend *
+gimp_tile_backend_xcf_new (GimpTileBackendXcfInput *input,
+                           gint                     file_version,
+                           XcfCompressionType       compression,
+                           const Babl              *format,
+                           gint                     width,
+                           gint                     height,
+                           goffset                 *offsets,
+                           goffset                  max_data_length)
+{
+  GeglTileBackend           *backend;
+  GimpTileBackendXcfPrivate *priv;
+
+  g_return_val_if_fail (input != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (offsets != NULL, NULL);
+
+  backend = g_object_new (GIMP_TYPE_TILE_BACKEND_XCF,
+                          "tile-width",  XCF_TILE_WIDTH,
+                          "tile-height", XCF_TILE_HEIGHT,
+                          "format",      format,
+                          NULL);
+
+  priv = GIMP_TILE_BACKEND_XCF (backend)->priv;
+
+  priv->input           = gimp_tile_backend_xcf_input_ref (input);
+  priv->file_version    = file_version;
+  priv->compression     = compression;
+  priv->width           = width;
+  priv->height          = height;
+  priv->bpp             = babl_format_get_bytes_per_pixel (format);
+  priv->n_tile_rows     = (height + XCF_TILE_HEIGHT - 1) / XCF_TILE_HEIGHT;
+  priv->n_tile_cols     = (width  + XCF_TILE_WIDTH  - 1) / XCF_TILE_WIDTH;
+  priv->offsets         = offsets;
+  priv->max_data_length = max_data_length;
+  priv->tile_state      = g_new0 (guint8,
+                                  priv->n_tile_rows * priv->n_tile_cols);
+
+  gegl_tile_backend_set_extent (backend,
+                                GEGL_RECTANGLE (0, 0, width, height));
+
+  return backend;
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_tile_backend_xcf_get_rect (GimpTileBackendXcf *backend_xcf,
+                                gint                x,
+                                gint                y,
+                                GeglRectangle      *rect)
+{
+  GimpTileBackendXcfPrivate *priv = backend_xcf->priv;
+
+  if (x < 0 || x >= priv->n_tile_cols ||
+      y < 0 || y >= priv->n_tile_rows)
+    {
+      return FALSE;
+    }
+
+  rect->x      = x * XCF_TILE_WIDTH;
+  rect->y      = y * XCF_TILE_HEIGHT;
+  rect->width  = MIN (XCF_TILE_WIDTH,  priv->width  - rect->x);
+  rect->height = MIN (XCF_TILE_HEIGHT, priv->height - rect->y);
+
+  return TRUE;
+}
+
+static GeglTile *
+gimp_tile_backend_xcf_read (GimpTileBackendXcf *backend_xcf,
+                            gint                x,
+                            gint                y)
+{
+  GimpTileBackendXcfPrivate *priv      = backend_xcf->priv;
+  GeglTileBackend           *backend   = GEGL_TILE_BACKEND (backend_xcf);
+  const Babl                *format    = gegl_tile_backend_get_format (backend);
+  gint                       tile_num  = y * priv->n_tile_cols + x;
+  GeglTile                  *tile;
+  GeglRectangle              rect;
+  goffset                    offset;
+  goffset                    offset2;
+  guchar                    *xcfdata;
+  guchar                    *xcf_tile_data;
+  gsize                      bytes_read;
+  gboolean                   nonzero;
+  gint                       tile_size;
+  gint                       tile_stride;
+  gint                       xcf_tile_stride;
+  gint                       row;
+
+  gimp_tile_backend_xcf_get_rect (backend_xcf, x, y, &rect);
+
+  offset  = priv->offsets[tile_num];
+  offset2 = priv->offsets[tile_num + 1];
+
+  if (offset2 == 0)
+    offset2 = offset + priv->max_data_length;
+
+  xcfdata = g_malloc (offset2 - offset);
+
+  /* we may be reading past the end of the file here, so a short read is
+   * fine.  decompression happens outside of the input's lock.
+   */
+  bytes_read = gimp_tile_backend_xcf_input_read (priv->input, offset,
+                                                 xcfdata, offset2 - offset);
+
+  tile_size       = gegl_tile_backend_get_tile_size (backend);
+  tile_stride     = XCF_TILE_WIDTH * priv->bpp;
+  xcf_tile_stride = rect.width * priv->bpp;
+
+  /* xcf tiles at the right and bottom edges of the level are cropped, so
+   * decode into a temporary buffer, unless the tile is whole.
+   */
+  tile = gegl_tile_new (tile_size);
+
+  if (rect.width == XCF_TILE_WIDTH && rect.height == XCF_TILE_HEIGHT)
+    xcf_tile_data = gegl_tile_get_data (tile);
+  else
+    xcf_tile_data = g_malloc (xcf_tile_stride * rect.height);
+
+  if (! xcf_decode_tile (priv->compression, priv->file_version, format,
+                         xcfdata, bytes_read,
+                         xcf_tile_data, rect.width * rect.height,
+                         &nonzero))
+    {
+      g_printerr ("xcf: failed to load tile %d from file; "
+                  "possibly corrupt XCF file.\n", tile_num);
+
+      nonzero = FALSE;
+    }
+
+  if (! nonzero)
+    {
+      memset (gegl_tile_get_data (tile), 0, tile_size);
+    }
+  else if (xcf_tile_data != gegl_tile_get_data (tile))
+    {
+      guchar *tile_data = gegl_tile_get_data (tile);
+
+      memset (tile_data, 0, tile_size);
+
+      for (row = 0; row < rect.height; row++)
+        {
+          memcpy (tile_data     + row * tile_stride,
+                  xcf_tile_data + row * xcf_tile_stride,
+                  xcf_tile_stride);
+        }
+    }
+
+  if (xcf_tile_data != gegl_tile_get_data (tile))
+    g_free (xcf_tile_data);
+
+  g_free (xcfdata);
+
+  GIMP_LOG (XCF, "lazily loaded tile %d (%d, %d)", tile_num, x, y);
+
+  return tile;
+}
+
+static GeglTile *
+gimp_tile_backend_xcf_read_store (GimpTileBackendXcf *backend_xcf,
+                                  gint                x,
+                                  gint                y)
+{
+  GimpTileBackendXcfPrivate *priv    = backend_xcf->priv;
+  GeglTileBackend           *backend = GEGL_TILE_BACKEND (backend_xcf);
+  GeglTile                  *tile;
+  GeglRectangle              rect;
+
+  gimp_tile_backend_xcf_get_rect (backend_xcf, x, y, &rect);
+
+  tile = gegl_tile_new (gegl_tile_backend_get_tile_size (backend));
+
+  gegl_buffer_get (priv->store, &rect, 1.0,
+                   gegl_tile_backend_get_format (backend),
+                   gegl_tile_get_data (tile),
+                   XCF_TILE_WIDTH * priv->bpp,
+                   GEGL_ABYSS_NONE);
+
+  return tile;
+}
+
+static void
+gimp_tile_backend_xcf_write (GimpTileBackendXcf *backend_xcf,
+                             gint                x,
+                             gint                y,
+                             GeglTile           *tile)
+{
+  GimpTileBackendXcfPrivate *priv    = backend_xcf->priv;
+  GeglTileBackend           *backend = GEGL_TILE_BACKEND (backend_xcf);
+  GeglRectangle              rect;
+
+  gimp_tile_backend_xcf_get_rect (backend_xcf, x, y, &rect);
+
+  /* modified tiles are evicted to a regular, swap-backed buffer, so that
+   * they take no more memory than those of any other buffer.
+   */
+  if (! priv->store)
+    {
+      priv->store = g_object_new (GEGL_TYPE_BUFFER,
+                                  "format",      gegl_tile_backend_get_format (backend),
+                                  "x",           0,
+                                  "y",           0,
+                                  "width",       priv->width,
+                                  "height",      priv->height,
+                                  "tile-width",  XCF_TILE_WIDTH,
+                                  "tile-height", XCF_TILE_HEIGHT,
+                                  NULL);
+    }
+
+  gegl_buffer_set (priv->store, &rect, 0,
+                   gegl_tile_backend_get_format (backend),
+                   gegl_tile_get_data (tile),
+                   XCF_TILE_WIDTH * priv->bpp);
+
+  priv->tile_state[y * priv->n_tile_cols + x] = TILE_IN_STORE;
+}
@@ -0,0 +1,81 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimptilebackendxcf.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_TILE_BACKEND_XCF_H__
+#define __GIMP_TILE_BACKEND_XCF_H__
+
+#include <gegl-buffer-backend.h>
+
+/***
+ * GimpTileBackendXcf is a GeglTileBackend that reads the tiles of a
+ * drawable from an XCF file on first access.  Tiles written back by the
+ * tile cache are kept in a regular buffer from then on.
+ */
+
+G_BEGIN_DECLS
+
+#define GIMP_TYPE_TILE_BACKEND_XCF            (gimp_tile_backend_xcf_get_type ())
+#define GIMP_TILE_BACKEND_XCF(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_TILE_BACKEND_XCF, GimpTileBackendXcf))
+#define GIMP_TILE_BACKEND_XCF_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_TILE_BACKEND_XCF, GimpTileBackendXcfClass))
+#define GIMP_IS_TILE_BACKEND_XCF(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_TILE_BACKEND_XCF))
+#define GIMP_IS_TILE_BACKEND_XCF_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_TILE_BACKEND_XCF))
+#define GIMP_TILE_BACKEND_XCF_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_TILE_BACKEND_XCF, GimpTileBackendXcfClass))
+
+
+typedef struct _GimpTileBackendXcf        GimpTileBackendXcf;
+typedef struct _GimpTileBackendXcfClass   GimpTileBackendXcfClass;
+typedef struct _GimpTileBackendXcfPrivate GimpTileBackendXcfPrivate;
+
+struct _GimpTileBackendXcf
+{
+  GeglTileBackend            parent_instance;
+
+  GimpTileBackendXcfPrivate *priv;
+};
+
+struct _GimpTileBackendXcfClass
+{
+  GeglTileBackendClass parent_class;
+};
+
+
+GimpTileBackendXcfInput * gimp_tile_backend_xcf_input_new   (GFile                    *file,
+                                                             GError                  **error);
+GimpTileBackendXcfInput * gimp_tile_backend_xcf_input_ref   (GimpTileBackendXcfInput  *input);
+void                      gimp_tile_backend_xcf_input_unref (GimpTileBackendXcfInput  *input);
+gsize                     gimp_tile_backend_xcf_input_read  (GimpTileBackendXcfInput  *input,
+                                                             goffset                   offset,
+                                                             guchar                   *buffer,
+                                                             gsize                     count);
+
+GType                     gimp_tile_backend_xcf_get_type    (void) G_GNUC_CONST;
+
+GeglTileBackend         * gimp_tile_backend_xcf_new         (GimpTileBackendXcfInput  *input,
+                                                             gint                      file_version,
+                                                             XcfCompressionType        compression,
+                                                             const Babl               *format,
+                                                             gint                      width,
+                                                             gint                      height,
+                                                             goffset                  *offsets,
+                                                             goffset                   max_data_length);
+
+
+G_END_DECLS
+
+#endif /* __GIMP_TILE_BACKEND_XCF_H__ */
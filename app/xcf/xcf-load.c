@@ -77,6 +77,8 @@
 #include "xcf-seek.h"
 #include "xcf-utils.h"
 
+#include "gimptilebackendxcf.h"
+
 #include "gimp-log.h"
 #include "gimp-intl.h"
 
@@ -86,6 +88,32 @@
 /* #define GIMP_XCF_PATH_DEBUG */
 
 
+/* Per batch data for xcf_load_tile_parallel */
+typedef struct
+{
+  /* Common to all jobs. */
+  GeglBuffer         *buffer;
+  const Babl         *format;
+  gint                file_version;
+  XcfCompressionType  compression;
+
+  /* Job specific. */
+  gint                tile;
+  gint                batch_size;
+
+  /* Compressed data of the whole batch, reused across jobs. */
+  guchar             *in_data;
+  goffset             in_data_size;
+  gint                in_data_offset[XCF_TILE_LOAD_BATCH_SIZE];
+  gint                in_data_len[XCF_TILE_LOAD_BATCH_SIZE];
+
+  /* Return data. */
+  gboolean            success;
+  guchar             *tile_data;
+  gboolean            tile_nonzero[XCF_TILE_LOAD_BATCH_SIZE];
+} XcfLoadJobData;
+
+
 static void            xcf_load_add_masks     (GimpImage     *image);
 static gboolean        xcf_load_image_props   (XcfInfo       *info,
                                                GimpImage     *image);
@@ -121,19 +149,35 @@ static GimpVectors   * xcf_load_vectors       (XcfInfo       *info,
 static GimpLayerMask * xcf_load_layer_mask    (XcfInfo       *info,
                                                GimpImage     *image);
 static gboolean        xcf_load_buffer        (XcfInfo       *info,
-                                               GeglBuffer    *buffer);
+                                               GimpDrawable  *drawable);
 static gboolean        xcf_load_level         (XcfInfo       *info,
-                                               GeglBuffer    *buffer);
+                                               GimpDrawable  *drawable);
+static goffset         xcf_load_tile_end      (const goffset *offsets,
+                                               gint           tile,
+                                               goffset        max_data_length);
+static gboolean        xcf_load_level_parallel
+                                              (XcfInfo       *info,
+                                               GeglBuffer    *buffer,
+                                               const goffset *offsets,
+                                               gint           ntiles,
+                                               goffset        max_data_length,
+                                               gint           num_processors);
+static gboolean        xcf_load_read_job_data (XcfInfo       *info,
+                                               const goffset *offsets,
+                                               goffset        max_data_length,
+                                               XcfLoadJobData *job_data);
+static void            xcf_load_free_job_data (XcfLoadJobData *data);
+static gint            xcf_load_sort_job_data (XcfLoadJobData *data1,
+                                               XcfLoadJobData *data2,
+                                               gpointer       user_data);
+static void            xcf_load_tile_parallel (XcfLoadJobData *job_data,
+                                               GAsyncQueue   *queue);
 static gboolean        xcf_load_tile          (XcfInfo       *info,
                                                GeglBuffer    *buffer,
                                                GeglRectangle *tile_rect,
                                                const Babl    *format);
-static gboolean        xcf_load_tile_rle      (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format,
-                                               gint           data_length);
-static gboolean        xcf_load_tile_zlib     (XcfInfo       *info,
+static gboolean        xcf_load_tile_compressed
+                                              (XcfInfo       *info,
                                                GeglBuffer    *buffer,
                                                GeglRectangle *tile_rect,
                                                const Babl    *format,
@@ -2635,8 +2679,7 @@ xcf_load_layer (XcfInfo    *info,
 
       GIMP_LOG (XCF, "loading buffer");
 
-      if (! xcf_load_buffer (info,
-                             gimp_drawable_get_buffer (GIMP_DRAWABLE (layer))))
+      if (! xcf_load_buffer (info, GIMP_DRAWABLE (layer)))
         goto error;
 
       GIMP_LOG (XCF, "buffer loaded");
@@ -2760,8 +2803,7 @@ xcf_load_channel (XcfInfo   *info,
   if (! xcf_seek_pos (info, hierarchy_offset, NULL))
     goto error;
 
-  if (! xcf_load_buffer (info,
-                         gimp_drawable_get_buffer (GIMP_DRAWABLE (channel))))
+  if (! xcf_load_buffer (info, GIMP_DRAWABLE (channel)))
     goto error;
 
   xcf_progress_update (info);
@@ -3010,8 +3052,7 @@ xcf_load_layer_mask (XcfInfo   *info,
   if (! xcf_seek_pos (info, hierarchy_offset, NULL))
     goto error;
 
-  if (! xcf_load_buffer (info,
-                         gimp_drawable_get_buffer (GIMP_DRAWABLE (layer_mask))))
+  if (! xcf_load_buffer (info, GIMP_DRAWABLE (layer_mask)))
     goto error;
 
   xcf_progress_update (info);
@@ -3039,9 +3080,10 @@ xcf_load_layer_mask (XcfInfo   *info,
 }
 
 static gboolean
-xcf_load_buffer (XcfInfo    *info,
-                 GeglBuffer *buffer)
+xcf_load_buffer (XcfInfo      *info,
+                 GimpDrawable *drawable)
 {
+  GeglBuffer *buffer = gimp_drawable_get_buffer (drawable);
   const Babl *format;
   goffset     offset;
   gint        width;
@@ -3077,7 +3119,7 @@ xcf_load_buffer (XcfInfo    *info,
     return FALSE;
 
   /* read in the level */
-  if (! xcf_load_level (info, buffer))
+  if (! xcf_load_level (info, drawable))
     return FALSE;
 
   /* discard levels below first.
@@ -3088,22 +3130,24 @@ xcf_load_buffer (XcfInfo    *info,
 
 
 static gboolean
-xcf_load_level (XcfInfo    *info,
-                GeglBuffer *buffer)
+xcf_load_level (XcfInfo      *info,
+                GimpDrawable *drawable)
 {
+  GeglBuffer *buffer = gimp_drawable_get_buffer (drawable);
   const Babl *format;
   gint        bpp;
-  goffset     saved_pos;
-  goffset     offset;
-  goffset     offset2;
+  goffset    *offsets;
+  goffset     table_end;
   goffset     max_data_length;
   gint        n_tile_rows;
   gint        n_tile_cols;
-  guint       ntiles;
+  gint        ntiles;
   gint        width;
   gint        height;
+  gint        num_processors;
   gint        i;
-  gint        fail;
+  GTimer     *timer;
+  gboolean    success = TRUE;
 
   format = gegl_buffer_get_format (buffer);
   bpp    = babl_format_get_bytes_per_pixel (format);
@@ -3122,321 +3166,470 @@ xcf_load_level (XcfInfo    *info,
   max_data_length = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp *
                     XCF_TILE_MAX_DATA_LENGTH_FACTOR /* = 1.5, currently */;
 
+  n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
+  n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
+
+  ntiles = n_tile_rows * n_tile_cols;
+
+  /* read the whole offset table up front, so that the tile data can be
+   * fetched without seeking back and forth.  allocate ntiles + 1 slots,
+   * since a zero offset indicates the table's end.
+   */
+  offsets = g_new (goffset, ntiles + 1);
+
   /* read in the first tile offset.
    *  if it is '0', then this tile level is empty
    *  and we can simply return.
    */
-  xcf_read_offset (info, &offset, 1);
-  if (offset == 0)
-    return TRUE;
+  xcf_read_offset (info, offsets, 1);
+  if (offsets[0] == 0)
+    {
+      g_free (offsets);
 
-  n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
-  n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
+      return TRUE;
+    }
+
+  xcf_read_offset (info, offsets + 1, ntiles);
+
+  table_end = info->cp;
 
-  ntiles = n_tile_rows * n_tile_cols;
   for (i = 0; i < ntiles; i++)
     {
-      GeglRectangle rect;
+      goffset offset2;
 
-      fail = FALSE;
-
-      if (offset == 0)
+      if (offsets[i] == 0)
         {
           gimp_message_literal (info->gimp, G_OBJECT (info->progress),
                                 GIMP_MESSAGE_ERROR,
                                 "not enough tiles found in level");
+          g_free (offsets);
+
           return FALSE;
         }
 
-      /* save the current position as it is where the
-       *  next tile offset is stored.
+      /* if the next offset is 0 then we need to read in the maximum
+       * possible allowing for negative compression
        */
-      saved_pos = info->cp;
+      offset2 = xcf_load_tile_end (offsets, i, max_data_length);
 
-      /* read in the offset of the next tile so we can calculate the amount
-       * of data needed for this tile
-       */
-      xcf_read_offset (info, &offset2, 1);
-
-      /* if the offset is 0 then we need to read in the maximum possible
-       * allowing for negative compression
-       */
-      if (offset2 == 0)
-        offset2 = offset + max_data_length;
-
-      /* seek to the tile offset */
-      if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
-
-      if (offset2 < offset || offset2 - offset > max_data_length)
+      if (offset2 < offsets[i] || offset2 - offsets[i] > max_data_length)
         {
           gimp_message (info->gimp, G_OBJECT (info->progress),
                         GIMP_MESSAGE_ERROR,
                         "invalid tile data length: %" G_GOFFSET_FORMAT,
-                        offset2 - offset);
+                        offset2 - offsets[i]);
+          g_free (offsets);
+
           return FALSE;
         }
+    }
 
-      /* get buffer rectangle to write to */
-      gimp_gegl_buffer_get_tile_rect (buffer,
-                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
-                                      i, &rect);
+  if (offsets[ntiles] != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %" G_GOFFSET_FORMAT,
+                    offsets[ntiles]);
+      g_free (offsets);
 
-      GIMP_LOG (XCF, "loading tile %d/%d", i + 1, ntiles);
+      return FALSE;
+    }
 
-      /* read in the tile */
-      switch (info->compression)
-        {
-        case COMPRESS_NONE:
-          if (! xcf_load_tile (info, buffer, &rect, format))
-            fail = TRUE;
-          break;
-        case COMPRESS_RLE:
-          if (! xcf_load_tile_rle (info, buffer, &rect, format,
-                                   offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_ZLIB:
-          if (! xcf_load_tile_zlib (info, buffer, &rect, format,
-                                    offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_FRACTAL:
-          g_printerr ("xcf: fractal compression unimplemented. "
-                      "Possibly corrupt XCF file.");
-          fail = TRUE;
-          break;
-        default:
-          g_printerr ("xcf: unknown compression. "
-                      "Possibly corrupt XCF file.");
-          fail = TRUE;
-          break;
-        }
+  if (info->lazy_input &&
+      (info->compression == COMPRESS_NONE ||
+       info->compression == COMPRESS_RLE  ||
+       info->compression == COMPRESS_ZLIB))
+    {
+      GeglTileBackend *backend;
+      GeglBuffer      *lazy_buffer;
 
-      if (fail)
-        return FALSE;
+      /* don't read the tiles now, but replace the drawable's buffer with
+       * one that reads them from the file on first access.
+       */
+      backend = gimp_tile_backend_xcf_new (info->lazy_input,
+                                           info->file_version,
+                                           info->compression,
+                                           format, width, height,
+                                           offsets, max_data_length);
 
-      GIMP_LOG (XCF, "loaded tile %d/%d", i + 1, ntiles);
+      lazy_buffer = gegl_buffer_new_for_backend (NULL, backend);
+      g_object_unref (backend);
 
-      /* restore the saved position so we'll be ready to
-       *  read the next offset.
-       */
-      if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
+      gimp_drawable_set_buffer (drawable, FALSE, NULL, lazy_buffer);
+      g_object_unref (lazy_buffer);
 
-      /* read in the offset of the next tile */
-      xcf_read_offset (info, &offset, 1);
-    }
+      GIMP_LOG (XCF, "level %d x %d: %d tiles deferred", width, height, ntiles);
 
-  if (offset != 0)
-    {
-      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
-                    "encountered garbage after reading level: %" G_GOFFSET_FORMAT,
-                    offset);
-      return FALSE;
+      return xcf_seek_pos (info, table_end, NULL);
     }
 
-  return TRUE;
-}
+  num_processors = GIMP_GEGL_CONFIG (info->gimp->config)->num_processors;
 
-static gboolean
-xcf_load_tile (XcfInfo       *info,
-               GeglBuffer    *buffer,
-               GeglRectangle *tile_rect,
-               const Babl    *format)
-{
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
+  timer = g_timer_new ();
 
-  if (info->file_version <= 11)
+  if ((info->compression == COMPRESS_RLE ||
+       info->compression == COMPRESS_ZLIB) &&
+      num_processors > 1                   &&
+      ntiles > XCF_TILE_LOAD_BATCH_SIZE)
     {
-      xcf_read_int8 (info, tile_data, tile_size);
+      success = xcf_load_level_parallel (info, buffer, offsets, ntiles,
+                                         max_data_length, num_processors);
     }
   else
     {
-      gint n_components = babl_format_get_n_components (format);
+      /* non parallel implementation */
+      for (i = 0; success && i < ntiles; i++)
+        {
+          GeglRectangle rect;
+          goffset       offset2 = xcf_load_tile_end (offsets, i,
+                                                     max_data_length);
 
-      xcf_read_component (info, bpp / n_components, tile_data,
-                          tile_size / bpp * n_components);
+          /* seek to the tile offset */
+          if (! xcf_seek_pos (info, offsets[i], NULL))
+            {
+              success = FALSE;
+              break;
+            }
+
+          /* get buffer rectangle to write to */
+          gimp_gegl_buffer_get_tile_rect (buffer,
+                                          XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                          i, &rect);
+
+          GIMP_LOG (XCF, "loading tile %d/%d", i + 1, ntiles);
+
+          /* read in the tile */
+          switch (info->compression)
+            {
+            case COMPRESS_NONE:
+              success = xcf_load_tile (info, buffer, &rect, format);
+              break;
+            case COMPRESS_RLE:
+            case COMPRESS_ZLIB:
+              success = xcf_load_tile_compressed (info, buffer, &rect, format,
+                                                  offset2 - offsets[i]);
+              break;
+            case COMPRESS_FRACTAL:
+              g_printerr ("xcf: fractal compression unimplemented. "
+                          "Possibly corrupt XCF file.");
+              success = FALSE;
+              break;
+            default:
+              g_printerr ("xcf: unknown compression. "
+                          "Possibly corrupt XCF file.");
+              success = FALSE;
+              break;
+            }
+
+          GIMP_LOG (XCF, "loaded tile %d/%d", i + 1, ntiles);
+        }
     }
 
-  if (! xcf_data_is_zero (tile_data, tile_size))
+  GIMP_LOG (XCF, "level %d x %d: %d tiles loaded in %0.4f seconds",
+            width, height, ntiles, g_timer_elapsed (timer, NULL));
+
+  g_timer_destroy (timer);
+  g_free (offsets);
+
+  /* restore the position to the end of the offset table, where the
+   * caller expects it.
+   */
+  if (success && ! xcf_seek_pos (info, table_end, NULL))
+    return FALSE;
+
+  return success;
+}
+
+/* returns the end offset of tile 'tile' in the offset table.  the data
+ * length of the last tile is not known, so assume the maximal length,
+ * which may extend past the end of the file.
+ */
+static goffset
+xcf_load_tile_end (const goffset *offsets,
+                   gint           tile,
+                   goffset        max_data_length)
+{
+  if (offsets[tile + 1] != 0)
+    return offsets[tile + 1];
+  else
+    return offsets[tile] + max_data_length;
+}
+
+/* The parallel loader is a three-stage pipeline: the calling thread reads
+ * the compressed data of a batch of consecutive tiles in a single read,
+ * and hands it to a thread pool for decompression.  Decompressed batches
+ * are then written to the buffer by the calling thread, in file order.
+ */
+static gboolean
+xcf_load_level_parallel (XcfInfo       *info,
+                         GeglBuffer    *buffer,
+                         const goffset *offsets,
+                         gint           ntiles,
+                         goffset        max_data_length,
+                         gint           num_processors)
+{
+  const Babl      *format    = gegl_buffer_get_format (buffer);
+  gint             bpp       = babl_format_get_bytes_per_pixel (format);
+  gint             tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
+  GThreadPool     *pool;
+  GAsyncQueue     *queue;
+  GQueue           pending   = G_QUEUE_INIT;
+  GSList          *free_jobs = NULL;
+  XcfLoadJobData  *job_data;
+  gint             max_jobs  = num_processors * 2;
+  gint             n_jobs    = 0;
+  gint             next_read = 0;
+  gint             next_tile = 0;
+  gboolean         success   = TRUE;
+
+  /* The free function passed to the queue and thread pool will likely never
+   * be used, as we always wait for all the jobs we pushed.
+   */
+  queue = g_async_queue_new_full ((GDestroyNotify) xcf_load_free_job_data);
+  pool  = g_thread_pool_new_full ((GFunc) xcf_load_tile_parallel,
+                                  queue,
+                                  (GDestroyNotify) xcf_load_free_job_data,
+                                  num_processors, TRUE, NULL);
+
+  while (TRUE)
     {
-      gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                       GEGL_AUTO_ROWSTRIDE);
+      gint k;
+
+      /* Read stage: keep enough batches in flight to keep all the threads
+       * busy.
+       */
+      while (success && next_read < ntiles && n_jobs < max_jobs)
+        {
+          if (free_jobs)
+            {
+              job_data  = free_jobs->data;
+              free_jobs = g_slist_delete_link (free_jobs, free_jobs);
+            }
+          else
+            {
+              job_data = g_new0 (XcfLoadJobData, 1);
+              job_data->buffer       = buffer;
+              job_data->format       = format;
+              job_data->file_version = info->file_version;
+              job_data->compression  = info->compression;
+              job_data->tile_data    = g_malloc (tile_size *
+                                                 XCF_TILE_LOAD_BATCH_SIZE);
+            }
+
+          job_data->tile       = next_read;
+          job_data->batch_size = MIN (XCF_TILE_LOAD_BATCH_SIZE,
+                                      ntiles - next_read);
+
+          if (! xcf_load_read_job_data (info, offsets, max_data_length,
+                                        job_data))
+            {
+              xcf_load_free_job_data (job_data);
+              success = FALSE;
+              break;
+            }
+
+          next_read += job_data->batch_size;
+          n_jobs++;
+
+          g_thread_pool_push (pool, job_data, NULL);
+        }
+
+      if (n_jobs == 0)
+        break;
+
+      /* Write stage: wait for the next batch in file order. */
+      while (! (job_data = g_queue_peek_head (&pending)) ||
+             job_data->tile != next_tile)
+        {
+          g_queue_insert_sorted (&pending, g_async_queue_pop (queue),
+                                 (GCompareDataFunc) xcf_load_sort_job_data,
+                                 NULL);
+        }
+
+      g_queue_pop_head (&pending);
+      n_jobs--;
+
+      if (! job_data->success)
+        success = FALSE;
+
+      for (k = 0; success && k < job_data->batch_size; k++)
+        {
+          GeglRectangle rect;
+
+          if (! job_data->tile_nonzero[k])
+            continue;
+
+          gimp_gegl_buffer_get_tile_rect (buffer,
+                                          XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                          job_data->tile + k, &rect);
+
+          gegl_buffer_set (buffer, &rect, 0, format,
+                           job_data->tile_data + tile_size * k,
+                           GEGL_AUTO_ROWSTRIDE);
+        }
+
+      next_tile += job_data->batch_size;
+
+      free_jobs = g_slist_prepend (free_jobs, job_data);
     }
 
-  return TRUE;
+  g_thread_pool_free (pool, FALSE, TRUE);
+  g_async_queue_unref (queue);
+
+  g_slist_free_full (free_jobs, (GDestroyNotify) xcf_load_free_job_data);
+
+  return success;
 }
 
 static gboolean
-xcf_load_tile_rle (XcfInfo       *info,
-                   GeglBuffer    *buffer,
-                   GeglRectangle *tile_rect,
-                   const Babl    *format,
-                   gint           data_length)
+xcf_load_read_job_data (XcfInfo        *info,
+                        const goffset  *offsets,
+                        goffset        max_data_length,
+                        XcfLoadJobData *job_data)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  guchar  nonzero   = FALSE;
+  goffset start = offsets[job_data->tile];
+  goffset end;
   gsize   bytes_read;
-  gint    i;
-  guchar *xcfdata;
-  guchar *xcfodata;
-  guchar *xcfdatalimit;
+  gint    k;
 
-  /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
-   * contain any data.  It is better than returning FALSE, which would
-   * skip the whole hierarchy while there may still be some valid
-   * tiles in the file.
+  /* the tiles of a batch are stored back to back, so fetch the whole range
+   * with a single read.
    */
-  if (data_length <= 0)
-    return TRUE;
+  end = xcf_load_tile_end (offsets,
+                           job_data->tile + job_data->batch_size - 1,
+                           max_data_length);
 
-  xcfdata = xcfodata = g_alloca (data_length);
+  if (end - start > job_data->in_data_size)
+    {
+      job_data->in_data_size = end - start;
+      job_data->in_data      = g_realloc (job_data->in_data,
+                                          job_data->in_data_size);
+    }
+
+  if (! xcf_seek_pos (info, start, NULL))
+    return FALSE;
 
   /* we have to read directly instead of xcf_read_* because we may be
    * reading past the end of the file here
    */
-  g_input_stream_read_all (info->input, xcfdata, data_length,
+  g_input_stream_read_all (info->input, job_data->in_data, end - start,
                            &bytes_read, NULL, NULL);
   info->cp += bytes_read;
 
-  if (bytes_read == 0)
-    return TRUE;
-
-  xcfdatalimit = &xcfodata[bytes_read - 1];
-
-  for (i = 0; i < bpp; i++)
+  for (k = 0; k < job_data->batch_size; k++)
     {
-      guchar *data  = tile_data + i;
-      gint    size  = tile_rect->width * tile_rect->height;
-      gint    count = 0;
-      guchar  val;
-      gint    length;
-      gint    j;
+      goffset tile_start = offsets[job_data->tile + k] - start;
+      goffset tile_end   = xcf_load_tile_end (offsets, job_data->tile + k,
+                                              max_data_length) - start;
 
-      while (size > 0)
-        {
-          if (xcfdata > xcfdatalimit)
-            {
-              goto bogus_rle;
-            }
-
-          val = *xcfdata++;
-
-          length = val;
-          if (length >= 128)
-            {
-              length = 255 - (length - 1);
-              if (length == 128)
-                {
-                  if (xcfdata >= xcfdatalimit)
-                    {
-                      goto bogus_rle;
-                    }
-
-                  length = (*xcfdata << 8) + xcfdata[1];
-                  xcfdata += 2;
-                }
+      job_data->in_data_offset[k] = tile_start;
+      job_data->in_data_len[k]    = CLAMP ((goffset) bytes_read,
+                                           tile_start, tile_end) - tile_start;
+    }
 
-              count += length;
-              size -= length;
+  return TRUE;
+}
 
-              if (size < 0)
-                {
-                  goto bogus_rle;
-                }
+static void
+xcf_load_free_job_data (XcfLoadJobData *data)
+{
+  g_free (data->in_data);
+  g_free (data->tile_data);
+  g_free (data);
+}
 
-              if (&xcfdata[length-1] > xcfdatalimit)
-                {
-                  goto bogus_rle;
-                }
+static gint
+xcf_load_sort_job_data (XcfLoadJobData *data1,
+                        XcfLoadJobData *data2,
+                        gpointer        user_data)
+{
+  if (data1->tile < data2->tile)
+    return -1;
+  else if (data1->tile > data2->tile)
+    return 1;
+  else
+    return 0;
+}
 
-              while (length-- > 0)
-                {
-                  *data = *xcfdata++;
-                  nonzero |= *data;
-                  data += bpp;
-                }
-            }
-          else
-            {
-              length += 1;
-              if (length == 128)
-                {
-                  if (xcfdata >= xcfdatalimit)
-                    {
-                      goto bogus_rle;
-                    }
+static void
+xcf_load_tile_parallel (XcfLoadJobData *job_data,
+                        GAsyncQueue    *queue)
+{
+  gint bpp       = babl_format_get_bytes_per_pixel (job_data->format);
+  gint tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
+  gint k;
 
-                  length = (*xcfdata << 8) + xcfdata[1];
-                  xcfdata += 2;
-                }
+  job_data->success = TRUE;
 
-              count += length;
-              size -= length;
+  for (k = 0; k < job_data->batch_size; k++)
+    {
+      GeglRectangle tile_rect;
 
-              if (size < 0)
-                {
-                  goto bogus_rle;
-                }
+      gimp_gegl_buffer_get_tile_rect (job_data->buffer,
+                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                      job_data->tile + k, &tile_rect);
+
+      if (! xcf_decode_tile (job_data->compression,
+                             job_data->file_version,
+                             job_data->format,
+                             job_data->in_data +
+                             job_data->in_data_offset[k],
+                             job_data->in_data_len[k],
+                             job_data->tile_data + tile_size * k,
+                             tile_rect.width * tile_rect.height,
+                             &job_data->tile_nonzero[k]))
+        {
+          job_data->success = FALSE;
+          break;
+        }
+    }
 
-              if (xcfdata > xcfdatalimit)
-                {
-                  goto bogus_rle;
-                }
+  g_async_queue_push (queue, job_data);
+}
 
-              val = *xcfdata++;
-              nonzero |= val;
+static gboolean
+xcf_load_tile (XcfInfo       *info,
+               GeglBuffer    *buffer,
+               GeglRectangle *tile_rect,
+               const Babl    *format)
+{
+  gint    bpp       = babl_format_get_bytes_per_pixel (format);
+  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
+  guchar *tile_data = g_alloca (tile_size);
 
-              for (j = 0; j < length; j++)
-                {
-                  *data = val;
-                  data += bpp;
-                }
-            }
-        }
+  if (info->file_version <= 11)
+    {
+      xcf_read_int8 (info, tile_data, tile_size);
     }
-
-  if (nonzero)
+  else
     {
-      if (info->file_version >= 12)
-        {
-          gint n_components = babl_format_get_n_components (format);
+      gint n_components = babl_format_get_n_components (format);
 
-          xcf_read_from_be (bpp / n_components, tile_data,
-                            tile_size / bpp * n_components);
-        }
+      xcf_read_component (info, bpp / n_components, tile_data,
+                          tile_size / bpp * n_components);
+    }
 
+  if (! xcf_data_is_zero (tile_data, tile_size))
+    {
       gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
                        GEGL_AUTO_ROWSTRIDE);
     }
 
   return TRUE;
-
- bogus_rle:
-  return FALSE;
 }
 
 static gboolean
-xcf_load_tile_zlib (XcfInfo       *info,
-                    GeglBuffer    *buffer,
-                    GeglRectangle *tile_rect,
-                    const Babl    *format,
-                    gint           data_length)
+xcf_load_tile_compressed (XcfInfo       *info,
+                          GeglBuffer    *buffer,
+                          GeglRectangle *tile_rect,
+                          const Babl    *format,
+                          gint           data_length)
 {
-  z_stream  strm;
-  int       action;
-  int       status;
   gint      bpp       = babl_format_get_bytes_per_pixel (format);
   gint      tile_size = bpp * tile_rect->width * tile_rect->height;
   guchar   *tile_data = g_alloca (tile_size);
   gsize     bytes_read;
   guchar   *xcfdata;
+  gboolean  nonzero;
 
   /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
    * this tile (return TRUE without storing data) as if it did not
@@ -3456,69 +3649,20 @@ xcf_load_tile_zlib (XcfInfo       *info,
                            &bytes_read, NULL, NULL);
   info->cp += bytes_read;
 
-  if (bytes_read == 0)
-    return TRUE;
-
-  strm.next_out  = tile_data;
-  strm.avail_out = tile_size;
-
-  strm.zalloc    = Z_NULL;
-  strm.zfree     = Z_NULL;
-  strm.opaque    = Z_NULL;
-  strm.next_in   = xcfdata;
-  strm.avail_in  = bytes_read;
-
-  /* Initialize the stream decompression. */
-  status = inflateInit (&strm);
-  if (status != Z_OK)
-    return FALSE;
-
-  action = Z_NO_FLUSH;
-
-  while (status == Z_OK)
+  if (! xcf_decode_tile (info->compression, info->file_version, format,
+                         xcfdata, bytes_read,
+                         tile_data, tile_rect->width * tile_rect->height,
+                         &nonzero))
     {
-      if (strm.avail_in == 0)
-        {
-          action = Z_FINISH;
-        }
-
-      status = inflate (&strm, action);
-
-      if (status == Z_STREAM_END)
-        {
-          /* All the data was successfully decoded. */
-          break;
-        }
-      else if (status == Z_BUF_ERROR)
-        {
-          g_printerr ("xcf: decompressed tile bigger than the expected size.");
-          inflateEnd (&strm);
-          return FALSE;
-        }
-      else if (status != Z_OK)
-        {
-          g_printerr ("xcf: tile decompression failed: %s", zError (status));
-          inflateEnd (&strm);
-          return FALSE;
-        }
+      return FALSE;
     }
 
-  if (! xcf_data_is_zero (tile_data, tile_size))
+  if (nonzero)
     {
-      if (info->file_version >= 12)
-        {
-          gint n_components = babl_format_get_n_components (format);
-
-          xcf_read_from_be (bpp / n_components, tile_data,
-                            tile_size / bpp * n_components);
-        }
-
       gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
                        GEGL_AUTO_ROWSTRIDE);
     }
 
-  inflateEnd (&strm);
-
   return TRUE;
 }
 
@@ -23,6 +23,7 @@
 #define XCF_TILE_HEIGHT                 64
 #define XCF_TILE_MAX_DATA_LENGTH_FACTOR 1.5
 #define XCF_TILE_SAVE_BATCH_SIZE        128
+#define XCF_TILE_LOAD_BATCH_SIZE        32
 
 typedef enum
 {
@@ -97,7 +98,8 @@ typedef enum
   XCF_GROUP_ITEM_EXPANDED      = 1
 } XcfGroupItemFlagsType;
 
-typedef struct _XcfInfo  XcfInfo;
+typedef struct _XcfInfo                 XcfInfo;
+typedef struct _GimpTileBackendXcfInput GimpTileBackendXcfInput;
 
 struct _XcfInfo
 {
@@ -130,6 +132,9 @@ struct _XcfInfo
   goffset             floating_sel_offset;
   XcfCompressionType  compression;
   gint                file_version;
+
+  /* when set, drawable pixels are read from this input on demand */
+  GimpTileBackendXcfInput *lazy_input;
 };
 
 
@@ -17,13 +17,34 @@
 
 #include "config.h"
 
+#include <string.h>
+#include <zlib.h>
+
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+
+#include "xcf-private.h"
+#include "xcf-read.h"
 #include "xcf-utils.h"
 
 
+static gboolean   xcf_decode_tile_rle  (const guchar *xcfdata,
+                                        gsize         data_length,
+                                        guchar       *tile_data,
+                                        gint          bpp,
+                                        gint          n_pixels,
+                                        gboolean     *nonzero);
+static gboolean   xcf_decode_tile_zlib (const guchar *xcfdata,
+                                        gsize         data_length,
+                                        guchar       *tile_data,
+                                        gint          tile_size);
+
+
 gboolean
 xcf_data_is_zero (const void *data,
                   gint        size)
@@ -51,3 +72,239 @@ xcf_data_is_zero (const void *data,
 
   return TRUE;
 }
+
+/* decodes the on-disk data of a tile into 'tile_data', converting it to
+ * native byte order.  'nonzero' is set to whether the tile has any
+ * non-zero data, that is, whether it needs to be written to the buffer at
+ * all.  this function only touches its arguments, and may be called from
+ * any thread.
+ */
+gboolean
+xcf_decode_tile (XcfCompressionType  compression,
+                 gint                file_version,
+                 const Babl         *format,
+                 const guchar       *xcfdata,
+                 gsize               data_length,
+                 guchar             *tile_data,
+                 gint                n_pixels,
+                 gboolean           *nonzero)
+{
+  gint bpp       = babl_format_get_bytes_per_pixel (format);
+  gint tile_size = bpp * n_pixels;
+
+  *nonzero = FALSE;
+
+  if (data_length == 0)
+    return TRUE;
+
+  switch (compression)
+    {
+    case COMPRESS_NONE:
+      memcpy (tile_data, xcfdata, MIN (data_length, (gsize) tile_size));
+
+      if (data_length < (gsize) tile_size)
+        memset (tile_data + data_length, 0, tile_size - data_length);
+
+      *nonzero = ! xcf_data_is_zero (tile_data, tile_size);
+      break;
+
+    case COMPRESS_RLE:
+      if (! xcf_decode_tile_rle (xcfdata, data_length, tile_data, bpp, n_pixels,
+                                 nonzero))
+        return FALSE;
+      break;
+
+    case COMPRESS_ZLIB:
+      if (! xcf_decode_tile_zlib (xcfdata, data_length, tile_data, tile_size))
+        return FALSE;
+
+      *nonzero = ! xcf_data_is_zero (tile_data, tile_size);
+      break;
+
+    default:
+      g_return_val_if_reached (FALSE);
+    }
+
+  if (*nonzero && file_version >= 12)
+    {
+      gint n_components = babl_format_get_n_components (format);
+
+      xcf_read_from_be (bpp / n_components, tile_data,
+                        tile_size / bpp * n_components);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+xcf_decode_tile_rle (const guchar *xcfdata,
+                     gsize         data_length,
+                     guchar       *tile_data,
+                     gint          bpp,
+                     gint          n_pixels,
+                     gboolean     *nonzero)
+{
+  const guchar *xcfdatalimit;
+  guchar        any_nonzero = FALSE;
+  gint          i;
+
+  xcfdatalimit = &xcfdata[data_length - 1];
+
+  for (i = 0; i < bpp; i++)
+    {
+      guchar *data  = tile_data + i;
+      gint    size  = n_pixels;
+      gint    count = 0;
+      guchar  val;
+      gint    length;
+      gint    j;
+
+      while (size > 0)
+        {
+          if (xcfdata > xcfdatalimit)
+            {
+              goto bogus_rle;
+            }
+
+          val = *xcfdata++;
+
+          length = val;
+          if (length >= 128)
+            {
+              length = 255 - (length - 1);
+              if (length == 128)
+                {
+                  if (xcfdata >= xcfdatalimit)
+                    {
+                      goto bogus_rle;
+                    }
+
+                  length = (*xcfdata << 8) + xcfdata[1];
+                  xcfdata += 2;
+                }
+
+              count += length;
+              size -= length;
+
+              if (size < 0)
+                {
+                  goto bogus_rle;
+                }
+
+              if (&xcfdata[length-1] > xcfdatalimit)
+                {
+                  goto bogus_rle;
+                }
+
+              while (length-- > 0)
+                {
+                  *data = *xcfdata++;
+                  any_nonzero |= *data;
+                  data += bpp;
+                }
+            }
+          else
+            {
+              length += 1;
+              if (length == 128)
+                {
+                  if (xcfdata >= xcfdatalimit)
+                    {
+                      goto bogus_rle;
+                    }
+
+                  length = (*xcfdata << 8) + xcfdata[1];
+                  xcfdata += 2;
+                }
+
+              count += length;
+              size -= length;
+
+              if (size < 0)
+                {
+                  goto bogus_rle;
+                }
+
+              if (xcfdata > xcfdatalimit)
+                {
+                  goto bogus_rle;
+                }
+
+              val = *xcfdata++;
+              any_nonzero |= val;
+
+              for (j = 0; j < length; j++)
+                {
+                  *data = val;
+                  data += bpp;
+                }
+            }
+        }
+    }
+
+  *nonzero = any_nonzero != 0;
+
+  return TRUE;
+
+ bogus_rle:
+  return FALSE;
+}
+
+static gboolean
+xcf_decode_tile_zlib (const guchar *xcfdata,
+                      gsize         data_length,
+                      guchar       *tile_data,
+                      gint          tile_size)
+{
+  z_stream  strm;
+  int       action;
+  int       status;
+
+  strm.next_out  = tile_data;
+  strm.avail_out = tile_size;
+
+  strm.zalloc    = Z_NULL;
+  strm.zfree     = Z_NULL;
+  strm.opaque    = Z_NULL;
+  strm.next_in   = (guchar *) xcfdata;
+  strm.avail_in  = data_length;
+
+  /* Initialize the stream decompression. */
+  status = inflateInit (&strm);
+  if (status != Z_OK)
+    return FALSE;
+
+  action = Z_NO_FLUSH;
+
+  while (status == Z_OK)
+    {
+      if (strm.avail_in == 0)
+        {
+          action = Z_FINISH;
+        }
+
+      status = inflate (&strm, action);
+
+      if (status == Z_STREAM_END)
+        {
+          /* All the data was successfully decoded. */
+          break;
+        }
+      else if (status == Z_BUF_ERROR)
+        {
+          g_printerr ("xcf: decompressed tile bigger than the expected size.");
+          inflateEnd (&strm);
+          return FALSE;
+        }
+      else if (status != Z_OK)
+        {
+          g_printerr ("xcf: tile decompression failed: %s", zError (status));
+          inflateEnd (&strm);
+          return FALSE;
+        }
+    }
+
+  inflateEnd (&strm);
+
+  return TRUE;
+}
@@ -19,8 +19,17 @@
 #define __XCF_UTILS_H__
 
 
-gboolean   xcf_data_is_zero (const void *data,
-                             gint        size);
+gboolean   xcf_data_is_zero (const void         *data,
+                             gint                size);
+
+gboolean   xcf_decode_tile  (XcfCompressionType  compression,
+                             gint                file_version,
+                             const Babl         *format,
+                             const guchar       *xcfdata,
+                             gsize               data_length,
+                             guchar             *tile_data,
+                             gint                n_pixels,
+                             gboolean           *nonzero);
 
 
 #endif  /* __XCF_UTILS_H__ */
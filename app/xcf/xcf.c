@@ -26,9 +26,12 @@
 #include <gegl.h>
 
 #include "libgimpbase/gimpbase.h"
+#include "libgimpconfig/gimpconfig.h"
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpdrawable.h"
@@ -44,6 +47,9 @@
 #include "xcf-read.h"
 #include "xcf-save.h"
 
+#include "gimptilebackendxcf.h"
+
+#include "gimp-log.h"
 #include "gimp-intl.h"
 
 
@@ -65,6 +71,10 @@ static GimpValueArray * xcf_save_invoker (GimpProcedure         *procedure,
                                           const GimpValueArray  *args,
                                           GError               **error);
 
+static GimpTileBackendXcfInput *
+                        xcf_lazy_input_new (Gimp                  *gimp,
+                                            GFile                 *file);
+
 
 static GimpXcfLoaderFunc * const xcf_loaders[] =
 {
@@ -273,6 +283,9 @@ xcf_load_stream (Gimp          *gimp,
   info.file             = input_file;
   info.compression      = COMPRESS_NONE;
 
+  if (GIMP_CORE_CONFIG (gimp->config)->xcf_lazy_loading)
+    info.lazy_input = xcf_lazy_input_new (gimp, input_file);
+
   if (progress)
     gimp_progress_start (progress, FALSE, _("Opening '%s'"), filename);
 
@@ -306,8 +319,15 @@ xcf_load_stream (Gimp          *gimp,
       if (info.file_version >= 0 &&
           info.file_version < G_N_ELEMENTS (xcf_loaders))
         {
+          GTimer *timer = g_timer_new ();
+
           image = (*(xcf_loaders[info.file_version])) (gimp, &info, error);
 
+          GIMP_LOG (XCF, "'%s' loaded in %0.4f seconds",
+                    filename, g_timer_elapsed (timer, NULL));
+
+          g_timer_destroy (timer);
+
           if (! image)
             success = FALSE;
 
@@ -322,6 +342,8 @@ xcf_load_stream (Gimp          *gimp,
         }
     }
 
+  g_clear_pointer (&info.lazy_input, gimp_tile_backend_xcf_input_unref);
+
   if (progress)
     gimp_progress_end (progress);
 
@@ -500,3 +522,51 @@ xcf_save_invoker (GimpProcedure         *procedure,
 
   return return_vals;
 }
+
+/* opens the input the drawables of an image read their pixels from, when
+ * loading lazily.  the file must be a plain, local XCF file, which stays
+ * around after loading.
+ */
+static GimpTileBackendXcfInput *
+xcf_lazy_input_new (Gimp  *gimp,
+                    GFile *file)
+{
+  GimpTileBackendXcfInput *input;
+  GFile                   *temp_dir;
+  gboolean                 is_temp;
+  gchar                    id[9];
+
+  if (! file || ! g_file_is_native (file))
+    return NULL;
+
+  /* compressed files (.xcf.gz, .xcf.bz2, .xcf.xz, ...) are decompressed
+   * by the file-compressor plug-in into a temporary file, which is
+   * deleted right after loading
+   */
+  temp_dir = gimp_file_new_for_config_path (GIMP_GEGL_CONFIG (gimp->config)->temp_path,
+                                            NULL);
+  is_temp  = temp_dir && g_file_has_prefix (file, temp_dir);
+
+  g_clear_object (&temp_dir);
+
+  if (is_temp)
+    return NULL;
+
+  input = gimp_tile_backend_xcf_input_new (file, NULL);
+
+  if (! input)
+    return NULL;
+
+  /* the stream being loaded may not be the file's raw contents */
+  if (gimp_tile_backend_xcf_input_read (input, 0,
+                                        (guchar *) id, sizeof (id)) != sizeof (id) ||
+      memcmp (id, "gimp xcf ", sizeof (id)))
+    {
+      GIMP_LOG (XCF, "'%s' is not a plain XCF file, loading eagerly",
+                gimp_file_get_utf8_name (file));
+
+      g_clear_pointer (&input, gimp_tile_backend_xcf_input_unref);
+    }
+
+  return input;
+}
@@ -43,6 +43,19 @@
 
 #endif /* USE_POSIX_SHM */
 
+/*  drawable snapshots are memfds which the plug-in opens through the
+ *  core's /proc/<pid>/fd, which only works like that on Linux
+ */
+#if defined(HAVE_MEMFD_CREATE) && defined(__linux__)
+#define USE_MEMFD_SNAPSHOT 1
+#endif
+
+#ifdef USE_MEMFD_SNAPSHOT
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 #include <glib.h>
 
 #if defined(G_OS_WIN32) || defined(G_WITH_CYGWIN)
@@ -63,10 +76,14 @@
 #endif
 
 #include "gimp.h"
+
+#include "libgimpbase/gimpprotocol.h"
+
 #include "gimp-shm.h"
 
 
-#define TILE_MAP_SIZE     (gimp_tile_width () * gimp_tile_height () * 32)
+#define TILE_MAP_SIZE     (gimp_tile_width () * gimp_tile_height () * 32 * \
+                           GP_TILE_REGION_MAX_TILES)
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
 
@@ -201,3 +218,65 @@ _gimp_shm_close (void)
 
 #endif
 }
+
+/*  Returns whether drawable snapshots can be mapped at all; where they
+ *  can't, the plug-in doesn't ask for them, and transfers tiles.
+ */
+gboolean
+_gimp_shm_can_map_snapshot (void)
+{
+#ifdef USE_MEMFD_SNAPSHOT
+  static gint can_map = -1;
+
+  if (can_map == -1)
+    can_map = g_file_test ("/proc/self/fd", G_FILE_TEST_IS_DIR);
+
+  return can_map;
+#else
+  return FALSE;
+#endif
+}
+
+/*  Maps a drawable snapshot created by the core (see GPDrawableMap)
+ *  copy-on-write, so the plug-in can modify its mapping without
+ *  touching the snapshot. Returns NULL on failure.
+ */
+guchar *
+_gimp_shm_map_snapshot (gint  pid,
+                        gint  fd,
+                        gsize size)
+{
+#ifdef USE_MEMFD_SNAPSHOT
+  gchar   path[64];
+  guchar *addr;
+  gint    map_fd;
+
+  g_snprintf (path, sizeof (path), "/proc/%d/fd/%d", pid, fd);
+
+  map_fd = open (path, O_RDONLY | O_CLOEXEC);
+
+  if (map_fd == -1)
+    return NULL;
+
+  addr = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, map_fd, 0);
+
+  close (map_fd);
+
+  if (addr == MAP_FAILED)
+    return NULL;
+
+  return addr;
+#else
+  return NULL;
+#endif
+}
+
+void
+_gimp_shm_unmap_snapshot (guchar *addr,
+                          gsize   size)
+{
+#ifdef USE_MEMFD_SNAPSHOT
+  if (addr)
+    munmap (addr, size);
+#endif
+}
@@ -29,6 +29,13 @@ guchar * _gimp_shm_addr  (void);
 void     _gimp_shm_open  (gint shm_ID);
 void     _gimp_shm_close (void);
 
+gboolean _gimp_shm_can_map_snapshot (void);
+guchar * _gimp_shm_map_snapshot     (gint    pid,
+                                     gint    fd,
+                                     gsize   size);
+void     _gimp_shm_unmap_snapshot   (guchar *addr,
+                                     gsize   size);
+
 
 G_END_DECLS
 
@@ -97,7 +97,7 @@
  */
 
 
-#define WRITE_BUFFER_SIZE 1024
+#define WRITE_BUFFER_SIZE 8192
 
 /**
  * gimp_plug_in_error_quark:
@@ -156,6 +156,8 @@ struct _GimpPlugInPrivate
   GHashTable *images;
   GHashTable *items;
   GHashTable *resources;
+
+  gboolean    map_drawables;
 };
 
 
@@ -185,6 +187,9 @@ static gboolean   gimp_plug_in_write             (GIOChannel      *channel,
                                                   gpointer         user_data);
 static gboolean   gimp_plug_in_flush             (GIOChannel      *channel,
                                                   gpointer         user_data);
+static gboolean   gimp_plug_in_write_chars       (GIOChannel      *channel,
+                                                  const gchar     *buf,
+                                                  gsize            count);
 static gboolean   gimp_plug_in_io_error_handler  (GIOChannel      *channel,
                                                   GIOCondition     cond,
                                                   gpointer         data);
@@ -797,6 +802,56 @@ gimp_plug_in_get_pdb_error_handler (GimpPlugIn *plug_in)
   return _gimp_plug_in_get_pdb_error_handler ();
 }
 
+/**
+ * gimp_plug_in_set_map_drawables:
+ * @plug_in:       A plug-in
+ * @map_drawables: Whether to map drawable buffers.
+ *
+ * Sets whether buffers returned by gimp_drawable_get_buffer() map a
+ * snapshot of the drawable's pixels, instead of transferring the
+ * pixels one tile at a time. Shadow buffers are never mapped.
+ *
+ * The snapshot is a copy of the whole drawable, which the core makes
+ * in one pass when the buffer is created, so this is not zero-copy:
+ * it trades the per-tile round trips for one copy, and for the memory
+ * of the snapshot while the buffer exists. A mapped buffer does not
+ * see later changes made to the drawable by the core. Writes are sent
+ * to the core as usual. This is useful for plug-ins that read the
+ * whole drawable, like file exporters.
+ *
+ * Mapping is currently only supported on Linux. Elsewhere, this
+ * setting is ignored, and tiles are transferred as usual.
+ *
+ * Since: 3.0
+ **/
+void
+gimp_plug_in_set_map_drawables (GimpPlugIn *plug_in,
+                                gboolean    map_drawables)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN (plug_in));
+
+  plug_in->priv->map_drawables = map_drawables ? TRUE : FALSE;
+}
+
+/**
+ * gimp_plug_in_get_map_drawables:
+ * @plug_in: A plug-in
+ *
+ * Returns whether drawable buffers map a shared snapshot of the
+ * drawable. See gimp_plug_in_set_map_drawables() for details.
+ *
+ * Returns: %TRUE if drawable buffers are mapped.
+ *
+ * Since: 3.0
+ **/
+gboolean
+gimp_plug_in_get_map_drawables (GimpPlugIn *plug_in)
+{
+  g_return_val_if_fail (GIMP_IS_PLUG_IN (plug_in), FALSE);
+
+  return plug_in->priv->map_drawables;
+}
+
 
 /*  internal functions  */
 
@@ -1130,6 +1185,15 @@ gimp_plug_in_write (GIOChannel   *channel,
 {
   GimpPlugIn *plug_in = user_data;
 
+  /*  big blocks, like tile data and arrays, are not copied through the
+   *  buffer, but written right after what it holds
+   */
+  if (count >= WRITE_BUFFER_SIZE)
+    {
+      return (gimp_wire_flush (channel, plug_in) &&
+              gimp_plug_in_write_chars (channel, (const gchar *) buf, count));
+    }
+
   while (count > 0)
     {
       gulong bytes;
@@ -1167,45 +1231,55 @@ gimp_plug_in_flush (GIOChannel *channel,
 
   if (plug_in->priv->write_buffer_index > 0)
     {
-      gsize count = 0;
+      if (! gimp_plug_in_write_chars (channel,
+                                      plug_in->priv->write_buffer,
+                                      plug_in->priv->write_buffer_index))
+        return FALSE;
+
+      plug_in->priv->write_buffer_index = 0;
+    }
 
-      while (count != plug_in->priv->write_buffer_index)
+  return TRUE;
+}
+
+static gboolean
+gimp_plug_in_write_chars (GIOChannel  *channel,
+                          const gchar *buf,
+                          gsize        count)
+{
+  while (count > 0)
+    {
+      GIOStatus  status;
+      gsize      bytes;
+      GError    *error = NULL;
+
+      do
         {
-          GIOStatus status;
-          gsize     bytes;
-          GError   *error = NULL;
+          bytes = 0;
+          status = g_io_channel_write_chars (channel, buf, count,
+                                             &bytes,
+                                             &error);
+        }
+      while (status == G_IO_STATUS_AGAIN);
 
-          do
+      if (status != G_IO_STATUS_NORMAL)
+        {
+          if (error)
             {
-              bytes = 0;
-              status = g_io_channel_write_chars (channel,
-                                                 &plug_in->priv->write_buffer[count],
-                                                 (plug_in->priv->write_buffer_index - count),
-                                                 &bytes,
-                                                 &error);
+              g_warning ("%s: gimp_flush(): error: %s",
+                         g_get_prgname (), error->message);
+              g_error_free (error);
             }
-          while (status == G_IO_STATUS_AGAIN);
-
-          if (status != G_IO_STATUS_NORMAL)
+          else
             {
-              if (error)
-                {
-                  g_warning ("%s: gimp_flush(): error: %s",
-                             g_get_prgname (), error->message);
-                  g_error_free (error);
-                }
-              else
-                {
-                  g_warning ("%s: gimp_flush(): error", g_get_prgname ());
-                }
-
-              return FALSE;
+              g_warning ("%s: gimp_flush(): error", g_get_prgname ());
             }
 
-          count += bytes;
+          return FALSE;
         }
 
-      plug_in->priv->write_buffer_index = 0;
+      buf   += bytes;
+      count -= bytes;
     }
 
   return TRUE;
@@ -1246,6 +1320,9 @@ gimp_plug_in_loop (GimpPlugIn *plug_in)
         case GP_TILE_REQ:
         case GP_TILE_ACK:
         case GP_TILE_DATA:
+        case GP_DRAWABLE_MAP_REQ:
+        case GP_DRAWABLE_MAP:
+        case GP_DRAWABLE_MAP_ACK:
           g_warning ("unexpected tile message received (should not happen)");
           break;
 
@@ -1308,6 +1385,9 @@ gimp_plug_in_process_message (GimpPlugIn      *plug_in,
     case GP_TILE_REQ:
     case GP_TILE_ACK:
     case GP_TILE_DATA:
+    case GP_DRAWABLE_MAP_REQ:
+    case GP_DRAWABLE_MAP:
+    case GP_DRAWABLE_MAP_ACK:
       g_warning ("unexpected tile message received (should not happen)");
       break;
     case GP_PROC_RUN:
@@ -51,18 +51,46 @@ struct _GimpTile
 };
 
 
+typedef struct _GimpTileMapping GimpTileMapping;
+
+struct _GimpTileMapping
+{
+  gint    ref_count;
+
+  guchar *data;     /* the mapped drawable snapshot */
+  gsize   size;
+};
+
+
 struct _GimpTileBackendPluginPrivate
 {
-  gint32   drawable_id;
-  gboolean shadow;
-  gint     width;
-  gint     height;
-  gint     bpp;
-  gint     ntile_rows;
-  gint     ntile_cols;
+  gint32    drawable_id;
+  gboolean  shadow;
+  gint      width;
+  gint      height;
+  gint      bpp;
+  gint      ntile_rows;
+  gint      ntile_cols;
+
+  /* read-ahead state, the tiles following the last requested one in
+   * the same tile row, fetched with a single GP_TILE_REQ
+   */
+  gint      next_row;
+  gint      next_col;
+  gint      n_read_ahead;
+
+  gint      ahead_row;
+  gint      ahead_col;
+  gint      n_ahead;
+  GeglTile *ahead[GP_TILE_REGION_MAX_TILES];
+
+  /* the drawable snapshot, if mapped */
+  GimpTileMapping *mapping;
 };
 
 
+static void       gimp_tile_backend_plugin_finalize (GObject        *object);
+
 static gpointer   gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
                                                     GeglTileCommand  command,
                                                     gint             x,
@@ -84,11 +112,31 @@ static gboolean   gimp_tile_init  (GimpTileBackendPlugin *backend_plugin,
                                    gint                   col);
 static void       gimp_tile_unset (GimpTileBackendPlugin *backend_plugin,
                                    GimpTile              *tile);
-static void       gimp_tile_get   (GimpTileBackendPlugin *backend_plugin,
-                                   GimpTile              *tile);
+static gint       gimp_tile_get   (GimpTileBackendPlugin *backend_plugin,
+                                   gint                   row,
+                                   gint                   col,
+                                   gint                   n_tiles,
+                                   GeglTile             **tiles);
 static void       gimp_tile_put   (GimpTileBackendPlugin *backend_plugin,
                                    GimpTile              *tile);
 
+static void       gimp_tile_map         (GimpTileBackendPlugin *backend_plugin);
+static GeglTile * gimp_tile_map_read    (GimpTileBackendPlugin *backend_plugin,
+                                         gint                   x,
+                                         gint                   y);
+static void       gimp_tile_map_write   (GimpTileBackendPlugin *backend_plugin,
+                                         gint                   x,
+                                         gint                   y,
+                                         GeglTile              *tile);
+
+static GimpTileMapping * gimp_tile_mapping_ref   (GimpTileMapping *mapping);
+static void              gimp_tile_mapping_unref (GimpTileMapping *mapping);
+
+static GeglTile * gimp_tile_ahead_take  (GimpTileBackendPlugin *backend_plugin,
+                                         gint                   row,
+                                         gint                   col);
+static void       gimp_tile_ahead_clear (GimpTileBackendPlugin *backend_plugin);
+
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpTileBackendPlugin, _gimp_tile_backend_plugin,
                             GEGL_TYPE_TILE_BACKEND)
@@ -102,6 +150,9 @@ static GMutex backend_plugin_mutex;
 static void
 _gimp_tile_backend_plugin_class_init (GimpTileBackendPluginClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gimp_tile_backend_plugin_finalize;
 }
 
 static void
@@ -114,6 +165,18 @@ _gimp_tile_backend_plugin_init (GimpTileBackendPlugin *backend)
   source->command = gimp_tile_backend_plugin_command;
 }
 
+static void
+gimp_tile_backend_plugin_finalize (GObject *object)
+{
+  GimpTileBackendPlugin *backend_plugin = GIMP_TILE_BACKEND_PLUGIN (object);
+
+  gimp_tile_ahead_clear (backend_plugin);
+
+  g_clear_pointer (&backend_plugin->priv->mapping, gimp_tile_mapping_unref);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static gpointer
 gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
                                   GeglTileCommand  command,
@@ -145,8 +208,16 @@ gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
       /* TODO: actually store mipmapped tiles */
       if (z == 0)
         {
+          GeglTile *ahead;
+
           g_mutex_lock (&backend_plugin_mutex);
 
+          /*  a read-ahead copy of this tile is stale now  */
+          ahead = gimp_tile_ahead_take (backend_plugin, y, x);
+
+          if (ahead)
+            gegl_tile_unref (ahead);
+
           gimp_tile_write (backend_plugin, x, y, data);
 
           g_mutex_unlock (&backend_plugin_mutex);
@@ -156,6 +227,11 @@ gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
       break;
 
     case GEGL_TILE_FLUSH:
+      g_mutex_lock (&backend_plugin_mutex);
+
+      gimp_tile_ahead_clear (backend_plugin);
+
+      g_mutex_unlock (&backend_plugin_mutex);
       break;
 
     default:
@@ -196,9 +272,19 @@ _gimp_tile_backend_plugin_new (GimpDrawable *drawable,
   backend_plugin->priv->ntile_rows  = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
   backend_plugin->priv->ntile_cols  = (width  + TILE_WIDTH  - 1) / TILE_WIDTH;
 
+  backend_plugin->priv->n_read_ahead = 1;
+
   gegl_tile_backend_set_extent (backend,
                                 GEGL_RECTANGLE (0, 0, width, height));
 
+  /*  shadow buffers are written, not read, there is nothing to map  */
+  if (! shadow                                             &&
+      gimp_plug_in_get_map_drawables (gimp_get_plug_in ()) &&
+      _gimp_shm_can_map_snapshot ())
+    {
+      gimp_tile_map (backend_plugin);
+    }
+
   return backend;
 }
 
@@ -210,43 +296,60 @@ gimp_tile_read (GimpTileBackendPlugin *backend_plugin,
                 gint                   x,
                 gint                   y)
 {
-  GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
-  GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
-  GeglTile                     *tile;
-  GimpTile                      gimp_tile = { 0, };
-  gint                          tile_size;
-  guchar                       *tile_data;
+  GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
+  GeglTile                     *tiles[GP_TILE_REGION_MAX_TILES];
+  gboolean                      sequential;
+  gint                          n_tiles;
+  gint                          i;
 
-  if (! gimp_tile_init (backend_plugin, &gimp_tile, y, x))
-    return NULL;
+  if (y > priv->ntile_rows - 1 ||
+      x > priv->ntile_cols - 1)
+    {
+      return NULL;
+    }
 
-  tile_size  = gegl_tile_backend_get_tile_size (backend);
-  tile       = gegl_tile_new (tile_size);
-  tile_data  = gegl_tile_get_data (tile);
+  if (priv->mapping)
+    return gimp_tile_map_read (backend_plugin, x, y);
 
-  gimp_tile_get (backend_plugin, &gimp_tile);
+  sequential = (y == priv->next_row && x == priv->next_col);
 
-  if (gimp_tile.ewidth * gimp_tile.eheight * priv->bpp == tile_size)
+  if (x < priv->ntile_cols - 1)
     {
-      memcpy (tile_data, gimp_tile.data, tile_size);
+      priv->next_row = y;
+      priv->next_col = x + 1;
     }
   else
     {
-      gint  tile_stride      = TILE_WIDTH * priv->bpp;
-      gint  gimp_tile_stride = gimp_tile.ewidth * priv->bpp;
-      guint row;
-
-      for (row = 0; row < gimp_tile.eheight; row++)
-        {
-          memcpy (tile_data      + row * tile_stride,
-                  gimp_tile.data + row * gimp_tile_stride,
-                  gimp_tile_stride);
-        }
+      priv->next_row = y + 1;
+      priv->next_col = 0;
     }
 
-  gimp_tile_unset (backend_plugin, &gimp_tile);
+  tiles[0] = gimp_tile_ahead_take (backend_plugin, y, x);
 
-  return tile;
+  if (tiles[0])
+    return tiles[0];
+
+  /*  grow the read-ahead window while the tiles are requested in
+   *  scanline order, and fall back to single tiles otherwise
+   */
+  if (sequential)
+    priv->n_read_ahead = MIN (priv->n_read_ahead * 2, GP_TILE_REGION_MAX_TILES);
+  else
+    priv->n_read_ahead = 1;
+
+  n_tiles = MIN (priv->n_read_ahead, priv->ntile_cols - x);
+  n_tiles = gimp_tile_get (backend_plugin, y, x, n_tiles, tiles);
+
+  gimp_tile_ahead_clear (backend_plugin);
+
+  priv->ahead_row = y;
+  priv->ahead_col = x + 1;
+  priv->n_ahead   = n_tiles - 1;
+
+  for (i = 1; i < n_tiles; i++)
+    priv->ahead[i - 1] = tiles[i];
+
+  return tiles[0];
 }
 
 static gboolean
@@ -264,6 +367,9 @@ gimp_tile_write (GimpTileBackendPlugin *backend_plugin,
   if (! gimp_tile_init (backend_plugin, &gimp_tile, y, x))
     return FALSE;
 
+  if (priv->mapping)
+    gimp_tile_map_write (backend_plugin, x, y, tile);
+
   tile_size = gegl_tile_backend_get_tile_size (backend);
   tile_data = gegl_tile_get_data (tile);
 
@@ -333,19 +439,32 @@ gimp_tile_unset (GimpTileBackendPlugin *backend_plugin,
   g_clear_pointer (&tile->data, g_free);
 }
 
-static void
-gimp_tile_get (GimpTileBackendPlugin *backend_plugin,
-               GimpTile              *tile)
+static gint
+gimp_tile_get (GimpTileBackendPlugin  *backend_plugin,
+               gint                    row,
+               gint                    col,
+               gint                    n_tiles,
+               GeglTile              **tiles)
 {
   GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
+  GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
   GimpPlugIn                   *plug_in = gimp_get_plug_in ();
   GPTileReq                     tile_req;
   GPTileData                   *tile_data;
   GimpWireMessage               msg;
+  GimpTile                      gimp_tile = { 0, };
+  const guchar                 *src;
+  gint                          tile_size;
+  gint                          tile_stride;
+  guint                         width;
+  gint                          i;
+
+  gimp_tile_init (backend_plugin, &gimp_tile, row, col);
 
   tile_req.drawable_id = priv->drawable_id;
-  tile_req.tile_num    = tile->tile_num;
+  tile_req.tile_num    = gimp_tile.tile_num;
   tile_req.shadow      = priv->shadow;
+  tile_req.n_tiles     = n_tiles;
 
   if (! gp_tile_req_write (_gimp_plug_in_get_write_channel (plug_in),
                            &tile_req, plug_in))
@@ -354,42 +473,92 @@ gimp_tile_get (GimpTileBackendPlugin *backend_plugin,
   _gimp_plug_in_read_expect_msg (plug_in, &msg, GP_TILE_DATA);
 
   tile_data = msg.data;
-  if (tile_data->drawable_id != priv->drawable_id ||
-      tile_data->tile_num    != tile->tile_num    ||
-      tile_data->shadow      != priv->shadow      ||
-      tile_data->width       != tile->ewidth      ||
-      tile_data->height      != tile->eheight     ||
+
+  /*  the core may send fewer tiles than requested, but never more  */
+  width = (tile_data->n_tiles - 1) * TILE_WIDTH;
+
+  if (tile_data->n_tiles >= 1 && tile_data->n_tiles <= n_tiles)
+    {
+      GimpTile last_tile;
+
+      gimp_tile_init (backend_plugin, &last_tile,
+                      row, col + tile_data->n_tiles - 1);
+
+      width += last_tile.ewidth;
+    }
+
+  if (tile_data->drawable_id != priv->drawable_id  ||
+      tile_data->tile_num    != gimp_tile.tile_num ||
+      tile_data->shadow      != priv->shadow       ||
+      tile_data->n_tiles     <  1                  ||
+      tile_data->n_tiles     >  n_tiles            ||
+      tile_data->width       != width              ||
+      tile_data->height      != gimp_tile.eheight  ||
       tile_data->bpp         != priv->bpp)
     {
 #if 0
-      g_printerr ("tile_data: %d %d %d %d %d %d\n"
-                  "tile:      %d %d %d %d %d %d\n",
+      g_printerr ("tile_data: %d %d %d %d %d %d %d\n"
+                  "tile:      %d %d %d %d %d %d %d\n",
                   tile_data->drawable_id,
                   tile_data->tile_num,
                   tile_data->shadow,
+                  tile_data->n_tiles,
                   tile_data->width,
                   tile_data->height,
                   tile_data->bpp,
                   priv->drawable_id,
-                  tile->tile_num,
+                  gimp_tile.tile_num,
                   priv->shadow,
-                  tile->ewidth,
-                  tile->eheight,
+                  n_tiles,
+                  width,
+                  gimp_tile.eheight,
                   priv->bpp);
 #endif
       g_printerr ("received tile info did not match computed tile info");
       gimp_quit ();
     }
 
+  n_tiles = tile_data->n_tiles;
+
   if (tile_data->use_shm)
-    {
-      tile->data = g_memdup2 (_gimp_shm_addr (),
-                              tile->ewidth * tile->eheight * priv->bpp);
-    }
+    src = _gimp_shm_addr ();
   else
+    src = tile_data->data;
+
+  tile_size   = gegl_tile_backend_get_tile_size (backend);
+  tile_stride = TILE_WIDTH * priv->bpp;
+
+  /*  copy the tiles straight out of the message into the GEGL tiles  */
+  for (i = 0; i < n_tiles; i++)
     {
-      tile->data = tile_data->data;
-      tile_data->data = NULL;
+      guchar *data;
+      gint    gimp_tile_size;
+
+      gimp_tile_init (backend_plugin, &gimp_tile, row, col + i);
+
+      gimp_tile_size = gimp_tile.ewidth * gimp_tile.eheight * priv->bpp;
+
+      tiles[i] = gegl_tile_new (tile_size);
+      data     = gegl_tile_get_data (tiles[i]);
+
+      if (gimp_tile_size == tile_size)
+        {
+          memcpy (data, src, tile_size);
+        }
+      else
+        {
+          gint  gimp_tile_stride = gimp_tile.ewidth * priv->bpp;
+          guint y;
+
+          for (y = 0; y < gimp_tile.eheight; y++)
+            {
+              memcpy (data + y * tile_stride,
+                      src  + y * gimp_tile_stride,
+                      gimp_tile_stride);
+            }
+        }
+
+      src += gimp_tile_size;
     }
 
   if (! gp_tile_ack_write (_gimp_plug_in_get_write_channel (plug_in),
@@ -397,6 +566,8 @@ gimp_tile_get (GimpTileBackendPlugin *backend_plugin,
     gimp_quit ();
 
   gimp_wire_destroy (&msg);
+
+  return n_tiles;
 }
 
 static void
@@ -413,6 +584,7 @@ gimp_tile_put (GimpTileBackendPlugin *backend_plugin,
   tile_req.drawable_id = -1;
   tile_req.tile_num    = 0;
   tile_req.shadow      = 0;
+  tile_req.n_tiles     = 0;
 
   if (! gp_tile_req_write (_gimp_plug_in_get_write_channel (plug_in),
                            &tile_req, plug_in))
@@ -430,6 +602,7 @@ gimp_tile_put (GimpTileBackendPlugin *backend_plugin,
   tile_data.height      = tile->eheight;
   tile_data.use_shm     = tile_info->use_shm;
   tile_data.data        = NULL;
+  tile_data.n_tiles     = 1;
 
   if (tile_info->use_shm)
     {
@@ -455,3 +628,160 @@ gimp_tile_put (GimpTileBackendPlugin *backend_plugin,
 
   gimp_wire_destroy (&msg);
 }
+
+static void
+gimp_tile_map (GimpTileBackendPlugin *backend_plugin)
+{
+  GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
+  GimpPlugIn                   *plug_in = gimp_get_plug_in ();
+  GPDrawableMapReq              drawable_map_req;
+  GPDrawableMap                *drawable_map;
+  GimpWireMessage               msg;
+
+  drawable_map_req.drawable_id = priv->drawable_id;
+
+  if (! gp_drawable_map_req_write (_gimp_plug_in_get_write_channel (plug_in),
+                                   &drawable_map_req, plug_in))
+    gimp_quit ();
+
+  _gimp_plug_in_read_expect_msg (plug_in, &msg, GP_DRAWABLE_MAP);
+
+  drawable_map = msg.data;
+  if (drawable_map->drawable_id != priv->drawable_id ||
+      drawable_map->width       != priv->width       ||
+      drawable_map->height      != priv->height      ||
+      drawable_map->bpp         != priv->bpp)
+    {
+      g_printerr ("received drawable map info did not match drawable info");
+      gimp_quit ();
+    }
+
+  /*  no snapshot, fall back to transferring tiles  */
+  if (drawable_map->fd == -1)
+    {
+      gimp_wire_destroy (&msg);
+
+      return;
+    }
+
+  priv->mapping = g_slice_new0 (GimpTileMapping);
+
+  priv->mapping->ref_count = 1;
+  priv->mapping->size      = ((gsize) priv->ntile_rows * priv->ntile_cols *
+                              gegl_tile_backend_get_tile_size (GEGL_TILE_BACKEND (backend_plugin)));
+  priv->mapping->data      = _gimp_shm_map_snapshot (drawable_map->pid,
+                                                     drawable_map->fd,
+                                                     priv->mapping->size);
+
+  if (! priv->mapping->data)
+    g_clear_pointer (&priv->mapping, gimp_tile_mapping_unref);
+
+  /*  the core keeps the snapshot open until we have mapped it  */
+  if (! gp_drawable_map_ack_write (_gimp_plug_in_get_write_channel (plug_in),
+                                   plug_in))
+    gimp_quit ();
+
+  gimp_wire_destroy (&msg);
+}
+
+static GeglTile *
+gimp_tile_map_read (GimpTileBackendPlugin *backend_plugin,
+                    gint                   x,
+                    gint                   y)
+{
+  GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
+  GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
+  GeglTile                     *tile;
+  gint                          tile_size;
+
+  tile_size = gegl_tile_backend_get_tile_size (backend);
+
+  /*  let the tile use the mapping in place, it is private to us  */
+  tile = gegl_tile_new_bare ();
+
+  gegl_tile_set_data_full (tile,
+                           priv->mapping->data +
+                           ((gsize) y * priv->ntile_cols + x) * tile_size,
+                           tile_size,
+                           (GDestroyNotify) gimp_tile_mapping_unref,
+                           gimp_tile_mapping_ref (priv->mapping));
+
+  return tile;
+}
+
+static void
+gimp_tile_map_write (GimpTileBackendPlugin *backend_plugin,
+                     gint                   x,
+                     gint                   y,
+                     GeglTile              *tile)
+{
+  GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
+  GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
+  guchar                       *tile_data;
+  guchar                       *map_data;
+  gint                          tile_size;
+
+  tile_size = gegl_tile_backend_get_tile_size (backend);
+  tile_data = gegl_tile_get_data (tile);
+  map_data  = priv->mapping->data +
+              ((gsize) y * priv->ntile_cols + x) * tile_size;
+
+  /*  if GEGL had to copy the tile, update our mapping so the tile
+   *  reads back correctly once it was dropped from the cache
+   */
+  if (tile_data != map_data)
+    memcpy (map_data, tile_data, tile_size);
+}
+
+static GimpTileMapping *
+gimp_tile_mapping_ref (GimpTileMapping *mapping)
+{
+  g_atomic_int_inc (&mapping->ref_count);
+
+  return mapping;
+}
+
+static void
+gimp_tile_mapping_unref (GimpTileMapping *mapping)
+{
+  if (g_atomic_int_dec_and_test (&mapping->ref_count))
+    {
+      _gimp_shm_unmap_snapshot (mapping->data, mapping->size);
+
+      g_slice_free (GimpTileMapping, mapping);
+    }
+}
+
+static GeglTile *
+gimp_tile_ahead_take (GimpTileBackendPlugin *backend_plugin,
+                      gint                   row,
+                      gint                   col)
+{
+  GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
+  GeglTile                     *tile;
+
+  if (row != priv->ahead_row                    ||
+      col <  priv->ahead_col                    ||
+      col >= priv->ahead_col + priv->n_ahead)
+    {
+      return NULL;
+    }
+
+  tile = priv->ahead[col - priv->ahead_col];
+
+  priv->ahead[col - priv->ahead_col] = NULL;
+
+  return tile;
+}
+
+static void
+gimp_tile_ahead_clear (GimpTileBackendPlugin *backend_plugin)
+{
+  GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
+  gint                          i;
+
+  for (i = 0; i < priv->n_ahead; i++)
+    g_clear_pointer (&priv->ahead[i], gegl_tile_unref);
+
+  priv->n_ahead = 0;
+}
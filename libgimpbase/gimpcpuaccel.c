@@ -126,11 +126,28 @@ enum
 {
   ARCH_X86_INTEL_FEATURE_PNI      = 1 << 0,
   ARCH_X86_INTEL_FEATURE_SSSE3    = 1 << 9,
+  ARCH_X86_INTEL_FEATURE_FMA      = 1 << 12,
   ARCH_X86_INTEL_FEATURE_SSE4_1   = 1 << 19,
   ARCH_X86_INTEL_FEATURE_SSE4_2   = 1 << 20,
+  ARCH_X86_INTEL_FEATURE_OSXSAVE  = 1 << 27,
   ARCH_X86_INTEL_FEATURE_AVX      = 1 << 28
 };
 
+/* extended features, cpuid leaf 7 */
+enum
+{
+  ARCH_X86_INTEL_FEATURE_AVX2     = 1 << 5,
+  ARCH_X86_INTEL_FEATURE_AVX512F  = 1 << 16
+};
+
+/* state components enabled by the OS, in XCR0 */
+enum
+{
+  ARCH_X86_XCR0_SSE               = 1 << 1,
+  ARCH_X86_XCR0_AVX               = 1 << 2,
+  ARCH_X86_XCR0_AVX512            = 7 << 5
+};
+
 #if !defined(ARCH_X86_64) && (defined(PIC) || defined(__PIC__))
 #define cpuid(op,eax,ebx,ecx,edx)  \
   __asm__ ("movl %%ebx, %%esi\n\t" \
@@ -141,6 +158,16 @@ enum
              "=c" (ecx),           \
              "=d" (edx)            \
            : "0" (op))
+#define cpuid_count(op,count,eax,ebx,ecx,edx) \
+  __asm__ ("movl %%ebx, %%esi\n\t"            \
+           "cpuid\n\t"                        \
+           "xchgl %%ebx,%%esi"                \
+           : "=a" (eax),                      \
+             "=S" (ebx),                      \
+             "=c" (ecx),                      \
+             "=d" (edx)                       \
+           : "0" (op),                        \
+             "2" (count))
 #else
 #define cpuid(op,eax,ebx,ecx,edx)  \
   __asm__ ("cpuid"                 \
@@ -149,8 +176,23 @@ enum
              "=c" (ecx),           \
              "=d" (edx)            \
            : "0" (op))
+#define cpuid_count(op,count,eax,ebx,ecx,edx) \
+  __asm__ ("cpuid"                            \
+           : "=a" (eax),                      \
+             "=b" (ebx),                      \
+             "=c" (ecx),                      \
+             "=d" (edx)                       \
+           : "0" (op),                        \
+             "2" (count))
 #endif
 
+/* xgetbv, spelled out for assemblers which don't know it */
+#define xgetbv(index,eax,edx)             \
+  __asm__ (".byte 0x0f, 0x01, 0xd0"       \
+           : "=a" (eax),                  \
+             "=d" (edx)                   \
+           : "c" (index))
+
 
 static X86Vendor
 arch_get_vendor (void)
@@ -237,6 +279,11 @@ arch_accel_intel (void)
 #ifdef USE_MMX
   {
     guint32 eax, ebx, ecx, edx;
+    guint32 max_leaf;
+
+    cpuid (0, eax, ebx, ecx, edx);
+
+    max_leaf = eax;
 
     cpuid (1, eax, ebx, ecx, edx);
 
@@ -264,8 +311,37 @@ arch_accel_intel (void)
     if (ecx & ARCH_X86_INTEL_FEATURE_SSE4_2)
       caps |= GIMP_CPU_ACCEL_X86_SSE4_2;
 
-    if (ecx & ARCH_X86_INTEL_FEATURE_AVX)
-      caps |= GIMP_CPU_ACCEL_X86_AVX;
+    /* the AVX family is only usable if the OS saves the wider registers
+     * on context switches, which it announces in XCR0
+     */
+    if ((ecx & ARCH_X86_INTEL_FEATURE_OSXSAVE) &&
+        (ecx & ARCH_X86_INTEL_FEATURE_AVX))
+      {
+        guint32 xcr0, xcr0_high;
+
+        xgetbv (0, xcr0, xcr0_high);
+
+        if ((xcr0 & (ARCH_X86_XCR0_SSE | ARCH_X86_XCR0_AVX)) ==
+            (ARCH_X86_XCR0_SSE | ARCH_X86_XCR0_AVX))
+          {
+            caps |= GIMP_CPU_ACCEL_X86_AVX;
+
+            if (ecx & ARCH_X86_INTEL_FEATURE_FMA)
+              caps |= GIMP_CPU_ACCEL_X86_FMA;
+
+            if (max_leaf >= 7)
+              {
+                cpuid_count (7, 0, eax, ebx, ecx, edx);
+
+                if (ebx & ARCH_X86_INTEL_FEATURE_AVX2)
+                  caps |= GIMP_CPU_ACCEL_X86_AVX2;
+
+                if ((ebx & ARCH_X86_INTEL_FEATURE_AVX512F) &&
+                    (xcr0 & ARCH_X86_XCR0_AVX512) == ARCH_X86_XCR0_AVX512)
+                  caps |= GIMP_CPU_ACCEL_X86_AVX512F;
+              }
+          }
+      }
 #endif /* USE_SSE */
   }
 #endif /* USE_MMX */
@@ -145,6 +145,30 @@ static void _gp_has_init_write           (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_has_init_destroy         (GimpWireMessage  *msg);
 
+static void _gp_drawable_map_req_read    (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_req_write   (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_req_destroy (GimpWireMessage  *msg);
+
+static void _gp_drawable_map_read        (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_write       (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_destroy     (GimpWireMessage  *msg);
+
+static void _gp_drawable_map_ack_read    (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_ack_write   (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_drawable_map_ack_destroy (GimpWireMessage  *msg);
+
 
 
 void
@@ -202,6 +226,18 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_DRAWABLE_MAP_REQ,
+                      _gp_drawable_map_req_read,
+                      _gp_drawable_map_req_write,
+                      _gp_drawable_map_req_destroy);
+  gimp_wire_register (GP_DRAWABLE_MAP,
+                      _gp_drawable_map_read,
+                      _gp_drawable_map_write,
+                      _gp_drawable_map_destroy);
+  gimp_wire_register (GP_DRAWABLE_MAP_ACK,
+                      _gp_drawable_map_ack_read,
+                      _gp_drawable_map_ack_write,
+                      _gp_drawable_map_ack_destroy);
 }
 
 /* public writing API */
@@ -449,6 +485,62 @@ gp_has_init_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_drawable_map_req_write (GIOChannel       *channel,
+                           GPDrawableMapReq *drawable_map_req,
+                           gpointer          user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_DRAWABLE_MAP_REQ;
+  msg.data = drawable_map_req;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_drawable_map_write (GIOChannel    *channel,
+                       GPDrawableMap *drawable_map,
+                       gpointer       user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_DRAWABLE_MAP;
+  msg.data = drawable_map;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_drawable_map_ack_write (GIOChannel *channel,
+                           gpointer    user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_DRAWABLE_MAP_ACK;
+  msg.data = NULL;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 /*  quit  */
 
 static void
@@ -721,6 +813,9 @@ _gp_tile_req_read (GIOChannel      *channel,
   if (! _gimp_wire_read_int32 (channel,
                                &tile_req->shadow, 1, user_data))
     goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_req->n_tiles, 1, user_data))
+    goto cleanup;
 
   msg->data = tile_req;
   return;
@@ -747,6 +842,9 @@ _gp_tile_req_write (GIOChannel      *channel,
   if (! _gimp_wire_write_int32 (channel,
                                 &tile_req->shadow, 1, user_data))
     return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_req->n_tiles, 1, user_data))
+    return;
 }
 
 static void
@@ -781,6 +879,12 @@ _gp_tile_ack_destroy (GimpWireMessage *msg)
 
 /*  tile_data  */
 
+/*  A GPTileData message carries a run of n_tiles horizontally adjacent
+ *  tiles of the same tile row. width is the total width of the run, and
+ *  the pixels of each tile are stored contiguously, one tile after the
+ *  other, so the payload is always width * height * bpp bytes.
+ */
+
 static void
 _gp_tile_data_read (GIOChannel      *channel,
                     GimpWireMessage *msg,
@@ -810,6 +914,9 @@ _gp_tile_data_read (GIOChannel      *channel,
   if (! _gimp_wire_read_int32 (channel,
                                &tile_data->use_shm, 1, user_data))
     goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_data->n_tiles, 1, user_data))
+    goto cleanup;
 
   if (!tile_data->use_shm)
     {
@@ -861,6 +968,9 @@ _gp_tile_data_write (GIOChannel      *channel,
   if (! _gimp_wire_write_int32 (channel,
                                 &tile_data->use_shm, 1, user_data))
     return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_data->n_tiles, 1, user_data))
+    return;
 
   if (!tile_data->use_shm)
     {
@@ -2079,3 +2189,154 @@ static void
 _gp_has_init_destroy (GimpWireMessage *msg)
 {
 }
+
+/*  drawable_map_req  */
+
+static void
+_gp_drawable_map_req_read (GIOChannel      *channel,
+                           GimpWireMessage *msg,
+                           gpointer         user_data)
+{
+  GPDrawableMapReq *drawable_map_req = g_slice_new0 (GPDrawableMapReq);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_map_req->drawable_id, 1,
+                               user_data))
+    goto cleanup;
+
+  msg->data = drawable_map_req;
+  return;
+
+ cleanup:
+  g_slice_free (GPDrawableMapReq, drawable_map_req);
+  msg->data = NULL;
+}
+
+static void
+_gp_drawable_map_req_write (GIOChannel      *channel,
+                            GimpWireMessage *msg,
+                            gpointer         user_data)
+{
+  GPDrawableMapReq *drawable_map_req = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_map_req->drawable_id, 1,
+                                user_data))
+    return;
+}
+
+static void
+_gp_drawable_map_req_destroy (GimpWireMessage *msg)
+{
+  GPDrawableMapReq *drawable_map_req = msg->data;
+
+  if (drawable_map_req)
+    g_slice_free (GPDrawableMapReq, drawable_map_req);
+}
+
+/*  drawable_map  */
+
+/*  A GPDrawableMap message names a file descriptor in the core process
+ *  (fd is -1 if no snapshot could be made) holding a copy of the
+ *  drawable, stored tile by tile in row-major order, every tile padded
+ *  to the full tile size.  If fd is not -1, the plug-in replies with
+ *  GP_DRAWABLE_MAP_ACK once it has mapped the copy, or failed to, and
+ *  the core closes the file descriptor.
+ */
+
+static void
+_gp_drawable_map_read (GIOChannel      *channel,
+                       GimpWireMessage *msg,
+                       gpointer         user_data)
+{
+  GPDrawableMap *drawable_map = g_slice_new0 (GPDrawableMap);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_map->drawable_id, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->bpp, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &drawable_map->height, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_map->pid, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &drawable_map->fd, 1,
+                               user_data))
+    goto cleanup;
+
+  msg->data = drawable_map;
+  return;
+
+ cleanup:
+  g_slice_free (GPDrawableMap, drawable_map);
+  msg->data = NULL;
+}
+
+static void
+_gp_drawable_map_write (GIOChannel      *channel,
+                        GimpWireMessage *msg,
+                        gpointer         user_data)
+{
+  GPDrawableMap *drawable_map = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_map->drawable_id, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->bpp, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->width, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &drawable_map->height, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_map->pid, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &drawable_map->fd, 1,
+                                user_data))
+    return;
+}
+
+static void
+_gp_drawable_map_destroy (GimpWireMessage *msg)
+{
+  GPDrawableMap *drawable_map = msg->data;
+
+  if (drawable_map)
+    g_slice_free (GPDrawableMap, drawable_map);
+}
+
+/*  drawable_map_ack  */
+
+static void
+_gp_drawable_map_ack_read (GIOChannel      *channel,
+                           GimpWireMessage *msg,
+                           gpointer         user_data)
+{
+}
+
+static void
+_gp_drawable_map_ack_write (GIOChannel      *channel,
+                            GimpWireMessage *msg,
+                            gpointer         user_data)
+{
+}
+
+static void
+_gp_drawable_map_ack_destroy (GimpWireMessage *msg)
+{
+}
@@ -26,7 +26,13 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0110
+#define GIMP_PROTOCOL_VERSION  0x0112
+
+
+/* The maximum number of tiles transferred by a single GP_TILE_REQ,
+ * the shared memory segment is sized to hold that many tiles
+ */
+#define GP_TILE_REGION_MAX_TILES  16
 
 
 enum
@@ -43,7 +49,10 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_DRAWABLE_MAP_REQ,
+  GP_DRAWABLE_MAP,
+  GP_DRAWABLE_MAP_ACK
 };
 
 typedef enum
@@ -81,6 +90,8 @@ typedef struct _GPConfig           GPConfig;
 typedef struct _GPTileReq          GPTileReq;
 typedef struct _GPTileAck          GPTileAck;
 typedef struct _GPTileData         GPTileData;
+typedef struct _GPDrawableMapReq   GPDrawableMapReq;
+typedef struct _GPDrawableMap      GPDrawableMap;
 typedef struct _GPParamDef         GPParamDef;
 typedef struct _GPParamDefInt      GPParamDefInt;
 typedef struct _GPParamDefUnit     GPParamDefUnit;
@@ -139,6 +150,9 @@ struct _GPTileReq
   gint32   drawable_id;
   guint32  tile_num;
   guint32  shadow;
+
+  /* since protocol version 0x0111: */
+  guint32  n_tiles;
 };
 
 struct _GPTileData
@@ -151,6 +165,24 @@ struct _GPTileData
   guint32  height;
   guint32  use_shm;
   guchar  *data;
+
+  /* since protocol version 0x0111: */
+  guint32  n_tiles;
+};
+
+struct _GPDrawableMapReq
+{
+  gint32   drawable_id;
+};
+
+struct _GPDrawableMap
+{
+  gint32   drawable_id;
+  guint32  bpp;
+  guint32  width;
+  guint32  height;
+  gint32   pid;
+  gint32   fd;
 };
 
 struct _GPParamDefInt
@@ -336,6 +368,14 @@ gboolean  gp_extension_ack_write    (GIOChannel      *channel,
                                      gpointer         user_data);
 gboolean  gp_has_init_write         (GIOChannel      *channel,
                                      gpointer         user_data);
+gboolean  gp_drawable_map_req_write (GIOChannel      *channel,
+                                     GPDrawableMapReq *drawable_map_req,
+                                     gpointer         user_data);
+gboolean  gp_drawable_map_write     (GIOChannel      *channel,
+                                     GPDrawableMap   *drawable_map,
+                                     gpointer         user_data);
+gboolean  gp_drawable_map_ack_write (GIOChannel      *channel,
+                                     gpointer         user_data);
 
 
 G_END_DECLS
@@ -38,6 +38,12 @@ struct _GimpWireHandler
 };
 
 
+/*  values are byte-swapped through a buffer of this size, and written
+ *  a buffer at a time
+ */
+#define WIRE_CHUNK_SIZE 1024
+
+
 static GHashTable        *wire_ht         = NULL;
 static GimpWireIOFunc     wire_read_func  = NULL;
 static GimpWireIOFunc     wire_write_func = NULL;
@@ -400,35 +406,22 @@ _gimp_wire_read_double (GIOChannel *channel,
                         gint        count,
                         gpointer    user_data)
 {
-  gdouble *t;
-  guint8   tmp[8];
-  gint     i;
+  gint i;
 
   g_return_val_if_fail (count >= 0, FALSE);
 
-  t = (gdouble *) tmp;
+  if (! _gimp_wire_read_int8 (channel,
+                              (guint8 *) data, count * 8, user_data))
+    return FALSE;
 
+  /*  doubles are sent as big-endian IEEE 754 numbers  */
   for (i = 0; i < count; i++)
     {
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-      gint j;
-#endif
-
-      if (! _gimp_wire_read_int8 (channel, tmp, 8, user_data))
-        return FALSE;
-
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-      for (j = 0; j < 4; j++)
-        {
-          guint8 swap;
+      guint64 tmp;
 
-          swap       = tmp[j];
-          tmp[j]     = tmp[7 - j];
-          tmp[7 - j] = swap;
-        }
-#endif
-
-      data[i] = *t;
+      memcpy (&tmp, &data[i], 8);
+      tmp = GUINT64_FROM_BE (tmp);
+      memcpy (&data[i], &tmp, 8);
     }
 
   return TRUE;
@@ -500,18 +493,21 @@ _gimp_wire_write_int64 (GIOChannel    *channel,
 {
   g_return_val_if_fail (count >= 0, FALSE);
 
-  if (count > 0)
+  while (count > 0)
     {
-      gint i;
+      guint64 tmp[WIRE_CHUNK_SIZE / 8];
+      gint    n = MIN (count, G_N_ELEMENTS (tmp));
+      gint    i;
 
-      for (i = 0; i < count; i++)
-        {
-          guint64 tmp = GUINT64_TO_BE (data[i]);
+      for (i = 0; i < n; i++)
+        tmp[i] = GUINT64_TO_BE (data[i]);
 
-          if (! _gimp_wire_write_int8 (channel,
-                                       (const guint8 *) &tmp, 8, user_data))
-            return FALSE;
-        }
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) tmp, n * 8, user_data))
+        return FALSE;
+
+      data  += n;
+      count -= n;
     }
 
   return TRUE;
@@ -525,18 +521,21 @@ _gimp_wire_write_int32 (GIOChannel    *channel,
 {
   g_return_val_if_fail (count >= 0, FALSE);
 
-  if (count > 0)
+  while (count > 0)
     {
-      gint i;
+      guint32 tmp[WIRE_CHUNK_SIZE / 4];
+      gint    n = MIN (count, G_N_ELEMENTS (tmp));
+      gint    i;
 
-      for (i = 0; i < count; i++)
-        {
-          guint32 tmp = g_htonl (data[i]);
+      for (i = 0; i < n; i++)
+        tmp[i] = g_htonl (data[i]);
 
-          if (! _gimp_wire_write_int8 (channel,
-                                       (const guint8 *) &tmp, 4, user_data))
-            return FALSE;
-        }
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) tmp, n * 4, user_data))
+        return FALSE;
+
+      data  += n;
+      count -= n;
     }
 
   return TRUE;
@@ -550,18 +549,21 @@ _gimp_wire_write_int16 (GIOChannel    *channel,
 {
   g_return_val_if_fail (count >= 0, FALSE);
 
-  if (count > 0)
+  while (count > 0)
     {
-      gint i;
+      guint16 tmp[WIRE_CHUNK_SIZE / 2];
+      gint    n = MIN (count, G_N_ELEMENTS (tmp));
+      gint    i;
 
-      for (i = 0; i < count; i++)
-        {
-          guint16 tmp = g_htons (data[i]);
+      for (i = 0; i < n; i++)
+        tmp[i] = g_htons (data[i]);
 
-          if (! _gimp_wire_write_int8 (channel,
-                                       (const guint8 *) &tmp, 2, user_data))
-            return FALSE;
-        }
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) tmp, n * 2, user_data))
+        return FALSE;
+
+      data  += n;
+      count -= n;
     }
 
   return TRUE;
@@ -584,47 +586,25 @@ _gimp_wire_write_double (GIOChannel    *channel,
                          gint           count,
                          gpointer       user_data)
 {
-  gdouble *t;
-  guint8   tmp[8];
-  gint     i;
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-  gint     j;
-#endif
-
   g_return_val_if_fail (count >= 0, FALSE);
 
-  t = (gdouble *) tmp;
-
-  for (i = 0; i < count; i++)
+  while (count > 0)
     {
-      *t = data[i];
+      guint64 tmp[WIRE_CHUNK_SIZE / 8];
+      gint    n = MIN (count, G_N_ELEMENTS (tmp));
+      gint    i;
 
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-      for (j = 0; j < 4; j++)
-        {
-          guint8 swap;
+      memcpy (tmp, data, n * 8);
 
-          swap       = tmp[j];
-          tmp[j]     = tmp[7 - j];
-          tmp[7 - j] = swap;
-        }
-#endif
+      for (i = 0; i < n; i++)
+        tmp[i] = GUINT64_TO_BE (tmp[i]);
 
-      if (! _gimp_wire_write_int8 (channel, tmp, 8, user_data))
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) tmp, n * 8, user_data))
         return FALSE;
 
-#if 0
-      {
-        gint k;
-
-        g_print ("Wire representation of %f:\t", data[i]);
-
-        for (k = 0; k < 8; k++)
-          g_print ("%02x ", tmp[k]);
-
-        g_print ("\n");
-      }
-#endif
+      data  += n;
+      count -= n;
     }
 
   return TRUE;
@@ -0,0 +1,273 @@
+/* A small benchmark for the wire protocol: sends GP_PROC_RUN messages
+ * with array arguments of various sizes through a pipe, and prints how
+ * many messages, and how much payload, per second make it through.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib-object.h>
+
+#include "gimpbasetypes.h"
+
+#include "gimpparasite.h"
+#include "gimpprotocol.h"
+#include "gimpwire.h"
+
+
+/*  same as the plug-ins' and the core's write buffers  */
+#define WRITE_BUFFER_SIZE 8192
+
+/*  payload sent per test case  */
+#define BYTES_PER_CASE    (256 << 20)
+#define MAX_MESSAGES      200000
+
+
+typedef struct
+{
+  guint32 array_size;
+  guint32 id_array_size;
+} WireCase;
+
+typedef struct
+{
+  GIOChannel *channel;
+  gint        n_messages;
+  gboolean    success;
+} WireReader;
+
+
+static gchar write_buffer[WRITE_BUFFER_SIZE];
+static gsize write_buffer_index = 0;
+
+static const WireCase cases[] =
+{
+  { 0,         0      },
+  { 64,        16     },
+  { 4096,      1024   },
+  { 65536,     0      },
+  { 1 << 20,   0      },
+  { 16 << 20,  0      },
+  { 0,         262144 }
+};
+
+
+static gboolean
+wire_write_chars (GIOChannel  *channel,
+                  const gchar *buf,
+                  gsize        count)
+{
+  while (count > 0)
+    {
+      GIOStatus status;
+      gsize     bytes;
+
+      do
+        {
+          bytes  = 0;
+          status = g_io_channel_write_chars (channel, buf, count,
+                                             &bytes, NULL);
+        }
+      while (status == G_IO_STATUS_AGAIN);
+
+      if (status != G_IO_STATUS_NORMAL)
+        return FALSE;
+
+      buf   += bytes;
+      count -= bytes;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+wire_flush (GIOChannel *channel,
+            gpointer    user_data)
+{
+  if (write_buffer_index > 0)
+    {
+      if (! wire_write_chars (channel, write_buffer, write_buffer_index))
+        return FALSE;
+
+      write_buffer_index = 0;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+wire_write (GIOChannel   *channel,
+            const guint8 *buf,
+            gulong        count,
+            gpointer      user_data)
+{
+  if (count >= WRITE_BUFFER_SIZE)
+    {
+      return (wire_flush (channel, user_data) &&
+              wire_write_chars (channel, (const gchar *) buf, count));
+    }
+
+  if (write_buffer_index + count > WRITE_BUFFER_SIZE &&
+      ! wire_flush (channel, user_data))
+    return FALSE;
+
+  memcpy (&write_buffer[write_buffer_index], buf, count);
+  write_buffer_index += count;
+
+  return TRUE;
+}
+
+static gpointer
+wire_reader_func (WireReader *reader)
+{
+  gint i;
+
+  reader->success = TRUE;
+
+  for (i = 0; i < reader->n_messages; i++)
+    {
+      GimpWireMessage msg;
+
+      if (! gimp_wire_read_msg (reader->channel, &msg, NULL))
+        {
+          reader->success = FALSE;
+          break;
+        }
+
+      gimp_wire_destroy (&msg);
+    }
+
+  return NULL;
+}
+
+static gboolean
+wire_run_case (GIOChannel     *read_channel,
+               GIOChannel     *write_channel,
+               const WireCase *wire_case)
+{
+  GPProcRun   proc_run;
+  GPParam     params[3];
+  WireReader  reader;
+  GThread    *thread;
+  gint64      payload;
+  gint64      start_time;
+  gdouble     elapsed;
+  gint        n_messages;
+  gint        i;
+
+  memset (params, 0, sizeof (params));
+
+  params[0].param_type = GP_PARAM_TYPE_INT;
+  params[0].type_name  = "GParamInt";
+  params[0].data.d_int = 42;
+
+  params[1].param_type        = GP_PARAM_TYPE_ARRAY;
+  params[1].type_name         = "GimpParamUInt8Array";
+  params[1].data.d_array.size = wire_case->array_size;
+  params[1].data.d_array.data = g_malloc0 (MAX (wire_case->array_size, 1));
+
+  params[2].param_type                = GP_PARAM_TYPE_ID_ARRAY;
+  params[2].type_name                 = "GimpParamObjectArray";
+  params[2].data.d_id_array.type_name = "GimpLayer";
+  params[2].data.d_id_array.size      = wire_case->id_array_size;
+  params[2].data.d_id_array.data      = g_new0 (gint32,
+                                                MAX (wire_case->id_array_size, 1));
+
+  proc_run.name     = "test-wire";
+  proc_run.n_params = G_N_ELEMENTS (params);
+  proc_run.params   = params;
+
+  payload = (gint64) wire_case->array_size + 4 * wire_case->id_array_size;
+
+  n_messages = CLAMP (BYTES_PER_CASE / MAX (payload, 1), 16, MAX_MESSAGES);
+
+  reader.channel    = read_channel;
+  reader.n_messages = n_messages;
+
+  thread = g_thread_new ("wire-reader", (GThreadFunc) wire_reader_func,
+                         &reader);
+
+  start_time = g_get_monotonic_time ();
+
+  for (i = 0; i < n_messages; i++)
+    {
+      if (! gp_proc_run_write (write_channel, &proc_run, NULL))
+        break;
+    }
+
+  /*  let the reader see EOF instead of waiting forever  */
+  if (i < n_messages)
+    g_io_channel_shutdown (write_channel, FALSE, NULL);
+
+  g_thread_join (thread);
+
+  elapsed = (gdouble) (g_get_monotonic_time () - start_time) /
+            G_TIME_SPAN_SECOND;
+
+  g_free (params[1].data.d_array.data);
+  g_free (params[2].data.d_id_array.data);
+
+  if (i < n_messages || ! reader.success)
+    {
+      g_printerr ("  %9u bytes, %7u IDs: failed\n",
+                  wire_case->array_size, wire_case->id_array_size);
+
+      return FALSE;
+    }
+
+  g_printerr ("  %9u bytes, %7u IDs: %10.0f messages/s  %9.1f MB/s\n",
+              wire_case->array_size, wire_case->id_array_size,
+              n_messages / elapsed,
+              n_messages * payload / elapsed / (1 << 20));
+
+  return TRUE;
+}
+
+int
+main (void)
+{
+  GIOChannel *read_channel;
+  GIOChannel *write_channel;
+  gint        fds[2];
+  gboolean    success = TRUE;
+  gint        i;
+
+  if (pipe (fds) == -1)
+    {
+      g_printerr ("pipe() failed\n");
+
+      return EXIT_FAILURE;
+    }
+
+  read_channel  = g_io_channel_unix_new (fds[0]);
+  write_channel = g_io_channel_unix_new (fds[1]);
+
+  g_io_channel_set_encoding (read_channel,  NULL, NULL);
+  g_io_channel_set_encoding (write_channel, NULL, NULL);
+
+  g_io_channel_set_buffered (read_channel,  FALSE);
+  g_io_channel_set_buffered (write_channel, FALSE);
+
+  gp_init ();
+
+  gimp_wire_set_writer (wire_write);
+  gimp_wire_set_flusher (wire_flush);
+
+  g_printerr ("Testing wire protocol throughput...\n");
+
+  for (i = 0; i < G_N_ELEMENTS (cases); i++)
+    success &= wire_run_case (read_channel, write_channel, &cases[i]);
+
+  g_printerr ("\n");
+
+  g_io_channel_shutdown (read_channel,  FALSE, NULL);
+  g_io_channel_shutdown (write_channel, FALSE, NULL);
+
+  g_io_channel_unref (read_channel);
+  g_io_channel_unref (write_channel);
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
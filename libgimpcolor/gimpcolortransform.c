@@ -27,6 +27,10 @@
 
 #include <lcms2.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <gio/gio.h>
 #include <gegl.h>
 
@@ -58,6 +62,17 @@
  **/
 
 
+/* the number of grid points per axis of a transform's lookup table */
+#define LUT_SIZE           33
+#define LUT_SIZE_ACCURATE  65
+
+/* the number of pixels looked up at once, from a buffer on the stack */
+#define LUT_BLOCK_SIZE     512
+
+#define PIXELS_PER_THREAD \
+  (/* each thread costs as much as */ 64.0 * 64.0 /* pixels */)
+
+
 enum
 {
   PROGRESS,
@@ -65,6 +80,25 @@ enum
 };
 
 
+typedef struct _GimpColorLut GimpColorLut;
+
+struct _GimpColorLut
+{
+  gchar      *key;
+  gint        ref_count;
+
+  gint        size;
+  gint        strides[3];
+  gfloat     *table;
+
+  const Babl *src_format;
+  const Babl *dest_format;
+
+  /*  pixels outside of the table's range go through the transform itself  */
+  cmsHTRANSFORM transform;
+  const Babl   *grid_fish;
+};
+
 struct _GimpColorTransformPrivate
 {
   GimpColorProfile *src_profile;
@@ -75,10 +109,53 @@ struct _GimpColorTransformPrivate
 
   cmsHTRANSFORM     transform;
   const Babl       *fish;
-};
 
+  GimpColorLut     *lut;
+  const Babl       *lut_src_fish;
+  const Babl       *lut_dest_fish;
+};
 
-static void   gimp_color_transform_finalize (GObject *object);
+typedef struct
+{
+  GimpColorTransform *transform;
+  GeglBuffer         *src_buffer;
+  const Babl         *src_format;
+  GeglBuffer         *dest_buffer;
+  const Babl         *dest_format;
+  gint                dest_dx;
+  gint                dest_dy;
+  gboolean            progress;
+  gint                total_pixels;
+  gint                done_pixels;
+} ProcessBufferData;
+
+
+static void           gimp_color_transform_finalize     (GObject                  *object);
+
+static gboolean       gimp_color_transform_set_lut      (GimpColorTransform       *transform,
+                                                         GimpColorProfile         *src_profile,
+                                                         GimpColorProfile         *dest_profile,
+                                                         GimpColorProfile         *proof_profile,
+                                                         GimpColorRenderingIntent  intent,
+                                                         GimpColorRenderingIntent  proof_intent,
+                                                         GimpColorTransformFlags   flags);
+static void           gimp_color_transform_process_data (GimpColorTransform       *transform,
+                                                         gconstpointer             src,
+                                                         gpointer                  dest,
+                                                         gsize                     length);
+static void           gimp_color_transform_process_area (const GeglRectangle      *area,
+                                                         ProcessBufferData        *data);
+
+static GimpColorLut * gimp_color_lut_get                (GimpColorProfile         *src_profile,
+                                                         const Babl               *src_format,
+                                                         GimpColorProfile         *dest_profile,
+                                                         const Babl               *dest_format,
+                                                         GimpColorProfile         *proof_profile,
+                                                         GimpColorRenderingIntent  intent,
+                                                         GimpColorRenderingIntent  proof_intent,
+                                                         GimpColorTransformFlags   flags);
+static void           gimp_color_lut_unref              (GimpColorLut             *lut);
+static void           gimp_color_lut_free               (GimpColorLut             *lut);
 
 
 G_DEFINE_TYPE_WITH_PRIVATE (GimpColorTransform, gimp_color_transform,
@@ -90,6 +167,9 @@ static guint gimp_color_transform_signals[LAST_SIGNAL] = { 0 };
 
 static gchar *lcms_last_error = NULL;
 
+static GMutex      lut_cache_mutex;
+static GHashTable *lut_cache = NULL;
+
 
 static void
 lcms_error_clear (void)
@@ -146,6 +226,7 @@ gimp_color_transform_finalize (GObject *object)
   g_clear_object (&transform->priv->dest_profile);
 
   g_clear_pointer (&transform->priv->transform, cmsDeleteTransform);
+  g_clear_pointer (&transform->priv->lut, gimp_color_lut_unref);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -258,15 +339,28 @@ gimp_color_transform_new (GimpColorProfile         *src_profile,
   priv->dest_format = gimp_color_profile_get_lcms_format (dest_format,
                                                           &lcms_dest_format);
 
+  if ((flags & GIMP_COLOR_TRANSFORM_FLAGS_LUT) &&
+      gimp_color_transform_set_lut (transform,
+                                    src_profile, dest_profile, NULL,
+                                    rendering_intent, 0,
+                                    flags & ~GIMP_COLOR_TRANSFORM_FLAGS_LUT))
+    {
+      return transform;
+    }
+
+  flags &= ~GIMP_COLOR_TRANSFORM_FLAGS_LUT;
+
   src_lcms  = gimp_color_profile_get_lcms_profile (src_profile);
   dest_lcms = gimp_color_profile_get_lcms_profile (dest_profile);
 
   lcms_error_clear ();
 
+  /*  the transform is shared between the threads processing a buffer  */
   priv->transform = cmsCreateTransform (src_lcms,  lcms_src_format,
                                         dest_lcms, lcms_dest_format,
                                         rendering_intent,
-                                        flags |
+                                        flags            |
+                                        cmsFLAGS_NOCACHE |
                                         cmsFLAGS_COPY_ALPHA);
 
   if (lcms_last_error)
@@ -352,14 +446,27 @@ gimp_color_transform_new_proofing (GimpColorProfile         *src_profile,
   priv->dest_format = gimp_color_profile_get_lcms_format (dest_format,
                                                           &lcms_dest_format);
 
+  if ((flags & GIMP_COLOR_TRANSFORM_FLAGS_LUT) &&
+      gimp_color_transform_set_lut (transform,
+                                    src_profile, dest_profile, proof_profile,
+                                    display_intent, proof_intent,
+                                    flags & ~GIMP_COLOR_TRANSFORM_FLAGS_LUT))
+    {
+      return transform;
+    }
+
+  flags &= ~GIMP_COLOR_TRANSFORM_FLAGS_LUT;
+
   lcms_error_clear ();
 
+  /*  the transform is shared between the threads processing a buffer  */
   priv->transform = cmsCreateProofingTransform (src_lcms,  lcms_src_format,
                                                 dest_lcms, lcms_dest_format,
                                                 proof_lcms,
                                                 display_intent,
                                                 proof_intent,
                                                 flags                 |
+                                                cmsFLAGS_NOCACHE      |
                                                 cmsFLAGS_SOFTPROOFING |
                                                 cmsFLAGS_COPY_ALPHA);
 
@@ -455,14 +562,7 @@ gimp_color_transform_process_pixels (GimpColorTransform *transform,
       dest = dest_pixels;
     }
 
-  if (priv->transform)
-    {
-      cmsDoTransform (priv->transform, src, dest, length);
-    }
-  else
-    {
-      babl_process (priv->fish, src, dest, length);
-    }
+  gimp_color_transform_process_data (transform, src, dest, length);
 
   if (src_format != priv->src_format)
     {
@@ -494,6 +594,9 @@ gimp_color_transform_process_pixels (GimpColorTransform *transform,
  * spaces are ignored. The transform always takes place between the
  * color spaces determined by @transform's color profiles.
  *
+ * Unless a handler is connected to @transform's "progress" signal,
+ * large buffers are processed in parallel.
+ *
  * Since: 2.10
  **/
 void
@@ -504,11 +607,10 @@ gimp_color_transform_process_buffer (GimpColorTransform  *transform,
                                      const GeglRectangle *dest_rect)
 {
   GimpColorTransformPrivate *priv;
+  ProcessBufferData          data;
+  GeglRectangle              area;
   const Babl                *src_format;
   const Babl                *dest_format;
-  GeglBufferIterator        *iter;
-  gint                       total_pixels;
-  gint                       done_pixels = 0;
 
   g_return_if_fail (GIMP_IS_COLOR_TRANSFORM (transform));
   g_return_if_fail (GEGL_IS_BUFFER (src_buffer));
@@ -517,14 +619,9 @@ gimp_color_transform_process_buffer (GimpColorTransform  *transform,
   priv = transform->priv;
 
   if (src_rect)
-    {
-      total_pixels = src_rect->width * src_rect->height;
-    }
+    area = *src_rect;
   else
-    {
-      total_pixels = (gegl_buffer_get_width  (src_buffer) *
-                      gegl_buffer_get_height (src_buffer));
-    }
+    area = *gegl_buffer_get_extent (src_buffer);
 
   /* we must not do any babl color transforms when reading from
    * src_buffer or writing to dest_buffer, so construct formats with
@@ -541,64 +638,47 @@ gimp_color_transform_process_buffer (GimpColorTransform  *transform,
     babl_format_with_space ((const gchar *) priv->dest_format,
                             babl_format_get_space (dest_format));
 
+  data.transform    = transform;
+  data.src_buffer   = src_buffer;
+  data.src_format   = src_format;
+  data.dest_buffer  = dest_buffer;
+  data.dest_format  = dest_format;
+  data.dest_dx      = 0;
+  data.dest_dy      = 0;
+  data.total_pixels = area.width * area.height;
+  data.done_pixels  = 0;
+
   if (src_buffer != dest_buffer)
     {
-      iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
-                                       src_format,
-                                       GEGL_ACCESS_READ,
-                                       GEGL_ABYSS_NONE, 2);
-
-      gegl_buffer_iterator_add (iter, dest_buffer, dest_rect, 0,
-                                dest_format,
-                                GEGL_ACCESS_WRITE,
-                                GEGL_ABYSS_NONE);
-
-      while (gegl_buffer_iterator_next (iter))
+      if (dest_rect)
         {
-          if (priv->transform)
-            {
-              cmsDoTransform (priv->transform,
-                              iter->items[0].data, iter->items[1].data, iter->length);
-            }
-          else
-            {
-              babl_process (priv->fish,
-                            iter->items[0].data, iter->items[1].data, iter->length);
-            }
+          data.dest_dx = dest_rect->x - area.x;
+          data.dest_dy = dest_rect->y - area.y;
+        }
+      else
+        {
+          data.dest_dx = gegl_buffer_get_x (dest_buffer) - area.x;
+          data.dest_dy = gegl_buffer_get_y (dest_buffer) - area.y;
+        }
+    }
 
-          done_pixels += iter->items[0].roi.width * iter->items[0].roi.height;
+  /*  progress can only be reported when processing the buffer serially,
+   *  and in order
+   */
+  data.progress = g_signal_has_handler_pending (transform,
+                                                gimp_color_transform_signals[PROGRESS],
+                                                0, FALSE);
 
-          g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
-                         (gdouble) done_pixels /
-                         (gdouble) total_pixels);
-        }
+  if (data.progress)
+    {
+      gimp_color_transform_process_area (&area, &data);
     }
   else
     {
-      iter = gegl_buffer_iterator_new (src_buffer, src_rect, 0,
-                                       src_format,
-                                       GEGL_ACCESS_READWRITE,
-                                       GEGL_ABYSS_NONE, 1);
-
-      while (gegl_buffer_iterator_next (iter))
-        {
-          if (priv->transform)
-            {
-              cmsDoTransform (priv->transform,
-                              iter->items[0].data, iter->items[0].data, iter->length);
-            }
-          else
-            {
-              babl_process (priv->fish,
-                            iter->items[0].data, iter->items[0].data, iter->length);
-            }
-
-          done_pixels += iter->items[0].roi.width * iter->items[0].roi.height;
-
-          g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
-                         (gdouble) done_pixels /
-                         (gdouble) total_pixels);
-        }
+      gegl_parallel_distribute_area (
+        &area, PIXELS_PER_THREAD, GEGL_SPLIT_STRATEGY_AUTO,
+        (GeglParallelDistributeAreaFunc) gimp_color_transform_process_area,
+        &data);
     }
 
   g_signal_emit (transform, gimp_color_transform_signals[PROGRESS], 0,
@@ -640,3 +720,556 @@ gimp_color_transform_can_gegl_copy (GimpColorProfile *src_profile,
 
   return FALSE;
 }
+
+
+/*  private functions  */
+
+static gboolean
+gimp_color_transform_set_lut (GimpColorTransform       *transform,
+                              GimpColorProfile         *src_profile,
+                              GimpColorProfile         *dest_profile,
+                              GimpColorProfile         *proof_profile,
+                              GimpColorRenderingIntent  intent,
+                              GimpColorRenderingIntent  proof_intent,
+                              GimpColorTransformFlags   flags)
+{
+  GimpColorTransformPrivate *priv = transform->priv;
+
+  priv->lut = gimp_color_lut_get (src_profile,   priv->src_format,
+                                  dest_profile,  priv->dest_format,
+                                  proof_profile,
+                                  intent, proof_intent, flags);
+
+  if (! priv->lut)
+    return FALSE;
+
+  priv->lut_src_fish  = babl_fish (priv->src_format, priv->lut->src_format);
+  priv->lut_dest_fish = babl_fish (priv->lut->dest_format, priv->dest_format);
+
+  return TRUE;
+}
+
+static inline void
+gimp_color_lut_interpolate (const GimpColorLut *lut,
+                            const gfloat       *src,
+                            gfloat             *dest)
+{
+  const gfloat  scale = lut->size - 1;
+  const gfloat *c0;
+  const gfloat *c1;
+  const gfloat *c2;
+  const gfloat *c3;
+  gfloat        f[3];
+  gfloat        alpha = src[3];
+  gint          offset = 0;
+  gint          a0, a1, a2;
+  gint          c;
+
+  for (c = 0; c < 3; c++)
+    {
+      gfloat x = src[c] * scale;
+      gint   i;
+
+      /*  the lookup table only covers [0..1], and out-of-range pixels
+       *  are transformed by lcms instead, but guard against rounding
+       */
+      if (! (x > 0.0f))
+        x = 0.0f;
+      else if (x > scale)
+        x = scale;
+
+      i = MIN ((gint) x, lut->size - 2);
+
+      f[c]    = x - i;
+      offset += i * lut->strides[c];
+    }
+
+  /*  tetrahedral interpolation: walk from the cell's origin to its
+   *  opposite corner, along the axes in order of decreasing fraction
+   */
+  if (f[0] >= f[1])
+    {
+      if      (f[1] >= f[2]) { a0 = 0; a1 = 1; a2 = 2; }
+      else if (f[0] >= f[2]) { a0 = 0; a1 = 2; a2 = 1; }
+      else                   { a0 = 2; a1 = 0; a2 = 1; }
+    }
+  else
+    {
+      if      (f[0] >= f[2]) { a0 = 1; a1 = 0; a2 = 2; }
+      else if (f[1] >= f[2]) { a0 = 1; a1 = 2; a2 = 0; }
+      else                   { a0 = 2; a1 = 1; a2 = 0; }
+    }
+
+  c0 = lut->table + offset;
+  c1 = c0 + lut->strides[a0];
+  c2 = c1 + lut->strides[a1];
+  c3 = c2 + lut->strides[a2];
+
+#ifdef __SSE2__
+  {
+    __m128 v;
+
+    v = _mm_add_ps (_mm_add_ps (_mm_mul_ps (_mm_loadu_ps (c0),
+                                            _mm_set1_ps (1.0f  - f[a0])),
+                                _mm_mul_ps (_mm_loadu_ps (c1),
+                                            _mm_set1_ps (f[a0] - f[a1]))),
+                    _mm_add_ps (_mm_mul_ps (_mm_loadu_ps (c2),
+                                            _mm_set1_ps (f[a1] - f[a2])),
+                                _mm_mul_ps (_mm_loadu_ps (c3),
+                                            _mm_set1_ps (f[a2]))));
+
+    _mm_storeu_ps (dest, v);
+  }
+#else
+  for (c = 0; c < 3; c++)
+    {
+      dest[c] = c0[c] * (1.0f  - f[a0]) +
+                c1[c] * (f[a0] - f[a1]) +
+                c2[c] * (f[a1] - f[a2]) +
+                c3[c] * f[a2];
+    }
+#endif
+
+  dest[3] = alpha;
+}
+
+static void
+gimp_color_transform_process_lut (GimpColorTransform *transform,
+                                  gconstpointer       src,
+                                  gpointer            dest,
+                                  gsize               length)
+{
+  GimpColorTransformPrivate *priv     = transform->priv;
+  const guint8              *src_p    = src;
+  guint8                    *dest_p   = dest;
+  gint                       src_bpp  = babl_format_get_bytes_per_pixel (priv->src_format);
+  gint                       dest_bpp = babl_format_get_bytes_per_pixel (priv->dest_format);
+  gfloat                     pixels[4 * LUT_BLOCK_SIZE];
+  gfloat                     rgb[3 * LUT_BLOCK_SIZE];
+  gfloat                     samples[3 * LUT_BLOCK_SIZE];
+  gint                       out_of_range[LUT_BLOCK_SIZE];
+
+  while (length)
+    {
+      gsize n     = MIN (length, LUT_BLOCK_SIZE);
+      gint  n_out = 0;
+      gsize i;
+
+      babl_process (priv->lut_src_fish, src_p, pixels, n);
+
+      for (i = 0; i < n; i++)
+        {
+          gfloat *pixel = pixels + 4 * i;
+
+          /*  the lookup table only covers [0..1], collect the other
+           *  pixels, including NaN ones, for lcms
+           */
+          if (pixel[0] >= 0.0f && pixel[0] <= 1.0f &&
+              pixel[1] >= 0.0f && pixel[1] <= 1.0f &&
+              pixel[2] >= 0.0f && pixel[2] <= 1.0f)
+            {
+              gimp_color_lut_interpolate (priv->lut, pixel, pixel);
+            }
+          else
+            {
+              rgb[3 * n_out + 0] = pixel[0];
+              rgb[3 * n_out + 1] = pixel[1];
+              rgb[3 * n_out + 2] = pixel[2];
+
+              out_of_range[n_out++] = i;
+            }
+        }
+
+      if (n_out > 0)
+        {
+          gint j;
+
+          babl_process (priv->lut->grid_fish, rgb, samples, n_out);
+
+          cmsDoTransform (priv->lut->transform, samples, rgb, n_out);
+
+          for (j = 0; j < n_out; j++)
+            {
+              gfloat *pixel = pixels + 4 * out_of_range[j];
+
+              pixel[0] = rgb[3 * j + 0];
+              pixel[1] = rgb[3 * j + 1];
+              pixel[2] = rgb[3 * j + 2];
+            }
+        }
+
+      babl_process (priv->lut_dest_fish, pixels, dest_p, n);
+
+      src_p  += n * src_bpp;
+      dest_p += n * dest_bpp;
+      length -= n;
+    }
+}
+
+static void
+gimp_color_transform_process_data (GimpColorTransform *transform,
+                                   gconstpointer       src,
+                                   gpointer            dest,
+                                   gsize               length)
+{
+  GimpColorTransformPrivate *priv = transform->priv;
+
+  if (priv->lut)
+    {
+      gimp_color_transform_process_lut (transform, src, dest, length);
+    }
+  else if (priv->transform)
+    {
+      cmsDoTransform (priv->transform, src, dest, length);
+    }
+  else
+    {
+      babl_process (priv->fish, src, dest, length);
+    }
+}
+
+static void
+gimp_color_transform_process_area (const GeglRectangle *area,
+                                   ProcessBufferData   *data)
+{
+  GeglBufferIterator *iter;
+  gint                dest_item = 0;
+
+  if (data->src_buffer != data->dest_buffer)
+    {
+      GeglRectangle dest_area = *area;
+
+      dest_area.x += data->dest_dx;
+      dest_area.y += data->dest_dy;
+
+      iter = gegl_buffer_iterator_new (data->src_buffer, area, 0,
+                                       data->src_format,
+                                       GEGL_ACCESS_READ,
+                                       GEGL_ABYSS_NONE, 2);
+
+      gegl_buffer_iterator_add (iter, data->dest_buffer, &dest_area, 0,
+                                data->dest_format,
+                                GEGL_ACCESS_WRITE,
+                                GEGL_ABYSS_NONE);
+
+      dest_item = 1;
+    }
+  else
+    {
+      iter = gegl_buffer_iterator_new (data->src_buffer, area, 0,
+                                       data->src_format,
+                                       GEGL_ACCESS_READWRITE,
+                                       GEGL_ABYSS_NONE, 1);
+    }
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      gimp_color_transform_process_data (data->transform,
+                                         iter->items[0].data,
+                                         iter->items[dest_item].data,
+                                         iter->length);
+
+      if (data->progress)
+        {
+          data->done_pixels += (iter->items[0].roi.width *
+                                iter->items[0].roi.height);
+
+          g_signal_emit (data->transform,
+                         gimp_color_transform_signals[PROGRESS], 0,
+                         (gdouble) data->done_pixels /
+                         (gdouble) data->total_pixels);
+        }
+    }
+}
+
+
+static const Babl *
+gimp_color_lut_get_rgb_format (const Babl *format,
+                               gboolean    with_alpha)
+{
+  const gchar *model = babl_get_name (babl_format_get_model (format));
+
+  if (! strcmp (model, "RGB") || ! strcmp (model, "RGBA"))
+    {
+      return babl_format (with_alpha ? "RGBA float" : "RGB float");
+    }
+  else if (! strcmp (model, "R'G'B'") || ! strcmp (model, "R'G'B'A"))
+    {
+      return babl_format (with_alpha ? "R'G'B'A float" : "R'G'B' float");
+    }
+
+  return NULL;
+}
+
+static gchar *
+gimp_color_lut_get_profile_checksum (GimpColorProfile *profile)
+{
+  const guint8 *data;
+  gsize         length;
+
+  if (! profile)
+    return g_strdup ("none");
+
+  data = gimp_color_profile_get_icc_profile (profile, &length);
+
+  /*  skip the header, like gimp_color_profile_is_equal() does  */
+  return g_compute_checksum_for_data (G_CHECKSUM_MD5,
+                                      data   + sizeof (cmsICCHeader),
+                                      length - sizeof (cmsICCHeader));
+}
+
+static GimpColorLut *
+gimp_color_lut_new (gchar                    *key,
+                    GimpColorProfile         *src_profile,
+                    const Babl               *src_format,
+                    GimpColorProfile         *dest_profile,
+                    const Babl               *dest_format,
+                    GimpColorProfile         *proof_profile,
+                    GimpColorRenderingIntent  intent,
+                    GimpColorRenderingIntent  proof_intent,
+                    GimpColorTransformFlags   flags)
+{
+  GimpColorLut  *lut;
+  cmsHTRANSFORM  transform;
+  cmsHPROFILE    src_lcms;
+  cmsHPROFILE    dest_lcms;
+  gfloat        *grid;
+  gfloat        *samples;
+  gint           size;
+  gint           n_entries;
+  gint           r, g, b;
+  gint           i;
+
+  src_lcms  = gimp_color_profile_get_lcms_profile (src_profile);
+  dest_lcms = gimp_color_profile_get_lcms_profile (dest_profile);
+
+  /*  the transform is kept around for out-of-range pixels, and shared
+   *  between threads
+   */
+  flags |= cmsFLAGS_NOCACHE;
+
+  lcms_error_clear ();
+
+  if (proof_profile)
+    {
+      transform = cmsCreateProofingTransform (src_lcms,  TYPE_RGB_FLT,
+                                              dest_lcms, TYPE_RGB_FLT,
+                                              gimp_color_profile_get_lcms_profile (proof_profile),
+                                              intent,
+                                              proof_intent,
+                                              flags |
+                                              cmsFLAGS_SOFTPROOFING);
+    }
+  else
+    {
+      transform = cmsCreateTransform (src_lcms,  TYPE_RGB_FLT,
+                                      dest_lcms, TYPE_RGB_FLT,
+                                      intent,
+                                      flags);
+    }
+
+  if (lcms_last_error)
+    {
+      g_clear_pointer (&transform, cmsDeleteTransform);
+
+      g_printerr ("%s: %s\n", G_STRFUNC, lcms_last_error);
+    }
+
+  if (! transform)
+    return NULL;
+
+  if (flags & GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE)
+    size = LUT_SIZE_ACCURATE;
+  else
+    size = LUT_SIZE;
+
+  n_entries = size * size * size;
+
+  lut = g_new0 (GimpColorLut, 1);
+
+  lut->key         = key;
+  lut->ref_count   = 1;
+  lut->size        = size;
+  lut->strides[0]  = 4 * size * size;
+  lut->strides[1]  = 4 * size;
+  lut->strides[2]  = 4;
+  lut->table       = g_new (gfloat, 4 * n_entries);
+  lut->src_format  = babl_format ("R'G'B'A float");
+  lut->dest_format = gimp_color_lut_get_rgb_format (dest_format, TRUE);
+  lut->transform   = transform;
+  lut->grid_fish   = babl_fish (babl_format ("R'G'B' float"),
+                                gimp_color_lut_get_rgb_format (src_format,
+                                                               FALSE));
+
+  /*  the grid is uniform in perceptual values, which keeps it dense
+   *  enough in the shadows for linear sources too.  convert the grid
+   *  points to the source's encoding, and transform them.
+   */
+  grid    = g_new (gfloat, 3 * n_entries);
+  samples = g_new (gfloat, 3 * n_entries);
+
+  for (r = 0, i = 0; r < size; r++)
+    for (g = 0; g < size; g++)
+      for (b = 0; b < size; b++)
+        {
+          grid[i++] = (gfloat) r / (size - 1);
+          grid[i++] = (gfloat) g / (size - 1);
+          grid[i++] = (gfloat) b / (size - 1);
+        }
+
+  babl_process (lut->grid_fish, grid, samples, n_entries);
+
+  cmsDoTransform (transform, samples, grid, n_entries);
+
+  for (i = 0; i < n_entries; i++)
+    {
+      lut->table[4 * i + 0] = grid[3 * i + 0];
+      lut->table[4 * i + 1] = grid[3 * i + 1];
+      lut->table[4 * i + 2] = grid[3 * i + 2];
+      lut->table[4 * i + 3] = 0.0f;
+    }
+
+  g_free (grid);
+  g_free (samples);
+
+  return lut;
+}
+
+/*  returns the lookup table of the transform between the profiles, with
+ *  the given intents and flags, reusing an existing one if possible
+ */
+static GimpColorLut *
+gimp_color_lut_get (GimpColorProfile         *src_profile,
+                    const Babl               *src_format,
+                    GimpColorProfile         *dest_profile,
+                    const Babl               *dest_format,
+                    GimpColorProfile         *proof_profile,
+                    GimpColorRenderingIntent  intent,
+                    GimpColorRenderingIntent  proof_intent,
+                    GimpColorTransformFlags   flags)
+{
+  GimpColorLut    *lut;
+  GimpColorLut    *new_lut;
+  const Babl      *src_rgb_format;
+  const Babl      *dest_rgb_format;
+  cmsUInt16Number  alarm_codes[cmsMAXCHANNELS] = { 0, };
+  gchar           *src_checksum;
+  gchar           *dest_checksum;
+  gchar           *proof_checksum;
+  gchar           *key;
+
+  src_rgb_format  = gimp_color_lut_get_rgb_format (src_format,  FALSE);
+  dest_rgb_format = gimp_color_lut_get_rgb_format (dest_format, FALSE);
+
+  if (! src_rgb_format                         ||
+      ! dest_rgb_format                        ||
+      ! gimp_color_profile_is_rgb (src_profile) ||
+      ! gimp_color_profile_is_rgb (dest_profile))
+    {
+      return NULL;
+    }
+
+  /*  the alarm codes are global, and baked into the table  */
+  if (flags & GIMP_COLOR_TRANSFORM_FLAGS_GAMUT_CHECK)
+    cmsGetAlarmCodes (alarm_codes);
+
+  src_checksum   = gimp_color_lut_get_profile_checksum (src_profile);
+  dest_checksum  = gimp_color_lut_get_profile_checksum (dest_profile);
+  proof_checksum = gimp_color_lut_get_profile_checksum (proof_profile);
+
+  key = g_strdup_printf ("%s %s -> %s %s, proof %s, %d %d %x, %04x%04x%04x",
+                         src_checksum,  babl_get_name (src_rgb_format),
+                         dest_checksum, babl_get_name (dest_rgb_format),
+                         proof_checksum,
+                         intent, proof_intent, flags,
+                         alarm_codes[0], alarm_codes[1], alarm_codes[2]);
+
+  g_free (src_checksum);
+  g_free (dest_checksum);
+  g_free (proof_checksum);
+
+  g_mutex_lock (&lut_cache_mutex);
+
+  if (! lut_cache)
+    lut_cache = g_hash_table_new (g_str_hash, g_str_equal);
+
+  lut = g_hash_table_lookup (lut_cache, key);
+
+  if (lut)
+    {
+      lut->ref_count++;
+
+      g_mutex_unlock (&lut_cache_mutex);
+
+      g_free (key);
+
+      return lut;
+    }
+
+  g_mutex_unlock (&lut_cache_mutex);
+
+  /*  build the table without holding the lock, so that other transforms
+   *  can be created meanwhile
+   */
+  new_lut = gimp_color_lut_new (key,
+                                src_profile,   src_format,
+                                dest_profile,  dest_format,
+                                proof_profile,
+                                intent, proof_intent, flags);
+
+  if (! new_lut)
+    {
+      g_free (key);
+
+      return NULL;
+    }
+
+  g_mutex_lock (&lut_cache_mutex);
+
+  /*  another thread may have built the same table in the meantime  */
+  lut = g_hash_table_lookup (lut_cache, new_lut->key);
+
+  if (lut)
+    {
+      lut->ref_count++;
+    }
+  else
+    {
+      lut     = new_lut;
+      new_lut = NULL;
+
+      g_hash_table_insert (lut_cache, lut->key, lut);
+    }
+
+  g_mutex_unlock (&lut_cache_mutex);
+
+  if (new_lut)
+    gimp_color_lut_free (new_lut);
+
+  return lut;
+}
+
+static void
+gimp_color_lut_unref (GimpColorLut *lut)
+{
+  g_mutex_lock (&lut_cache_mutex);
+
+  if (--lut->ref_count == 0)
+    g_hash_table_remove (lut_cache, lut->key);
+  else
+    lut = NULL;
+
+  g_mutex_unlock (&lut_cache_mutex);
+
+  if (lut)
+    gimp_color_lut_free (lut);
+}
+
+static void
+gimp_color_lut_free (GimpColorLut *lut)
+{
+  cmsDeleteTransform (lut->transform);
+  g_free (lut->table);
+  g_free (lut->key);
+  g_free (lut);
+}
@@ -0,0 +1,194 @@
+/* unit tests for the lookup tables of the color transforms in
+ * gimpcolortransform.c, against plain lcms transforms
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <cairo.h>
+#include <gegl.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "gimpcolor.h"
+
+
+#define N_PIXELS  4096
+
+/*  the error allowed for in-range pixels, which are interpolated  */
+#define IN_RANGE_TOLERANCE      (1.0 / 255.0)
+
+/*  out-of-range pixels are transformed by lcms in both cases  */
+#define OUT_OF_RANGE_TOLERANCE  1e-5
+
+
+typedef struct
+{
+  const gchar        *name;
+  GimpColorProfile *(* new_profile) (void);
+} Profile;
+
+static const Profile profiles[] =
+{
+  { "linear sRGB", gimp_color_profile_new_rgb_srgb_linear },
+  { "Adobe RGB",   gimp_color_profile_new_rgb_adobe       }
+};
+
+
+static gint
+test_transform (GimpColorProfile        *src_profile,
+                GimpColorProfile        *dest_profile,
+                GimpColorTransformFlags  flags,
+                const gfloat            *src,
+                gboolean                 in_range)
+{
+  const Babl         *format = babl_format ("R'G'B'A float");
+  GimpColorTransform *lut_transform;
+  GimpColorTransform *transform;
+  gfloat             *expected;
+  gfloat             *result;
+  gdouble             tolerance;
+  gdouble             max_error = 0.0;
+  gint                i;
+
+  tolerance = in_range ? IN_RANGE_TOLERANCE : OUT_OF_RANGE_TOLERANCE;
+
+  lut_transform = gimp_color_transform_new (src_profile,  format,
+                                            dest_profile, format,
+                                            GIMP_COLOR_RENDERING_INTENT_PERCEPTUAL,
+                                            flags |
+                                            GIMP_COLOR_TRANSFORM_FLAGS_LUT);
+  transform     = gimp_color_transform_new (src_profile,  format,
+                                            dest_profile, format,
+                                            GIMP_COLOR_RENDERING_INTENT_PERCEPTUAL,
+                                            flags);
+
+  if (! lut_transform || ! transform)
+    {
+      g_print ("Failed to create the transforms!\n");
+
+      g_clear_object (&lut_transform);
+      g_clear_object (&transform);
+
+      return 1;
+    }
+
+  expected = g_new (gfloat, 4 * N_PIXELS);
+  result   = g_new (gfloat, 4 * N_PIXELS);
+
+  gimp_color_transform_process_pixels (transform,
+                                       format, src,
+                                       format, expected,
+                                       N_PIXELS);
+  gimp_color_transform_process_pixels (lut_transform,
+                                       format, src,
+                                       format, result,
+                                       N_PIXELS);
+
+  for (i = 0; i < 4 * N_PIXELS; i++)
+    max_error = MAX (max_error, fabs (result[i] - expected[i]));
+
+  g_object_unref (lut_transform);
+  g_object_unref (transform);
+
+  g_free (expected);
+  g_free (result);
+
+  g_print ("  %s pixels, max error %g\n",
+           in_range ? "in-range" : "out-of-range", max_error);
+
+  if (! (max_error <= tolerance))
+    {
+      g_print ("  error exceeds %g!\n", tolerance);
+
+      return 1;
+    }
+
+  return 0;
+}
+
+int
+main (void)
+{
+  GimpColorProfile *srgb;
+  GRand            *rand;
+  gfloat           *in_range;
+  gfloat           *out_of_range;
+  gint              failures = 0;
+  gint              i;
+
+  /*  the lookup table is only used for lcms transforms  */
+  g_setenv ("GIMP_COLOR_TRANSFORM_DISABLE_BABL", "1", TRUE);
+
+  gegl_init (NULL, NULL);
+
+  rand = g_rand_new_with_seed (0);
+
+  in_range     = g_new (gfloat, 4 * N_PIXELS);
+  out_of_range = g_new (gfloat, 4 * N_PIXELS);
+
+  for (i = 0; i < 4 * N_PIXELS; i++)
+    {
+      in_range[i]     = g_rand_double (rand);
+      out_of_range[i] = g_rand_double_range (rand, -0.5, 1.5);
+    }
+
+  /*  make sure at least one channel of each pixel is out of range  */
+  for (i = 0; i < N_PIXELS; i++)
+    {
+      gfloat *pixel = out_of_range + 4 * i;
+      gint    c     = g_rand_int_range (rand, 0, 3);
+
+      if (pixel[c] >= 0.0f && pixel[c] <= 1.0f)
+        pixel[c] = (i & 1) ? -0.2f : 1.3f;
+    }
+
+  srgb = gimp_color_profile_new_rgb_srgb ();
+
+  g_print ("\nTesting color transforms with a lookup table ...\n");
+
+  for (i = 0; i < G_N_ELEMENTS (profiles); i++)
+    {
+      GimpColorProfile *profile = profiles[i].new_profile ();
+      gint              optimize;
+
+      for (optimize = 0; optimize < 2; optimize++)
+        {
+          GimpColorTransformFlags flags = 0;
+
+          if (! optimize)
+            flags |= GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE;
+
+          g_print (" sRGB -> %s%s:\n",
+                   profiles[i].name, optimize ? "" : ", accurate");
+
+          failures += test_transform (srgb, profile, flags,
+                                      in_range, TRUE);
+          failures += test_transform (srgb, profile, flags,
+                                      out_of_range, FALSE);
+        }
+
+      g_object_unref (profile);
+    }
+
+  g_object_unref (srgb);
+
+  g_free (in_range);
+  g_free (out_of_range);
+
+  g_rand_free (rand);
+
+  gegl_exit ();
+
+  if (failures)
+    {
+      g_print ("%d transforms failed!\n\n", failures);
+      return EXIT_FAILURE;
+    }
+  else
+    {
+      g_print ("All transforms passed.\n\n");
+      return EXIT_SUCCESS;
+    }
+}
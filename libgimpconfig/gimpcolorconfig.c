@@ -90,6 +90,12 @@
   _("When disabled, image display might be of better quality " \
     "at the cost of speed.")
 
+#define DISPLAY_USE_LUT_BLURB \
+  _("When enabled, display and soft-proofing color transformations " \
+    "are precomputed into lookup tables, which are shared between " \
+    "images and displays. This is faster, especially for high bit " \
+    "depth images, at a small cost in accuracy.")
+
 #define SIMULATION_RENDERING_INTENT_BLURB \
   _("How colors are converted from your image's color space to the "  \
     "output simulation device (usually your monitor). " \
@@ -131,6 +137,7 @@ enum
   PROP_DISPLAY_RENDERING_INTENT,
   PROP_DISPLAY_USE_BPC,
   PROP_DISPLAY_OPTIMIZE,
+  PROP_DISPLAY_USE_LUT,
   PROP_SIMULATION_RENDERING_INTENT,
   PROP_SIMULATION_USE_BPC,
   PROP_SIMULATION_OPTIMIZE,
@@ -155,6 +162,7 @@ struct _GimpColorConfigPrivate
   GimpColorRenderingIntent  display_intent;
   gboolean                  display_use_black_point_compensation;
   gboolean                  display_optimize;
+  gboolean                  display_use_lut;
 
   GimpColorRenderingIntent  simulation_intent;
   gboolean                  simulation_use_black_point_compensation;
@@ -289,6 +297,13 @@ gimp_color_config_class_init (GimpColorConfigClass *klass)
                             TRUE,
                             GIMP_PARAM_STATIC_STRINGS);
 
+  GIMP_CONFIG_PROP_BOOLEAN (object_class, PROP_DISPLAY_USE_LUT,
+                            "display-use-lut",
+                            _("Use lookup tables for display color transformations"),
+                            DISPLAY_USE_LUT_BLURB,
+                            FALSE,
+                            GIMP_PARAM_STATIC_STRINGS);
+
   GIMP_CONFIG_PROP_ENUM (object_class, PROP_SIMULATION_RENDERING_INTENT,
                          "simulation-rendering-intent",
                          _("Soft-proofing rendering intent"),
@@ -412,6 +427,9 @@ gimp_color_config_set_property (GObject      *object,
     case PROP_DISPLAY_OPTIMIZE:
       priv->display_optimize = g_value_get_boolean (value);
       break;
+    case PROP_DISPLAY_USE_LUT:
+      priv->display_use_lut = g_value_get_boolean (value);
+      break;
     case PROP_SIMULATION_RENDERING_INTENT:
       priv->simulation_intent = g_value_get_enum (value);
       break;
@@ -486,6 +504,9 @@ gimp_color_config_get_property (GObject    *object,
     case PROP_DISPLAY_OPTIMIZE:
       g_value_set_boolean (value, priv->display_optimize);
       break;
+    case PROP_DISPLAY_USE_LUT:
+      g_value_set_boolean (value, priv->display_use_lut);
+      break;
     case PROP_SIMULATION_RENDERING_INTENT:
       g_value_set_enum (value, priv->simulation_intent);
       break;
@@ -575,6 +596,20 @@ gimp_color_config_get_display_optimize (GimpColorConfig *config)
   return GET_PRIVATE (config)->display_optimize;
 }
 
+/**
+ * gimp_color_config_get_display_use_lut:
+ * @config: a #GimpColorConfig
+ *
+ * Since: 3.0
+ **/
+gboolean
+gimp_color_config_get_display_use_lut (GimpColorConfig *config)
+{
+  g_return_val_if_fail (GIMP_IS_COLOR_CONFIG (config), FALSE);
+
+  return GET_PRIVATE (config)->display_use_lut;
+}
+
 /**
  * gimp_color_config_get_display_profile_from_gdk:
  * @config: a #GimpColorConfig
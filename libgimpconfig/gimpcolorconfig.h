@@ -68,6 +68,7 @@ GimpColorRenderingIntent
                    gimp_color_config_get_display_intent           (GimpColorConfig  *config);
 gboolean           gimp_color_config_get_display_bpc              (GimpColorConfig  *config);
 gboolean           gimp_color_config_get_display_optimize         (GimpColorConfig  *config);
+gboolean           gimp_color_config_get_display_use_lut          (GimpColorConfig  *config);
 gboolean           gimp_color_config_get_display_profile_from_gdk (GimpColorConfig  *config);
 
 GimpColorRenderingIntent
@@ -1007,6 +1007,9 @@ gimp_widget_get_color_transform (GtkWidget               *widget,
       if (! gimp_color_config_get_simulation_optimize (config))
         flags |= GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE;
 
+      if (gimp_color_config_get_display_use_lut (config))
+        flags |= GIMP_COLOR_TRANSFORM_FLAGS_LUT;
+
       if (gimp_color_config_get_simulation_gamut_check (config))
         {
           GimpRGB         color;
@@ -1045,6 +1048,9 @@ gimp_widget_get_color_transform (GtkWidget               *widget,
       if (! gimp_color_config_get_display_optimize (config))
         flags |= GIMP_COLOR_TRANSFORM_FLAGS_NOOPTIMIZE;
 
+      if (gimp_color_config_get_display_use_lut (config))
+        flags |= GIMP_COLOR_TRANSFORM_FLAGS_LUT;
+
       cache->transform =
         gimp_color_transform_new (cache->src_profile,
                                   cache->src_format,
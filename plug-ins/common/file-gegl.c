@@ -321,6 +321,9 @@ goat_save (GimpProcedure        *procedure,
                                                error);
     }
 
+  /*  we only read the drawable, map it instead of fetching tiles  */
+  gimp_plug_in_set_map_drawables (gimp_procedure_get_plug_in (procedure), TRUE);
+
   if (! save_image (file, format->save_op, image, drawables[0],
                     &error))
     {
@@ -39,6 +39,51 @@
 
 #define COMP_MODE_SIZE sizeof(guint16)
 
+/* Number of layers whose channels are read and decoded ahead of the
+ * layer being added to the image, per decoding thread.  This bounds the
+ * amount of compressed and decoded data held in memory at once.
+ */
+#define DECODE_LAYERS_AHEAD 1
+
+
+typedef struct _PSDlayerDecode PSDlayerDecode;
+
+/* A channel whose compressed data was read, waiting to be decoded */
+typedef struct
+{
+  PSDlayerDecode *layer;
+  PSDchannel     *channel;
+  guint16         comp_mode;
+  gchar          *blob;
+  guint64         blob_len;
+  guint32        *rle_pack_len;
+} PSDchannelDecode;
+
+struct _PSDlayerDecode
+{
+  PSDchannel       **lyr_chn;
+  gint               num_channels;
+  PSDchannelDecode  *chn_decode;
+  gint               n_decode;
+  gint               n_pending;
+  gboolean           empty_mask;
+  GError            *error;
+};
+
+typedef struct
+{
+  PSDimage       *img_a;
+  PSDlayer      **lyr_a;
+  GInputStream   *input;
+  PSDlayerDecode *layers;
+  gint            num_layers;
+  gint            next_layer;
+  gint            layers_ahead;
+  GThreadPool    *pool;
+  GMutex          mutex;
+  GCond           cond;
+} PSDdecoder;
+
 
 /*  Local function prototypes  */
 static gint             read_header_block          (PSDimage       *img_a,
@@ -106,12 +151,31 @@ static void             free_lyr_a                 (PSDlayer      **lyr_a,
 static void             free_lyr_chn               (PSDchannel    **lyr_chn,
                                                     gint            channel_count);
 
-static gboolean         read_RLE_channel           (PSDimage       *img_a,
+static guint32 *        read_RLE_pack_len          (PSDimage       *img_a,
                                                     PSDchannel     *lyr_chn,
                                                     guint64         channel_data_len,
                                                     GInputStream   *input,
                                                     GError        **error);
 
+static gboolean         read_layer_channels        (PSDimage       *img_a,
+                                                    PSDlayer       *lyr_a,
+                                                    PSDlayerDecode *decode,
+                                                    GInputStream   *input,
+                                                    GError        **error);
+static void             decode_channel_func        (PSDchannelDecode *chn_decode,
+                                                    PSDdecoder       *decoder);
+static gboolean         decoder_push_layer         (PSDdecoder     *decoder,
+                                                    gint            lidx,
+                                                    GError        **error);
+static gboolean         decoder_read_ahead         (PSDdecoder     *decoder,
+                                                    gint            lidx,
+                                                    GError        **error);
+static PSDchannel **    decoder_wait_layer         (PSDdecoder     *decoder,
+                                                    gint            lidx,
+                                                    gboolean       *empty_mask,
+                                                    GError        **error);
+static void             decoder_free               (PSDdecoder     *decoder);
+
 static gint             read_channel_data          (PSDchannel     *channel,
                                                     guint16         bps,
                                                     guint16         compression,
@@ -119,6 +183,21 @@ static gint             read_channel_data          (PSDchannel     *channel,
                                                     GInputStream   *input,
                                                     guint32         comp_len,
                                                     GError        **error);
+static gchar *          read_channel_blob          (PSDchannel     *channel,
+                                                    guint16         bps,
+                                                    guint16         compression,
+                                                    const guint32  *rle_pack_len,
+                                                    GInputStream   *input,
+                                                    guint32         comp_len,
+                                                    guint64        *blob_len,
+                                                    GError        **error);
+static gint             decode_channel_data        (PSDchannel     *channel,
+                                                    guint16         bps,
+                                                    guint16         compression,
+                                                    const guint32  *rle_pack_len,
+                                                    gchar          *blob,
+                                                    guint64         blob_len,
+                                                    GError        **error);
 
 static void             decode_32_bit_predictor    (gchar          *src,
                                                     gchar          *dst,
@@ -1724,12 +1803,12 @@ psd_convert_lab_to_srgb (PSDimage *img_a,
   return (guchar*) dst;
 }
 
-static gboolean
-read_RLE_channel (PSDimage      *img_a,
-                  PSDchannel    *lyr_chn,
-                  guint64        channel_data_len,
-                  GInputStream  *input,
-                  GError       **error)
+static guint32 *
+read_RLE_pack_len (PSDimage      *img_a,
+                   PSDchannel    *lyr_chn,
+                   guint64        channel_data_len,
+                   GInputStream  *input,
+                   GError       **error)
 {
   gint      rle_count_size = (img_a->version == 1 ? 2 : 4);
   gint      rle_row_size   = lyr_chn->rows * rle_count_size;
@@ -1750,7 +1829,7 @@ read_RLE_channel (PSDimage      *img_a,
         {
           psd_set_error (error);
           g_free (rle_pack_len);
-          return FALSE;
+          return NULL;
         }
       if (img_a->version == 1)
         rle_pack_len[rowi] = img_a->ibm_pc_format                 ?
@@ -1762,17 +1841,7 @@ read_RLE_channel (PSDimage      *img_a,
                              GUINT32_FROM_BE (rle_pack_len[rowi]);
     }
 
-  if (read_channel_data (lyr_chn, img_a->bps,
-                         PSD_COMP_RLE, rle_pack_len, input, 0,
-                         error) < 1)
-    {
-      psd_set_error (error);
-      g_free (rle_pack_len);
-      return FALSE;
-    }
-
-  g_free (rle_pack_len);
-  return TRUE;
+  return rle_pack_len;
 }
 
 static void
@@ -1786,6 +1855,339 @@ free_lyr_chn (PSDchannel **lyr_chn, gint channel_count)
   g_free (lyr_chn);
 }
 
+/* Reads the compressed data of a layer's channels, to be decoded by
+ * the decoder.
+ */
+static gboolean
+read_layer_channels (PSDimage        *img_a,
+                     PSDlayer        *lyr_a,
+                     PSDlayerDecode  *decode,
+                     GInputStream    *input,
+                     GError         **error)
+{
+  PSDchannel **lyr_chn;
+  gboolean     empty_mask;
+  gint         cidx;
+
+  /* Empty mask */
+  if (lyr_a->layer_mask.bottom - lyr_a->layer_mask.top == 0
+      || lyr_a->layer_mask.right - lyr_a->layer_mask.left == 0)
+      empty_mask = TRUE;
+  else
+      empty_mask = FALSE;
+
+  IFDBG(3) g_debug ("Empty mask %d, size %d %d", empty_mask,
+                    lyr_a->layer_mask.bottom - lyr_a->layer_mask.top,
+                    lyr_a->layer_mask.right - lyr_a->layer_mask.left);
+
+  /* Load layer channel data */
+  IFDBG(2) g_debug ("Number of channels: %d", lyr_a->num_channels);
+  /* Create pointer array for the channel records */
+  lyr_chn = g_new0 (PSDchannel *, lyr_a->num_channels);
+
+  decode->lyr_chn      = lyr_chn;
+  decode->num_channels = lyr_a->num_channels;
+  decode->chn_decode   = g_new0 (PSDchannelDecode, lyr_a->num_channels);
+
+  for (cidx = 0; cidx < lyr_a->num_channels; ++cidx)
+    {
+      PSDchannelDecode *chn_decode = &decode->chn_decode[decode->n_decode];
+      guint16           comp_mode  = PSD_COMP_RAW;
+      guint32          *rle_pack_len = NULL;
+      guint32           comp_len     = 0;
+
+      /* Allocate channel record */
+      lyr_chn[cidx] = g_malloc (sizeof (PSDchannel) );
+
+      lyr_chn[cidx]->id = lyr_a->chn_info[cidx].channel_id;
+      lyr_chn[cidx]->rows = lyr_a->bottom - lyr_a->top;
+      lyr_chn[cidx]->columns = lyr_a->right - lyr_a->left;
+      lyr_chn[cidx]->data = NULL;
+
+      if (lyr_chn[cidx]->id == PSD_CHANNEL_EXTRA_MASK)
+        {
+          if (! psd_seek (input, lyr_a->chn_info[cidx].data_len,
+                          G_SEEK_CUR, error))
+            {
+              psd_set_error (error);
+              return FALSE;
+            }
+
+          continue;
+        }
+      else if (lyr_chn[cidx]->id == PSD_CHANNEL_MASK)
+        {
+          /* Works around a bug in panotools psd files where the layer mask
+             size is given as 0 but data exists. Set mask size to layer size.
+          */
+          if (empty_mask && lyr_a->chn_info[cidx].data_len - 2 > 0)
+            {
+              empty_mask = FALSE;
+              if (lyr_a->layer_mask.top == lyr_a->layer_mask.bottom)
+                {
+                  lyr_a->layer_mask.top = lyr_a->top;
+                  lyr_a->layer_mask.bottom = lyr_a->bottom;
+                }
+              if (lyr_a->layer_mask.right == lyr_a->layer_mask.left)
+                {
+                  lyr_a->layer_mask.right = lyr_a->right;
+                  lyr_a->layer_mask.left = lyr_a->left;
+                }
+            }
+          lyr_chn[cidx]->rows = (lyr_a->layer_mask.bottom -
+                                lyr_a->layer_mask.top);
+          lyr_chn[cidx]->columns = (lyr_a->layer_mask.right -
+                                   lyr_a->layer_mask.left);
+        }
+
+      IFDBG(3) g_debug ("Channel id %d, %dx%d",
+                        lyr_chn[cidx]->id,
+                        lyr_chn[cidx]->columns,
+                        lyr_chn[cidx]->rows);
+
+      /* Only read channel data if there is any channel
+       * data. Note that the channel data can contain a
+       * compression method but no actual data.
+       */
+      if (lyr_a->chn_info[cidx].data_len >= COMP_MODE_SIZE)
+        {
+          if (psd_read (input, &comp_mode, COMP_MODE_SIZE, error) < COMP_MODE_SIZE)
+            {
+              psd_set_error (error);
+              return FALSE;
+            }
+
+          if (! img_a->ibm_pc_format)
+            comp_mode = GUINT16_FROM_BE (comp_mode);
+          else
+            comp_mode = GUINT16_FROM_LE (comp_mode);
+          IFDBG(3) g_debug ("Compression mode: %d", comp_mode);
+        }
+      if (lyr_a->chn_info[cidx].data_len > COMP_MODE_SIZE)
+        {
+          switch (comp_mode)
+            {
+              case PSD_COMP_RAW:        /* Planar raw data */
+                IFDBG(3) g_debug ("Raw data length: %" G_GSIZE_FORMAT,
+                                  lyr_a->chn_info[cidx].data_len - 2);
+                break;
+
+              case PSD_COMP_RLE:        /* Packbits */
+                rle_pack_len = read_RLE_pack_len (img_a, lyr_chn[cidx],
+                                                  lyr_a->chn_info[cidx].data_len,
+                                                  input, error);
+                if (! rle_pack_len)
+                  return FALSE;
+                break;
+
+              case PSD_COMP_ZIP:                 /* ? */
+              case PSD_COMP_ZIP_PRED:
+                comp_len = lyr_a->chn_info[cidx].data_len - 2;
+                break;
+
+              default:
+                g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                            _("Unsupported compression mode: %d"), comp_mode);
+                return FALSE;
+                break;
+            }
+
+          chn_decode->layer        = decode;
+          chn_decode->channel      = lyr_chn[cidx];
+          chn_decode->comp_mode    = comp_mode;
+          chn_decode->rle_pack_len = rle_pack_len;
+          chn_decode->blob         = read_channel_blob (lyr_chn[cidx],
+                                                        img_a->bps,
+                                                        comp_mode,
+                                                        rle_pack_len,
+                                                        input, comp_len,
+                                                        &chn_decode->blob_len,
+                                                        error);
+          if (! chn_decode->blob)
+            {
+              psd_set_error (error);
+              g_free (rle_pack_len);
+              chn_decode->rle_pack_len = NULL;
+              return FALSE;
+            }
+
+          decode->n_decode++;
+        }
+    }
+
+  decode->empty_mask = empty_mask;
+
+  return TRUE;
+}
+
+static void
+decode_channel_func (PSDchannelDecode *chn_decode,
+                     PSDdecoder       *decoder)
+{
+  PSDlayerDecode *decode = chn_decode->layer;
+  GError         *error  = NULL;
+
+  if (decode_channel_data (chn_decode->channel, decoder->img_a->bps,
+                           chn_decode->comp_mode, chn_decode->rle_pack_len,
+                           chn_decode->blob, chn_decode->blob_len,
+                           &error) < 1)
+    {
+      psd_set_error (&error);
+    }
+
+  chn_decode->blob = NULL;
+  g_clear_pointer (&chn_decode->rle_pack_len, g_free);
+
+  g_mutex_lock (&decoder->mutex);
+
+  if (error && ! decode->error)
+    decode->error = error;
+  else
+    g_clear_error (&error);
+
+  if (--decode->n_pending == 0)
+    g_cond_broadcast (&decoder->cond);
+
+  g_mutex_unlock (&decoder->mutex);
+}
+
+/* Reads the compressed data of a layer's channels, which follows the
+ * previous layer's in the file, and queues it for decoding.
+ */
+static gboolean
+decoder_push_layer (PSDdecoder  *decoder,
+                    gint         lidx,
+                    GError     **error)
+{
+  PSDlayer       *lyr_a  = decoder->lyr_a[lidx];
+  PSDlayerDecode *decode = &decoder->layers[lidx];
+  gint            i;
+
+  if (lyr_a->drop)
+    {
+      /* Step past layer data */
+      for (i = 0; i < lyr_a->num_channels; ++i)
+        {
+          if (! psd_seek (decoder->input, lyr_a->chn_info[i].data_len,
+                          G_SEEK_CUR, error))
+            {
+              psd_set_error (error);
+              return FALSE;
+            }
+        }
+
+      return TRUE;
+    }
+
+  if (! read_layer_channels (decoder->img_a, lyr_a, decode,
+                             decoder->input, error))
+    {
+      return FALSE;
+    }
+
+  decode->n_pending = decode->n_decode;
+
+  for (i = 0; i < decode->n_decode; i++)
+    g_thread_pool_push (decoder->pool, &decode->chn_decode[i], NULL);
+
+  return TRUE;
+}
+
+/* Makes sure the channels of a layer, and of the next few layers, are
+ * being read and decoded.  Must be called for each layer in turn, before
+ * it is freed.
+ */
+static gboolean
+decoder_read_ahead (PSDdecoder  *decoder,
+                    gint         lidx,
+                    GError     **error)
+{
+  while (decoder->next_layer < decoder->num_layers &&
+         decoder->next_layer <= lidx + decoder->layers_ahead)
+    {
+      if (! decoder_push_layer (decoder, decoder->next_layer++, error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Returns the decoded channels of a layer, once they're ready */
+static PSDchannel **
+decoder_wait_layer (PSDdecoder  *decoder,
+                    gint         lidx,
+                    gboolean    *empty_mask,
+                    GError     **error)
+{
+  PSDlayerDecode  *decode = &decoder->layers[lidx];
+  PSDchannel     **lyr_chn;
+
+  g_mutex_lock (&decoder->mutex);
+
+  while (decode->n_pending > 0)
+    g_cond_wait (&decoder->cond, &decoder->mutex);
+
+  g_mutex_unlock (&decoder->mutex);
+
+  if (decode->error)
+    {
+      g_propagate_error (error, decode->error);
+      decode->error = NULL;
+
+      return NULL;
+    }
+
+  lyr_chn         = decode->lyr_chn;
+  decode->lyr_chn = NULL;
+
+  *empty_mask = decode->empty_mask;
+
+  return lyr_chn;
+}
+
+static void
+decoder_free (PSDdecoder *decoder)
+{
+  gint lidx;
+  gint i;
+
+  /* Drop the pending channels, and wait for the ones being decoded */
+  if (decoder->pool)
+    g_thread_pool_free (decoder->pool, TRUE, TRUE);
+
+  for (lidx = 0; lidx < decoder->num_layers; lidx++)
+    {
+      PSDlayerDecode *decode = &decoder->layers[lidx];
+
+      for (i = 0; i < decode->n_decode; i++)
+        {
+          g_free (decode->chn_decode[i].blob);
+          g_free (decode->chn_decode[i].rle_pack_len);
+        }
+
+      if (decode->lyr_chn)
+        {
+          for (i = 0; i < decode->num_channels; i++)
+            {
+              if (decode->lyr_chn[i])
+                g_free (decode->lyr_chn[i]->data);
+            }
+
+          free_lyr_chn (decode->lyr_chn, decode->num_channels);
+        }
+
+      g_free (decode->chn_decode);
+      g_clear_error (&decode->error);
+    }
+
+  g_free (decoder->layers);
+
+  g_mutex_clear (&decoder->mutex);
+  g_cond_clear (&decoder->cond);
+
+  memset (decoder, 0, sizeof (PSDdecoder));
+}
+
 static gint
 add_layers (GimpImage     *image,
             PSDimage      *img_a,
@@ -1824,6 +2226,8 @@ add_layers (GimpImage     *image,
   GeglBuffer           *buffer;
   GimpImageType         image_type;
   LayerModeInfo         mode_info;
+  PSDdecoder            decoder = { 0, };
+  gint                  n_threads;
 
 
   IFDBG(2) g_debug ("Number of layers: %d", img_a->num_layers);
@@ -1904,24 +2308,39 @@ add_layers (GimpImage     *image,
   parent_group_stack = g_array_new (FALSE, FALSE, sizeof (GimpLayer *));
   g_array_append_val (parent_group_stack, parent_group);
 
+  /* The compressed channel data of the layers is read a few layers
+   * ahead of the one being added to the image, and decoded on a thread
+   * pool meanwhile; the layers are added in order, each as soon as its
+   * channels are ready.
+   */
+  n_threads = gimp_get_num_processors ();
+
+  decoder.img_a        = img_a;
+  decoder.lyr_a        = lyr_a;
+  decoder.input        = input;
+  decoder.num_layers   = img_a->num_layers;
+  decoder.layers       = g_new0 (PSDlayerDecode, img_a->num_layers);
+  decoder.layers_ahead = n_threads * DECODE_LAYERS_AHEAD;
+  decoder.pool         = g_thread_pool_new ((GFunc) decode_channel_func,
+                                            &decoder, n_threads, FALSE,
+                                            NULL);
+
+  g_mutex_init (&decoder.mutex);
+  g_cond_init (&decoder.cond);
+
   for (lidx = 0; lidx < img_a->num_layers; ++lidx)
     {
       IFDBG(2) g_debug ("Process Layer No %d (%s).", lidx, lyr_a[lidx]->name);
 
+      if (! decoder_read_ahead (&decoder, lidx, error))
+        {
+          decoder_free (&decoder);
+          return -1;
+        }
+
       if (lyr_a[lidx]->drop)
         {
           IFDBG(2) g_debug ("Drop layer %d", lidx);
-
-          /* Step past layer data */
-          for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
-            {
-              if (! psd_seek (input, lyr_a[lidx]->chn_info[cidx].data_len,
-                              G_SEEK_CUR, error))
-                {
-                  psd_set_error (error);
-                  return -1;
-                }
-            }
         }
       else
         {
@@ -1932,143 +2351,12 @@ add_layers (GimpImage     *image,
           else
               empty = FALSE;
 
-          /* Empty mask */
-          if (lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top == 0
-              || lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left == 0)
-              empty_mask = TRUE;
-          else
-              empty_mask = FALSE;
-
-          IFDBG(3) g_debug ("Empty mask %d, size %d %d", empty_mask,
-                            lyr_a[lidx]->layer_mask.bottom - lyr_a[lidx]->layer_mask.top,
-                            lyr_a[lidx]->layer_mask.right - lyr_a[lidx]->layer_mask.left);
-
-          /* Load layer channel data */
-          IFDBG(2) g_debug ("Number of channels: %d", lyr_a[lidx]->num_channels);
-          /* Create pointer array for the channel records */
-          lyr_chn = g_new0 (PSDchannel *, lyr_a[lidx]->num_channels);
-          for (cidx = 0; cidx < lyr_a[lidx]->num_channels; ++cidx)
+          /* Wait for the layer channel data */
+          lyr_chn = decoder_wait_layer (&decoder, lidx, &empty_mask, error);
+          if (! lyr_chn)
             {
-              guint16 comp_mode = PSD_COMP_RAW;
-
-              /* Allocate channel record */
-              lyr_chn[cidx] = g_malloc (sizeof (PSDchannel) );
-
-              lyr_chn[cidx]->id = lyr_a[lidx]->chn_info[cidx].channel_id;
-              lyr_chn[cidx]->rows = lyr_a[lidx]->bottom - lyr_a[lidx]->top;
-              lyr_chn[cidx]->columns = lyr_a[lidx]->right - lyr_a[lidx]->left;
-              lyr_chn[cidx]->data = NULL;
-
-              if (lyr_chn[cidx]->id == PSD_CHANNEL_EXTRA_MASK)
-                {
-                  if (! psd_seek (input, lyr_a[lidx]->chn_info[cidx].data_len,
-                                  G_SEEK_CUR, error))
-                    {
-                      psd_set_error (error);
-                      free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                      return -1;
-                    }
-
-                  continue;
-                }
-              else if (lyr_chn[cidx]->id == PSD_CHANNEL_MASK)
-                {
-                  /* Works around a bug in panotools psd files where the layer mask
-                     size is given as 0 but data exists. Set mask size to layer size.
-                  */
-                  if (empty_mask && lyr_a[lidx]->chn_info[cidx].data_len - 2 > 0)
-                    {
-                      empty_mask = FALSE;
-                      if (lyr_a[lidx]->layer_mask.top == lyr_a[lidx]->layer_mask.bottom)
-                        {
-                          lyr_a[lidx]->layer_mask.top = lyr_a[lidx]->top;
-                          lyr_a[lidx]->layer_mask.bottom = lyr_a[lidx]->bottom;
-                        }
-                      if (lyr_a[lidx]->layer_mask.right == lyr_a[lidx]->layer_mask.left)
-                        {
-                          lyr_a[lidx]->layer_mask.right = lyr_a[lidx]->right;
-                          lyr_a[lidx]->layer_mask.left = lyr_a[lidx]->left;
-                        }
-                    }
-                  lyr_chn[cidx]->rows = (lyr_a[lidx]->layer_mask.bottom -
-                                        lyr_a[lidx]->layer_mask.top);
-                  lyr_chn[cidx]->columns = (lyr_a[lidx]->layer_mask.right -
-                                           lyr_a[lidx]->layer_mask.left);
-                }
-
-              IFDBG(3) g_debug ("Channel id %d, %dx%d",
-                                lyr_chn[cidx]->id,
-                                lyr_chn[cidx]->columns,
-                                lyr_chn[cidx]->rows);
-
-              /* Only read channel data if there is any channel
-               * data. Note that the channel data can contain a
-               * compression method but no actual data.
-               */
-              if (lyr_a[lidx]->chn_info[cidx].data_len >= COMP_MODE_SIZE)
-                {
-                  if (psd_read (input, &comp_mode, COMP_MODE_SIZE, error) < COMP_MODE_SIZE)
-                    {
-                      psd_set_error (error);
-                      free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                      return -1;
-                    }
-
-                  if (! img_a->ibm_pc_format)
-                    comp_mode = GUINT16_FROM_BE (comp_mode);
-                  else
-                    comp_mode = GUINT16_FROM_LE (comp_mode);
-                  IFDBG(3) g_debug ("Compression mode: %d", comp_mode);
-                }
-              if (lyr_a[lidx]->chn_info[cidx].data_len > COMP_MODE_SIZE)
-                {
-                  switch (comp_mode)
-                    {
-                      case PSD_COMP_RAW:        /* Planar raw data */
-                        IFDBG(3) g_debug ("Raw data length: %" G_GSIZE_FORMAT,
-                                          lyr_a[lidx]->chn_info[cidx].data_len - 2);
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                               PSD_COMP_RAW, NULL, input, 0,
-                                               error) < 1)
-                          {
-                            psd_set_error (error);
-                            free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                            return -1;
-                          }
-                        break;
-
-                      case PSD_COMP_RLE:        /* Packbits */
-                        if (! read_RLE_channel (img_a, lyr_chn[cidx],
-                                                lyr_a[lidx]->chn_info[cidx].data_len,
-                                                input, error))
-                          {
-                            psd_set_error (error);
-                            free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                            return -1;
-                          }
-                        break;
-
-                      case PSD_COMP_ZIP:                 /* ? */
-                      case PSD_COMP_ZIP_PRED:
-                        if (read_channel_data (lyr_chn[cidx], img_a->bps,
-                                               comp_mode, NULL, input,
-                                               lyr_a[lidx]->chn_info[cidx].data_len - 2,
-                                               error) < 1)
-                          {
-                            psd_set_error (error);
-                            free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                            return -1;
-                          }
-                        break;
-
-                      default:
-                        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                                    _("Unsupported compression mode: %d"), comp_mode);
-                        free_lyr_chn (lyr_chn, lyr_a[lidx]->num_channels);
-                        return -1;
-                        break;
-                    }
-                }
+              decoder_free (&decoder);
+              return -1;
             }
 
           /* Draw layer */
@@ -2533,6 +2821,8 @@ add_layers (GimpImage     *image,
   g_free (lyr_a);
   g_array_free (parent_group_stack, FALSE);
 
+  decoder_free (&decoder);
+
   /* Set the selected layers */
   gimp_image_take_selected_layers (image, selected_layers);
   g_list_free (img_a->layer_selection);
@@ -3094,10 +3384,34 @@ read_channel_data (PSDchannel     *channel,
                    guint32         comp_len,
                    GError        **error)
 {
-  gchar    *raw_data = NULL;
-  gchar    *src;
+  gchar   *blob;
+  guint64  blob_len;
+
+  blob = read_channel_blob (channel, bps, compression, rle_pack_len,
+                            input, comp_len, &blob_len, error);
+  if (! blob)
+    return -1;
+
+  return decode_channel_data (channel, bps, compression, rle_pack_len,
+                              blob, blob_len, error);
+}
+
+/* Reads the still compressed data of a channel, so that it can be
+ * decoded by decode_channel_data() independently of the input.
+ */
+static gchar *
+read_channel_blob (PSDchannel     *channel,
+                   guint16         bps,
+                   guint16         compression,
+                   const guint32  *rle_pack_len,
+                   GInputStream   *input,
+                   guint32         comp_len,
+                   guint64        *blob_len,
+                   GError        **error)
+{
+  gchar    *blob;
   guint32   readline_len;
-  gint      i, j;
+  gint      i;
 
   if (bps == 1)
     readline_len = ((channel->columns + 7) / 8);
@@ -3113,61 +3427,105 @@ read_channel_data (PSDchannel     *channel,
     {
       g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                    _("Unsupported or invalid channel size"));
-      return -1;
+      return NULL;
     }
 
-  raw_data = g_malloc (readline_len * channel->rows);
   switch (compression)
     {
       case PSD_COMP_RAW:
-        if (psd_read (input, raw_data, readline_len * channel->rows, error) < readline_len * channel->rows)
-          {
-            psd_set_error (error);
-            g_free (raw_data);
-            return -1;
-          }
+        *blob_len = (guint64) readline_len * channel->rows;
         break;
 
       case PSD_COMP_RLE:
+        *blob_len = 0;
+        for (i = 0; i < channel->rows; ++i)
+          *blob_len += rle_pack_len[i];
+        break;
+
+      case PSD_COMP_ZIP:
+      case PSD_COMP_ZIP_PRED:
+        *blob_len = comp_len;
+        break;
+
+      default:
+        g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                     _("Unsupported compression mode: %d"), compression);
+        return NULL;
+    }
+
+  /* FIXME check for over-run of the channel data */
+  if (*blob_len <= G_MAXINT)
+    blob = g_try_malloc (MAX (*blob_len, 1));
+  else
+    blob = NULL;
+
+  if (! blob)
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   _("Unsupported or invalid channel size"));
+      return NULL;
+    }
+
+  if (psd_read (input, blob, *blob_len, error) < *blob_len)
+    {
+      psd_set_error (error);
+      g_free (blob);
+      return NULL;
+    }
+
+  return blob;
+}
+
+/* Decodes a channel read by read_channel_blob(), taking ownership of
+ * @blob.  Doesn't touch the input, and may be called from any thread.
+ */
+static gint
+decode_channel_data (PSDchannel     *channel,
+                     guint16         bps,
+                     guint16         compression,
+                     const guint32  *rle_pack_len,
+                     gchar          *blob,
+                     guint64         blob_len,
+                     GError        **error)
+{
+  gchar    *raw_data = NULL;
+  gchar    *src;
+  guint32   readline_len;
+  gint      i, j;
+
+  if (bps == 1)
+    readline_len = ((channel->columns + 7) / 8);
+  else
+    readline_len = (channel->columns * bps / 8);
+
+  switch (compression)
+    {
+      case PSD_COMP_RAW:
+        raw_data = blob;
+        blob     = NULL;
+        break;
+
+      case PSD_COMP_RLE:
+        raw_data = g_malloc (readline_len * channel->rows);
+        src      = blob;
         for (i = 0; i < channel->rows; ++i)
           {
-            src = gegl_scratch_alloc (rle_pack_len[i]);
-/*      FIXME check for over-run
-            if (PSD_TELL(input) + rle_pack_len[i] > block_end)
-              {
-                psd_set_error (TRUE, errno, error);
-                return -1;
-              }
-*/
-            if (psd_read (input, src, rle_pack_len[i], error) < rle_pack_len[i])
-              {
-                psd_set_error (error);
-                gegl_scratch_free (src);
-                g_free (raw_data);
-                return -1;
-              }
             /* FIXME check for errors returned from decode packbits */
             decode_packbits (src, raw_data + i * readline_len,
                              rle_pack_len[i], readline_len);
-            gegl_scratch_free (src);
+            src += rle_pack_len[i];
           }
         break;
+
       case PSD_COMP_ZIP:
       case PSD_COMP_ZIP_PRED:
         {
           z_stream zs;
 
-          src = g_malloc (comp_len);
-          if (psd_read (input, src, comp_len, error) < comp_len)
-            {
-              psd_set_error (error);
-              g_free (src);
-              g_free (raw_data);
-              return -1;
-            }
+          raw_data = g_malloc (readline_len * channel->rows);
 
-          zs.next_in = (guchar*) src;
-          zs.avail_in = comp_len;
+          zs.next_in = (guchar*) blob;
+          zs.avail_in = blob_len;
           zs.next_out = (guchar*) raw_data;
           zs.avail_out = readline_len * channel->rows;
           zs.zalloc = zzalloc;
@@ -3182,16 +3540,16 @@ read_channel_data (PSDchannel     *channel,
             {
               g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
                            _("Failed to decompress data"));
-              g_free (src);
+              g_free (blob);
               g_free (raw_data);
               return -1;
             }
-
-          g_free (src);
           break;
         }
     }
 
+  g_free (blob);
+
   /* Convert channel data to GIMP format */
   switch (bps)
     {
@@ -32,6 +32,7 @@
 #include "file-tiff-io.h"
 
 static gboolean tiff_file_size_error = FALSE;
+static GThread  *tiff_main_thread     = NULL;
 
 typedef struct
 {
@@ -85,50 +86,66 @@ register_geotags (TIFF *tif)
 }
 
 
-static TiffIO tiff_io = { 0, };
-
-
 TIFF *
 tiff_open (GFile        *file,
            const gchar  *mode,
            GError      **error)
 {
+  TiffIO *tiff_io;
+  TIFF   *tif;
+
   TIFFSetWarningHandler ((TIFFErrorHandler) tiff_io_warning);
   TIFFSetErrorHandler ((TIFFErrorHandler) tiff_io_error);
 
-  parent_extender = TIFFSetTagExtender (register_geotags);
+  if (! tiff_main_thread)
+    {
+      tiff_main_thread = g_thread_self ();
+
+      parent_extender = TIFFSetTagExtender (register_geotags);
+    }
+
+  tiff_io = g_new0 (TiffIO, 1);
 
-  tiff_io.file = file;
+  tiff_io->file = file;
 
   if (! strcmp (mode, "r"))
     {
-      tiff_io.input = G_INPUT_STREAM (g_file_read (file, NULL, error));
-      if (! tiff_io.input)
-        return NULL;
+      tiff_io->input = G_INPUT_STREAM (g_file_read (file, NULL, error));
+      if (! tiff_io->input)
+        {
+          g_free (tiff_io);
+          return NULL;
+        }
 
-      tiff_io.stream = G_OBJECT (tiff_io.input);
+      tiff_io->stream = G_OBJECT (tiff_io->input);
     }
   else if(! strcmp (mode, "w") || ! strcmp (mode, "w8"))
     {
-      tiff_io.output = G_OUTPUT_STREAM (g_file_replace (file,
-                                                        NULL, FALSE,
-                                                        G_FILE_CREATE_NONE,
-                                                        NULL, error));
-      if (! tiff_io.output)
-        return NULL;
-
-      tiff_io.stream = G_OBJECT (tiff_io.output);
+      tiff_io->output = G_OUTPUT_STREAM (g_file_replace (file,
+                                                         NULL, FALSE,
+                                                         G_FILE_CREATE_NONE,
+                                                         NULL, error));
+      if (! tiff_io->output)
+        {
+          g_free (tiff_io);
+          return NULL;
+        }
+
+      tiff_io->stream = G_OBJECT (tiff_io->output);
     }
   else if(! strcmp (mode, "a"))
     {
       GIOStream *iostream = G_IO_STREAM (g_file_open_readwrite (file, NULL,
                                                                 error));
       if (! iostream)
-        return NULL;
+        {
+          g_free (tiff_io);
+          return NULL;
+        }
 
-      tiff_io.input  = g_io_stream_get_input_stream (iostream);
-      tiff_io.output = g_io_stream_get_output_stream (iostream);
-      tiff_io.stream = G_OBJECT (iostream);
+      tiff_io->input  = g_io_stream_get_input_stream (iostream);
+      tiff_io->output = g_io_stream_get_output_stream (iostream);
+      tiff_io->stream = G_OBJECT (iostream);
     }
   else
     {
@@ -137,18 +154,49 @@ tiff_open (GFile        *file,
 
 #if 0
 #warning FIXME !can_seek code is broken
-  tiff_io.can_seek = g_seekable_can_seek (G_SEEKABLE (tiff_io.stream));
+  tiff_io->can_seek = g_seekable_can_seek (G_SEEKABLE (tiff_io->stream));
 #endif
-  tiff_io.can_seek = TRUE;
-
-  return TIFFClientOpen ("file-tiff", mode,
-                         (thandle_t) &tiff_io,
-                         tiff_io_read,
-                         tiff_io_write,
-                         tiff_io_seek,
-                         tiff_io_close,
-                         tiff_io_get_file_size,
-                         NULL, NULL);
+  tiff_io->can_seek = TRUE;
+
+  tif = TIFFClientOpen ("file-tiff", mode,
+                        (thandle_t) tiff_io,
+                        tiff_io_read,
+                        tiff_io_write,
+                        tiff_io_seek,
+                        tiff_io_close,
+                        tiff_io_get_file_size,
+                        NULL, NULL);
+
+  if (! tif)
+    tiff_io_close ((thandle_t) tiff_io);
+
+  return tif;
+}
+
+/* Opens another read handle on the file of @tif, on the same directory,
+ * e.g. for decoding its strips or tiles on another thread.
+ */
+TIFF *
+tiff_reopen (TIFF    *tif,
+             GError **error)
+{
+  TiffIO *io = (TiffIO *) TIFFClientdata (tif);
+  TIFF   *new_tif;
+
+  new_tif = tiff_open (io->file, "r", error);
+
+  if (new_tif && ! TIFFSetDirectory (new_tif, TIFFCurrentDirectory (tif)))
+    {
+      g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                   "Could not set TIFF directory %d",
+                   TIFFCurrentDirectory (tif));
+
+      TIFFClose (new_tif);
+
+      return NULL;
+    }
+
+  return new_tif;
 }
 
 gboolean
@@ -170,6 +218,19 @@ tiff_io_warning (const gchar *module,
 {
   gint tag = 0;
 
+  /* Only the main thread may talk to the core, warnings from
+   * decoding threads are just reported to stderr.
+   */
+  if (g_thread_self () != tiff_main_thread)
+    {
+      gchar *msg = g_strdup_vprintf (fmt, ap);
+
+      g_printerr ("LibTiff warning: [%s] %s\n", module, msg);
+      g_free (msg);
+
+      return;
+    }
+
   /* Between libtiff 3.7.0beta2 and 4.0.0alpha. */
   if (! strcmp (fmt, "%s: unknown field with tag %d (0x%x) encountered") ||
       /* Before libtiff 3.7.0beta2. */
@@ -288,6 +349,15 @@ tiff_io_error (const gchar *module,
 
   msg = g_strdup_vprintf (fmt, ap);
 
+  if (g_thread_self () != tiff_main_thread)
+    {
+      /* See tiff_io_warning() */
+      g_printerr ("LibTiff error: [%s] %s\n", module, msg);
+      g_free (msg);
+
+      return;
+    }
+
   if (g_strcmp0 (fmt, "Maximum TIFF file size exceeded") == 0)
     /* @module in my tests were "TIFFAppendToStrip" but I wonder if
      * this same error could not happen with other "modules".
@@ -538,16 +608,9 @@ tiff_io_close (thandle_t handle)
     }
 
   g_object_unref (io->stream);
-  io->stream = NULL;
-  io->input  = NULL;
-  io->output = NULL;
 
   g_free (io->buffer);
-  io->buffer = NULL;
-
-  io->allocated = 0;
-  io->used      = 0;
-  io->position  = 0;
+  g_free (io);
 
   return closed ? 0 : -1;
 }
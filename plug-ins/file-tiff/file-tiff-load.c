@@ -64,6 +64,14 @@
 
 #define PLUG_IN_ROLE "gimp-file-tiff-load"
 
+/* TIFFReadFromUserBuffer() and TIFFGetStrileByteCount() */
+#if TIFFLIB_VERSION >= 20191103
+#define PARALLEL_DECODE 1
+#endif
+
+/* upper bound for the memory used by strips or tiles in flight */
+#define PARALLEL_DECODE_MAX_MEMORY (256 << 20)
+
 
 typedef struct
 {
@@ -81,6 +89,28 @@ typedef enum
   GIMP_TIFF_LOAD_CHANNEL
 } DefaultExtra;
 
+#ifdef PARALLEL_DECODE
+typedef struct
+{
+  guint32   strile;
+  guint32   x;
+  guint32   y;
+  guint32   cols;
+  guint32   rows;
+  guchar   *raw;
+  tmsize_t  raw_size;
+  guchar   *buffer;
+  tmsize_t  buffer_size;
+  gboolean  success;
+} TiffStrile;
+
+typedef struct
+{
+  GAsyncQueue *decoders;
+  GAsyncQueue *done;
+} TiffDecodeData;
+#endif
+
 typedef enum
 {
   GIMP_TIFF_DEFAULT,
@@ -103,6 +133,27 @@ static void               load_contiguous  (TIFF              *tif,
                                             TiffColorMode      tiff_mode,
                                             gboolean           is_signed,
                                             gint               extra);
+static void          load_contiguous_tile  (const guchar      *buffer,
+                                            gint               rowstride,
+                                            ChannelData       *channel,
+                                            const Babl        *src_format,
+                                            gint               extra,
+                                            guint32            x,
+                                            guint32            y,
+                                            guint32            cols,
+                                            guint32            rows);
+#ifdef PARALLEL_DECODE
+static gboolean     load_contiguous_parallel (TIFF            *tif,
+                                            ChannelData       *channel,
+                                            const Babl        *type,
+                                            gushort            bps,
+                                            gushort            spp,
+                                            TiffColorMode      tiff_mode,
+                                            gboolean           is_signed,
+                                            gint               extra);
+static void               decode_strile    (TiffStrile        *strile,
+                                            TiffDecodeData    *data);
+#endif
 static void               load_separate    (TIFF              *tif,
                                             ChannelData       *channel,
                                             const Babl        *type,
@@ -1929,6 +1980,12 @@ load_contiguous (TIFF         *tif,
 
   g_printerr ("%s\n", __func__);
 
+#ifdef PARALLEL_DECODE
+  if (load_contiguous_parallel (tif, channel, type, bps, spp,
+                                tiff_mode, is_signed, extra))
+    return;
+#endif
+
   TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
   TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
 
@@ -1974,10 +2031,8 @@ load_contiguous (TIFF         *tif,
 
       for (x = 0; x < image_width; x += tile_width)
         {
-          GeglBuffer *src_buf;
-          guint32     rows;
-          guint32     cols;
-          gint        offset;
+          guint32 rows;
+          guint32 cols;
 
           gimp_progress_update (progress + one_row *
                                 ((gdouble) x / (gdouble) image_width));
@@ -2024,61 +2079,323 @@ load_contiguous (TIFF         *tif,
               convert_miniswhite (buffer, cols, rows);
             }
 
-          src_buf = gegl_buffer_linear_new_from_data (needs_upscale ? bw_buffer : buffer,
-                                                      src_format,
-                                                      GEGL_RECTANGLE (0, 0, cols, rows),
-                                                      tile_width * bytes_per_pixel,
-                                                      NULL, NULL);
+          load_contiguous_tile (needs_upscale ? bw_buffer : buffer,
+                                tile_width * bytes_per_pixel,
+                                channel, src_format, extra,
+                                x, y, cols, rows);
+        }
+
+      progress += one_row;
+    }
+
+  g_free (buffer);
+  g_free (bw_buffer);
+}
+
 
-          offset = 0;
+static void
+load_contiguous_tile (const guchar *buffer,
+                      gint          rowstride,
+                      ChannelData  *channel,
+                      const Babl   *src_format,
+                      gint          extra,
+                      guint32       x,
+                      guint32       y,
+                      guint32       cols,
+                      guint32       rows)
+{
+  GeglBuffer *src_buf;
+  gint        offset;
+  gint        i;
+
+  src_buf = gegl_buffer_linear_new_from_data ((guchar *) buffer,
+                                              src_format,
+                                              GEGL_RECTANGLE (0, 0, cols, rows),
+                                              rowstride,
+                                              NULL, NULL);
 
-          for (i = 0; i <= extra; i++)
+  offset = 0;
+
+  for (i = 0; i <= extra; i++)
+    {
+      GeglBufferIterator *iter;
+      gint                src_bpp;
+      gint                dest_bpp;
+
+      src_bpp  = babl_format_get_bytes_per_pixel (src_format);
+      dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
+
+      iter = gegl_buffer_iterator_new (src_buf,
+                                       GEGL_RECTANGLE (0, 0, cols, rows),
+                                       0, NULL,
+                                       GEGL_ACCESS_READ,
+                                       GEGL_ABYSS_NONE, 2);
+      gegl_buffer_iterator_add (iter, channel[i].buffer,
+                                GEGL_RECTANGLE (x, y, cols, rows),
+                                0, channel[i].format,
+                                GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
+
+      while (gegl_buffer_iterator_next (iter))
+        {
+          guchar *s      = iter->items[0].data;
+          guchar *d      = iter->items[1].data;
+          gint    length = iter->length;
+
+          s += offset;
+
+          while (length--)
             {
-              GeglBufferIterator *iter;
-              gint                src_bpp;
-              gint                dest_bpp;
-
-              src_bpp  = babl_format_get_bytes_per_pixel (src_format);
-              dest_bpp = babl_format_get_bytes_per_pixel (channel[i].format);
-
-              iter = gegl_buffer_iterator_new (src_buf,
-                                               GEGL_RECTANGLE (0, 0, cols, rows),
-                                               0, NULL,
-                                               GEGL_ACCESS_READ,
-                                               GEGL_ABYSS_NONE, 2);
-              gegl_buffer_iterator_add (iter, channel[i].buffer,
-                                        GEGL_RECTANGLE (x, y, cols, rows),
-                                        0, channel[i].format,
-                                        GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE);
-
-              while (gegl_buffer_iterator_next (iter))
-                {
-                  guchar *s      = iter->items[0].data;
-                  guchar *d      = iter->items[1].data;
-                  gint    length = iter->length;
+              memcpy (d, s, dest_bpp);
+              d += dest_bpp;
+              s += src_bpp;
+            }
+        }
 
-                  s += offset;
+      offset += dest_bpp;
+    }
 
-                  while (length--)
-                    {
-                      memcpy (d, s, dest_bpp);
-                      d += dest_bpp;
-                      s += src_bpp;
-                    }
-                }
+  g_object_unref (src_buf);
+}
+
+#ifdef PARALLEL_DECODE
+/* Reads the raw strips or tiles of a contiguous image in file order,
+ * decodes them on a thread pool, and writes them to the buffers in
+ * whatever order they are decoded.  Returns FALSE, without touching the
+ * buffers, if the image is not worth, or can't be, decoded in parallel.
+ */
+static gboolean
+load_contiguous_parallel (TIFF          *tif,
+                          ChannelData   *channel,
+                          const Babl    *type,
+                          gushort        bps,
+                          gushort        spp,
+                          TiffColorMode  tiff_mode,
+                          gboolean       is_signed,
+                          gint           extra)
+{
+  TiffDecodeData  data;
+  GThreadPool    *pool;
+  const Babl     *src_format;
+  guint32         image_width;
+  guint32         image_height;
+  guint32         tile_width;
+  guint32         tile_height;
+  gushort         compression;
+  tmsize_t        strile_size;
+  guint32         n_striles;
+  guint32         across;
+  guint32         n_done    = 0;
+  gint            n_pending = 0;
+  gint            max_pending;
+  gint            n_threads;
+  gint            bytes_per_pixel;
+  gint            failed_y  = -1;
+  guint32         strile;
+  gint            i;
+
+  if (tiff_mode != GIMP_TIFF_DEFAULT && bps < 8)
+    return FALSE;
+
+  /* only codecs where strips and tiles decode independently, and
+   * where decoding is what takes the time
+   */
+  TIFFGetFieldDefaulted (tif, TIFFTAG_COMPRESSION, &compression);
+
+  switch (compression)
+    {
+    case COMPRESSION_LZW:
+    case COMPRESSION_ADOBE_DEFLATE:
+    case COMPRESSION_DEFLATE:
+    case COMPRESSION_PACKBITS:
+    case COMPRESSION_LZMA:
+    case COMPRESSION_ZSTD:
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  TIFFGetField (tif, TIFFTAG_IMAGEWIDTH,  &image_width);
+  TIFFGetField (tif, TIFFTAG_IMAGELENGTH, &image_height);
+
+  if (TIFFIsTiled (tif))
+    {
+      TIFFGetField (tif, TIFFTAG_TILEWIDTH,  &tile_width);
+      TIFFGetField (tif, TIFFTAG_TILELENGTH, &tile_height);
+
+      strile_size = TIFFTileSize (tif);
+      n_striles   = TIFFNumberOfTiles (tif);
+    }
+  else
+    {
+      tile_width = image_width;
+      TIFFGetFieldDefaulted (tif, TIFFTAG_ROWSPERSTRIP, &tile_height);
+      tile_height = MIN (tile_height, image_height);
+
+      strile_size = TIFFStripSize (tif);
+      n_striles   = TIFFNumberOfStrips (tif);
+    }
+
+  n_threads = gimp_get_num_processors ();
+
+  /* a decoded and, at most, a raw strile each */
+  max_pending = MIN (2 * n_threads,
+                     PARALLEL_DECODE_MAX_MEMORY / MAX (2 * strile_size, 1));
+
+  if (n_threads < 2 || n_striles < 2 || max_pending < 2 ||
+      tile_width == 0 || tile_height == 0)
+    return FALSE;
+
+  /* each decoding thread needs its own handle for the codec state */
+  data.decoders = g_async_queue_new_full ((GDestroyNotify) TIFFClose);
+  data.done     = g_async_queue_new ();
+
+  for (i = 0; i < n_threads; i++)
+    {
+      TIFF *decoder = tiff_reopen (tif, NULL);
+
+      if (! decoder)
+        break;
+
+      g_async_queue_push (data.decoders, decoder);
+    }
+
+  if (i < n_threads)
+    {
+      g_async_queue_unref (data.decoders);
+      g_async_queue_unref (data.done);
+
+      return FALSE;
+    }
+
+  pool = g_thread_pool_new ((GFunc) decode_strile, &data,
+                            n_threads, FALSE, NULL);
+
+  src_format = babl_format_n (type, spp);
+
+  bytes_per_pixel = 0;
+  for (i = 0; i <= extra; i++)
+    bytes_per_pixel += babl_format_get_bytes_per_pixel (channel[i].format);
+
+  across = (image_width + tile_width - 1) / tile_width;
+  strile = 0;
+
+  while (TRUE)
+    {
+      TiffStrile *s;
+
+      /* keep the thread pool fed, with a bounded number of striles */
+      while (strile < n_striles && n_pending < max_pending && failed_y < 0)
+        {
+          s = g_new0 (TiffStrile, 1);
+
+          s->strile = strile;
+          s->x      = (strile % across) * tile_width;
+          s->y      = (strile / across) * tile_height;
+          s->cols   = MIN (image_width  - s->x, tile_width);
+          s->rows   = MIN (image_height - s->y, tile_height);
+
+          if (TIFFIsTiled (tif))
+            s->buffer_size = strile_size;
+          else
+            s->buffer_size = TIFFVStripSize (tif, s->rows);
 
-              offset += dest_bpp;
+          s->raw_size = TIFFGetStrileByteCount (tif, strile);
+
+          if (s->raw_size > 0)
+            s->raw = g_try_malloc (s->raw_size);
+
+          if (! s->raw ||
+              (TIFFIsTiled (tif) ?
+               TIFFReadRawTile (tif, strile, s->raw, s->raw_size) :
+               TIFFReadRawStrip (tif, strile, s->raw, s->raw_size)) != s->raw_size)
+            {
+              failed_y = s->y;
+
+              g_free (s->raw);
+              g_free (s);
+
+              break;
             }
 
-          g_object_unref (src_buf);
+          g_thread_pool_push (pool, s, NULL);
+
+          strile++;
+          n_pending++;
         }
 
-      progress += one_row;
+      if (n_pending == 0)
+        break;
+
+      s = g_async_queue_pop (data.done);
+
+      if (! s->success)
+        {
+          if (failed_y < 0 || s->y < failed_y)
+            failed_y = s->y;
+        }
+      else if (failed_y < 0)
+        {
+          if (is_signed)
+            convert_int2uint (s->buffer, bps, spp, s->cols, s->rows,
+                              tile_width * bytes_per_pixel);
+
+          if (tiff_mode == GIMP_TIFF_GRAY_MINISWHITE && bps == 8)
+            convert_miniswhite (s->buffer, s->cols, s->rows);
+
+          load_contiguous_tile (s->buffer, tile_width * bytes_per_pixel,
+                                channel, src_format, extra,
+                                s->x, s->y, s->cols, s->rows);
+        }
+
+      g_free (s->buffer);
+      g_free (s);
+
+      n_done++;
+      n_pending--;
+
+      if (n_done % 16 == 0)
+        gimp_progress_update ((gdouble) n_done / (gdouble) n_striles);
     }
 
-  g_free (buffer);
-  g_free (bw_buffer);
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  g_async_queue_unref (data.decoders);
+  g_async_queue_unref (data.done);
+
+  if (failed_y >= 0)
+    {
+      if (TIFFIsTiled (tif))
+        g_message (_("Reading tile failed. Image may be corrupt at line %d."),
+                   failed_y);
+      else
+        g_message (_("Reading scanline failed. Image may be corrupt at line %d."),
+                   failed_y);
+    }
+
+  return TRUE;
+}
+
+static void
+decode_strile (TiffStrile     *strile,
+               TiffDecodeData *data)
+{
+  TIFF *decoder = g_async_queue_pop (data->decoders);
+
+  strile->buffer  = g_try_malloc (strile->buffer_size);
+  strile->success = strile->buffer &&
+                    TIFFReadFromUserBuffer (decoder, strile->strile,
+                                            strile->raw, strile->raw_size,
+                                            strile->buffer,
+                                            strile->buffer_size);
+
+  g_async_queue_push (data->decoders, decoder);
+
+  g_clear_pointer (&strile->raw, g_free);
+
+  g_async_queue_push (data->done, strile);
 }
+#endif /* PARALLEL_DECODE */
 
 
 static void
@@ -16,6 +16,9 @@
 #include "libgimp/stdplugins-intl.h"
 
 
+#define CHUNK_PIXELS (1 << 20)
+
+
 /*************/
 /* Main loop */
 /*************/
@@ -24,13 +27,16 @@ void
 compute_image (void)
 {
   gint         xcount, ycount;
-  GimpRGB      color;
+  gint         chunk_height;
+  gint         n_rows;
+  GimpRGB     *colors;
+  gdouble     *xpos;
+  gdouble     *ypos;
   glong        progress_counter = 0;
-  GimpVector3  p;
   GimpImage   *new_image = NULL;
   GimpLayer   *new_layer = NULL;
   gint32       index;
-  guchar      *row = NULL;
+  guchar      *rows = NULL;
   guchar       obpp;
   gboolean     has_alpha;
   get_ray_func ray_func;
@@ -96,49 +102,67 @@ compute_image (void)
   /* FIXME */
   obpp = has_alpha ? 4 : 3; //gimp_drawable_get_bpp (output_drawable);
 
-  row = g_new (guchar, obpp * width);
+  /* Shade the image in chunks of rows; the rows of a chunk are
+   * distributed among threads by shade_rows()
+   */
+  chunk_height = CLAMP (CHUNK_PIXELS / width, 1, height);
 
-  gimp_progress_init (_("Lighting Effects"));
+  colors = g_new (GimpRGB, (gsize) width * chunk_height);
+  rows   = g_new (guchar, (gsize) obpp * width * chunk_height);
+  xpos   = g_new (gdouble, width);
+  ypos   = g_new (gdouble, chunk_height);
 
-  /* Init the first row */
-  if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1 && height >= 2)
-    interpol_row (0, width, 0);
+  for (xcount = 0; xcount < width; xcount++)
+    xpos[xcount] = xcount;
+
+  gimp_progress_init (_("Lighting Effects"));
 
-  for (ycount = 0; ycount < height; ycount++)
+  for (ycount = 0; ycount < height; ycount += n_rows)
     {
-      if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1)
-	precompute_normals (0, width, ycount);
+      gint i;
 
-      index = 0;
+      n_rows = MIN (chunk_height, height - ycount);
 
-      for (xcount = 0; xcount < width; xcount++)
-	{
-	  p = int_to_pos (xcount, ycount);
-	  color = (* ray_func) (&p);
+      for (i = 0; i < n_rows; i++)
+        ypos[i] = ycount + i;
 
-	  row[index++] = (guchar) (color.r * 255.0);
-	  row[index++] = (guchar) (color.g * 255.0);
-	  row[index++] = (guchar) (color.b * 255.0);
+      source_rows_fetch (ypos, n_rows);
 
-	  if (has_alpha)
-	    row[index++] = (guchar) (color.a * 255.0);
+      shade_rows (ray_func, xpos, width, ypos, n_rows, colors);
 
-	  progress_counter++;
-	}
+      source_rows_release ();
 
-      gimp_progress_update ((gdouble) progress_counter /
-                            (gdouble) maxcounter);
+      index = 0;
 
-      gegl_buffer_set (dest_buffer, GEGL_RECTANGLE (0, ycount, width, 1), 0,
+      for (i = 0; i < width * n_rows; i++)
+        {
+          rows[index++] = (guchar) (colors[i].r * 255.0);
+          rows[index++] = (guchar) (colors[i].g * 255.0);
+          rows[index++] = (guchar) (colors[i].b * 255.0);
+
+          if (has_alpha)
+            rows[index++] = (guchar) (colors[i].a * 255.0);
+        }
+
+      gegl_buffer_set (dest_buffer, GEGL_RECTANGLE (0, ycount, width, n_rows),
+                       0,
                        has_alpha ?
                        babl_format ("R'G'B'A u8") : babl_format ("R'G'B' u8"),
-                       row,
+                       rows,
                        GEGL_AUTO_ROWSTRIDE);
+
+      progress_counter += (glong) width * n_rows;
+
+      gimp_progress_update ((gdouble) progress_counter /
+                            (gdouble) maxcounter);
     }
 
   gimp_progress_update (1.0);
 
-  g_free (row);
+  g_free (colors);
+  g_free (rows);
+  g_free (xpos);
+  g_free (ypos);
 
   g_object_unref (dest_buffer);
 
@@ -22,6 +22,7 @@ GeglBuffer   *dest_buffer;
 GimpDrawable *bump_drawable;
 GeglBuffer   *bump_buffer;
 const Babl   *bump_format;
+guchar       *bump_data = NULL;
 
 GimpDrawable *env_drawable;
 GeglBuffer   *env_buffer;
@@ -39,6 +40,14 @@ gint border_x1, border_y1, border_x2, border_y2;
 
 guchar sinemap[256], spheremap[256], logmap[256];
 
+/* Rows of the source image, as R'G'B'A double, indexed by y.  They are
+ * fetched on the main thread, so the shading threads never touch the
+ * buffers, which go through the plug-in's tile backend.
+ */
+static GimpRGB **source_rows = NULL;
+
+static guchar  *env_data    = NULL;
+
 /******************/
 /* Implementation */
 /******************/
@@ -71,23 +80,15 @@ GimpRGB
 peek (gint x,
       gint y)
 {
-  GimpRGB color;
-
-  gegl_buffer_sample (source_buffer, x, y, NULL,
-                      &color, babl_format ("R'G'B'A double"),
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-
-  if (! babl_format_has_alpha (gegl_buffer_get_format (source_buffer)))
-    color.a = 1.0;
-
-  return color;
+  return source_rows[y][x];
 }
 
 GimpRGB
 peek_env_map (gint x,
 	      gint y)
 {
-  GimpRGB color;
+  const guchar *data;
+  GimpRGB       color;
 
   if (x < 0)
     x = 0;
@@ -98,11 +99,9 @@ peek_env_map (gint x,
   else if (y >= env_height)
     y = env_height - 1;
 
-  gegl_buffer_sample (env_buffer, x, y, NULL,
-                      &color, babl_format ("R'G'B'A double"),
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+  data = env_data + ((gsize) y * env_width + x) * 3;
 
-  color.a = 1.0;
+  gimp_rgba_set_uchar (&color, data[0], data[1], data[2], 255);
 
   return color;
 }
@@ -126,6 +125,56 @@ poke (gint    x,
                    GEGL_AUTO_ROWSTRIDE);
 }
 
+/* Fetch the source rows needed to shade the image rows at ypos */
+void
+source_rows_fetch (const gdouble *ypos,
+                   gint           n_rows)
+{
+  const Babl *format = babl_format ("R'G'B'A double");
+  gint        i;
+
+  if (! source_rows)
+    source_rows = g_new0 (GimpRGB *, height);
+
+  for (i = 0; i < n_rows; i++)
+    {
+      GimpVector3 pos;
+      gdouble     xf, yf;
+      gint        y;
+
+      pos = int_to_posf (0.0, ypos[i]);
+      pos_to_float (pos.x, pos.y, &xf, &yf);
+
+      /*  bilinear interpolation reads the row below, too  */
+      for (y = RINT (yf); y <= RINT (yf) + 1; y++)
+        {
+          gint row = CLAMP (y, 0, height - 1);
+
+          if (source_rows[row])
+            continue;
+
+          source_rows[row] = g_new (GimpRGB, width);
+
+          gegl_buffer_get (source_buffer,
+                           GEGL_RECTANGLE (0, row, width, 1), 1.0,
+                           format, source_rows[row],
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+        }
+    }
+}
+
+void
+source_rows_release (void)
+{
+  gint y;
+
+  if (! source_rows)
+    return;
+
+  for (y = 0; y < height; y++)
+    g_clear_pointer (&source_rows[y], g_free);
+}
+
 gint
 check_bounds (gint x,
 	      gint y)
@@ -385,15 +434,46 @@ bumpmap_setup (GimpDrawable *bumpmap)
 {
   if (bumpmap)
     {
-      if (! bump_buffer)
-        {
-          bump_buffer = gimp_drawable_get_buffer (bumpmap);
-        }
-
       if (gimp_drawable_is_rgb (bumpmap))
         bump_format = babl_format ("R'G'B' u8");
       else
         bump_format = babl_format ("Y' u8"); /* FIXME */
+
+      if (! bump_buffer)
+        {
+          gint    bpp = babl_format_get_bytes_per_pixel (bump_format);
+          guchar *row;
+          gint    x, y;
+
+          bump_buffer = gimp_drawable_get_buffer (bumpmap);
+
+          /* Keep one averaged byte per pixel, the shading threads
+           * compute the heights from it
+           */
+          bump_data = g_new (guchar, (gsize) width * height);
+          row       = g_new (guchar, width * bpp);
+
+          for (y = 0; y < height; y++)
+            {
+              guchar *dest = bump_data + (gsize) y * width;
+
+              gegl_buffer_get (bump_buffer, GEGL_RECTANGLE (0, y, width, 1),
+                               1.0, bump_format, row,
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+              for (x = 0; x < width; x++)
+                {
+                  if (bpp > 1)
+                    dest[x] = (guchar)((float)((row[x * bpp + 0] +
+                                                row[x * bpp + 1] +
+                                                row[x * bpp + 2]) / 3.0));
+                  else
+                    dest[x] = row[x];
+                }
+            }
+
+          g_free (row);
+        }
     }
 }
 
@@ -406,5 +486,29 @@ envmap_setup (GimpDrawable *envmap)
       env_height = gimp_drawable_get_height (envmap);
 
       env_buffer = gimp_drawable_get_buffer (envmap);
+
+      env_data = g_new (guchar, (gsize) env_width * env_height * 3);
+
+      gegl_buffer_get (env_buffer,
+                       GEGL_RECTANGLE (0, 0, env_width, env_height), 1.0,
+                       babl_format ("R'G'B' u8"), env_data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
     }
 }
+
+/* Free the source rows, the bump and environment maps, and the
+ * buffers they were read from
+ */
+void
+image_cleanup (void)
+{
+  source_rows_release ();
+  g_clear_pointer (&source_rows, g_free);
+
+  g_clear_pointer (&bump_data, g_free);
+  g_clear_pointer (&env_data, g_free);
+
+  g_clear_object (&source_buffer);
+  g_clear_object (&bump_buffer);
+  g_clear_object (&env_buffer);
+}
@@ -13,6 +13,7 @@ extern GeglBuffer   *dest_buffer;
 extern GimpDrawable *bump_drawable;
 extern GeglBuffer   *bump_buffer;
 extern const Babl   *bump_format;
+extern guchar       *bump_data;
 
 extern GimpDrawable *env_drawable;
 extern GeglBuffer   *env_buffer;
@@ -41,6 +42,9 @@ GimpRGB        peek_env_map    (gint          x,
 void           poke            (gint          x,
 				gint          y,
 				GimpRGB       *color);
+void           source_rows_fetch   (const gdouble *ypos,
+                                    gint           n_rows);
+void           source_rows_release (void);
 gint           check_bounds    (gint          x,
 				gint          y);
 GimpVector3    int_to_pos      (gint          x,
@@ -67,6 +71,7 @@ gint           image_setup     (GimpDrawable *drawable,
 				gint          interactive);
 void           bumpmap_setup   (GimpDrawable *bumpmap);
 void           envmap_setup    (GimpDrawable *envmap);
+void           image_cleanup   (void);
 
 
 #endif  /* __LIGHTING_IMAGE_H__ */
@@ -781,6 +781,8 @@ lighting_run (GimpProcedure        *procedure,
         case GIMP_RUN_INTERACTIVE:
           if (! main_dialog (procedure, config, drawable))
             {
+              image_cleanup ();
+
               return gimp_procedure_new_return_values (procedure,
                                                        GIMP_PDB_CANCEL,
                                                        NULL);
@@ -812,6 +814,8 @@ lighting_run (GimpProcedure        *procedure,
                                                NULL);
     }
 
+  image_cleanup ();
+
   g_free (xpostab);
   g_free (ypostab);
 
@@ -44,11 +44,10 @@ compute_preview (gint startx, gint starty, gint w, gint h)
 {
   gint xcnt, ycnt, f1, f2;
   guchar r, g, b;
-  gdouble imagex, imagey;
   gint32 index = 0;
   GimpRGB color;
   GimpRGB lightcheck, darkcheck;
-  GimpVector3 pos;
+  GimpRGB *colors;
   get_ray_func ray_func;
 
   if (xpostab_size != w)
@@ -99,8 +98,6 @@ compute_preview (gint startx, gint starty, gint w, gint h)
       bumpmap_setup (gimp_drawable_get_by_id (mapvals.bumpmap_id));
     }
 
-  imagey = 0;
-
   if (mapvals.previewquality)
     ray_func = get_ray_color;
   else
@@ -116,6 +113,13 @@ compute_preview (gint startx, gint starty, gint w, gint h)
         ray_func = get_ray_color_no_bilinear_ref;
     }
 
+  /* The source rows are kept around for the next preview */
+  source_rows_fetch (ypostab, h);
+
+  colors = g_new (GimpRGB, w * h);
+
+  shade_rows (ray_func, xpostab, w, ypostab, h, colors);
+
   cairo_surface_flush (preview_surface);
 
   for (ycnt = 0; ycnt < PREVIEW_HEIGHT; ycnt++)
@@ -126,19 +130,7 @@ compute_preview (gint startx, gint starty, gint w, gint h)
           if ((ycnt >= starty && ycnt < (starty + h)) &&
               (xcnt >= startx && xcnt < (startx + w)))
             {
-              imagex = xpostab[xcnt - startx];
-              imagey = ypostab[ycnt - starty];
-              pos = int_to_posf (imagex, imagey);
-
-              if (mapvals.bump_mapped == TRUE &&
-                  mapvals.bumpmap_id != -1 &&
-                  xcnt == startx)
-                {
-                  pos_to_float (pos.x, pos.y, &imagex, &imagey);
-                  precompute_normals (0, width, RINT (imagey));
-                }
-
-              color = (*ray_func) (&pos);
+              color = colors[(ycnt - starty) * w + (xcnt - startx)];
 
               if (color.a < 1.0)
                 {
@@ -169,7 +161,6 @@ compute_preview (gint startx, gint starty, gint w, gint h)
               gimp_rgb_get_uchar (&color, &r, &g, &b);
               GIMP_CAIRO_RGB24_SET_PIXEL((preview_rgb_data + index), r, g, b);
               index += 4;
-              imagex++;
             }
           else
             {
@@ -181,6 +172,8 @@ compute_preview (gint startx, gint starty, gint w, gint h)
         }
     }
   cairo_surface_mark_dirty (preview_surface);
+
+  g_free (colors);
 }
 
 static void
@@ -11,11 +11,20 @@
 #include "lighting-shade.h"
 
 
-static GimpVector3 *triangle_normals[2] = { NULL, NULL };
-static GimpVector3 *vertex_normals[3]   = { NULL, NULL, NULL };
-static gdouble     *heights[3] = { NULL, NULL, NULL };
-static gdouble      xstep, ystep;
-static guchar      *bumprow = NULL;
+#define SHADE_MIN_PIXELS 4096
+
+
+typedef struct
+{
+  get_ray_func   ray_func;
+  const gdouble *xpos;
+  gint           n_cols;
+  const gdouble *ypos;
+  GimpRGB       *dest;
+} ShadeRowsData;
+
+
+static gdouble xstep, ystep;
 
 static gint pre_w = -1;
 static gint pre_h = -1;
@@ -31,6 +40,7 @@ phong_shade (GimpVector3 *position,
              GimpVector3 *lightposition,
              GimpRGB      *diff_col,
              GimpRGB      *light_col,
+             gdouble       diffuse_int,
              LightType    light_type)
 {
   GimpRGB       diffuse_color, specular_color;
@@ -82,7 +92,7 @@ phong_shade (GimpVector3 *position,
       /* =================================================== */
 
       diffuse_color = *light_col;
-      gimp_rgb_multiply (&diffuse_color, mapvals.material.diffuse_int);
+      gimp_rgb_multiply (&diffuse_color, diffuse_int);
       diffuse_color.r *= diff_col->r;
       diffuse_color.g *= diff_col->g;
       diffuse_color.b *= diff_col->b;
@@ -107,115 +117,60 @@ phong_shade (GimpVector3 *position,
   return diffuse_color;
 }
 
-void
-precompute_init (gint w,
-                 gint h)
+static const guchar *
+get_transfer_map (void)
 {
-  gint n;
-  gint bpp=1;
-
-  xstep = 1.0 / (gdouble) width;
-  ystep = 1.0 / (gdouble) height;
-
-  pre_w = w;
-  pre_h = h;
-
-  for (n = 0; n < 3; n++)
+  switch (mapvals.bumpmaptype)
     {
-      if (vertex_normals[n] != NULL)
-        g_free (vertex_normals[n]);
-
-      if (heights[n] != NULL)
-        g_free (heights[n]);
-
-      heights[n]        = g_new (gdouble, w);
-      vertex_normals[n] = g_new (GimpVector3, w);
+    case LINEAR_MAP:
+      return NULL;
+    case LOGARITHMIC_MAP:
+      return logmap;
+    case SINUSOIDAL_MAP:
+      return sinemap;
+    default:
+      return spheremap;
     }
+}
 
-  for (n = 0; n < 2; n++)
-    if (triangle_normals[n] != NULL)
-      g_free (triangle_normals[n]);
-
-  g_clear_pointer (&bumprow, g_free);
-
-  if (mapvals.bumpmap_id != -1)
-    {
-      GimpDrawable *drawable = gimp_drawable_get_by_id (mapvals.bumpmap_id);
-
-      bpp = gimp_drawable_get_bpp (drawable);
-    }
-
-  bumprow = g_new (guchar, w * bpp);
-
-  triangle_normals[0] = g_new (GimpVector3, (w << 1) + 2);
-  triangle_normals[1] = g_new (GimpVector3, (w << 1) + 2);
-
-  for (n = 0; n < (w << 1) + 1; n++)
-    {
-      gimp_vector3_set (&triangle_normals[0][n], 0.0, 0.0, 1.0);
-      gimp_vector3_set (&triangle_normals[1][n], 0.0, 0.0, 1.0);
-    }
+/* Compute the heights of bump map row y */
+static void
+load_heights (gdouble *heights,
+              gint     y)
+{
+  const guchar *map = get_transfer_map ();
+  const guchar *row = bump_data + (gsize) y * pre_w;
+  gint          n;
 
-  for (n = 0; n < w; n++)
+  for (n = 0; n < pre_w; n++)
     {
-      gimp_vector3_set (&vertex_normals[0][n], 0.0, 0.0, 1.0);
-      gimp_vector3_set (&vertex_normals[1][n], 0.0, 0.0, 1.0);
-      gimp_vector3_set (&vertex_normals[2][n], 0.0, 0.0, 1.0);
-      heights[0][n] = 0.0;
-      heights[1][n] = 0.0;
-      heights[2][n] = 0.0;
+      if (map)
+        heights[n] = (gdouble) mapvals.bumpmax * (gdouble) map[row[n]] / 255.0;
+      else
+        heights[n] = (gdouble) mapvals.bumpmax * (gdouble) row[n] / 255.0;
     }
 }
 
-
 /* Interpol linearly height[2] and triangle_normals[1]
  * using the next row
  */
-void
-interpol_row (gint x1,
-              gint x2,
-              gint y)
+static void
+interpol_row (ShadeState *state,
+              gint        x1,
+              gint        x2,
+              gint        y)
 {
-  GimpVector3  p1, p2, p3;
-  gint         n, i;
-  guchar      *map = NULL;
-  gint         bpp = 1;
-  guchar      *bumprow1 = NULL;
-  guchar      *bumprow2 = NULL;
-
-  if (mapvals.bumpmap_id != -1)
-    {
-      bumpmap_setup (gimp_drawable_get_by_id (mapvals.bumpmap_id));
-
-      bpp = babl_format_get_bytes_per_pixel (bump_format);
-    }
+  GimpVector3   p1, p2, p3;
+  gint          n, i;
+  const guchar *map     = get_transfer_map ();
+  const guchar *bumprow1;
+  const guchar *bumprow2 = NULL;
+  gdouble     **heights = state->heights;
 
-  bumprow1 = g_new0 (guchar, pre_w * bpp);
-  bumprow2 = g_new0 (guchar, pre_w * bpp);
+  bumprow1 = bump_data + (gsize) y * pre_w + x1;
 
-  gegl_buffer_get (bump_buffer, GEGL_RECTANGLE (x1, y, x2 - x1, 1), 1.0,
-                   bump_format, bumprow1,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  gegl_buffer_get (bump_buffer, GEGL_RECTANGLE (x1, y - 1, x2 - x1, 1), 1.0,
-                   bump_format, bumprow2,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  if (mapvals.bumpmaptype > 0)
-    {
-      switch (mapvals.bumpmaptype)
-        {
-        case 1:
-          map = logmap;
-          break;
-        case 2:
-          map = sinemap;
-          break;
-        default:
-          map = spheremap;
-          break;
-        }
-    }
+  if (y > 0)
+    bumprow2 = bump_data + (gsize) (y - 1) * pre_w + x1;
 
   for (n = 0; n < (x2 - x1); n++)
     {
@@ -223,21 +178,13 @@ interpol_row (gint x1,
       guchar  mapval;
       guchar  mapval1, mapval2;
 
-      if (bpp > 1)
-        {
-          mapval1 = (guchar)((float)((bumprow1[n * bpp] +bumprow1[n * bpp +1] + bumprow1[n * bpp + 2])/3.0 )) ;
-          mapval2 = (guchar)((float)((bumprow2[n * bpp] +bumprow2[n * bpp +1] + bumprow2[n * bpp + 2])/3.0 )) ;
-        }
-      else
-        {
-          mapval1 = bumprow1[n * bpp];
-          mapval2 = bumprow2[n * bpp];
-        }
+      mapval1 = bumprow1[n];
+      mapval2 = bumprow2 ? bumprow2[n] : 0;
 
       diff =  mapval1 - mapval2;
       mapval = (guchar) CLAMP (mapval1 + diff, 0.0, 255.0);
 
-      if (mapvals.bumpmaptype > 0)
+      if (map)
         {
           heights[1][n] = (gdouble) mapvals.bumpmax * (gdouble) map[mapval1] / 255.0;
           heights[2][n] = (gdouble) mapvals.bumpmax * (gdouble) map[mapval] / 255.0;
@@ -265,36 +212,32 @@ interpol_row (gint x1,
       p3.y = 0.0;
       p3.z = heights[2][n+1] - heights[2][n];
 
-      triangle_normals[1][i] = gimp_vector3_cross_product (&p2, &p1);
-      triangle_normals[1][i+1] = gimp_vector3_cross_product (&p3, &p2);
+      state->triangle_normals[1][i] = gimp_vector3_cross_product (&p2, &p1);
+      state->triangle_normals[1][i+1] = gimp_vector3_cross_product (&p3, &p2);
 
-      gimp_vector3_normalize (&triangle_normals[1][i]);
-      gimp_vector3_normalize (&triangle_normals[1][i+1]);
+      gimp_vector3_normalize (&state->triangle_normals[1][i]);
+      gimp_vector3_normalize (&state->triangle_normals[1][i+1]);
 
       i += 2;
     }
-
-  g_free (bumprow1);
-  g_free (bumprow2);
 }
 
 /********************************************/
 /* Compute triangle and then vertex normals */
 /********************************************/
 
-
-void
-precompute_normals (gint x1,
-                    gint x2,
-                    gint y)
+static void
+precompute_normals (ShadeState *state,
+                    gint        x1,
+                    gint        x2,
+                    gint        y)
 {
   GimpVector3 *tmpv, p1, p2, p3, normal;
   gdouble     *tmpd;
   gint         n, i, nv;
-  guchar      *map = NULL;
-  gint         bpp = 1;
-  guchar       mapval;
-
+  GimpVector3 **triangle_normals = state->triangle_normals;
+  GimpVector3 **vertex_normals   = state->vertex_normals;
+  gdouble     **heights          = state->heights;
 
   /* First, compute the heights */
   /* ========================== */
@@ -313,66 +256,7 @@ precompute_normals (gint x1,
   heights[1] = heights[2];
   heights[2] = tmpd;
 
-  if (mapvals.bumpmap_id != -1)
-    {
-      bumpmap_setup (gimp_drawable_get_by_id (mapvals.bumpmap_id));
-
-      bpp = babl_format_get_bytes_per_pixel (bump_format);
-    }
-
-  gegl_buffer_get (bump_buffer, GEGL_RECTANGLE (x1, y, x2 - x1, 1), 1.0,
-                   bump_format, bumprow,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  if (mapvals.bumpmaptype > 0)
-    {
-      switch (mapvals.bumpmaptype)
-        {
-        case 1:
-          map = logmap;
-          break;
-        case 2:
-          map = sinemap;
-          break;
-        default:
-          map = spheremap;
-          break;
-        }
-
-      for (n = 0; n < (x2 - x1); n++)
-        {
-          if (bpp > 1)
-            {
-              mapval = (guchar)((float)((bumprow[n * bpp + 0] +
-                                         bumprow[n * bpp + 1] +
-                                         bumprow[n * bpp + 2])  /3.0));
-            }
-          else
-            {
-              mapval = bumprow[n * bpp];
-            }
-
-          heights[2][n] = (gdouble) mapvals.bumpmax * (gdouble) map[mapval] / 255.0;
-        }
-    }
-  else
-    {
-      for (n = 0; n < (x2 - x1); n++)
-        {
-          if (bpp > 1)
-            {
-              mapval = (guchar)((float)((bumprow[n * bpp + 0] +
-                                         bumprow[n * bpp + 1] +
-                                         bumprow[n * bpp + 2]) / 3.0));
-            }
-          else
-            {
-              mapval = bumprow[n * bpp];
-            }
-
-          heights[2][n] = (gdouble) mapvals.bumpmax * (gdouble) mapval / 255.0;
-        }
-    }
+  load_heights (heights[2], y);
 
   /* Compute triangle normals */
   /* ======================== */
@@ -452,6 +336,177 @@ precompute_normals (gint x1,
     }
 }
 
+/*****************************************************/
+/* Per-thread shading state.  The normals of a row   */
+/* depend on the two rows above it, so a thread that */
+/* starts in the middle of the image, or skips rows, */
+/* rebuilds them from there.                         */
+/*****************************************************/
+
+static void
+shade_state_reset (ShadeState *state)
+{
+  gint n;
+
+  for (n = 0; n < (pre_w << 1) + 1; n++)
+    {
+      gimp_vector3_set (&state->triangle_normals[0][n], 0.0, 0.0, 1.0);
+      gimp_vector3_set (&state->triangle_normals[1][n], 0.0, 0.0, 1.0);
+    }
+
+  for (n = 0; n < pre_w; n++)
+    {
+      gimp_vector3_set (&state->vertex_normals[0][n], 0.0, 0.0, 1.0);
+      gimp_vector3_set (&state->vertex_normals[1][n], 0.0, 0.0, 1.0);
+      gimp_vector3_set (&state->vertex_normals[2][n], 0.0, 0.0, 1.0);
+      state->heights[0][n] = 0.0;
+      state->heights[1][n] = 0.0;
+      state->heights[2][n] = 0.0;
+    }
+
+  /* Init the first row */
+  if (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1 && pre_h >= 2)
+    interpol_row (state, 0, pre_w, 0);
+
+  state->y = -1;
+}
+
+static ShadeState *
+shade_state_new (void)
+{
+  ShadeState *state = g_new0 (ShadeState, 1);
+  gint        n;
+
+  for (n = 0; n < 3; n++)
+    {
+      state->heights[n]        = g_new (gdouble, pre_w);
+      state->vertex_normals[n] = g_new (GimpVector3, pre_w);
+    }
+
+  for (n = 0; n < 2; n++)
+    state->triangle_normals[n] = g_new (GimpVector3, (pre_w << 1) + 2);
+
+  shade_state_reset (state);
+
+  return state;
+}
+
+static void
+shade_state_free (ShadeState *state)
+{
+  gint n;
+
+  for (n = 0; n < 3; n++)
+    {
+      g_free (state->heights[n]);
+      g_free (state->vertex_normals[n]);
+    }
+
+  for (n = 0; n < 2; n++)
+    g_free (state->triangle_normals[n]);
+
+  g_free (state);
+}
+
+static void
+shade_state_seek (ShadeState *state,
+                  gint        y)
+{
+  if (y == state->y)
+    return;
+
+  if (y != state->y + 1)
+    {
+      if (y < 2)
+        {
+          shade_state_reset (state);
+
+          if (y == 1)
+            precompute_normals (state, 0, pre_w, 0);
+        }
+      else
+        {
+          load_heights (state->heights[2], y - 2);
+          precompute_normals (state, 0, pre_w, y - 1);
+        }
+    }
+
+  precompute_normals (state, 0, pre_w, y);
+
+  state->y = y;
+}
+
+static void
+shade_rows_range (gsize                offset,
+                  gsize                size,
+                  const ShadeRowsData *data)
+{
+  ShadeState *state = shade_state_new ();
+  gboolean    bump_mapped;
+  gsize       r;
+
+  bump_mapped = (mapvals.bump_mapped == TRUE && mapvals.bumpmap_id != -1);
+
+  for (r = offset; r < offset + size; r++)
+    {
+      GimpRGB *dest = data->dest + r * data->n_cols;
+      gint     x;
+
+      if (bump_mapped)
+        shade_state_seek (state, CLAMP (RINT (data->ypos[r]), 0, pre_h - 1));
+
+      for (x = 0; x < data->n_cols; x++)
+        {
+          GimpVector3 pos = int_to_posf (data->xpos[x], data->ypos[r]);
+
+          dest[x] = data->ray_func (state, &pos);
+        }
+    }
+
+  shade_state_free (state);
+}
+
+void
+precompute_init (gint w,
+                 gint h)
+{
+  xstep = 1.0 / (gdouble) width;
+  ystep = 1.0 / (gdouble) height;
+
+  pre_w = w;
+  pre_h = h;
+}
+
+/*********************************************************************/
+/* Shade n_cols x n_rows pixels at the image positions given by xpos */
+/* and ypos into dest, splitting the rows between threads.  The      */
+/* source rows have to be fetched with source_rows_fetch() first,    */
+/* and the bump and environment maps have to be set up.              */
+/*********************************************************************/
+
+void
+shade_rows (get_ray_func   ray_func,
+            const gdouble *xpos,
+            gint           n_cols,
+            const gdouble *ypos,
+            gint           n_rows,
+            GimpRGB       *dest)
+{
+  ShadeRowsData data;
+
+  data.ray_func = ray_func;
+  data.xpos     = xpos;
+  data.n_cols   = n_cols;
+  data.ypos     = ypos;
+  data.dest     = dest;
+
+  gegl_parallel_distribute_range (n_rows,
+                                  MAX (1, SHADE_MIN_PIXELS / MAX (n_cols, 1)),
+                                  (GeglParallelDistributeRangeFunc)
+                                    shade_rows_range,
+                                  &data);
+}
+
 /***********************************************************************/
 /* Compute the reflected ray given the normalized normal and ins. vec. */
 /***********************************************************************/
@@ -483,10 +538,10 @@ sphere_to_image (GimpVector3 *normal,
                  gdouble     *u,
                  gdouble     *v)
 {
-  static gdouble     alpha, fac;
-  static GimpVector3 cross_prod;
-  static GimpVector3 firstaxis  = { 1.0, 0.0, 0.0 };
-  static GimpVector3 secondaxis = { 0.0, 1.0, 0.0 };
+  static const GimpVector3 firstaxis  = { 1.0, 0.0, 0.0 };
+  static const GimpVector3 secondaxis = { 0.0, 1.0, 0.0 };
+  gdouble                  alpha, fac;
+  GimpVector3              cross_prod;
 
   alpha = acos (-gimp_vector3_inner_product (&secondaxis, normal));
 
@@ -522,7 +577,8 @@ sphere_to_image (GimpVector3 *normal,
 /*********************************************************************/
 
 GimpRGB
-get_ray_color (GimpVector3 *position)
+get_ray_color (ShadeState  *state,
+               GimpVector3 *position)
 {
   GimpRGB       color;
   GimpRGB       color_int;
@@ -537,7 +593,7 @@ get_ray_color (GimpVector3 *position)
 
   x = RINT (xf);
 
-  if (mapvals.transparent_background && heights[1][x] == 0)
+  if (mapvals.transparent_background && state->heights[1][x] == 0)
     {
       gimp_rgb_set_alpha (&color_sum, 0.0);
     }
@@ -570,11 +626,12 @@ get_ray_color (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
+                                         mapvals.material.diffuse_int,
                                          mapvals.lightsource[k].type);
             }
           else
             {
-              normal = vertex_normals[1][(gint) RINT (xf)];
+              normal = state->vertex_normals[1][(gint) RINT (xf)];
 
               light_color = phong_shade (position,
                                          &mapvals.viewpoint,
@@ -582,6 +639,7 @@ get_ray_color (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
+                                         mapvals.material.diffuse_int,
                                          mapvals.lightsource[k].type);
             }
 
@@ -595,7 +653,8 @@ get_ray_color (GimpVector3 *position)
 }
 
 GimpRGB
-get_ray_color_ref (GimpVector3 *position)
+get_ray_color_ref (ShadeState  *state,
+                   GimpVector3 *position)
 {
   GimpRGB      color_sum;
   GimpRGB      color_int;
@@ -605,7 +664,6 @@ get_ray_color_ref (GimpVector3 *position)
   gdouble      xf, yf;
   GimpVector3  normal, *p, v, r;
   gint         k;
-  gdouble      tmpval;
 
   pos_to_float (position->x, position->y, &xf, &yf);
 
@@ -618,12 +676,12 @@ get_ray_color_ref (GimpVector3 *position)
     }
   else
     {
-      normal = vertex_normals[1][(gint) RINT (xf)];
+      normal = state->vertex_normals[1][(gint) RINT (xf)];
     }
 
   gimp_vector3_normalize (&normal);
 
-  if (mapvals.transparent_background && heights[1][x] == 0)
+  if (mapvals.transparent_background && state->heights[1][x] == 0)
     {
       gimp_rgb_set_alpha (&color_sum, 0.0);
     }
@@ -652,6 +710,7 @@ get_ray_color_ref (GimpVector3 *position)
                                      p,
                                      &color,
                                      &color_int,
+                                     mapvals.material.diffuse_int,
                                      mapvals.lightsource[0].type);
         }
 
@@ -667,19 +726,15 @@ get_ray_color_ref (GimpVector3 *position)
       env_color = peek_env_map (RINT (env_width * xf),
                                 RINT (env_height * yf));
 
-      tmpval = mapvals.material.diffuse_int;
-      mapvals.material.diffuse_int = 0.;
-
       light_color = phong_shade (position,
                                  &mapvals.viewpoint,
                                  &normal,
                                  &r,
                                  &color,
                                  &env_color,
+                                 0.0,
                                  DIRECTIONAL_LIGHT);
 
-      mapvals.material.diffuse_int = tmpval;
-
       gimp_rgb_add (&color_sum, &light_color);
     }
 
@@ -689,7 +744,8 @@ get_ray_color_ref (GimpVector3 *position)
 }
 
 GimpRGB
-get_ray_color_no_bilinear (GimpVector3 *position)
+get_ray_color_no_bilinear (ShadeState  *state,
+                           GimpVector3 *position)
 {
   GimpRGB       color;
   GimpRGB       color_int;
@@ -704,7 +760,7 @@ get_ray_color_no_bilinear (GimpVector3 *position)
 
   x = RINT (xf);
 
-  if (mapvals.transparent_background && heights[1][x] == 0)
+  if (mapvals.transparent_background && state->heights[1][x] == 0)
     {
       gimp_rgb_set_alpha (&color_sum, 0.0);
     }
@@ -737,11 +793,12 @@ get_ray_color_no_bilinear (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
+                                         mapvals.material.diffuse_int,
                                          mapvals.lightsource[k].type);
             }
           else
             {
-              normal = vertex_normals[1][x];
+              normal = state->vertex_normals[1][x];
 
               light_color = phong_shade (position,
                                          &mapvals.viewpoint,
@@ -749,6 +806,7 @@ get_ray_color_no_bilinear (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
+                                         mapvals.material.diffuse_int,
                                          mapvals.lightsource[k].type);
             }
 
@@ -762,7 +820,8 @@ get_ray_color_no_bilinear (GimpVector3 *position)
 }
 
 GimpRGB
-get_ray_color_no_bilinear_ref (GimpVector3 *position)
+get_ray_color_no_bilinear_ref (ShadeState  *state,
+                               GimpVector3 *position)
 {
   GimpRGB      color_sum;
   GimpRGB      color_int;
@@ -772,7 +831,6 @@ get_ray_color_no_bilinear_ref (GimpVector3 *position)
   gdouble      xf, yf;
   GimpVector3  normal, *p, v, r;
   gint         k;
-  gdouble      tmpval;
 
   pos_to_float (position->x, position->y, &xf, &yf);
 
@@ -785,12 +843,12 @@ get_ray_color_no_bilinear_ref (GimpVector3 *position)
     }
   else
     {
-      normal = vertex_normals[1][(gint) RINT (xf)];
+      normal = state->vertex_normals[1][(gint) RINT (xf)];
     }
 
   gimp_vector3_normalize (&normal);
 
-  if (mapvals.transparent_background && heights[1][x] == 0)
+  if (mapvals.transparent_background && state->heights[1][x] == 0)
     {
       gimp_rgb_set_alpha (&color_sum, 0.0);
     }
@@ -819,6 +877,7 @@ get_ray_color_no_bilinear_ref (GimpVector3 *position)
                                          p,
                                          &color,
                                          &color_int,
+                                         mapvals.material.diffuse_int,
                                          mapvals.lightsource[0].type);
         }
 
@@ -834,19 +893,15 @@ get_ray_color_no_bilinear_ref (GimpVector3 *position)
       env_color = peek_env_map (RINT (env_width * xf),
                                 RINT (env_height * yf));
 
-      tmpval = mapvals.material.diffuse_int;
-      mapvals.material.diffuse_int = 0.;
-
       light_color = phong_shade (position,
                                  &mapvals.viewpoint,
                                  &normal,
                                  &r,
                                  &color,
                                  &env_color,
+                                 0.0,
                                  DIRECTIONAL_LIGHT);
 
-      mapvals.material.diffuse_int = tmpval;
-
       gimp_rgb_add (&color_sum, &light_color);
     }
 
@@ -1,20 +1,33 @@
 #ifndef __LIGHTING_SHADE_H__
 #define __LIGHTING_SHADE_H__
 
-typedef GimpRGB (* get_ray_func) (GimpVector3 *vector);
+typedef struct
+{
+  GimpVector3 *triangle_normals[2];
+  GimpVector3 *vertex_normals[3];
+  gdouble     *heights[3];
+  gint         y;
+} ShadeState;
 
-GimpRGB get_ray_color                 (GimpVector3 *position);
-GimpRGB get_ray_color_no_bilinear     (GimpVector3 *position);
-GimpRGB get_ray_color_ref             (GimpVector3 *position);
-GimpRGB get_ray_color_no_bilinear_ref (GimpVector3 *position);
+typedef GimpRGB (* get_ray_func) (ShadeState  *state,
+                                  GimpVector3 *vector);
 
-void    precompute_init               (gint         w,
-				       gint         h);
-void    precompute_normals            (gint         x1,
-				       gint         x2,
-				       gint         y);
-void    interpol_row                  (gint         x1,
-                                       gint         x2,
-                                       gint         y);
+GimpRGB get_ray_color                 (ShadeState    *state,
+                                       GimpVector3   *position);
+GimpRGB get_ray_color_no_bilinear     (ShadeState    *state,
+                                       GimpVector3   *position);
+GimpRGB get_ray_color_ref             (ShadeState    *state,
+                                       GimpVector3   *position);
+GimpRGB get_ray_color_no_bilinear_ref (ShadeState    *state,
+                                       GimpVector3   *position);
+
+void    precompute_init               (gint           w,
+				       gint           h);
+void    shade_rows                    (get_ray_func   ray_func,
+                                       const gdouble *xpos,
+                                       gint           n_cols,
+                                       const gdouble *ypos,
+                                       gint           n_rows,
+                                       GimpRGB       *dest);
 
 #endif  /* __LIGHTING_SHADE_H__ */
@@ -19,6 +19,25 @@
 #include "libgimp/stdplugins-intl.h"
 
 
+#define CHUNK_PIXELS      (1 << 20)
+#define RENDER_MIN_PIXELS 4096
+
+
+typedef struct
+{
+  const gdouble *xpos;
+  gint           n_cols;
+  const gdouble *ypos;
+  GimpRGB       *dest;
+} RenderRowsData;
+
+typedef struct
+{
+  gint     y;
+  GimpRGB *dest;
+} SupersampleData;
+
+
 /*************/
 /* Main loop */
 /*************/
@@ -128,15 +147,11 @@ init_compute (void)
 
         memcpy (rotmat, b, sizeof (gfloat) * 16);
 
-        /* Set up pixel regions for the box face images */
-        /* ============================================ */
+        /* Set up the box face images */
+        /* ========================== */
 
         for (i = 0; i < 6; i++)
-          {
-            box_drawables[i] = gimp_drawable_get_by_id (mapvals.boxmap_id[i]);
-
-            box_buffers[i] = gimp_drawable_get_buffer (box_drawables[i]);
-          }
+          box_drawables[i] = gimp_drawable_get_by_id (mapvals.boxmap_id[i]);
 
         break;
 
@@ -165,15 +180,11 @@ init_compute (void)
 
         memcpy (rotmat, b, sizeof (gfloat) * 16);
 
-        /* Set up pixel regions for the cylinder cap images */
-        /* ================================================ */
+        /* Set up the cylinder cap images */
+        /* ============================== */
 
         for (i = 0; i < 2; i++)
-          {
-            cylinder_drawables[i] = gimp_drawable_get_by_id (mapvals.cylindermap_id[i]);;
-
-            cylinder_buffers[i] = gimp_drawable_get_buffer (cylinder_drawables[i]);
-          }
+          cylinder_drawables[i] = gimp_drawable_get_by_id (mapvals.cylindermap_id[i]);
         break;
     }
 
@@ -196,12 +207,149 @@ render (gdouble   x,
 }
 
 static void
-show_progress (gint     min,
-               gint     max,
-               gint     curr,
-               gpointer data)
+render_rows_range (gsize                 offset,
+                   gsize                 size,
+                   const RenderRowsData *data)
+{
+  gsize r;
+
+  for (r = offset; r < offset + size; r++)
+    {
+      GimpRGB     *dest = data->dest + r * data->n_cols;
+      GimpVector3  pos;
+      gint         x;
+
+      pos.y = data->ypos[r];
+      pos.z = 0.0;
+
+      for (x = 0; x < data->n_cols; x++)
+        {
+          pos.x = data->xpos[x];
+
+          dest[x] = get_ray_color (&pos);
+        }
+    }
+}
+
+/*****************************************************************/
+/* Render n_cols x n_rows pixels at the positions given by xpos  */
+/* and ypos into dest, splitting the rows between threads.  The  */
+/* textures have to be set up with textures_setup() first.       */
+/*****************************************************************/
+
+void
+render_rows (const gdouble *xpos,
+             gint           n_cols,
+             const gdouble *ypos,
+             gint           n_rows,
+             GimpRGB       *dest)
+{
+  RenderRowsData data;
+
+  data.xpos   = xpos;
+  data.n_cols = n_cols;
+  data.ypos   = ypos;
+  data.dest   = dest;
+
+  gegl_parallel_distribute_range (n_rows,
+                                  MAX (1, RENDER_MIN_PIXELS / MAX (n_cols, 1)),
+                                  (GeglParallelDistributeRangeFunc)
+                                    render_rows_range,
+                                  &data);
+}
+
+static void
+put_pixel (gint      x,
+           gint      y,
+           GimpRGB  *color,
+           gpointer  user_data)
+{
+  SupersampleData *data = user_data;
+
+  data->dest[(gsize) (y - data->y) * width + x] = *color;
+}
+
+static void
+supersample_rows_range (gsize            offset,
+                        gsize            size,
+                        SupersampleData *data)
+{
+  gimp_adaptive_supersample_area (0, data->y + offset,
+                                  width - 1, data->y + offset + size - 1,
+                                  max_depth,
+                                  mapvals.pixelthreshold,
+                                  render,
+                                  NULL,
+                                  put_pixel,
+                                  data,
+                                  NULL,
+                                  NULL);
+}
+
+/*************************************************/
+/* Render the whole image in chunks of rows and  */
+/* write each chunk to the destination buffer.   */
+/*************************************************/
+
+static void
+compute_image_rows (void)
 {
-  gimp_progress_update ((gdouble) curr / (gdouble) max);
+  GimpRGB *colors;
+  gdouble *xpos;
+  gdouble *ypos;
+  gint     chunk_height;
+  gint     n_rows;
+  gint     xcount, ycount;
+  glong    progress_counter = 0;
+
+  chunk_height = CLAMP (CHUNK_PIXELS / width, 1, height);
+
+  colors = g_new (GimpRGB, (gsize) width * chunk_height);
+  xpos   = g_new (gdouble, width);
+  ypos   = g_new (gdouble, chunk_height);
+
+  for (xcount = 0; xcount < width; xcount++)
+    xpos[xcount] = (gdouble) xcount / (gdouble) width;
+
+  for (ycount = 0; ycount < height; ycount += n_rows)
+    {
+      n_rows = MIN (chunk_height, height - ycount);
+
+      if (! mapvals.antialiasing)
+        {
+          gint i;
+
+          for (i = 0; i < n_rows; i++)
+            ypos[i] = (gdouble) (ycount + i) / (gdouble) height;
+
+          render_rows (xpos, width, ypos, n_rows, colors);
+        }
+      else
+        {
+          SupersampleData data;
+
+          data.y    = ycount;
+          data.dest = colors;
+
+          gegl_parallel_distribute_range (n_rows, 1,
+                                          (GeglParallelDistributeRangeFunc)
+                                            supersample_rows_range,
+                                          &data);
+        }
+
+      gegl_buffer_set (dest_buffer, GEGL_RECTANGLE (0, ycount, width, n_rows),
+                       0, babl_format ("R'G'B'A double"), colors,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      progress_counter += (glong) width * n_rows;
+
+      gimp_progress_update ((gdouble) progress_counter /
+                            (gdouble) maxcounter);
+    }
+
+  g_free (colors);
+  g_free (xpos);
+  g_free (ypos);
 }
 
 /**************************************************/
@@ -212,16 +360,14 @@ show_progress (gint     min,
 void
 compute_image (void)
 {
-  gint         xcount, ycount;
-  GimpRGB      color;
-  glong        progress_counter = 0;
-  GimpVector3  p;
   GimpImage   *new_image    = NULL;
   GimpLayer   *new_layer    = NULL;
   gboolean     insert_layer = FALSE;
 
   init_compute ();
 
+  textures_setup (0);
+
   if (mapvals.create_new_image)
     {
       new_image = gimp_image_new (width, height, GIMP_RGB);
@@ -276,36 +422,7 @@ compute_image (void)
       break;
     }
 
-  if (! mapvals.antialiasing)
-    {
-      for (ycount = 0; ycount < height; ycount++)
-        {
-          for (xcount = 0; xcount < width; xcount++)
-            {
-              p = int_to_pos (xcount, ycount);
-              color = (* get_ray_color) (&p);
-              poke (xcount, ycount, &color, NULL);
-
-              progress_counter++;
-            }
-
-          gimp_progress_update ((gdouble) progress_counter /
-                                (gdouble) maxcounter);
-        }
-    }
-  else
-    {
-      gimp_adaptive_supersample_area (0, 0,
-                                      width - 1, height - 1,
-                                      max_depth,
-                                      mapvals.pixelthreshold,
-                                      render,
-                                      NULL,
-                                      poke,
-                                      NULL,
-                                      show_progress,
-                                      NULL);
-    }
+  compute_image_rows ();
 
   gimp_progress_update (1.0);
 
@@ -5,6 +5,11 @@ extern gdouble imat[4][4];
 extern gfloat  rotmat[16];
 
 void init_compute     (void);
+void render_rows      (const gdouble        *xpos,
+                       gint                  n_cols,
+                       const gdouble        *ypos,
+                       gint                  n_rows,
+                       GimpRGB              *dest);
 void compute_image    (void);
 void copy_from_config (GimpProcedureConfig  *config);
 
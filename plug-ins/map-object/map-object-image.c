@@ -31,10 +31,8 @@ GeglBuffer   *source_buffer;
 GeglBuffer   *dest_buffer;
 
 GimpDrawable *box_drawables[6];
-GeglBuffer   *box_buffers[6];
 
 GimpDrawable *cylinder_drawables[2];
-GeglBuffer   *cylinder_buffers[2];
 
 guchar          *preview_rgb_data = NULL;
 gint             preview_rgb_stride;
@@ -46,41 +44,89 @@ GimpRGB  background;
 
 gint border_x, border_y, border_w, border_h;
 
+
+#define MAX_TEXTURE_LEVELS 16
+
+enum
+{
+  TEXTURE_IMAGE,
+  TEXTURE_BOX,
+  TEXTURE_CYLINDER = TEXTURE_BOX + 6,
+  N_TEXTURES       = TEXTURE_CYLINDER + 2
+};
+
+/* The image and the box and cylinder maps, fetched into linear memory
+ * at the mip-level in use, so the render threads never have to go
+ * through the drawables' buffers.  Levels are kept once fetched.
+ */
+typedef struct
+{
+  gint32      drawable_id;
+  gint        width;
+  gint        height;
+  const Babl *format;
+  gint        bpp;
+  gint        level;
+  gpointer    levels[MAX_TEXTURE_LEVELS];
+} MapTexture;
+
+static MapTexture textures[N_TEXTURES];
+
 /******************/
 /* Implementation */
 /******************/
 
-GimpRGB
-peek (gint x,
-      gint y)
+static inline gint
+texture_width (const MapTexture *texture)
 {
+  return MAX (1, texture->width >> texture->level);
+}
+
+static inline gint
+texture_height (const MapTexture *texture)
+{
+  return MAX (1, texture->height >> texture->level);
+}
+
+static inline GimpRGB
+texture_peek (const MapTexture *texture,
+              gint              x,
+              gint              y)
+{
+  gsize   offset = (gsize) y * texture_width (texture) + x;
   GimpRGB color;
 
-  gegl_buffer_sample (source_buffer, x, y, NULL,
-                      &color, babl_format ("R'G'B'A double"),
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+  if (texture->bpp == 4)
+    {
+      const guchar *src = (const guchar *) texture->levels[texture->level] +
+                          offset * 4;
 
-  if (! babl_format_has_alpha (gegl_buffer_get_format (source_buffer)))
-    color.a = 1.0;
+      gimp_rgba_set_uchar (&color, src[0], src[1], src[2], src[3]);
+    }
+  else
+    {
+      const gfloat *src = (const gfloat *) texture->levels[texture->level] +
+                          offset * 4;
+
+      gimp_rgba_set (&color, src[0], src[1], src[2], src[3]);
+    }
 
   return color;
 }
 
+GimpRGB
+peek (gint x,
+      gint y)
+{
+  return texture_peek (&textures[TEXTURE_IMAGE], x, y);
+}
+
 static GimpRGB
 peek_box_image (gint image,
                 gint x,
                 gint y)
 {
-  GimpRGB color;
-
-  gegl_buffer_sample (box_buffers[image], x, y, NULL,
-                      &color, babl_format ("R'G'B'A double"),
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-
-  if (! babl_format_has_alpha (gegl_buffer_get_format (box_buffers[image])))
-    color.a = 1.0;
-
-  return color;
+  return texture_peek (&textures[TEXTURE_BOX + image], x, y);
 }
 
 static GimpRGB
@@ -88,16 +134,7 @@ peek_cylinder_image (gint image,
                      gint x,
                      gint y)
 {
-  GimpRGB color;
-
-  gegl_buffer_sample (cylinder_buffers[image], x, y, NULL,
-                      &color, babl_format ("R'G'B'A double"),
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-
-  if (! babl_format_has_alpha (gegl_buffer_get_format (cylinder_buffers[image])))
-    color.a = 1.0;
-
-  return color;
+  return texture_peek (&textures[TEXTURE_CYLINDER + image], x, y);
 }
 
 void
@@ -115,10 +152,12 @@ gint
 checkbounds (gint x,
              gint y)
 {
-  if (x < border_x ||
-      y < border_y ||
-      x >= border_x + border_w ||
-      y >= border_y + border_h)
+  gint level = textures[TEXTURE_IMAGE].level;
+
+  if (x < border_x >> level ||
+      y < border_y >> level ||
+      x >= (border_x + border_w) >> level ||
+      y >= (border_y + border_h) >> level)
     return FALSE;
   else
     return TRUE;
@@ -131,8 +170,8 @@ checkbounds_box_image (gint image,
 {
   gint w, h;
 
-  w = gegl_buffer_get_width  (box_buffers[image]);
-  h = gegl_buffer_get_height (box_buffers[image]);
+  w = texture_width  (&textures[TEXTURE_BOX + image]);
+  h = texture_height (&textures[TEXTURE_BOX + image]);
 
   if (x < 0 || y < 0 || x >= w || y >= h)
     return FALSE ;
@@ -147,8 +186,8 @@ checkbounds_cylinder_image (gint image,
 {
   gint w, h;
 
-  w = gegl_buffer_get_width  (cylinder_buffers[image]);
-  h = gegl_buffer_get_height (cylinder_buffers[image]);
+  w = texture_width  (&textures[TEXTURE_CYLINDER + image]);
+  h = texture_height (&textures[TEXTURE_CYLINDER + image]);
 
   if (x < 0 || y < 0 || x >= w || y >= h)
     return FALSE;
@@ -189,30 +228,35 @@ get_image_color (gdouble  u,
                  gdouble  v,
                  gint    *inside)
 {
+  gint    w, h;
   gint    x1, y1, x2, y2;
   GimpRGB p[4];
 
-  pos_to_int (u, v, &x1, &y1);
+  w = texture_width  (&textures[TEXTURE_IMAGE]);
+  h = texture_height (&textures[TEXTURE_IMAGE]);
+
+  x1 = (gint) ((u * (gdouble) w));
+  y1 = (gint) ((v * (gdouble) h));
 
   if (mapvals.tiled == TRUE)
     {
       *inside = TRUE;
 
-      if (x1 < 0) x1 = (width-1) - (-x1 % width);
-      else        x1 = x1 % width;
+      if (x1 < 0) x1 = (w-1) - (-x1 % w);
+      else        x1 = x1 % w;
 
-      if (y1 < 0) y1 = (height-1) - (-y1 % height);
-      else        y1 = y1 % height;
+      if (y1 < 0) y1 = (h-1) - (-y1 % h);
+      else        y1 = y1 % h;
 
-      x2 = (x1 + 1) % width;
-      y2 = (y1 + 1) % height;
+      x2 = (x1 + 1) % w;
+      y2 = (y1 + 1) % h;
 
       p[0] = peek (x1, y1);
       p[1] = peek (x2, y1);
       p[2] = peek (x1, y2);
       p[3] = peek (x2, y2);
 
-      return gimp_bilinear_rgba (u * width, v * height, p);
+      return gimp_bilinear_rgba (u * w, v * h, p);
     }
 
   if (checkbounds (x1, y1) == FALSE)
@@ -239,7 +283,7 @@ get_image_color (gdouble  u,
   p[2] = peek (x1, y2);
   p[3] = peek (x2, y2);
 
-  return gimp_bilinear_rgba (u * width, v * height, p);
+  return gimp_bilinear_rgba (u * w, v * h, p);
 }
 
 GimpRGB
@@ -251,8 +295,8 @@ get_box_image_color (gint    image,
   gint    x1, y1, x2, y2;
   GimpRGB p[4];
 
-  w = gegl_buffer_get_width  (box_buffers[image]);
-  h = gegl_buffer_get_height (box_buffers[image]);
+  w = texture_width  (&textures[TEXTURE_BOX + image]);
+  h = texture_height (&textures[TEXTURE_BOX + image]);
 
   x1 = (gint) ((u * (gdouble) w));
   y1 = (gint) ((v * (gdouble) h));
@@ -283,8 +327,8 @@ get_cylinder_image_color (gint    image,
   gint    x1, y1, x2, y2;
   GimpRGB p[4];
 
-  w = gegl_buffer_get_width  (cylinder_buffers[image]);
-  h = gegl_buffer_get_height (cylinder_buffers[image]);
+  w = texture_width  (&textures[TEXTURE_CYLINDER + image]);
+  h = texture_height (&textures[TEXTURE_CYLINDER + image]);
 
   x1 = (gint) ((u * (gdouble) w));
   y1 = (gint) ((v * (gdouble) h));
@@ -306,6 +350,91 @@ get_cylinder_image_color (gint    image,
   return gimp_bilinear_rgba (u * w, v * h, p);
 }
 
+/****************************************************/
+/* Fetch a drawable into linear memory at the first */
+/* mip-level that is no smaller than max_size, or   */
+/* at full size if max_size is 0.                   */
+/****************************************************/
+
+static void
+texture_setup (MapTexture   *texture,
+               GimpDrawable *drawable,
+               gint          max_size)
+{
+  gint32 drawable_id = gimp_item_get_id (GIMP_ITEM (drawable));
+  gint   level       = 0;
+
+  if (texture->drawable_id != drawable_id || ! texture->format)
+    {
+      const Babl *format = gimp_drawable_get_format (drawable);
+      gint        i;
+
+      for (i = 0; i < MAX_TEXTURE_LEVELS; i++)
+        g_clear_pointer (&texture->levels[i], g_free);
+
+      texture->drawable_id = drawable_id;
+      texture->width       = gimp_drawable_get_width  (drawable);
+      texture->height      = gimp_drawable_get_height (drawable);
+
+      /* 8-bit drawables convert losslessly, keep them small */
+      if (babl_format_get_type (format, 0) == babl_type ("u8"))
+        texture->format = babl_format ("R'G'B'A u8");
+      else
+        texture->format = babl_format ("R'G'B'A float");
+
+      texture->bpp = babl_format_get_bytes_per_pixel (texture->format);
+    }
+
+  if (max_size > 0)
+    {
+      while (level + 1 < MAX_TEXTURE_LEVELS &&
+             MAX (texture->width, texture->height) >> (level + 1) >= max_size)
+        level++;
+    }
+
+  texture->level = level;
+
+  if (! texture->levels[level])
+    {
+      GeglBuffer *buffer = gimp_drawable_get_buffer (drawable);
+      gint        w      = texture_width  (texture);
+      gint        h      = texture_height (texture);
+
+      texture->levels[level] = g_malloc ((gsize) w * h * texture->bpp);
+
+      gegl_buffer_get (buffer, GEGL_RECTANGLE (0, 0, w, h),
+                       1.0 / (1 << level),
+                       texture->format, texture->levels[level],
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      g_object_unref (buffer);
+    }
+}
+
+/* Set up the textures used by the current map type.  Must be called
+ * from the main thread, after init_compute().
+ */
+void
+textures_setup (gint max_size)
+{
+  gint i;
+
+  texture_setup (&textures[TEXTURE_IMAGE], input_drawable, max_size);
+
+  if (mapvals.maptype == MAP_BOX)
+    {
+      for (i = 0; i < 6; i++)
+        texture_setup (&textures[TEXTURE_BOX + i], box_drawables[i],
+                       max_size);
+    }
+  else if (mapvals.maptype == MAP_CYLINDER)
+    {
+      for (i = 0; i < 2; i++)
+        texture_setup (&textures[TEXTURE_CYLINDER + i], cylinder_drawables[i],
+                       max_size);
+    }
+}
+
 /****************************************/
 /* Allocate memory for temporary images */
 /****************************************/
@@ -12,10 +12,8 @@ extern GeglBuffer   *source_buffer;
 extern GeglBuffer   *dest_buffer;
 
 extern GimpDrawable *box_drawables[6];
-extern GeglBuffer   *box_buffers[6];
 
 extern GimpDrawable *cylinder_drawables[2];
-extern GeglBuffer   *cylinder_buffers[2];
 
 extern guchar          *preview_rgb_data;
 extern gint             preview_rgb_stride;
@@ -34,6 +32,7 @@ extern gint        image_setup              (GimpDrawable *drawable,
                                              gint          interactive,
                                              GimpProcedureConfig
                                                           *config);
+extern void        textures_setup           (gint          max_size);
 extern glong       in_xy_to_index           (gint          x,
                                              gint          y);
 extern glong       out_xy_to_index          (gint          x,
@@ -17,6 +17,10 @@
 #include "map-object-preview.h"
 
 
+/* Render the preview from textures about this large */
+#define PREVIEW_TEXTURE_SIZE (4 * PREVIEW_WIDTH)
+
+
 gdouble mat[3][4];
 gint    lightx, lighty;
 
@@ -88,6 +92,7 @@ compute_preview (gint x,
   gdouble      realw;
   gdouble      realh;
   GimpVector3  p1, p2;
+  GimpRGB     *colors;
   GimpRGB      color;
   GimpRGB      lightcheck, darkcheck;
   gint         xcnt, ycnt, f1, f2;
@@ -99,6 +104,8 @@ compute_preview (gint x,
   if (! preview_surface)
     return;
 
+  textures_setup (PREVIEW_TEXTURE_SIZE);
+
   p1 = int_to_pos (x, y);
   p2 = int_to_pos (x + w, y + h);
 
@@ -131,7 +138,10 @@ compute_preview (gint x,
                  GIMP_CHECK_LIGHT, GIMP_CHECK_LIGHT, GIMP_CHECK_LIGHT, 1.0);
   gimp_rgba_set (&darkcheck,
                  GIMP_CHECK_DARK, GIMP_CHECK_DARK, GIMP_CHECK_DARK, 1.0);
-  gimp_vector3_set (&p2, -1.0, -1.0, 0.0);
+
+  colors = g_new (GimpRGB, pw * ph);
+
+  render_rows (xpostab, pw, ypostab, ph, colors);
 
   cairo_surface_flush (preview_surface);
 
@@ -140,11 +150,7 @@ compute_preview (gint x,
       index = ycnt * preview_rgb_stride;
       for (xcnt = 0; xcnt < pw; xcnt++)
         {
-          p1.x = xpostab[xcnt];
-          p1.y = ypostab[ycnt];
-
-          p2 = p1;
-          color = (* get_ray_color) (&p1);
+          color = colors[ycnt * pw + xcnt];
 
           if (color.a < 1.0)
             {
@@ -176,6 +182,8 @@ compute_preview (gint x,
         }
     }
   cairo_surface_mark_dirty (preview_surface);
+
+  g_free (colors);
 }
 
 /*************************************************/